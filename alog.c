@@ -0,0 +1,592 @@
+/*
+*     alog.c
+*
+* 2006-2007 Copyright (c)
+* Robert Iakobashvili, <coroberti@gmail.com>
+* Michael Moser,  <moser.michael@gmail.com>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+// must be first include
+#include "fdsetsize.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "alog.h"
+#include "batch.h"
+#include "client.h"
+#include "conf.h"
+#include "loader.h"
+#include "zout.h"
+
+/* Size of a ring of a batch in bytes, should be a power of 2 */
+#define ALOG_RING_SIZE (4*1024*1024)
+
+/* Size of the writer output buffer */
+#define ALOG_OUT_BUFFER_SIZE (256*1024)
+
+/* Maximum length of a string in a record; longer strings are truncated */
+#define ALOG_STR_MAX 4096
+
+/* Maximum length of a formatted text by alog_printf () */
+#define ALOG_PRINTF_MAX 1024
+
+/* Writer sleep, when all rings are empty, usec */
+#define ALOG_IDLE_SLEEP 5000
+
+typedef enum alog_rec_kind
+{
+        ALOG_REC_PAD = 0, /* Skip till the end of the ring */
+        ALOG_REC_LINE,    /* Client log line, formatted by the writer */
+        ALOG_REC_TEXT,    /* Text to be written as is */
+} alog_rec_kind;
+
+/*
+   Record header, followed by the strings (not zero-terminated) of the
+   lengths. Records are 8-byte aligned.
+ */
+typedef struct alog_rec
+{
+        unsigned int len;
+        unsigned short kind;
+        unsigned short ind_len;
+        unsigned short data_len;
+        unsigned short url_len;
+        unsigned short url_target_len;
+        unsigned short reserved;
+        int client_index;
+        long offs;
+        long cycle;
+        long url_index;
+} alog_rec;
+
+#define ALOG_ALIGN(len) (((len) + 7) & ~7UL)
+
+/*
+   Single-producer (loading thread) single-consumer (writer) ring of a batch.
+   Positions are free-running byte counters.
+ */
+typedef struct alog_ring
+{
+        char* buf;
+
+        volatile unsigned long head;
+        volatile unsigned long tail;
+
+        struct batch_context* bctx;
+        FILE* out;
+
+        /* Records dropped by the producer, when the ring is full */
+        unsigned long dropped;
+
+        /*
+           Set by alog_close (). The writer drains the ring, removes it from
+           the rings and acknowledges by <released>.
+         */
+        volatile int closing;
+        volatile int released;
+} alog_ring;
+
+static alog_ring* volatile rings[BATCHES_MAX_NUM];
+
+static pthread_t writer_thread;
+static int writer_started = 0;
+static volatile int writer_stopping = 0;
+
+/* Accessed only by the writer thread */
+static char* out_buffer = NULL;
+static size_t out_len = 0;
+static unsigned long written_num = 0;
+
+static void* alog_writer (void* arg);
+static char* alog_reserve (alog_ring* r, size_t len);
+static void alog_commit (alog_ring* r, char* rec);
+static int alog_drain (alog_ring* r);
+
+/****************************************************************************************
+* Function name - alog_start
+*
+* Description - Starts the writer thread, when asynchronous logging is configured
+*               by -a command line option.
+*
+* Return Code/Output - On Success - 0, on Error -1
+****************************************************************************************/
+int alog_start ()
+{
+        if (!async_logging || writer_started)
+                return 0;
+
+        if (!(out_buffer = malloc (ALOG_OUT_BUFFER_SIZE)))
+        {
+                fprintf (stderr, "%s - error: malloc () failed with errno %d.\n",
+                         __func__, errno);
+                return -1;
+        }
+
+        if (pthread_create (&writer_thread, NULL, alog_writer, NULL))
+        {
+                fprintf (stderr, "%s - error: pthread_create () failed with errno %d.\n",
+                         __func__, errno);
+                free (out_buffer);
+                out_buffer = NULL;
+                return -1;
+        }
+
+        writer_started = 1;
+        atexit (alog_stop);
+
+        return 0;
+}
+
+/****************************************************************************************
+* Function name - alog_stop
+*
+* Description - Lets the writer thread to drain all the rings and joins it.
+*               Registered by alog_start () to run at exit.
+*
+* Return Code/Output - None
+****************************************************************************************/
+void alog_stop ()
+{
+        int i;
+        unsigned long dropped = 0;
+
+        if (!writer_started)
+                return;
+
+        writer_stopping = 1;
+        pthread_join (writer_thread, NULL);
+        writer_started = 0;
+
+        for (i = 0; i < BATCHES_MAX_NUM; i++)
+        {
+                if (rings[i])
+                        dropped += rings[i]->dropped;
+        }
+
+        if (dropped)
+        {
+                fprintf (stderr, "%s - %lu log records written, %lu dropped on full rings.\n",
+                         __func__, written_num, dropped);
+        }
+
+        free (out_buffer);
+        out_buffer = NULL;
+}
+
+/****************************************************************************************
+* Function name - alog_open
+*
+* Description - Allocates the ring of a batch and registers it with the writer thread
+*
+* Input -       *bctx - pointer to the batch context
+*               *out  - the batch logfile (or stderr)
+* Return Code/Output - On Success - 0, on Error -1
+****************************************************************************************/
+int alog_open (batch_context* bctx, FILE* out)
+{
+        alog_ring* r;
+        int i;
+
+        if (!writer_started || !out)
+                return 0;
+
+        if (!(r = calloc (1, sizeof (alog_ring))) ||
+            !(r->buf = malloc (ALOG_RING_SIZE)))
+        {
+                fprintf (stderr, "%s - error: allocation failed.\n", __func__);
+                free (r);
+                return -1;
+        }
+
+        r->bctx = bctx;
+        r->out = out;
+
+        for (i = 0; i < BATCHES_MAX_NUM; i++)
+        {
+                if (__sync_bool_compare_and_swap (&rings[i], NULL, r))
+                {
+                        bctx->alog = r;
+                        return 0;
+                }
+        }
+
+        fprintf (stderr, "%s - error: no free ring slot.\n", __func__);
+        free (r->buf);
+        free (r);
+        return -1;
+}
+
+/****************************************************************************************
+* Function name - alog_close
+*
+* Description - Waits for the writer thread to drain the ring of the batch and releases
+*               it. To be called prior to closing the batch logfile.
+*
+* Input -       *bctx - pointer to the batch context
+* Return Code/Output - None
+****************************************************************************************/
+void alog_close (batch_context* bctx)
+{
+        alog_ring* r = bctx->alog;
+        int i;
+
+        if (!r)
+                return;
+
+        bctx->alog = NULL;
+
+        r->closing = 1;
+        while (writer_started && !r->released)
+        {
+                usleep (ALOG_IDLE_SLEEP);
+        }
+
+        if (r->dropped)
+        {
+                fprintf (stderr, "%s - \"%s\" - %lu log records dropped on full ring.\n",
+                         __func__, bctx->batch_name, r->dropped);
+        }
+
+        if (!r->released)
+        {
+                /* No writer running */
+                for (i = 0; i < BATCHES_MAX_NUM; i++)
+                {
+                        if (rings[i] == r)
+                                rings[i] = NULL;
+                }
+        }
+
+        free (r->buf);
+        free (r);
+}
+
+/****************************************************************************************
+* Function name - alog_reserve
+*
+* Description - Reserves contiguous space for a record in the ring. When the space
+*               left till the end of the ring is not enough, pads it and wraps.
+*               Never waits: when the ring is full, the record is dropped.
+*
+* Input -       *r  - pointer to the ring
+*               len - 8-byte aligned length of the record
+* Return Code/Output - pointer to the record space or NULL, when the ring is full
+****************************************************************************************/
+static char* alog_reserve (alog_ring* r, size_t len)
+{
+        const unsigned long tail = r->tail;
+        const unsigned long off = tail & (ALOG_RING_SIZE - 1);
+        const unsigned long contiguous = ALOG_RING_SIZE - off;
+        const unsigned long need = (contiguous < len) ? contiguous + len : len;
+
+        if (tail + need - r->head > ALOG_RING_SIZE)
+        {
+                r->dropped++;
+                return NULL;
+        }
+
+        if (contiguous < len)
+        {
+                alog_rec* pad = (alog_rec *) (r->buf + off);
+
+                pad->len = contiguous;
+                pad->kind = ALOG_REC_PAD;
+
+                __sync_synchronize ();
+                r->tail = tail + contiguous;
+
+                return r->buf;
+        }
+
+        return r->buf + off;
+}
+
+static void alog_commit (alog_ring* r, char* rec)
+{
+        __sync_synchronize ();
+        r->tail += ((alog_rec *) rec)->len;
+}
+
+static char* alog_copy (char* dst, const char* src, unsigned short len)
+{
+        memcpy (dst, src, len);
+        return dst + len;
+}
+
+/****************************************************************************************
+* Function name - alog_line
+*
+* Description - Queues a client log line, formatted later by the writer
+*
+* Input -       *cctx        - pointer to the client context
+*               offs         - msec since the start of the load
+*               *ind         - indication string, e.g. "!! OK"
+*               *data        - the logged data
+*               *url         - effective url or NULL
+*               *url_target  - configured url, when differs from the effective one, or NULL
+* Return Code/Output - None
+****************************************************************************************/
+void alog_line (client_context* cctx,
+                long offs,
+                const char* ind,
+                const char* data,
+                const char* url,
+                const char* url_target)
+{
+        alog_ring* r = cctx->bctx->alog;
+        size_t ind_len = strlen (ind);
+        size_t data_len = strlen (data);
+        size_t url_len = url ? strlen (url) : 0;
+        size_t url_target_len = url_target ? strlen (url_target) : 0;
+        alog_rec* rec;
+        char* p;
+
+        if (data_len && data[data_len - 1] == '\n')
+                data_len--;
+
+        if (ind_len > ALOG_STR_MAX) ind_len = ALOG_STR_MAX;
+        if (data_len > ALOG_STR_MAX) data_len = ALOG_STR_MAX;
+        if (url_len > ALOG_STR_MAX) url_len = ALOG_STR_MAX;
+        if (url_target_len > ALOG_STR_MAX) url_target_len = ALOG_STR_MAX;
+
+        if (!(rec = (alog_rec *) alog_reserve (r, ALOG_ALIGN (sizeof (alog_rec) + ind_len +
+                                                              data_len + url_len +
+                                                              url_target_len))))
+                return;
+
+        rec->len = ALOG_ALIGN (sizeof (alog_rec) + ind_len + data_len + url_len + url_target_len);
+        rec->kind = ALOG_REC_LINE;
+        rec->ind_len = ind_len;
+        rec->data_len = data_len;
+        rec->url_len = url_len;
+        rec->url_target_len = url_target_len;
+        rec->client_index = cctx->client_index;
+        rec->offs = offs;
+        rec->cycle = cctx->cycle_num;
+        rec->url_index = cctx->url_curr_index;
+
+        p = (char *) (rec + 1);
+        p = alog_copy (p, ind, ind_len);
+        p = alog_copy (p, data, data_len);
+        p = alog_copy (p, url, url_len);
+        alog_copy (p, url_target, url_target_len);
+
+        alog_commit (r, (char *) rec);
+}
+
+/****************************************************************************************
+* Function name - alog_text
+*
+* Description - Queues text to be written to the client logfile as is
+*
+* Input -       *cctx - pointer to the client context
+*               *text - the text
+*               len   - length of the text
+* Return Code/Output - None
+****************************************************************************************/
+void alog_text (client_context* cctx, const char* text, size_t len)
+{
+        alog_ring* r = cctx->bctx->alog;
+        alog_rec* rec;
+
+        if (len > ALOG_STR_MAX)
+                len = ALOG_STR_MAX;
+
+        if (!(rec = (alog_rec *) alog_reserve (r, ALOG_ALIGN (sizeof (alog_rec) + len))))
+                return;
+
+        rec->len = ALOG_ALIGN (sizeof (alog_rec) + len);
+        rec->kind = ALOG_REC_TEXT;
+        rec->data_len = len;
+        memcpy (rec + 1, text, len);
+
+        alog_commit (r, (char *) rec);
+}
+
+/****************************************************************************************
+* Function name - alog_printf
+*
+* Description - Formats to a record and queues the text to be written to the client
+*               logfile
+*
+* Input -       *cctx - pointer to the client context
+*               *fmt  - printf format
+* Return Code/Output - None
+****************************************************************************************/
+void alog_printf (client_context* cctx, const char* fmt, ...)
+{
+        char buf[ALOG_PRINTF_MAX];
+        va_list ap;
+        int len;
+
+        va_start (ap, fmt);
+        len = vsnprintf (buf, sizeof (buf), fmt, ap);
+        va_end (ap);
+
+        if (len < 0)
+                return;
+
+        alog_text (cctx, buf, (size_t) len < sizeof (buf) ? (size_t) len : sizeof (buf) - 1);
+}
+
+/*
+   Writer output buffer helpers. The buffer is written out, when a record
+   may not fit, and at the end of each pass over a ring.
+ */
+static void alog_out_flush (FILE* out)
+{
+        if (out_len)
+        {
+                fwrite (out_buffer, 1, out_len, out);
+                out_len = 0;
+        }
+}
+
+static void alog_out (const char* s, size_t len)
+{
+        memcpy (out_buffer + out_len, s, len);
+        out_len += len;
+}
+
+/****************************************************************************************
+* Function name - alog_drain
+*
+* Description - Formats and writes all the records of a ring. Called only by the
+*               writer thread.
+*
+* Input -       *r - pointer to the ring
+* Return Code/Output - number of records taken from the ring
+****************************************************************************************/
+static int alog_drain (alog_ring* r)
+{
+        unsigned long head = r->head;
+        const unsigned long tail = r->tail;
+        int records = 0;
+
+        __sync_synchronize ();
+
+        while (head != tail)
+        {
+                alog_rec* rec = (alog_rec *) (r->buf + (head & (ALOG_RING_SIZE - 1)));
+                const char* p = (const char *) (rec + 1);
+
+                /* A record with the line prefix and a newline fits 512 bytes more */
+                if (out_len + rec->len + 512 > ALOG_OUT_BUFFER_SIZE)
+                        alog_out_flush (r->out);
+
+                if (rec->kind == ALOG_REC_LINE)
+                {
+                        char prefix[128];
+                        const int plen = snprintf (prefix, sizeof (prefix), "%ld %ld %ld %s",
+                                                   rec->offs, rec->cycle, rec->url_index,
+                                                   client_name (&r->bctx->cctx_array[rec->client_index]));
+
+                        alog_out (prefix, plen < (int) sizeof (prefix) ? plen : (int) sizeof (prefix) - 1);
+                        alog_out (p, rec->ind_len);
+                        alog_out (" ", 1);
+                        alog_out (p + rec->ind_len, rec->data_len);
+                        p += rec->ind_len + rec->data_len;
+
+                        if (rec->url_len)
+                        {
+                                alog_out (" eff-url: url ", 14);
+                                alog_out (p, rec->url_len);
+                                p += rec->url_len;
+                        }
+                        if (rec->url_target_len)
+                        {
+                                alog_out (" url: url ", 10);
+                                alog_out (p, rec->url_target_len);
+                        }
+                        alog_out ("\n", 1);
+                        records++;
+                }
+                else if (rec->kind == ALOG_REC_TEXT)
+                {
+                        alog_out (p, rec->data_len);
+                        records++;
+                }
+
+                head += rec->len;
+        }
+
+        if (records)
+        {
+                alog_out_flush (r->out);
+                fflush (r->out);
+
+                /* The logfile rewinding is done here, not by the loading thread */
+                if (r->out != stderr && !zout_file (r->out) &&
+                    ftell (r->out) > logfile_rewind_size*1024*1024)
+                {
+                        rewind (r->out);
+                }
+        }
+
+        __sync_synchronize ();
+        r->head = head;
+
+        written_num += records;
+
+        return records;
+}
+
+static void* alog_writer (void* arg)
+{
+        (void) arg;
+
+        for (;;)
+        {
+                const int stopping = writer_stopping;
+                int i, records = 0;
+
+                for (i = 0; i < BATCHES_MAX_NUM; i++)
+                {
+                        alog_ring* r = rings[i];
+
+                        if (!r)
+                                continue;
+
+                        const int closing = r->closing;
+
+                        records += alog_drain (r);
+
+                        if (closing && r->head == r->tail)
+                        {
+                                /* The ring is not touched by the writer any more */
+                                rings[i] = NULL;
+                                __sync_synchronize ();
+                                r->released = 1;
+                        }
+                }
+
+                if (stopping)
+                        break;
+
+                if (!records)
+                        usleep (ALOG_IDLE_SLEEP);
+        }
+
+        return NULL;
+}
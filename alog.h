@@ -0,0 +1,133 @@
+/*
+*     alog.h
+*
+* 2006-2007 Copyright (c)
+* Robert Iakobashvili, <coroberti@gmail.com>
+* Michael Moser,  <moser.michael@gmail.com>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#ifndef ALOG_H
+#define ALOG_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+/*
+   Asynchronous batched logging of client activities (-a command line option).
+
+   Loading threads never format or write the batch logfile. They put compact
+   binary records to a lock-free single-producer single-consumer ring of their
+   batch. A writer thread takes the records from all rings, formats them into
+   a large buffer and writes it out in batches. When the writer falls behind
+   and a ring is full, new records are dropped and counted.
+ */
+
+struct batch_context;
+struct client_context;
+
+/****************************************************************************************
+* Function name - alog_start
+*
+* Description - Starts the writer thread, when asynchronous logging is configured
+*               by -a command line option.
+*
+* Return Code/Output - On Success - 0, on Error -1
+****************************************************************************************/
+int alog_start ();
+
+/****************************************************************************************
+* Function name - alog_stop
+*
+* Description - Lets the writer thread to drain all the rings and joins it.
+*               Registered by alog_start () to run at exit.
+*
+* Return Code/Output - None
+****************************************************************************************/
+void alog_stop ();
+
+/****************************************************************************************
+* Function name - alog_open
+*
+* Description - Allocates the ring of a batch and registers it with the writer thread
+*
+* Input -       *bctx - pointer to the batch context
+*               *out  - the batch logfile (or stderr)
+* Return Code/Output - On Success - 0, on Error -1
+****************************************************************************************/
+int alog_open (struct batch_context* bctx, FILE* out);
+
+/****************************************************************************************
+* Function name - alog_close
+*
+* Description - Waits for the writer thread to drain the ring of the batch and releases
+*               it. To be called prior to closing the batch logfile.
+*
+* Input -       *bctx - pointer to the batch context
+* Return Code/Output - None
+****************************************************************************************/
+void alog_close (struct batch_context* bctx);
+
+/****************************************************************************************
+* Function name - alog_line
+*
+* Description - Queues a client log line, formatted by the writer as
+*               "<msec_offset> <cycle> <url_no> <client> <ind> <data>[ eff-url: url <url>]
+*               [ url: url <url_target>]". Trailing newline of <data> is dropped.
+*
+* Input -       *cctx        - pointer to the client context
+*               offs         - msec since the start of the load
+*               *ind         - indication string, e.g. "!! OK"
+*               *data        - the logged data
+*               *url         - effective url or NULL
+*               *url_target  - configured url, when differs from the effective one, or NULL
+* Return Code/Output - None
+****************************************************************************************/
+void alog_line (struct client_context* cctx,
+                long offs,
+                const char* ind,
+                const char* data,
+                const char* url,
+                const char* url_target);
+
+/****************************************************************************************
+* Function name - alog_text
+*
+* Description - Queues text to be written to the client logfile as is
+*
+* Input -       *cctx - pointer to the client context
+*               *text - the text
+*               len   - length of the text
+* Return Code/Output - None
+****************************************************************************************/
+void alog_text (struct client_context* cctx, const char* text, size_t len);
+
+/****************************************************************************************
+* Function name - alog_printf
+*
+* Description - Formats to a record and queues the text to be written to the client
+*               logfile. Used for rare messages, hot paths use alog_line ().
+*
+* Input -       *cctx - pointer to the client context
+*               *fmt  - printf format
+* Return Code/Output - None
+****************************************************************************************/
+void alog_printf (struct client_context* cctx, const char* fmt, ...)
+        __attribute__ ((format (printf, 2, 3)));
+
+#endif /* ALOG_H */
@@ -22,6 +22,9 @@
 // must be the first include
 #include "fdsetsize.h"
 
+#include <string.h>
+#include <arpa/inet.h>
+
 #include "batch.h"
 
 int is_batch_group_leader (batch_context* bctx)
@@ -29,22 +32,105 @@ int is_batch_group_leader (batch_context* bctx)
         return !bctx->batch_id;
 }
 
-size_t next_ipv4_shared_index (batch_context* bctx)
+/*
+   Offset of the source IP-address of a client from the minimal address of
+   the batch: round-robin over the shared addresses or the client index.
+   With PIPELINING all the clients take the minimal address, since libcurl
+   re-uses a connection only for handles with the same interface.
+ */
+static size_t client_ip_offset (batch_context* bctx, size_t client_index)
+{
+        if (bctx->pipelining)
+        {
+                return 0;
+        }
+
+        return bctx->ip_shared_num ?
+                client_index % (size_t) bctx->ip_shared_num : client_index;
+}
+
+/****************************************************************************************
+* Function name - client_ip_sockaddr
+*
+* Description - Makes the source socket address of a client, with zero port, from
+*               the minimal IPv4 or IPv6 address of the batch and the client index.
+*
+* Input -       *bctx        - pointer to the batch context
+*               client_index - index of the client in the batch
+* Input/Output  *ss          - the socket address
+*               *len         - length of the socket address
+* Return Code/Output - On Success - 0, on Error -1, when an IPv6 address passes the scope
+****************************************************************************************/
+int client_ip_sockaddr (batch_context* bctx,
+                        size_t client_index,
+                        struct sockaddr_storage* ss,
+                        socklen_t* len)
 {
-        size_t to_return = bctx->ipv4_shared_index;
+        size_t offset = client_ip_offset (bctx, client_index);
+
+        memset (ss, 0, sizeof (*ss));
+
+        if (!bctx->ipv6)
+        {
+                struct sockaddr_in* sin = (struct sockaddr_in *) ss;
+
+                sin->sin_family = AF_INET;
+                sin->sin_addr.s_addr = htonl (bctx->ip_addr_min + offset);
+                *len = sizeof (*sin);
+        }
+        else
+        {
+                struct sockaddr_in6* sin6 = (struct sockaddr_in6 *) ss;
+                int i;
+
+                sin6->sin6_family = AF_INET6;
+                sin6->sin6_addr = bctx->ipv6_addr_min;
+                *len = sizeof (*sin6);
+
+                /* Add the offset, keeping the first two bytes of the scope */
+                for (i = 15; i > 1 && offset; i--)
+                {
+                        offset += sin6->sin6_addr.s6_addr[i];
+                        sin6->sin6_addr.s6_addr[i] = offset & 0xff;
+                        offset >>= 8;
+                }
 
-        if (++bctx->ipv4_shared_index == (size_t)bctx->ip_shared_num)
-                bctx->ipv4_shared_index = 0;
+                if (offset)
+                {
+                        return -1;
+                }
+        }
 
-        return to_return;
+        return 0;
 }
 
-size_t next_ipv6_shared_index (batch_context* bctx)
+/****************************************************************************************
+* Function name - client_ip_str
+*
+* Description - Prints text presentation of the source IP-address of a client.
+*
+* Input -       *bctx        - pointer to the batch context
+*               client_index - index of the client in the batch
+* Input/Output  *buf         - buffer of at least INET6_ADDRSTRLEN
+*               len          - size of the buffer
+* Return Code/Output - On Success - buf, on Error - NULL
+****************************************************************************************/
+const char* client_ip_str (batch_context* bctx,
+                           size_t client_index,
+                           char* buf,
+                           size_t len)
 {
-        size_t to_return = bctx->ipv6_shared_index;
+        struct sockaddr_storage ss;
+        socklen_t ss_len;
 
-        if (++bctx->ipv6_shared_index == (size_t)bctx->ip_shared_num)
-                bctx->ipv6_shared_index = 0;
+        if (client_ip_sockaddr (bctx, client_index, &ss, &ss_len) == -1)
+        {
+                return NULL;
+        }
 
-        return to_return;
+        return inet_ntop (ss.ss_family,
+                          ss.ss_family == AF_INET ?
+                          (const void *) &((struct sockaddr_in *) &ss)->sin_addr :
+                          (const void *) &((struct sockaddr_in6 *) &ss)->sin6_addr,
+                          buf, len);
 }
@@ -26,6 +26,7 @@
 #define BATCH_H
 
 #include <stddef.h>
+#include <sys/socket.h>
 #include <netinet/in.h>
 #include <pthread.h>
 
@@ -36,12 +37,25 @@
 #include "url.h"
 #include "statistics.h"
 
+/* Partitioning of LOCAL_PORT_MIN - LOCAL_PORT_MAX range */
+#define LOCAL_PORT_PARTITION_CLIENT 0
+#define LOCAL_PORT_PARTITION_THREAD 1
+
 #define BATCH_NAME_SIZE 64
 #define BATCH_NAME_EXTRA_SIZE 12
 #define POST_BUFFER_SIZE 256
 
 #define CUSTOM_HDRS_MAX_NUM 64
 
+/* Values of PIPELINING tag */
+#define PIPELINING_OFF 0
+#define PIPELINING_ON 1
+#define PIPELINING_MULTIPLEX 2
+
+/* Maximum number of steps of POOL_CONNECTIONS and default step duration */
+#define POOL_STEPS_MAX 32
+#define POOL_STEP_DURATION_DEFAULT 10
+
 typedef enum form_usagetype
 {
         FORM_USAGETYPE_START = 0,
@@ -117,7 +131,52 @@ typedef struct batch_context
          */
         int ip_shared_num;
 
-        size_t ipv4_shared_index;
+        /*
+           Socket tuning of the batch connections: SO_LINGER {1,0} for RST close,
+           TCP_NODELAY (0 - libcurl default, 1 - on, -1 - off), send and receive
+           buffers in bytes (0 - system default) and IP_BIND_ADDRESS_NO_PORT.
+         */
+        int sock_linger_rst;
+        int sock_nodelay;
+        int sock_sndbuf;
+        int sock_rcvbuf;
+        int sock_bind_no_port;
+
+        /*
+           Range of local ports, 0 - ephemeral ports, partitioned between the
+           clients or the threads (LOCAL_PORT_PARTITION_*).
+         */
+        int local_port_min;
+        int local_port_max;
+        int local_port_partition;
+
+        /*
+           Resolving of the url hostnames (DNS_MODE_*) and the interval of
+           re-resolving of pinned addresses in seconds, 0 - no refresh.
+         */
+        int dns_mode;
+        int dns_refresh_interval;
+
+        /* Transport engine of the urls (ENGINE_*) */
+        int engine;
+
+        /*
+           Pipelining or multiplexing (PIPELINING_*) of the requests of the
+           clients over shared connections, the maximum number of connections
+           to a host and of requests sent on a connection, 0 - libcurl default.
+         */
+        int pipelining;
+        int max_host_connections;
+        int max_pipeline_length;
+
+        /*
+           Connection-pool mode: numbers of connections of the steps, requests
+           in flight per connection and duration of a step in seconds.
+         */
+        int pool_conns[POOL_STEPS_MAX];
+        int pool_conns_num;
+        int pool_in_flight;
+        int pool_step_duration;
 
         /*
            CIDR netmask number from 0 to 128, like 16 or 24, etc. If the input netmask is
@@ -134,10 +193,6 @@ typedef struct batch_context
         /* Miximum IPv6-address of a client in the batch. */
         struct in6_addr ipv6_addr_max;
 
-        struct in6_addr in6_prev, in6_new;
-
-        size_t ipv6_shared_index;
-
         /*
            Number of cycles to repeat the urls downloads and afterwards sleeping
            cycles. Zero means run it until time to run is exhausted.
@@ -204,9 +259,6 @@ typedef struct batch_context
         /* Multiple handle for curl. Contains all curl handles of a batch */
         CURLM *multiple_handle;
 
-        /* Assisting array of pointers to ip-addresses */
-        char** ip_addr_array;
-
         /* Current parsing state. Used on reading and parsing conf-file. */
         size_t batch_init_state;
 
@@ -216,6 +268,23 @@ typedef struct batch_context
         /* Array of all client contexts for the batch */
         struct client_context* cctx_array;
 
+        /*
+           Side tables of the client contexts, indexed by client_index.
+           Each table is allocated only, when required by the configuration.
+         */
+
+        /* Client statistics for <batch-name>.ctx, when DUMP_CLIENTS is enabled */
+        struct client_stat* cstats;
+
+        /* Client POST and GET form buffers, when urls have FORM_STRING */
+        struct client_forms* cforms;
+
+        /* Client response logfiles, when urls have LOG_RESP_HEADERS/BODIES */
+        struct client_resp_logs* cresp_logs;
+
+        /* Client fetch decisions, urls_num per client, when FETCH_PROBABILITY_ONCE */
+        char* fetch_decisions;
+
         /* Number of clients free to send fixed rate requests */
         int free_clients_count;
 
@@ -280,9 +349,44 @@ typedef struct batch_context
         /* The file to be used for operational statistics output */
         FILE* opstats_file;
 
+        /* Ring of asynchronous client logging (-a), NULL when logging is synchronous */
+        struct alog_ring* alog;
+
+        /* Tail-based logging state (-T), NULL when all traces are logged */
+        struct tlog* tlog;
+
+        /* Segmented store of responses, NULL when responses are logged to files */
+        struct rstore* rstore;
+
+        /* Heaps of the slowest requests per url (-k), NULL when not captured */
+        struct topk* topk;
+
+        /* Log responses to the segmented store of the batch, LOG_RESP_SEGMENTS */
+        int log_resp_segments;
+
+        /* Duplicate client handles from url templates, HANDLE_TEMPLATES */
+        int use_handle_templates;
+
+        /* Template handles indexed by url, NULL when not used */
+        CURL** url_templates;
+
+        /* Shares of the urls per batch or for all batches, SHARE_SCOPE */
+        int share_scope;
+        struct share_set* share;
+
+        /* Compiled urls and connections of the fast engine, NULL when not used */
+        struct fast_engine* fast;
+
+        /* Free pool of reset CURL handles of finished and failed clients */
+        CURL** handle_pool;
+        int handle_pool_num;
+
         /* Dump operational statistics indicator, 0: no dump */
         int dump_opstats;
 
+        /* Dump client based statistics to <batch-name>.ctx indicator, 0: no dump */
+        int dump_clients;
+
         /* Timestamp, when the loading started */
         unsigned long start_time;
 
@@ -304,10 +408,16 @@ typedef struct batch_context
         /* Array of HTTP stats for the URLs */
         stat_point* url_stats;
 
+        /* Accomplished transfers counted for 1 of N sampling of TCP_INFO (-I) */
+        unsigned long tcp_info_count;
+
         /* Operations statistics */
         op_stat_point op_delta;
         op_stat_point op_total;
 
+        /* Self-profiling of the batch thread event loop */
+        loop_prof prof;
+
         /* Count of response times dumped before new-line,
            used to limit line length */
         int ct_resps;
@@ -316,8 +426,37 @@ typedef struct batch_context
 
 int is_batch_group_leader (batch_context* bctx);
 
-size_t next_ipv4_shared_index (batch_context* bctx);
-
-size_t next_ipv6_shared_index (batch_context* bctx);
+/****************************************************************************************
+* Function name - client_ip_sockaddr
+*
+* Description - Makes the source socket address of a client, with zero port, from
+*               the minimal IPv4 or IPv6 address of the batch and the client index.
+*
+* Input -       *bctx        - pointer to the batch context
+*               client_index - index of the client in the batch
+* Input/Output  *ss          - the socket address
+*               *len         - length of the socket address
+* Return Code/Output - On Success - 0, on Error -1, when an IPv6 address passes the scope
+****************************************************************************************/
+int client_ip_sockaddr (batch_context* bctx,
+                        size_t client_index,
+                        struct sockaddr_storage* ss,
+                        socklen_t* len);
+
+/****************************************************************************************
+* Function name - client_ip_str
+*
+* Description - Prints text presentation of the source IP-address of a client.
+*
+* Input -       *bctx        - pointer to the batch context
+*               client_index - index of the client in the batch
+* Input/Output  *buf         - buffer of at least INET6_ADDRSTRLEN
+*               len          - size of the buffer
+* Return Code/Output - On Success - buf, on Error - NULL
+****************************************************************************************/
+const char* client_ip_str (batch_context* bctx,
+                           size_t client_index,
+                           char* buf,
+                           size_t len);
 
 #endif /* BATCH_H */
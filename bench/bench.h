@@ -0,0 +1,85 @@
+/*
+ *     bench.h
+ *
+ * 2006-2007 Copyright (c)
+ * Robert Iakobashvili, <coroberti@gmail.com>
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+/*
+   Microbenchmarks of curl-loader core data structures, built by
+   "make bench". Each benchmark prints tab-separated result rows, one per
+   measured case, after a '#'-commented header line:
+
+   bench  case  n  ops  sec  ops_per_sec  ns_per_op  mb_per_sec
+
+   <n> is the size parameter of the case, e.g. number of timers in queue,
+   and <mb_per_sec> is zero for cases not processing bytes.
+ */
+
+/****************************************************************************************
+* Function name - bench_now
+*
+* Description - Delivers monotonic timestamp in seconds
+*
+* Return Code/Output - timestamp in seconds
+****************************************************************************************/
+double bench_now ();
+
+/****************************************************************************************
+* Function name - bench_header
+*
+* Description - Prints the commented header of the result columns
+*
+* Return Code/Output - None
+****************************************************************************************/
+void bench_header ();
+
+/****************************************************************************************
+* Function name - bench_report
+*
+* Description - Prints a result row
+*
+* Input -       *bench - name of the benchmark, e.g. "timer_queue"
+*               *name  - name of the case, e.g. "schedule"
+*               n      - size parameter of the case
+*               ops    - number of operations done
+*               sec    - seconds spent
+*               bytes  - number of bytes processed or zero
+* Return Code/Output - None
+****************************************************************************************/
+void bench_report (const char* bench,
+                   const char* name,
+                   unsigned long n,
+                   unsigned long ops,
+                   double sec,
+                   unsigned long long bytes);
+
+/****************************************************************************************
+* Function name - bench_rand
+*
+* Description - Fast deterministic pseudo-random numbers (xorshift), so that
+*               benchmark runs are repeatable
+*
+* Return Code/Output - pseudo-random number
+****************************************************************************************/
+unsigned long bench_rand ();
+
+#endif /* BENCH_H */
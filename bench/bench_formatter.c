@@ -0,0 +1,68 @@
+/*
+ *     bench_formatter.c
+ *
+ * 2006-2007 Copyright (c)
+ * Robert Iakobashvili, <coroberti@gmail.com>
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+   Rate of forming POST buffers and GET URLs from FORM_STRING templates
+   with the records of FORM_RECORDS_FILE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "url_formatter.h"
+
+#include "bench.h"
+
+#define BENCH_FORMATTER_OPS 1000000
+
+int main ()
+{
+        const char* form = "user={0}&password={1}&session={2}";
+        form_records_cdata fcd;
+        char buffer[512];
+        unsigned long i;
+        double start;
+
+        memset (&fcd, 0, sizeof (fcd));
+        fcd.form_tokens[0] = "user0123";
+        fcd.form_tokens[1] = "secret-password";
+        fcd.form_tokens[2] = "0123456789abcdef0123456789abcdef";
+
+        bench_header ();
+
+        /* The formatter traces its tokens to stderr */
+        if (! freopen ("/dev/null", "w", stderr))
+        {
+                return 1;
+        }
+
+        start = bench_now ();
+        for (i = 0; i < BENCH_FORMATTER_OPS; i++)
+        {
+                url_formatter (buffer, sizeof (buffer), form, &fcd);
+        }
+        bench_report ("url_formatter", "form_3tokens", 3, BENCH_FORMATTER_OPS,
+                      bench_now () - start, 0);
+
+        return 0;
+}
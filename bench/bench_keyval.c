@@ -0,0 +1,147 @@
+/*
+ *     bench_keyval.c
+ *
+ * 2006-2007 Copyright (c)
+ * Robert Iakobashvili, <coroberti@gmail.com>
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+   Scanning rate of the keyval engine, searching server responses for
+   keywords of RESPONSE_TOKEN tags and collecting their values.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "keyval.h"
+
+#include "bench.h"
+
+#define BENCH_KEYVAL_BODY_SIZE (1024*1024)
+#define BENCH_KEYVAL_CHUNK 4096
+#define BENCH_KEYVAL_ROUNDS 20
+
+static char* bench_keyval_body ()
+{
+        static const char* words[] =
+                {"<div class=\"item\">", "value", "session", "=", "\"", "lorem ",
+                 "ipsum ", "</div>\n", "token ", "dolor "};
+        char* body;
+        size_t len = 0;
+
+        if (! (body = malloc (BENCH_KEYVAL_BODY_SIZE + 1)))
+        {
+                return NULL;
+        }
+
+        while (len < BENCH_KEYVAL_BODY_SIZE)
+        {
+                const char* w = words[bench_rand () % (sizeof (words) / sizeof (words[0]))];
+                size_t wlen = strlen (w);
+
+                if (len + wlen > BENCH_KEYVAL_BODY_SIZE)
+                {
+                        wlen = BENCH_KEYVAL_BODY_SIZE - len;
+                }
+                memcpy (body + len, w, wlen);
+                len += wlen;
+        }
+        body[len] = '\0';
+
+        /* The keyword searched for, with its value at the very end */
+        memcpy (body + len - 32, " csrftoken=\"0123456789abcdef\" \n", 31);
+
+        return body;
+}
+
+static int bench_keyval (char* body, int keys_num)
+{
+        static char* keys[] = {"csrftoken", "absentkey1", "absentkey2", "absentkey3"};
+        static int context;
+        unsigned long chunks = 0;
+        char name[32];
+        double start;
+        int i, round;
+
+        if (keyval_start (1) < 0)
+        {
+                fprintf (stderr, "%s - error: keyval_start () failed.\n", __func__);
+                return -1;
+        }
+
+        for (i = 0; i < keys_num; i++)
+        {
+                if (keyval_create (0, &context, keys[i]) < 0)
+                {
+                        fprintf (stderr, "%s - error: keyval_create () failed.\n", __func__);
+                        return -1;
+                }
+        }
+
+        start = bench_now ();
+        for (round = 0; round < BENCH_KEYVAL_ROUNDS; round++)
+        {
+                keyval_init (0, &context);
+
+                for (i = 0; i < BENCH_KEYVAL_BODY_SIZE; i += BENCH_KEYVAL_CHUNK)
+                {
+                        keyval_scan (0, &context, body + i, BENCH_KEYVAL_CHUNK);
+                        chunks++;
+                }
+
+                keyval_flush (0, &context);
+        }
+
+        snprintf (name, sizeof (name), "scan_%dkeys", keys_num);
+        bench_report ("keyval", name, keys_num, chunks, bench_now () - start,
+                      (unsigned long long) BENCH_KEYVAL_ROUNDS * BENCH_KEYVAL_BODY_SIZE);
+
+        if (! keyval_lookup (keys[0], 0))
+        {
+                fprintf (stderr, "%s - error: value of \"%s\" not found.\n",
+                         __func__, keys[0]);
+                return -1;
+        }
+
+        keyval_stop ();
+
+        return 0;
+}
+
+int main ()
+{
+        char* body;
+
+        if (! (body = bench_keyval_body ()))
+        {
+                fprintf (stderr, "%s - error: allocation failed.\n", __func__);
+                return 1;
+        }
+
+        bench_header ();
+
+        if (bench_keyval (body, 1) == -1 || bench_keyval (body, 4) == -1)
+        {
+                return 1;
+        }
+
+        free (body);
+
+        return 0;
+}
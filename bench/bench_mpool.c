@@ -0,0 +1,103 @@
+/*
+ *     bench_mpool.c
+ *
+ * 2006-2007 Copyright (c)
+ * Robert Iakobashvili, <coroberti@gmail.com>
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+   Throughput of the memory pool, used for the timer queue nodes.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "mpool.h"
+#include "cl_alloc.h"
+
+#include "bench.h"
+
+#define BENCH_MPOOL_OBJ_SIZE 64
+#define BENCH_MPOOL_ROUNDS 100
+
+static int bench_mpool (unsigned long n)
+{
+        mpool pool;
+        allocatable** objs;
+        unsigned long i, round, ops = 0;
+        double start;
+
+        if (! (objs = cl_calloc (n, sizeof (allocatable*))))
+        {
+                fprintf (stderr, "%s - error: allocation failed.\n", __func__);
+                return -1;
+        }
+
+        start = bench_now ();
+        if (mpool_init (&pool, BENCH_MPOOL_OBJ_SIZE, n) == -1)
+        {
+                fprintf (stderr, "%s - error: mpool_init () failed.\n", __func__);
+                return -1;
+        }
+        bench_report ("mpool", "init", n, n, bench_now () - start, 0);
+
+        /* Take a batch of n objects and return it, a number of rounds */
+        start = bench_now ();
+        for (round = 0; round < BENCH_MPOOL_ROUNDS; round++)
+        {
+                for (i = 0; i < n; i++)
+                {
+                        if (! (objs[i] = mpool_take_obj (&pool)))
+                        {
+                                fprintf (stderr, "%s - error: mpool_take_obj () failed.\n",
+                                         __func__);
+                                return -1;
+                        }
+                }
+
+                for (i = 0; i < n; i++)
+                {
+                        mpool_return_obj (&pool, objs[i]);
+                }
+                ops += 2 * n;
+        }
+        bench_report ("mpool", "take_return", n, ops, bench_now () - start, 0);
+
+        mpool_free (&pool);
+        free (objs);
+
+        return 0;
+}
+
+int main ()
+{
+        static const unsigned long sizes[] = {1000, 10000, 100000};
+        size_t i;
+
+        bench_header ();
+
+        for (i = 0; i < sizeof (sizes) / sizeof (sizes[0]); i++)
+        {
+                if (bench_mpool (sizes[i]) == -1)
+                {
+                        return 1;
+                }
+        }
+
+        return 0;
+}
@@ -0,0 +1,129 @@
+/*
+ *     bench_timers.c
+ *
+ * 2006-2007 Copyright (c)
+ * Robert Iakobashvili, <coroberti@gmail.com>
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+   Throughput of the timer queue (heap), used by loading threads for
+   sleeping clients, url completion timers and periodic timers.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "timer_queue.h"
+#include "timer_node.h"
+#include "heap.h"
+#include "cl_alloc.h"
+
+#include "bench.h"
+
+static unsigned long fired;
+
+static int bench_timer_func (timer_node* tn, void* param, unsigned long now)
+{
+        (void) tn; (void) param; (void) now;
+        fired++;
+        return 0;
+}
+
+static int bench_timers (unsigned long n)
+{
+        timer_node* nodes;
+        long* ids;
+        timer_queue* tq;
+        unsigned long i;
+        double start;
+
+        if (! (nodes = cl_calloc (n, sizeof (timer_node))) ||
+            ! (ids = cl_calloc (n, sizeof (long))) ||
+            ! (tq = cl_calloc (1, sizeof (heap))))
+        {
+                fprintf (stderr, "%s - error: allocation failed.\n", __func__);
+                return -1;
+        }
+
+        if (tq_init (tq, n, n / 10 + 1, n) == -1)
+        {
+                fprintf (stderr, "%s - error: tq_init () failed.\n", __func__);
+                return -1;
+        }
+
+        for (i = 0; i < n; i++)
+        {
+                nodes[i].next_timer = 1000 + bench_rand () % (n * 10);
+                nodes[i].period = 0;
+                nodes[i].func_timer = bench_timer_func;
+        }
+
+        /* Schedule all, then dispatch all in expiration order */
+        start = bench_now ();
+        for (i = 0; i < n; i++)
+        {
+                ids[i] = tq_schedule_timer (tq, &nodes[i]);
+        }
+        bench_report ("timer_queue", "schedule", n, n, bench_now () - start, 0);
+
+        fired = 0;
+        start = bench_now ();
+        while (! tq_empty (tq))
+        {
+                tq_dispatch_nearest_timer (tq, NULL, (unsigned long) -1);
+        }
+        bench_report ("timer_queue", "dispatch", n, fired, bench_now () - start, 0);
+
+        /* Schedule all, then cancel all in the scheduling order */
+        for (i = 0; i < n; i++)
+        {
+                ids[i] = tq_schedule_timer (tq, &nodes[i]);
+        }
+
+        start = bench_now ();
+        for (i = 0; i < n; i++)
+        {
+                tq_cancel_timer (tq, ids[i]);
+        }
+        bench_report ("timer_queue", "cancel", n, n, bench_now () - start, 0);
+
+        tq_release (tq);
+        free (tq);
+        free (ids);
+        free (nodes);
+
+        return 0;
+}
+
+int main ()
+{
+        static const unsigned long sizes[] = {10000, 100000, 1000000};
+        size_t i;
+
+        bench_header ();
+
+        for (i = 0; i < sizeof (sizes) / sizeof (sizes[0]); i++)
+        {
+                if (bench_timers (sizes[i]) == -1)
+                {
+                        return 1;
+                }
+        }
+
+        return 0;
+}
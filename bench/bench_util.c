@@ -0,0 +1,72 @@
+/*
+ *     bench_util.c
+ *
+ * 2006-2007 Copyright (c)
+ * Robert Iakobashvili, <coroberti@gmail.com>
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <stdio.h>
+#include <time.h>
+
+#include "bench.h"
+
+static unsigned long bench_seed = 2463534242UL;
+
+double bench_now ()
+{
+        struct timespec ts;
+
+        clock_gettime (CLOCK_MONOTONIC, &ts);
+
+        return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void bench_header ()
+{
+        fprintf (stdout,
+                 "# bench\tcase\tn\tops\tsec\tops_per_sec\tns_per_op\tmb_per_sec\n");
+}
+
+void bench_report (const char* bench,
+                   const char* name,
+                   unsigned long n,
+                   unsigned long ops,
+                   double sec,
+                   unsigned long long bytes)
+{
+        if (sec <= 0.0)
+        {
+                sec = 1e-9;
+        }
+
+        fprintf (stdout, "%s\t%s\t%lu\t%lu\t%.6f\t%.0f\t%.1f\t%.1f\n",
+                 bench, name, n, ops, sec,
+                 ops / sec,
+                 ops ? sec * 1e9 / ops : 0.0,
+                 bytes / sec / (1024.0 * 1024.0));
+        fflush (stdout);
+}
+
+unsigned long bench_rand ()
+{
+        bench_seed ^= bench_seed << 13;
+        bench_seed ^= bench_seed >> 17;
+        bench_seed ^= bench_seed << 5;
+
+        return bench_seed & 0xFFFFFFFFUL;
+}
@@ -0,0 +1,153 @@
+#!/bin/bash
+#
+#     loopback.sh
+#
+# End-to-end loopback benchmark of curl-loader against the bundled stub
+# HTTP server, run by "make bench-loopback". For each reference configuration
+# and each loading mode (hyper and smooth) reports requests/s, the loader
+# CPU, requests/s per loader core and the loader latency overhead, i.e.
+# the average response time seen by the loader minus the stub server delay.
+#
+# Environment variables:
+# CONFS        - reference configurations from conf-examples, default "bulk 10K 60K";
+# MODES        - loading modes, default "hyper smooth";
+# DURATION     - seconds of each run, default 30;
+# PORT         - stub server port, default 8080;
+# BODY_SIZE    - response body size in bytes, default 1024;
+# DELAY        - stub server response delay in msec, default 0;
+# STATUS_MIX   - stub server status mix, default 200:1;
+# STUB_WORKERS - stub server threads, default 2;
+# RAMPUP_ALL   - when 1, all the clients are started at once, default 0;
+# LOCAL_IPS    - number of loader addresses from 127.0.0.1, default 8.
+#
+# Must be run as root, like curl-loader itself.
+#
+
+TOP=$(cd $(dirname $0)/.. && pwd)
+LOADER=$TOP/curl-loader
+STUB=$TOP/bench/stub_server
+
+CONFS=${CONFS:-"bulk 10K 60K"}
+MODES=${MODES:-"hyper smooth"}
+DURATION=${DURATION:-30}
+PORT=${PORT:-8080}
+BODY_SIZE=${BODY_SIZE:-1024}
+DELAY=${DELAY:-0}
+STATUS_MIX=${STATUS_MIX:-200:1}
+STUB_WORKERS=${STUB_WORKERS:-2}
+RAMPUP_ALL=${RAMPUP_ALL:-0}
+LOCAL_IPS=${LOCAL_IPS:-8}
+
+# Smooth mode is select () based and limited by the loader FD_SETSIZE
+SMOOTH_CLIENTS_MAX=20000
+
+if [ $(id -u) -ne 0 ]; then
+    echo "$0: curl-loader must be run as root." >&2
+    exit 1
+fi
+
+if [ ! -x $LOADER ] || [ ! -x $STUB ]; then
+    echo "$0: build first by \"make\" and \"make bench-loopback\"." >&2
+    exit 1
+fi
+
+ulimit -n 1000000 2>/dev/null || ulimit -n 100000 2>/dev/null
+
+WORK=$(mktemp -d /tmp/curl-loader-loopback.XXXXXX)
+CLK_TCK=$(getconf CLK_TCK)
+
+$STUB -p $PORT -s $BODY_SIZE -d $DELAY -e "$STATUS_MIX" -w $STUB_WORKERS \
+    > $WORK/stub.out 2> $WORK/stub.err &
+STUB_PID=$!
+trap "kill -INT $STUB_PID 2>/dev/null" EXIT
+sleep 1
+
+if ! kill -0 $STUB_PID 2>/dev/null; then
+    cat $WORK/stub.err >&2
+    exit 1
+fi
+
+#
+# Makes loopback variant of a reference configuration: the clients share
+# LOCAL_IPS addresses from 127.0.0.1 on lo, so that large configurations
+# do not run out of local ports, and fetch from the stub server.
+#
+make_conf ()
+{
+    local conf=$1 batch=$2 out=$3
+
+    sed -e "s|^BATCH_NAME *=.*|BATCH_NAME=$batch|" \
+        -e "s|^INTERFACE *=.*|INTERFACE=lo|" \
+        -e "s|^NETMASK *=.*|NETMASK=8|" \
+        -e "s|^IP_ADDR_MIN *=.*|IP_ADDR_MIN=127.0.0.1|" \
+        -e "s|^IP_ADDR_MAX *=.*|IP_ADDR_MAX=127.0.0.$LOCAL_IPS\nIP_SHARED_NUM=$LOCAL_IPS|" \
+        -e "/^IP_SHARED_NUM *=/d" \
+        -e "s|^URL *=.*|URL=http://127.0.0.1:$PORT/index.html|" \
+        $TOP/conf-examples/$conf.conf > $out
+
+    if [ "$RAMPUP_ALL" = "1" ]; then
+        local max=$(sed -n "s|^CLIENTS_NUM_MAX *= *\([0-9]*\).*|\1|p" $out)
+        sed -i -e "/^CLIENTS_NUM_START *=/d" \
+            -e "s|^CLIENTS_NUM_MAX *=.*|&\nCLIENTS_NUM_START=$max|" $out
+    fi
+}
+
+cpu_ticks ()
+{
+    awk '{print $14 + $15}' /proc/$1/stat 2>/dev/null
+}
+
+printf "%-6s %-7s %8s %10s %8s %12s %10s %12s\n" \
+    conf mode clients "req/s" "cpu%" "req/s/core" "lat(ms)" "overhead(ms)"
+
+for conf in $CONFS; do
+    for mode in $MODES; do
+        case $mode in
+            hyper) mode_num=0 ;;
+            smooth) mode_num=1 ;;
+            *) echo "$0: unknown mode $mode" >&2; continue ;;
+        esac
+
+        batch=lb-$conf-$mode
+        make_conf $conf $batch $WORK/$batch.conf
+        clients=$(sed -n "s|^CLIENTS_NUM_MAX *= *\([0-9]*\).*|\1|p" $WORK/$batch.conf)
+
+        if [ $mode = smooth ] && [ $clients -gt $SMOOTH_CLIENTS_MAX ]; then
+            printf "%-6s %-7s %8s %10s\n" $conf $mode $clients "skipped (FD_SETSIZE)"
+            continue
+        fi
+
+        (cd $WORK && exec $LOADER -f $WORK/$batch.conf -m $mode_num \
+            > $WORK/$batch.out 2> $WORK/$batch.err) &
+        pid=$!
+
+        sleep $DURATION
+
+        # CPU of the loader since its start, taken just before the final totals
+        ticks=$(cpu_ticks $pid)
+        kill -INT $pid 2>/dev/null
+        wait $pid 2>/dev/null
+
+        # The final totals follow the "*, *, ..." separator of the .txt file
+        read req lat runtime <<< $(awk -F', *' \
+            '/^\*/ {final = 1; next} final && $2 ~ /^H\/F/ && $2 !~ /S/ {print $4, $12, $1; exit}' \
+            $WORK/$batch.txt 2>/dev/null)
+
+        awk -v conf=$conf -v mode=$mode -v clients=$clients \
+            -v req=${req:-0} -v lat=${lat:-0} -v runtime=${runtime:-0} \
+            -v ticks=$ticks -v hz=$CLK_TCK -v delay=$DELAY 'BEGIN {
+                rps = runtime > 0 ? req / runtime : 0;
+                cpu = runtime > 0 ? ticks / hz / runtime : 0;
+                printf "%-6s %-7s %8d %10.0f %8.1f %12.0f %10d %12d\n",
+                    conf, mode, clients, rps, cpu * 100,
+                    cpu > 0 ? rps / cpu : 0, lat, lat - delay
+            }'
+    done
+done
+
+kill -INT $STUB_PID 2>/dev/null
+wait $STUB_PID 2>/dev/null
+trap - EXIT
+cat $WORK/stub.out
+
+echo "Logs and statistics are in $WORK"
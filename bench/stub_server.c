@@ -0,0 +1,734 @@
+/*
+ *     stub_server.c
+ *
+ * 2006-2007 Copyright (c)
+ * Robert Iakobashvili, <coroberti@gmail.com>
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+   Stub HTTP/1.1 server for loopback benchmarks of curl-loader, built by
+   "make bench-loopback". It is never meant to be the bottleneck: each worker
+   thread runs its own epoll loop on its own SO_REUSEPORT listening socket,
+   responses are pre-built and keep-alive and pipelined requests are served.
+
+   Options:
+   -a address      - listening address, default 127.0.0.1;
+   -p port         - listening port, default 8080;
+   -s size         - response body size in bytes, default 1024;
+   -d msec         - delay of each response in msec, default 0;
+   -e status-mix   - weighted response statuses, e.g. 200:95,404:3,500:2,
+                     default 200:1;
+   -w workers      - number of worker threads, default 1.
+
+   On SIGINT or SIGTERM prints the number of requests served and the average
+   time from request received till response written, and exits.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#define STUB_EVENTS_NUM 1024
+#define STUB_IN_BUFFER_SIZE 8192
+#define STUB_STATUS_MAX 8
+#define STUB_WORKERS_MAX 64
+
+typedef struct stub_response
+{
+        int status;
+        int weight;
+        char* buffer;
+        size_t len;
+} stub_response;
+
+typedef struct stub_conn
+{
+        int fd;
+
+        /* Closed, but still linked to the delayed queue */
+        int dead;
+
+        /* Close, when all the responses have been written */
+        int close_after;
+
+        /* Is in the delayed queue */
+        int delayed;
+
+        /* Number of received requests not yet responded */
+        int queued;
+
+        /* Bytes of a large request body still to be dropped */
+        long skip;
+
+        /* Response being written and its written offset */
+        stub_response* out;
+        size_t out_off;
+
+        /* Is EPOLLOUT subscribed */
+        int pollout;
+
+        /* Time of the first queued request received and its response due */
+        unsigned long long received_usec;
+        unsigned long long due_usec;
+
+        struct stub_conn* next_delayed;
+
+        int in_len;
+        char in[STUB_IN_BUFFER_SIZE];
+} stub_conn;
+
+typedef struct stub_worker
+{
+        pthread_t thread;
+        int epfd;
+        int lfd;
+
+        stub_conn* delayed_head;
+        stub_conn* delayed_tail;
+
+        unsigned long mix_counter;
+
+        unsigned long long requests;
+        unsigned long long connections;
+        unsigned long long service_usec;
+} stub_worker;
+
+static const char* stub_address = "127.0.0.1";
+static int stub_port = 8080;
+static size_t stub_body_size = 1024;
+static unsigned long stub_delay_msec = 0;
+static int stub_workers_num = 1;
+
+static stub_response stub_responses[STUB_STATUS_MAX];
+static int stub_responses_num = 0;
+static int stub_weights_sum = 0;
+
+static volatile int stub_stop = 0;
+
+static unsigned long long stub_now_usec ()
+{
+        struct timespec ts;
+
+        clock_gettime (CLOCK_MONOTONIC, &ts);
+
+        return (unsigned long long) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static const char* stub_reason (int status)
+{
+        switch (status)
+        {
+        case 200: return "OK";
+        case 204: return "No Content";
+        case 301: return "Moved Permanently";
+        case 302: return "Found";
+        case 304: return "Not Modified";
+        case 400: return "Bad Request";
+        case 403: return "Forbidden";
+        case 404: return "Not Found";
+        case 500: return "Internal Server Error";
+        case 502: return "Bad Gateway";
+        case 503: return "Service Unavailable";
+        default:  return "Unknown";
+        }
+}
+
+/****************************************************************************************
+* Function name - stub_parse_mix
+*
+* Description - Parses status mix string, e.g. "200:95,404:3,500:2", and builds
+*               the response buffers
+*
+* Input -       *mix - status mix string
+* Return Code/Output - On success - 0, on error -1
+****************************************************************************************/
+static int stub_parse_mix (const char* mix)
+{
+        const char* p = mix;
+        char header[256];
+
+        while (*p)
+        {
+                stub_response* r;
+                char* end;
+                int hlen;
+
+                if (stub_responses_num == STUB_STATUS_MAX)
+                {
+                        fprintf (stderr, "%s - error: up to %d statuses supported.\n",
+                                 __func__, STUB_STATUS_MAX);
+                        return -1;
+                }
+
+                r = &stub_responses[stub_responses_num];
+                r->status = strtol (p, &end, 10);
+                r->weight = 1;
+
+                if (end == p || r->status < 100 || r->status > 599)
+                {
+                        fprintf (stderr, "%s - error: wrong status in \"%s\".\n", __func__, mix);
+                        return -1;
+                }
+
+                p = end;
+                if (*p == ':')
+                {
+                        r->weight = strtol (p + 1, &end, 10);
+                        if (end == p + 1 || r->weight <= 0)
+                        {
+                                fprintf (stderr, "%s - error: wrong weight in \"%s\".\n",
+                                         __func__, mix);
+                                return -1;
+                        }
+                        p = end;
+                }
+
+                if (*p == ',')
+                {
+                        p++;
+                }
+                else if (*p)
+                {
+                        fprintf (stderr, "%s - error: wrong format of \"%s\".\n", __func__, mix);
+                        return -1;
+                }
+
+                hlen = snprintf (header, sizeof (header),
+                                 "HTTP/1.1 %d %s\r\n"
+                                 "Server: curl-loader-stub\r\n"
+                                 "Content-Type: text/plain\r\n"
+                                 "Content-Length: %lu\r\n\r\n",
+                                 r->status, stub_reason (r->status),
+                                 (unsigned long) stub_body_size);
+
+                r->len = hlen + stub_body_size;
+                if (! (r->buffer = malloc (r->len)))
+                {
+                        fprintf (stderr, "%s - error: malloc () failed.\n", __func__);
+                        return -1;
+                }
+                memcpy (r->buffer, header, hlen);
+                memset (r->buffer + hlen, 'x', stub_body_size);
+
+                stub_weights_sum += r->weight;
+                stub_responses_num++;
+        }
+
+        return stub_responses_num ? 0 : -1;
+}
+
+static stub_response* stub_next_response (stub_worker* w)
+{
+        int slot = w->mix_counter++ % stub_weights_sum;
+        int i;
+
+        for (i = 0; i < stub_responses_num - 1; i++)
+        {
+                if (slot < stub_responses[i].weight)
+                        break;
+                slot -= stub_responses[i].weight;
+        }
+
+        return &stub_responses[i];
+}
+
+static void stub_conn_close (stub_worker* w, stub_conn* c)
+{
+        epoll_ctl (w->epfd, EPOLL_CTL_DEL, c->fd, NULL);
+        close (c->fd);
+        c->fd = -1;
+
+        if (c->delayed)
+        {
+                /* Released, when taken from the delayed queue */
+                c->dead = 1;
+                return;
+        }
+
+        free (c);
+}
+
+static void stub_conn_pollout (stub_worker* w, stub_conn* c, int on)
+{
+        struct epoll_event ev;
+
+        if (c->pollout == on)
+                return;
+
+        ev.events = EPOLLIN | (on ? EPOLLOUT : 0);
+        ev.data.ptr = c;
+        epoll_ctl (w->epfd, EPOLL_CTL_MOD, c->fd, &ev);
+        c->pollout = on;
+}
+
+/****************************************************************************************
+* Function name - stub_conn_send
+*
+* Description - Writes responses to all the queued requests of a connection, till
+*               the socket buffer is full.
+*
+* Input -       *w - pointer to the worker
+*               *c - pointer to the connection
+* Return Code/Output - On success - 0, when the connection is closed -1
+****************************************************************************************/
+static int stub_conn_send (stub_worker* w, stub_conn* c)
+{
+        while (c->out || (c->queued && !c->delayed))
+        {
+                ssize_t rc;
+
+                if (!c->out)
+                {
+                        c->out = stub_next_response (w);
+                        c->out_off = 0;
+                }
+
+                rc = write (c->fd, c->out->buffer + c->out_off, c->out->len - c->out_off);
+
+                if (rc < 0)
+                {
+                        if (errno == EAGAIN || errno == EWOULDBLOCK)
+                        {
+                                stub_conn_pollout (w, c, 1);
+                                return 0;
+                        }
+                        if (errno == EINTR)
+                                continue;
+
+                        stub_conn_close (w, c);
+                        return -1;
+                }
+
+                c->out_off += rc;
+                if (c->out_off < c->out->len)
+                        continue;
+
+                c->out = NULL;
+                c->queued--;
+                w->requests++;
+                w->service_usec += stub_now_usec () - c->received_usec;
+        }
+
+        if (c->close_after)
+        {
+                stub_conn_close (w, c);
+                return -1;
+        }
+
+        stub_conn_pollout (w, c, 0);
+        return 0;
+}
+
+/****************************************************************************************
+* Function name - stub_conn_parse
+*
+* Description - Counts complete requests in the input buffer and removes them.
+*               Request bodies are skipped using Content-Length.
+*
+* Input -       *c - pointer to the connection
+* Return Code/Output - Number of complete requests found
+****************************************************************************************/
+static int stub_conn_parse (stub_conn* c)
+{
+        int requests = 0;
+        int off = 0;
+
+        if (c->skip)
+        {
+                off = c->skip < c->in_len ? c->skip : c->in_len;
+                c->skip -= off;
+        }
+
+        for (;;)
+        {
+                char* start = c->in + off;
+                char* end;
+                char* cl;
+                long body_len = 0;
+                int req_len;
+
+                c->in[c->in_len] = '\0';
+
+                if (! (end = strstr (start, "\r\n\r\n")))
+                        break;
+
+                *end = '\0';
+
+                if ((cl = strcasestr (start, "\r\nContent-Length:")))
+                {
+                        body_len = atol (cl + sizeof ("\r\nContent-Length:") - 1);
+                }
+
+                if (strcasestr (start, "\r\nConnection: close"))
+                {
+                        c->close_after = 1;
+                }
+
+                *end = '\r';
+
+                req_len = (end + 4 - start) + body_len;
+                if (off + req_len > c->in_len)
+                {
+                        if (req_len > STUB_IN_BUFFER_SIZE - 1)
+                        {
+                                /* Large bodies are not buffered, just dropped */
+                                c->skip = off + req_len - c->in_len;
+                                off = c->in_len;
+                                requests++;
+                        }
+                        break;
+                }
+
+                off += req_len;
+                requests++;
+        }
+
+        if (off)
+        {
+                memmove (c->in, c->in + off, c->in_len - off);
+                c->in_len -= off;
+        }
+
+        return requests;
+}
+
+static void stub_conn_read (stub_worker* w, stub_conn* c)
+{
+        int requests = 0;
+
+        for (;;)
+        {
+                ssize_t rc = read (c->fd, c->in + c->in_len,
+                                   STUB_IN_BUFFER_SIZE - 1 - c->in_len);
+
+                if (rc == 0)
+                {
+                        stub_conn_close (w, c);
+                        return;
+                }
+
+                if (rc < 0)
+                {
+                        if (errno == EINTR)
+                                continue;
+                        if (errno == EAGAIN || errno == EWOULDBLOCK)
+                                break;
+
+                        stub_conn_close (w, c);
+                        return;
+                }
+
+                c->in_len += rc;
+                requests += stub_conn_parse (c);
+
+                if (c->in_len == STUB_IN_BUFFER_SIZE - 1)
+                {
+                        /* Headers do not fit the buffer */
+                        stub_conn_close (w, c);
+                        return;
+                }
+        }
+
+        if (!requests)
+                return;
+
+        if (!c->queued && !c->out)
+        {
+                c->received_usec = stub_now_usec ();
+        }
+        c->queued += requests;
+
+        if (!stub_delay_msec)
+        {
+                stub_conn_send (w, c);
+                return;
+        }
+
+        if (!c->delayed)
+        {
+                /* The delay is the same for all, thus the queue is ordered by due time */
+                c->due_usec = stub_now_usec () + stub_delay_msec * 1000;
+                c->delayed = 1;
+                c->next_delayed = NULL;
+
+                if (w->delayed_tail)
+                        w->delayed_tail->next_delayed = c;
+                else
+                        w->delayed_head = c;
+                w->delayed_tail = c;
+        }
+}
+
+static int stub_delayed_dispatch (stub_worker* w)
+{
+        const unsigned long long now = stub_now_usec ();
+
+        while (w->delayed_head && w->delayed_head->due_usec <= now)
+        {
+                stub_conn* c = w->delayed_head;
+
+                if (! (w->delayed_head = c->next_delayed))
+                        w->delayed_tail = NULL;
+
+                c->delayed = 0;
+
+                if (c->dead)
+                        free (c);
+                else
+                        stub_conn_send (w, c);
+        }
+
+        if (!w->delayed_head)
+                return 100;
+
+        return (int) ((w->delayed_head->due_usec - now + 999) / 1000);
+}
+
+static void stub_accept (stub_worker* w)
+{
+        for (;;)
+        {
+                struct epoll_event ev;
+                stub_conn* c;
+                int one = 1;
+                int fd = accept4 (w->lfd, NULL, NULL, SOCK_NONBLOCK);
+
+                if (fd < 0)
+                {
+                        if (errno == EINTR)
+                                continue;
+                        if (errno != EAGAIN && errno != EWOULDBLOCK)
+                                perror ("accept4");
+                        return;
+                }
+
+                setsockopt (fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof (one));
+
+                if (! (c = calloc (1, sizeof (stub_conn))))
+                {
+                        close (fd);
+                        continue;
+                }
+
+                c->fd = fd;
+                ev.events = EPOLLIN;
+                ev.data.ptr = c;
+
+                if (epoll_ctl (w->epfd, EPOLL_CTL_ADD, fd, &ev) == -1)
+                {
+                        close (fd);
+                        free (c);
+                        continue;
+                }
+
+                w->connections++;
+        }
+}
+
+static int stub_listen ()
+{
+        struct sockaddr_in sa;
+        int one = 1;
+        int fd = socket (AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+
+        if (fd < 0)
+        {
+                perror ("socket");
+                return -1;
+        }
+
+        setsockopt (fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof (one));
+        if (setsockopt (fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof (one)) == -1)
+        {
+                perror ("SO_REUSEPORT");
+                close (fd);
+                return -1;
+        }
+
+        memset (&sa, 0, sizeof (sa));
+        sa.sin_family = AF_INET;
+        sa.sin_port = htons (stub_port);
+
+        if (inet_pton (AF_INET, stub_address, &sa.sin_addr) != 1)
+        {
+                fprintf (stderr, "%s - error: wrong address \"%s\".\n", __func__, stub_address);
+                close (fd);
+                return -1;
+        }
+
+        if (bind (fd, (struct sockaddr*) &sa, sizeof (sa)) == -1 ||
+            listen (fd, 65535) == -1)
+        {
+                perror ("bind/listen");
+                close (fd);
+                return -1;
+        }
+
+        return fd;
+}
+
+static void* stub_worker_run (void* arg)
+{
+        stub_worker* w = arg;
+        struct epoll_event events[STUB_EVENTS_NUM];
+        int timeout = 100;
+
+        while (!stub_stop)
+        {
+                int i, n = epoll_wait (w->epfd, events, STUB_EVENTS_NUM, timeout);
+
+                for (i = 0; i < n; i++)
+                {
+                        stub_conn* c = events[i].data.ptr;
+
+                        if (!c)
+                        {
+                                stub_accept (w);
+                                continue;
+                        }
+
+                        if (events[i].events & (EPOLLERR | EPOLLHUP))
+                        {
+                                stub_conn_close (w, c);
+                                continue;
+                        }
+
+                        if ((events[i].events & EPOLLOUT) && stub_conn_send (w, c) == -1)
+                                continue;
+
+                        if (events[i].events & EPOLLIN)
+                                stub_conn_read (w, c);
+                }
+
+                timeout = stub_delay_msec ? stub_delayed_dispatch (w) : 100;
+        }
+
+        return NULL;
+}
+
+static void stub_usage (const char* prog)
+{
+        fprintf (stderr,
+                 "usage: %s [-a address] [-p port] [-s body-size] [-d delay-msec]\n"
+                 "       [-e status:weight[,status:weight...]] [-w workers]\n", prog);
+}
+
+int main (int argc, char** argv)
+{
+        static stub_worker workers[STUB_WORKERS_MAX];
+        const char* mix = "200:1";
+        unsigned long long requests = 0, connections = 0, service_usec = 0;
+        unsigned long long start_usec;
+        double seconds;
+        sigset_t sigs;
+        int sig, i, opt;
+
+        while ((opt = getopt (argc, argv, "a:p:s:d:e:w:h")) != -1)
+        {
+                switch (opt)
+                {
+                case 'a': stub_address = optarg; break;
+                case 'p': stub_port = atoi (optarg); break;
+                case 's': stub_body_size = strtoul (optarg, NULL, 10); break;
+                case 'd': stub_delay_msec = strtoul (optarg, NULL, 10); break;
+                case 'e': mix = optarg; break;
+                case 'w': stub_workers_num = atoi (optarg); break;
+                default:
+                        stub_usage (argv[0]);
+                        return 1;
+                }
+        }
+
+        if (stub_workers_num < 1 || stub_workers_num > STUB_WORKERS_MAX ||
+            stub_port <= 0 || stub_port > 65535)
+        {
+                stub_usage (argv[0]);
+                return 1;
+        }
+
+        if (stub_parse_mix (mix) == -1)
+        {
+                return 1;
+        }
+
+        /* Signals are taken by sigwait () of the main thread only */
+        sigemptyset (&sigs);
+        sigaddset (&sigs, SIGINT);
+        sigaddset (&sigs, SIGTERM);
+        pthread_sigmask (SIG_BLOCK, &sigs, NULL);
+        signal (SIGPIPE, SIG_IGN);
+
+        for (i = 0; i < stub_workers_num; i++)
+        {
+                struct epoll_event ev;
+                stub_worker* w = &workers[i];
+
+                if ((w->lfd = stub_listen ()) == -1 ||
+                    (w->epfd = epoll_create1 (0)) == -1)
+                {
+                        return 1;
+                }
+
+                ev.events = EPOLLIN;
+                ev.data.ptr = NULL;
+                epoll_ctl (w->epfd, EPOLL_CTL_ADD, w->lfd, &ev);
+
+                if (pthread_create (&w->thread, NULL, stub_worker_run, w))
+                {
+                        fprintf (stderr, "%s - error: pthread_create () failed.\n", __func__);
+                        return 1;
+                }
+        }
+
+        fprintf (stderr, "stub_server: listening on %s:%d, body %lu bytes, delay %lu msec, "
+                 "%d workers.\n", stub_address, stub_port, (unsigned long) stub_body_size,
+                 stub_delay_msec, stub_workers_num);
+
+        start_usec = stub_now_usec ();
+        sigwait (&sigs, &sig);
+        stub_stop = 1;
+        seconds = (stub_now_usec () - start_usec) / 1e6;
+
+        for (i = 0; i < stub_workers_num; i++)
+        {
+                pthread_join (workers[i].thread, NULL);
+                requests += workers[i].requests;
+                connections += workers[i].connections;
+                service_usec += workers[i].service_usec;
+        }
+
+        fprintf (stdout, "stub_server: requests %llu, connections %llu, seconds %.1f, "
+                 "req/s %.0f, service avg %.1f usec\n",
+                 requests, connections, seconds, requests / (seconds > 0 ? seconds : 1),
+                 requests ? (double) service_usec / requests : 0.0);
+
+        return 0;
+}
@@ -23,195 +23,424 @@
 // must be the first include
 #include "fdsetsize.h"
 
+#include <string.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
 
 #include "client.h"
 #include "batch.h"
+#include "conf.h"
+#include "tlog.h"
+#include "topk.h"
+#include "tls_rate.h"
+#include "dns_pin.h"
+
 
+static void stat_tcp_info_sample (client_context* cctx, stat_point* us);
+static void stat_dns_lookup (client_context* cctx, stat_point* us, stat_point* ds);
+static void stat_conn_reuse (client_context* cctx, stat_point* us, stat_point* ds);
 
 /*
-   Accessors to the flags-counters of headers.
-   Incrementing counters for the flags-counters of headers.
+   Accessors to the flags of headers.
+   Setting the flags of headers.
  */
 int first_hdr_req (client_context* cctx)
 {
-        return cctx->first_hdr_req;
+        return cctx->first_hdrs & FIRST_HDR_REQ;
 }
 
 void first_hdr_req_inc (client_context* cctx)
 {
-        cctx->first_hdr_req++;
+        cctx->first_hdrs |= FIRST_HDR_REQ;
 }
 
 int first_hdr_1xx (client_context* cctx)
 {
-        return cctx->first_hdr_1xx;
+        return cctx->first_hdrs & FIRST_HDR_1XX;
 }
 
 void first_hdr_1xx_inc (client_context* cctx)
 {
-        cctx->first_hdr_1xx++;
+        cctx->first_hdrs |= FIRST_HDR_1XX;
 }
 
 int first_hdr_2xx (client_context* cctx)
 {
-        return cctx->first_hdr_2xx;
+        return cctx->first_hdrs & FIRST_HDR_2XX;
 }
 
 void first_hdr_2xx_inc (client_context* cctx)
 {
-        cctx->first_hdr_2xx++;
+        cctx->first_hdrs |= FIRST_HDR_2XX;
 }
 
 int first_hdr_3xx (client_context* cctx)
 {
-        return cctx->first_hdr_3xx++;
+        return cctx->first_hdrs & FIRST_HDR_3XX;
 }
 
 void first_hdr_3xx_inc (client_context* cctx)
 {
-        cctx->first_hdr_3xx++;
+        cctx->first_hdrs |= FIRST_HDR_3XX;
 }
 
 int first_hdr_4xx (client_context* cctx)
 {
-        return cctx->first_hdr_4xx;
+        return cctx->first_hdrs & FIRST_HDR_4XX;
 }
 
 void first_hdr_4xx_inc (client_context* cctx)
 {
-        cctx->first_hdr_4xx++;
+        cctx->first_hdrs |= FIRST_HDR_4XX;
 }
 
 int first_hdr_5xx (client_context* cctx)
 {
-        return cctx->first_hdr_5xx;
+        return cctx->first_hdrs & FIRST_HDR_5XX;
 }
 
 void first_hdr_5xx_inc (client_context* cctx)
 {
-        cctx->first_hdr_5xx++;
+        cctx->first_hdrs |= FIRST_HDR_5XX;
 }
 
 /*
-   Reseting to zero counters for the flags-counters of headers.
+   Clearing the flags of headers.
  */
 void first_hdrs_clear_all (client_context* cctx)
 {
-        cctx->first_hdr_req = cctx->first_hdr_1xx = cctx->first_hdr_2xx =
-                                                            cctx->first_hdr_3xx = cctx->first_hdr_4xx = cctx->first_hdr_5xx = 0;
+        cctx->first_hdrs = 0;
 }
 
 void first_hdrs_clear_non_req (client_context* cctx)
 {
-        cctx->first_hdr_1xx = cctx->first_hdr_2xx = cctx->first_hdr_3xx =
-                                                            cctx->first_hdr_4xx = cctx->first_hdr_5xx = 0;
+        cctx->first_hdrs &= FIRST_HDR_REQ;
 }
 
 void first_hdrs_clear_non_1xx (client_context* cctx)
 {
-        cctx->first_hdr_req = cctx->first_hdr_2xx = cctx->first_hdr_3xx =
-                                                            cctx->first_hdr_4xx = cctx->first_hdr_5xx = 0;
+        cctx->first_hdrs &= FIRST_HDR_1XX;
 }
 
 void first_hdrs_clear_non_2xx (client_context* cctx)
 {
-        cctx->first_hdr_req = cctx->first_hdr_3xx = cctx->first_hdr_4xx =
-                                                            cctx->first_hdr_5xx = 0;
+        cctx->first_hdrs &= (FIRST_HDR_1XX | FIRST_HDR_2XX);
 }
 
 void first_hdrs_clear_non_3xx (client_context* cctx)
 {
-        cctx->first_hdr_req = cctx->first_hdr_2xx = cctx->first_hdr_4xx = cctx->first_hdr_5xx = 0;
+        cctx->first_hdrs &= (FIRST_HDR_1XX | FIRST_HDR_3XX);
 }
 
 void first_hdrs_clear_non_4xx (client_context* cctx)
 {
-        cctx->first_hdr_req = cctx->first_hdr_2xx = cctx->first_hdr_3xx = cctx->first_hdr_5xx = 0;
+        cctx->first_hdrs &= (FIRST_HDR_1XX | FIRST_HDR_4XX);
 }
 
 void first_hdrs_clear_non_5xx (client_context* cctx)
 {
-        cctx->first_hdr_req = cctx->first_hdr_2xx = cctx->first_hdr_4xx = cctx->first_hdr_3xx = 0;
+        cctx->first_hdrs &= (FIRST_HDR_1XX | FIRST_HDR_5XX);
+}
+
+/*
+   Client name is not kept in client context, but formatted on demand
+   for logging.
+ */
+const char* client_name (client_context* cctx)
+{
+        static __thread char name[CLIENT_NAME_LEN];
+        char ip_str[INET6_ADDRSTRLEN];
+
+        if (verbose_logging > 1 &&
+            client_ip_str (cctx->bctx, cctx->client_index, ip_str, sizeof (ip_str)))
+        {
+                snprintf (name, sizeof (name) - 1, "%d (%s) ",
+                          (int) cctx->client_index + 1, ip_str);
+        }
+        else
+        {
+                snprintf (name, sizeof (name) - 1, "%d ",
+                          (int) cctx->client_index + 1);
+        }
+        return name;
+}
+
+/*
+   Accessors to the side tables of the batch.
+ */
+client_stat* client_stats (client_context* cctx)
+{
+        return cctx->bctx->cstats ? &cctx->bctx->cstats[cctx->client_index] : NULL;
+}
+
+client_forms* client_forms_get (client_context* cctx)
+{
+        return cctx->bctx->cforms ? &cctx->bctx->cforms[cctx->client_index] : NULL;
+}
+
+client_resp_logs* client_resp_logs_get (client_context* cctx)
+{
+        return cctx->bctx->cresp_logs ? &cctx->bctx->cresp_logs[cctx->client_index] : NULL;
+}
+
+char* client_fetch_decisions (client_context* cctx)
+{
+        return cctx->bctx->fetch_decisions ?
+                cctx->bctx->fetch_decisions + cctx->client_index * cctx->bctx->urls_num : NULL;
 }
 
+size_t client_bytes_per_client (batch_context* bctx)
+{
+        size_t bytes = sizeof (client_context);
+
+        if (bctx->cstats)
+                bytes += sizeof (client_stat);
+
+        if (bctx->cresp_logs)
+                bytes += sizeof (client_resp_logs);
+
+        if (bctx->fetch_decisions)
+                bytes += bctx->urls_num;
+
+        if (bctx->cforms && bctx->client_num_max > 0)
+        {
+                size_t buffers = 0;
+                int i;
+
+                for (i = 0; i < bctx->client_num_max; i++)
+                {
+                        buffers += bctx->cforms[i].post_data_len +
+                                bctx->cforms[i].get_url_form_data_len;
+                }
+
+                bytes += sizeof (client_forms) + buffers / bctx->client_num_max;
+        }
+
+        return bytes;
+}
+
+/*
+   Counters of the current request are accumulated in the client scratch
+   record and committed to the client, url and batch statistics once per
+   request by stat_request_commit ().
+ */
 void stat_data_out_add (client_context* cctx, unsigned long bytes)
 {
-        cctx->st.data_out += bytes;
-        cctx->bctx->url_stats[cctx->url_curr_index].data_out += bytes;
-        cctx->is_https ? (cctx->bctx->https_delta.data_out += bytes) :
-        (cctx->bctx->http_delta.data_out += bytes);
+        cctx->rs.data_out += bytes;
 }
 
 void stat_data_in_add (client_context* cctx, unsigned long bytes)
 {
-        cctx->st.data_in += bytes;
-        cctx->bctx->url_stats[cctx->url_curr_index].data_in += bytes;
-        cctx->is_https ? (cctx->bctx->https_delta.data_in += bytes) :
-        (cctx->bctx->http_delta.data_in += bytes);
+        cctx->rs.data_in += bytes;
 }
 
 void stat_err_inc (client_context* cctx)
 {
-        cctx->st.other_errs++;
-        cctx->bctx->url_stats[cctx->url_curr_index].other_errs++;
-        cctx->is_https ? cctx->bctx->https_delta.other_errs++ :
-        cctx->bctx->http_delta.other_errs++;
+        cctx->rs.other_errs++;
 }
 
 void stat_url_timeout_err_inc (client_context* cctx)
 {
-        cctx->st.url_timeout_errs++;
-        cctx->bctx->url_stats[cctx->url_curr_index].url_timeout_errs++;
-        cctx->is_https ? cctx->bctx->https_delta.url_timeout_errs++ :
-        cctx->bctx->http_delta.url_timeout_errs++;
+        cctx->rs.url_timeout_errs++;
 }
 
 void stat_req_inc (client_context* cctx)
 {
-        cctx->st.requests++;
-        cctx->bctx->url_stats[cctx->url_curr_index].requests++;
-        cctx->is_https ? cctx->bctx->https_delta.requests++ :
-        cctx->bctx->http_delta.requests++;
+        cctx->rs.requests++;
 }
 
 void stat_1xx_inc (client_context* cctx)
 {
-        cctx->st.resp_1xx++;
-        cctx->bctx->url_stats[cctx->url_curr_index].resp_1xx++;
-        cctx->is_https ? cctx->bctx->https_delta.resp_1xx++ :
-        cctx->bctx->http_delta.resp_1xx++;
+        cctx->rs.resp_1xx++;
 }
 
 void stat_2xx_inc (client_context* cctx)
 {
-        cctx->st.resp_2xx++;
-        cctx->bctx->url_stats[cctx->url_curr_index].resp_2xx++;
-        cctx->is_https ? cctx->bctx->https_delta.resp_2xx++ :
-        cctx->bctx->http_delta.resp_2xx++;
+        cctx->rs.resp_2xx++;
 }
 
 void stat_3xx_inc (client_context* cctx)
 {
-        cctx->st.resp_3xx++;
-        cctx->bctx->url_stats[cctx->url_curr_index].resp_3xx++;
-        cctx->is_https ? cctx->bctx->https_delta.resp_3xx++ :
-        cctx->bctx->http_delta.resp_3xx++;
+        cctx->rs.resp_3xx++;
 }
 
 void stat_4xx_inc (client_context* cctx)
 {
-        cctx->st.resp_4xx++;
-        cctx->bctx->url_stats[cctx->url_curr_index].resp_4xx++;
-        cctx->is_https ? cctx->bctx->https_delta.resp_4xx++ :
-        cctx->bctx->http_delta.resp_4xx++;
+        cctx->rs.resp_4xx++;
 }
 
 void stat_5xx_inc (client_context* cctx)
 {
-        cctx->st.resp_5xx++;
-        cctx->bctx->url_stats[cctx->url_curr_index].resp_5xx++;
-        cctx->is_https ? cctx->bctx->https_delta.resp_5xx++ :
-        cctx->bctx->http_delta.resp_5xx++;
+        cctx->rs.resp_5xx++;
+}
+
+void stat_request_commit (client_context* cctx)
+{
+        client_req_stat* rs = &cctx->rs;
+        batch_context* bctx = cctx->bctx;
+        client_stat* st;
+        stat_point* us;
+        stat_point* ds;
+
+        /* Keep or discard the trace of the request, when tail-based logging */
+        if (bctx->tlog)
+        {
+                tlog_request_done (cctx);
+        }
+
+        if (tls_handshake_mode)
+        {
+                tls_rate_commit (cctx);
+        }
+
+        if (!rs->data_in && !rs->data_out && !rs->requests &&
+            !rs->resp_1xx && !rs->resp_2xx && !rs->resp_3xx &&
+            !rs->resp_4xx && !rs->resp_5xx &&
+            !rs->other_errs && !rs->url_timeout_errs)
+        {
+                return;
+        }
+
+        if (bctx->topk)
+        {
+                topk_request_done (cctx);
+        }
+
+        if ((st = client_stats (cctx)))
+        {
+                st->data_in += rs->data_in;
+                st->data_out += rs->data_out;
+                st->requests += rs->requests;
+                st->resp_1xx += rs->resp_1xx;
+                st->resp_2xx += rs->resp_2xx;
+                st->resp_3xx += rs->resp_3xx;
+                st->resp_4xx += rs->resp_4xx;
+                st->resp_5xx += rs->resp_5xx;
+                st->other_errs += rs->other_errs;
+                st->url_timeout_errs += rs->url_timeout_errs;
+        }
+
+        us = &bctx->url_stats[cctx->url_curr_index];
+        ds = cctx->is_https ? &bctx->https_delta : &bctx->http_delta;
+
+        us->data_in += rs->data_in;
+        us->data_out += rs->data_out;
+        us->requests += rs->requests;
+        us->resp_1xx += rs->resp_1xx;
+        us->resp_2xx += rs->resp_2xx;
+        us->resp_3xx += rs->resp_3xx;
+        us->resp_4xx += rs->resp_4xx;
+        us->resp_5xx += rs->resp_5xx;
+        us->other_errs += rs->other_errs;
+        us->url_timeout_errs += rs->url_timeout_errs;
+
+        if (tcp_info_sample_rate &&
+            !(bctx->tcp_info_count++ % tcp_info_sample_rate))
+        {
+                stat_tcp_info_sample (cctx, us);
+        }
+
+        if (bctx->dns_mode == DNS_MODE_PHASE)
+        {
+                stat_dns_lookup (cctx, us, ds);
+        }
+
+        if (bctx->pipelining && !cctx->fast)
+        {
+                stat_conn_reuse (cctx, us, ds);
+        }
+
+        ds->data_in += rs->data_in;
+        ds->data_out += rs->data_out;
+        ds->requests += rs->requests;
+        ds->resp_1xx += rs->resp_1xx;
+        ds->resp_2xx += rs->resp_2xx;
+        ds->resp_3xx += rs->resp_3xx;
+        ds->resp_4xx += rs->resp_4xx;
+        ds->resp_5xx += rs->resp_5xx;
+        ds->other_errs += rs->other_errs;
+        ds->url_timeout_errs += rs->url_timeout_errs;
+
+        memset (rs, 0, sizeof (*rs));
+}
+
+/*
+   Accounts the name lookup of a new connection of the accomplished transfer
+   as a phase of its own. Re-used connections do not resolve.
+ */
+static void stat_dns_lookup (client_context* cctx, stat_point* us, stat_point* ds)
+{
+        double lookup_time = 0.0;
+        long connects = 0;
+        unsigned long usec;
+
+        if (!cctx->handle ||
+            curl_easy_getinfo (cctx->handle, CURLINFO_NUM_CONNECTS, &connects) != CURLE_OK ||
+            !connects ||
+            curl_easy_getinfo (cctx->handle, CURLINFO_NAMELOOKUP_TIME, &lookup_time) != CURLE_OK)
+                return;
+
+        usec = (unsigned long) (lookup_time * 1000000.0);
+
+        stat_point_dns_add (us, usec);
+        stat_point_dns_add (ds, usec);
+}
+
+/*
+   Accounts the transfer on a new or on a re-used connection. The request on
+   a re-used connection waited in its queue till the headers were sent.
+ */
+static void stat_conn_reuse (client_context* cctx, stat_point* us, stat_point* ds)
+{
+        long connects = 0;
+
+        if (!cctx->handle ||
+            curl_easy_getinfo (cctx->handle, CURLINFO_NUM_CONNECTS, &connects) != CURLE_OK)
+                return;
+
+        stat_point_conn_add (us, !connects, cctx->req_queue_msec);
+        stat_point_conn_add (ds, !connects, cctx->req_queue_msec);
+}
+
+/*
+   Samples TCP_INFO of the connection of the accomplished transfer to the
+   histograms of the url. The connection is still open at the commit,
+   unless closed by the server or not kept by -r option.
+ */
+static void stat_tcp_info_sample (client_context* cctx, stat_point* us)
+{
+#if defined (TCP_INFO)
+        struct tcp_info ti;
+        socklen_t len = sizeof (ti);
+#if LIBCURL_VERSION_NUM >= 0x072d00
+        curl_socket_t sock = CURL_SOCKET_BAD;
+
+        if (!cctx->handle ||
+            curl_easy_getinfo (cctx->handle, CURLINFO_ACTIVESOCKET, &sock) != CURLE_OK ||
+            sock == CURL_SOCKET_BAD)
+                return;
+#else
+        long sock = -1;
+
+        if (!cctx->handle ||
+            curl_easy_getinfo (cctx->handle, CURLINFO_LASTSOCKET, &sock) != CURLE_OK ||
+            sock == -1)
+                return;
+#endif
+
+        if (getsockopt ((int) sock, IPPROTO_TCP, TCP_INFO, &ti, &len) == -1)
+                return;
+
+        stat_point_tcpi_add (us, TCPI_RTT, ti.tcpi_rtt);
+        stat_point_tcpi_add (us, TCPI_RTTVAR, ti.tcpi_rttvar);
+        stat_point_tcpi_add (us, TCPI_RETRANS, ti.tcpi_total_retrans);
+        stat_point_tcpi_add (us, TCPI_CWND, ti.tcpi_snd_cwnd);
+#else
+        (void) cctx;
+        (void) us;
+#endif
 }
 
 void stat_appl_delay_add (client_context* cctx, unsigned long resp_timestamp)
@@ -236,17 +465,22 @@ void stat_appl_delay_add (client_context* cctx, unsigned long resp_timestamp)
 
                 cctx->bctx->url_stats[cctx->url_curr_index].last_resp = req_duration;
 
+                stat_point_resp_hist_add (&cctx->bctx->url_stats[cctx->url_curr_index],
+                                          req_duration);
+
                 if (cctx->is_https)
                 {
                         cctx->bctx->https_delta.appl_delay =
                                 (cctx->bctx->https_delta.appl_delay * cctx->bctx->https_delta.appl_delay_points +
                                  req_duration) / ++cctx->bctx->https_delta.appl_delay_points;
+                        stat_point_resp_hist_add (&cctx->bctx->https_delta, req_duration);
                 }
                 else
                 {
                         cctx->bctx->http_delta.appl_delay =
                                 (cctx->bctx->http_delta.appl_delay * cctx->bctx->http_delta.appl_delay_points +
                                  req_duration) / ++cctx->bctx->http_delta.appl_delay_points;
+                        stat_point_resp_hist_add (&cctx->bctx->http_delta, req_duration);
                 }
         }
 }
@@ -290,15 +524,17 @@ void stat_appl_delay_2xx_add (client_context* cctx, unsigned long resp_timestamp
 
 void dump_client (FILE* file, client_context* cctx)
 {
-        if (!file || !cctx)
+        client_stat* st;
+
+        if (!file || !cctx || !(st = client_stats (cctx)))
                 return;
 
         fprintf (file,
                  "%s,cycles:%ld,state:%d,b-in:%lld,b-out:%lld,req:%ld,1xx:%ld,2xx:%ld,3xx:%ld,4xx:%ld,5xx:%ld,err:%ld,T-err:%ld\n",
-                 cctx->client_name, cctx->cycle_num, cctx->client_state,
-                 cctx->st.data_in,  cctx->st.data_out, cctx->st.requests,
-                 cctx->st.resp_1xx, cctx->st.resp_2xx, cctx->st.resp_3xx, cctx->st.resp_4xx, cctx->st.resp_5xx,
-                 cctx->st.other_errs, cctx->st.url_timeout_errs);
+                 client_name (cctx), cctx->cycle_num, cctx->client_state,
+                 st->data_in,  st->data_out, st->requests,
+                 st->resp_1xx, st->resp_2xx, st->resp_3xx, st->resp_4xx, st->resp_5xx,
+                 st->other_errs, st->url_timeout_errs);
 
         fflush (file);
 }
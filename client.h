@@ -61,6 +61,105 @@ typedef enum cstate
 /* Forward declarations */
 struct batch_context;
 
+/*
+   Flags of the first header seen by a client for the current request/response.
+
+   Indication of the first header is used to collect statistics. Statistics is
+   updated only once on the first header of req/resp.
+ */
+#define FIRST_HDR_REQ 0x01
+#define FIRST_HDR_1XX 0x02
+#define FIRST_HDR_2XX 0x04
+#define FIRST_HDR_3XX 0x08
+#define FIRST_HDR_4XX 0x10
+#define FIRST_HDR_5XX 0x20
+
+/*
+   client_stat - per-client counters, dumped to the <batch-name>.ctx file.
+   Kept in a side table of the batch (cstats), allocated only when the
+   clients dump is enabled by DUMP_CLIENTS tag.
+ */
+typedef struct client_stat
+{
+        unsigned long long data_in;
+        unsigned long long data_out;
+        unsigned long requests;
+        unsigned long resp_1xx;
+        unsigned long resp_2xx;
+        unsigned long resp_3xx;
+        unsigned long resp_4xx;
+        unsigned long resp_5xx;
+        unsigned long other_errs;
+        unsigned long url_timeout_errs;
+} client_stat;
+
+/*
+   client_forms - client buffers for POST-ing and for GET-ing with form strings.
+   Kept in a side table of the batch (cforms), allocated only, when at least
+   a single url is configured with <form_str>.
+ */
+typedef struct client_forms
+{
+        char* post_data;
+
+        size_t post_data_len;
+
+        char* get_url_form_data;
+
+        size_t get_url_form_data_len;
+} client_forms;
+
+/*
+   client_resp_logs - client files for logging of responses headers and bodies.
+   Kept in a side table of the batch (cresp_logs), allocated only, when at
+   least a single url is configured with LOG_RESP_HEADERS or LOG_RESP_BODIES.
+   The files are used, unless the responses go to the segmented store.
+ */
+typedef struct client_resp_logs
+{
+        FILE* logfile_headers;
+
+        FILE* logfile_bodies;
+
+        /*
+           Response being collected for the segmented store (LOG_RESP_SEGMENTS):
+           headers and body buffers with their used lengths and sizes, cycle
+           and url of the response, whether it is still to be stored and
+           whether bytes of it were lost, when a buffer could not be grown.
+         */
+        char* hdr_buf;
+        size_t hdr_len;
+        size_t hdr_size;
+
+        char* body_buf;
+        size_t body_len;
+        size_t body_size;
+
+        long resp_cycle;
+        long resp_url;
+        int resp_pending;
+        int resp_truncated;
+} client_resp_logs;
+
+/*
+   client_req_stat - scratch counters of the request in progress.
+   Updated from the libcurl trace callbacks and committed to the client,
+   url and batch statistics once per request by stat_request_commit ().
+ */
+typedef struct client_req_stat
+{
+        unsigned long data_in;
+        unsigned long data_out;
+        unsigned short requests;
+        unsigned short resp_1xx;
+        unsigned short resp_2xx;
+        unsigned short resp_3xx;
+        unsigned short resp_4xx;
+        unsigned short resp_5xx;
+        unsigned short other_errs;
+        unsigned short url_timeout_errs;
+} client_req_stat;
+
 /*
    client_context -the structure is the placeholder of  a virtual client
    stateful information.
@@ -68,12 +167,11 @@ struct batch_context;
    Client context is passed to curl handle as the private data to be returned
    back to the tracing function for output to logfile.
 
-   Client context is also heavily used for login/logoff operations, keeping
-   client-specific POST-buffers, is a placeholder for loading statistics and
-   counters, assisting to collect such statistics.
-
-   Client context keeps client specific context for loading, e.g. pointer to
-   libcurl handle (CURL* handle), number of cycles done, etc.
+   Client context keeps only the fields used at each loading step, e.g. pointer
+   to libcurl handle (CURL* handle), number of cycles done, current url, etc.
+   Data used rarely or by some configurations only (client statistics, POST-buffers,
+   response logfiles, fetch decisions) is kept in side tables of the batch context,
+   indexed by <client_index>, and allocated only when required.
 
    client_context inherits from timer_node (the first field) to enable usage of
    client_context in timer-queue.
@@ -95,27 +193,20 @@ typedef struct client_context
 
         long tid_url_completion;
 
-        /*
-           <Current Cycle Num> space <Client Sequence Num> space <Client IP-address>
-         */
-        char client_name[CLIENT_NAME_LEN];
-
         /*
            Library handle, representing all knowledge about the client from the
            side of libcurl library. We set to it url, timeouts, etc, using libcurl API.
          */
         CURL* handle;
 
-        /*
-           Current cycle number.
-         */
-        long cycle_num;
+        /* Cookies of the client for handles duplicated from url templates */
+        CURLSH* cookie_share;
 
         /*
-           The file to be used as an output channel for this particular
-           client (normally used a file-per-batch logging strategy)
+           Handles of the client duplicated from url templates, indexed by url,
+           allocated on the first use and kept till the end of the batch.
          */
-        FILE* file_output;
+        CURL** url_handles;
 
         /*
            Batch context, which is running the client. Used for getting configs, like
@@ -123,6 +214,11 @@ typedef struct client_context
          */
         struct batch_context* bctx;
 
+        /*
+           Current cycle number.
+         */
+        long cycle_num;
+
         /* Index of the client within its batch. */
         size_t client_index;
 
@@ -132,79 +228,86 @@ typedef struct client_context
         /* Remember here preload url. */
         size_t preload_url_curr_index;
 
+        /*
+           Timestamp of a request sent. Used to calculate server
+           application response delay.
+         */
+        unsigned long req_sent_timestamp;
+
+        /*
+           Msec from req_sent_timestamp till the request headers were sent,
+           i.e. the wait of the request in the queue of a shared connection.
+         */
+        unsigned long req_queue_msec;
+
         /* Current state of the client. */
         cstate client_state;
 
         /* Remember here pre-load state of a client. */
         cstate preload_state;
 
+        /* Statistics of the request in progress, not yet committed */
+        client_req_stat rs;
+
         /* Number of errors */
         int errors_num;
 
         /* Whether to update statistics of https or http. What about ftp: TODO */
-        int is_https;
+        unsigned char is_https;
 
-        /*
-           The buffers for the POST method login and logoff are allocated only,
-           when a single url is configured to make some POST-ing and has
-           filled <form_str>
-         */
-        char* post_data;
-
-        size_t post_data_len;
-
-        char* get_url_form_data;
-
-        size_t get_url_form_data_len;
-
-        FILE* logfile_headers;
+        /* The transfer of the current url is run by the fast engine, ENGINE FAST */
+        unsigned char fast;
 
-        FILE* logfile_bodies;
-
-        char* url_fetch_decision;
+        /* TLS_HS_* outcome of a TLS handshake of the request in progress (-H) */
+        unsigned char tls_hs;
 
         /*
-           Counter of the headers going in or out.  For the first header in request
-           or response, the respective counter is zero, whereas next headers of the same
-           request/response are positive numbers.
-
-           Indication of the first header is used to collect statistics. Statistics is
-           updated only once on the first header of req/resp.
+           FIRST_HDR_* flags of the headers already seen for the current
+           request and response.
          */
-        int first_hdr_req;
-        int first_hdr_1xx;
-        int first_hdr_2xx;
-        int first_hdr_3xx;
-        int first_hdr_4xx;
-        int first_hdr_5xx;
+        unsigned char first_hdrs;
 
         /*
-           Timestamp of a request sent. Used to calculate server
-           application response delay.
+           GF
+           The previous curl_infotype seen by this client in a server response.
+           Used by scan_response() for url-set
          */
-        unsigned long req_sent_timestamp;
+        unsigned char previous_type;
 
         /*
-           Client-based statistics. Parallel to updating batch statistics,
-           client-based statistics is also updated.
+           The file to be used as an output channel for this particular
+           client (normally used a file-per-batch logging strategy)
          */
-        stat_point st;
+        FILE* file_output;
 
         /*
            Pointer to socket data used by hyper-mode
          */
         void * ext_data;
 
+} client_context;
 
-        /*
-           GF
-           The previous curl_infotype seen by this client in a server response.
-           Used by scan_response() for url-set
-         */
-        curl_infotype previous_type;
+/*
+   Returns client name for logging: <Client Sequence Num> space, and with
+   verbose logging also (<Client IP-address>). The name is formatted to
+   a thread-local buffer, valid till the next call by the same thread.
+ */
+const char* client_name (client_context* cctx);
 
+/*
+   Accessors to the side tables of a client. Return NULL, when the
+   table has not been allocated for the batch.
+ */
+client_stat* client_stats (client_context* cctx);
+client_forms* client_forms_get (client_context* cctx);
+client_resp_logs* client_resp_logs_get (client_context* cctx);
+char* client_fetch_decisions (client_context* cctx);
 
-} client_context;
+/*
+   Returns bytes of memory used per client by the client context and
+   allocated side tables of the batch.
+ */
+size_t client_bytes_per_client (struct batch_context* bctx);
 
 int first_hdr_req (client_context* cctx);
 void first_hdr_req_inc (client_context* cctx);
@@ -243,6 +346,13 @@ void stat_3xx_inc (client_context* cctx);
 void stat_4xx_inc (client_context* cctx);
 void stat_5xx_inc (client_context* cctx);
 
+/*
+   Commits the scratch counters of the accomplished request to the client,
+   url and batch statistics and clears them. Called on CURLMSG_DONE and on
+   url completion timeout.
+ */
+void stat_request_commit (client_context* cctx);
+
 void stat_appl_delay_add (client_context* cctx, unsigned long resp_timestamp);
 void stat_appl_delay_2xx_add (client_context* cctx, unsigned long resp_timestamp);
 
@@ -29,6 +29,7 @@
 #include <string.h>
 
 #include "conf.h"
+#include "topk.h"
 
 /*
    Command line configuration options. Setting defaults here.
@@ -61,6 +62,10 @@ int stderr_print_client_msg = 0;
 /* Storming or smooth loading */
 int loading_mode = LOAD_MODE_DEFAULT;
 
+/* Latency range of fake transfers in dry-run mode, msec */
+unsigned long sim_latency_min = 0;
+unsigned long sim_latency_max = 0;
+
 /* Whether to include url to all log outputs. */
 int url_logging = 0;
 
@@ -69,6 +74,26 @@ int detailed_logging = 0;
 
 int warnings_skip = 0;
 
+/* Log client activities by a writer thread in batches */
+int async_logging = 0;
+
+/* gzip compression level of the output files, 0 - no compression */
+int compress_level = 0;
+
+/* Tail-based logging: keep traces of failed, slower than msec, or 1 of N requests */
+int tail_logging = 0;
+unsigned long tail_latency_threshold = 0;
+unsigned int tail_sample_rate = 0;
+
+/* Number of the slowest requests per url to capture, 0 - disabled */
+int topk_slowest = 0;
+
+/* Sample TCP_INFO of 1 of N accomplished transfers, 0 - disabled */
+unsigned int tcp_info_sample_rate = 0;
+
+/* TLS handshake-rate mode: fresh connections and handshake statistics */
+int tls_handshake_mode = 0;
+
 /* Name of the configuration file */
 char config_file[PATH_MAX + 1];
 
@@ -81,14 +106,40 @@ char config_proxy[PATH_MAX];
  */
 unsigned long error_recovery_client = 1; /* Default: error recovery and continue */
 
+/* TCP port of the OpenMetrics listener. Zero - disabled. */
+int metrics_port = 0;
+
+/* Address of the OpenMetrics listener */
+char metrics_bind_addr[16] = "0.0.0.0";
+
+/* Redis server to publish statistics to. Empty - disabled. */
+char redis_host[256];
+int redis_port = 6379;
+
+/* Name of the Redis stream */
+char redis_stream[128] = "curl-loader";
+
+/* Whether to publish to Redis also per-request samples */
+int redis_samples = 0;
+
+static int parse_metrics_listen (char* str);
+static int parse_redis_target (char* str);
+static int parse_sim_latency (char* str);
+static int parse_tail_logging (char* str);
+
 int parse_command_line (int argc, char *argv [])
 {
         int rget_opt = 0;
+        int mode_opt = 0, dry_run_opt = 0; /* -m and -n given */
 
-        while ((rget_opt = getopt (argc, argv, "c:dehf:i:l:m:op:rst:vuwx:")) != EOF)
+        while ((rget_opt = getopt (argc, argv, "ac:dehf:Hi:I:k:l:m:M:n:op:rR:sSt:T:vuwx:z:")) != EOF)
         {
                 switch (rget_opt)
                 {
+                case 'a': /* Asynchronous logging of client activities */
+                        async_logging = 1;
+                        break;
+
                 case 'c': /* Connection establishment timeout */
                         if (!optarg || (connect_timeout = atoi (optarg)) <= 0)
                         {
@@ -119,6 +170,10 @@ int parse_command_line (int argc, char *argv [])
                         }
                         break;
 
+                case 'H': /* TLS handshake-rate mode */
+                        tls_handshake_mode = 1;
+                        break;
+
                 case 'i': /* Statistics snapshot timeout */
                         if (!optarg ||
                             (snapshot_statistics_timeout = atoi (optarg)) < 1)
@@ -129,6 +184,26 @@ int parse_command_line (int argc, char *argv [])
                         }
                         break;
 
+                case 'I': /* TCP_INFO sampling of 1 of N transfers */
+                        if (!optarg ||
+                            (tcp_info_sample_rate = (unsigned int) atoi (optarg)) < 1)
+                        {
+                                fprintf (stderr, "%s error: -I option should be followed by a number >= 1.\n",
+                                         __func__);
+                                return -1;
+                        }
+                        break;
+
+                case 'k': /* Capture the K slowest requests per url */
+                        if (!optarg ||
+                            (topk_slowest = atoi (optarg)) < 1 || topk_slowest > TOPK_MAX)
+                        {
+                                fprintf (stderr, "%s error: -k option should be followed by a number from 1 to %d.\n",
+                                         __func__, TOPK_MAX);
+                                return -1;
+                        }
+                        break;
+
                 case 'l': /* Number of cycles before a logfile rewinds. */
                         if (!optarg ||
                             (logfile_rewind_size = atol (optarg)) < 2)
@@ -139,17 +214,38 @@ int parse_command_line (int argc, char *argv [])
                         }
                         break;
 
-                case 'm': /* Modes of loading: SMOOTH and STORMING */
+                case 'm': /* Modes of loading: SMOOTH, STORMING and POOL */
 
                         if (!optarg ||
                             (((loading_mode = atol (optarg)) != LOAD_MODE_SMOOTH &&
-                              loading_mode != LOAD_MODE_HYPER )))
+                              loading_mode != LOAD_MODE_HYPER &&
+                              loading_mode != LOAD_MODE_POOL)))
                         {
-                                fprintf (stderr, "%s error: -m to be followed by a number either %d or %d.\n",
-                                         __func__, LOAD_MODE_SMOOTH, LOAD_MODE_HYPER);
+                                fprintf (stderr, "%s error: -m to be followed by a number %d, %d or %d.\n",
+                                         __func__, LOAD_MODE_HYPER, LOAD_MODE_SMOOTH, LOAD_MODE_POOL);
                                 return -1;
                         }
+                        mode_opt = 1;
+                        break;
 
+                case 'M': /* OpenMetrics listener [address:]port */
+                        if (!optarg || parse_metrics_listen (optarg) == -1)
+                        {
+                                fprintf (stderr, "%s error: -M option should be followed by [address:]port.\n",
+                                         __func__);
+                                return -1;
+                        }
+                        break;
+
+                case 'n': /* Dry run with fake transfers of latency msec[-msec] */
+                        if (!optarg || parse_sim_latency (optarg) == -1)
+                        {
+                                fprintf (stderr, "%s error: -n option should be followed by "
+                                         "latency in msec or a range msec-msec.\n", __func__);
+                                return -1;
+                        }
+                        loading_mode = LOAD_MODE_DRY_RUN;
+                        dry_run_opt = 1;
                         break;
 
                 case 'o': /* Print body of the file to stdout. Default - just skip it. */
@@ -159,6 +255,19 @@ int parse_command_line (int argc, char *argv [])
                 case 'r':
                         break;
 
+                case 'R': /* Redis server and stream to publish statistics */
+                        if (!optarg || parse_redis_target (optarg) == -1)
+                        {
+                                fprintf (stderr, "%s error: -R option should be followed by host[:port][/stream].\n",
+                                         __func__);
+                                return -1;
+                        }
+                        break;
+
+                case 'S': /* Publish also per-request samples to Redis */
+                        redis_samples = 1;
+                        break;
+
                 case 's': /* Stderr printout of client messages (instead of to a batch logfile). */
                         stderr_print_client_msg = 1;
                         break;
@@ -174,6 +283,17 @@ int parse_command_line (int argc, char *argv [])
                         }
                         break;
 
+                case 'T': /* Tail-based sampled logging */
+                        if (!optarg || parse_tail_logging (optarg) == -1)
+                        {
+                                fprintf (stderr, "%s error: -T option should be followed by "
+                                         "latency threshold in msec and optionally :N for "
+                                         "1 of N sampling.\n", __func__);
+                                return -1;
+                        }
+                        tail_logging = 1;
+                        break;
+
                 case 'v': /* accumulate verbosity */
                         verbose_logging += 1;
                         break;
@@ -196,6 +316,16 @@ int parse_command_line (int argc, char *argv [])
                         }
                         break;
 
+                case 'z': /* gzip compression of output files */
+                        if (!optarg ||
+                            (compress_level = atoi (optarg)) < 1 || compress_level > 9)
+                        {
+                                fprintf (stderr, "%s error: -z option should be followed by a compression level from 1 to 9.\n",
+                                         __func__);
+                                return -1;
+                        }
+                        break;
+
                 default:
                         fprintf (stderr, "%s error: not supported option\n", __func__);
                         print_help ();
@@ -203,6 +333,27 @@ int parse_command_line (int argc, char *argv [])
                 }
         }
 
+        if (dry_run_opt && mode_opt)
+        {
+                fprintf (stderr, "%s error: -n dry run is not supported with -m mode.\n",
+                         __func__);
+                return -1;
+        }
+
+        if (loading_mode == LOAD_MODE_DRY_RUN && threads_subbatches_num)
+        {
+                fprintf (stderr, "%s error: -n dry run is not supported with -t threads.\n",
+                         __func__);
+                return -1;
+        }
+
+        if (loading_mode == LOAD_MODE_POOL && threads_subbatches_num)
+        {
+                fprintf (stderr, "%s error: -m %d pool mode is not supported with -t threads.\n",
+                         __func__, LOAD_MODE_POOL);
+                return -1;
+        }
+
         if (optind < argc)
         {
                 fprintf (stderr, "%s error: non-option argv-elements: ", __func__);
@@ -216,23 +367,164 @@ int parse_command_line (int argc, char *argv [])
         return 0;
 }
 
+/*******************************************************************************
+ * Function name - parse_metrics_listen
+ *
+ * Description - Parses [address:]port of the OpenMetrics listener
+ *
+ * Input -       *str - the string to parse
+ * Return Code/Output - On Success - 0, on Error -1
+ ********************************************************************************/
+static int parse_metrics_listen (char* str)
+{
+        char* colon = strrchr (str, ':');
+        char* port_str = str;
+
+        if (colon)
+        {
+                const size_t addr_len = colon - str;
+
+                if (!addr_len || addr_len >= sizeof (metrics_bind_addr))
+                        return -1;
+
+                memcpy (metrics_bind_addr, str, addr_len);
+                metrics_bind_addr[addr_len] = '\0';
+                port_str = colon + 1;
+        }
+
+        if ((metrics_port = atoi (port_str)) <= 0 || metrics_port > 65535)
+                return -1;
+
+        return 0;
+}
+
+/*******************************************************************************
+ * Function name - parse_sim_latency
+ *
+ * Description - Parses msec or msec-msec latency range of dry-run fake transfers
+ *
+ * Input -       *str - the string to parse
+ * Return Code/Output - On Success - 0, on Error -1
+ ********************************************************************************/
+static int parse_sim_latency (char* str)
+{
+        char* end = NULL;
+
+        sim_latency_min = strtoul (str, &end, 10);
+        if (end == str)
+                return -1;
+
+        sim_latency_max = sim_latency_min;
+
+        if (*end == '-')
+        {
+                str = end + 1;
+                sim_latency_max = strtoul (str, &end, 10);
+                if (end == str)
+                        return -1;
+        }
+
+        if (*end || sim_latency_max < sim_latency_min)
+                return -1;
+
+        return 0;
+}
+
+/*******************************************************************************
+ * Function name - parse_tail_logging
+ *
+ * Description - Parses msec[:N] of tail-based sampled logging
+ *
+ * Input -       *str - the string to parse
+ * Return Code/Output - On Success - 0, on Error -1
+ ********************************************************************************/
+static int parse_tail_logging (char* str)
+{
+        char* end = NULL;
+
+        tail_latency_threshold = strtoul (str, &end, 10);
+        if (end == str)
+                return -1;
+
+        if (*end == ':')
+        {
+                str = end + 1;
+                tail_sample_rate = strtoul (str, &end, 10);
+                if (end == str)
+                        return -1;
+        }
+
+        if (*end)
+                return -1;
+
+        return 0;
+}
+
+/*******************************************************************************
+ * Function name - parse_redis_target
+ *
+ * Description - Parses host[:port][/stream] of the Redis statistics publisher
+ *
+ * Input -       *str - the string to parse
+ * Return Code/Output - On Success - 0, on Error -1
+ ********************************************************************************/
+static int parse_redis_target (char* str)
+{
+        char* slash = strchr (str, '/');
+        char* colon;
+
+        if (slash)
+        {
+                if (!slash[1] || strlen (slash + 1) >= sizeof (redis_stream))
+                        return -1;
+
+                strcpy (redis_stream, slash + 1);
+                *slash = '\0';
+        }
+
+        if ((colon = strchr (str, ':')))
+        {
+                if ((redis_port = atoi (colon + 1)) <= 0 || redis_port > 65535)
+                        return -1;
+
+                *colon = '\0';
+        }
+
+        if (!*str || strlen (str) >= sizeof (redis_host))
+                return -1;
+
+        strcpy (redis_host, str);
+
+        return 0;
+}
+
 void print_help ()
 {
         fprintf (stderr, "Note, to run your load, create your batch configuration file.\n\n");
         fprintf (stderr, "usage: run as a root:\n");
         fprintf (stderr, "./curl-loader -f <configuration file name> with [other options below]:\n");
+        fprintf (stderr, " -a[synchronous logging of clients: records are formatted and written in batches by a writer thread]\n");
         fprintf (stderr, " -c[onnection establishment timeout, seconds]\n");
         fprintf (stderr, " -d[etailed logging; outputs to logfile headers and bodies of requests/responses. Good for text pages/files]\n");
         fprintf (stderr, " -e[rror drop client (smooth mode). Client on error doesn't attempt next cycle]\n");
+        fprintf (stderr, " -H - TLS handshake-rate mode: fresh connections, handshakes/s, resumption ratio and failures\n");
         fprintf (stderr, " -i[ntermediate (snapshot) statistics time interval (default 3 sec)]\n");
+        fprintf (stderr, " -I N - sample TCP_INFO (RTT, RTT variance, retransmits, cwnd) of 1 of N transfers to per url histograms\n");
+        fprintf (stderr, " -k K - capture the K slowest requests per url with timing details to the final report and JSON\n");
         fprintf (stderr, " -l[ogfile max size in MB (default 1024). On the size reached, file pointer rewinded]\n");
-        fprintf (stderr, " -m[ode of loading, 0 - hyper  (default), 1 - smooth]\n");
+        fprintf (stderr, " -m[ode of loading, 0 - hyper  (default), 1 - smooth, 3 - connection pool]\n");
+        fprintf (stderr, " -M [address:]port - serve OpenMetrics (Prometheus) statistics at http://address:port/metrics\n");
+        fprintf (stderr, " -n msec[-msec] - dry run without network: fake transfers of the latency on a virtual clock\n");
         fprintf (stderr, " -r[euse onnections disabled. Close connections and re-open them. Try with and without]\n");
+        fprintf (stderr, " -R host[:port][/stream] - publish interval statistics to a Redis stream (default port 6379, stream curl-loader)\n");
+        fprintf (stderr, " -S[amples of each request published to Redis as well, when -R is used]\n");
         fprintf (stderr, " -t[hreads number to run batch clients as sub-batches in several threads. Works to utilize SMP/m-core HW]\n");
+        fprintf (stderr, " -T msec[:N] - tail-based logging: only traces of failed requests, slower than msec or 1 of N random requests\n");
         fprintf (stderr, " -v[erbose output to the logfiles; includes info about headers sent/received]\n");
         fprintf (stderr, " -u[rl logging - logs url names to logfile, when -v verbose option is used]\n");
         fprintf (stderr, " -w[arnings skip]\n");
         fprintf (stderr, " -x[set|unset proxy] \"<proxy:port>\"\n");
+        fprintf (stderr, " -z level - gzip compression (1-9) of logfile, statistics files and responses store by a compressor thread\n");
         fprintf (stderr, "\n");
 
         fprintf (stderr, "For more examples of configuration files please, look at \"conf-examples\" directory.\n");
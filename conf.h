@@ -84,6 +84,23 @@ extern int stderr_print_client_msg;
  */
 extern unsigned long error_recovery_client;
 
+/*
+   TCP port and address of the embedded OpenMetrics (Prometheus) listener,
+   run by the batch group leader. Zero port means disabled.
+ */
+extern int metrics_port;
+extern char metrics_bind_addr[16];
+
+/*
+   Redis server, port and stream to publish statistics to by XADD.
+   Empty host means disabled. When redis_samples is true, a record per
+   accomplished request is published as well.
+ */
+extern char redis_host[256];
+extern int redis_port;
+extern char redis_stream[128];
+extern int redis_samples;
+
 /*
    Loading modes: Storming and Smooth
  */
@@ -91,12 +108,21 @@ enum load_mode
 {
         LOAD_MODE_HYPER = 0, /* Hyper-mode via epoll () */
         LOAD_MODE_SMOOTH = 1, /* Smooth mode via select () */
+        LOAD_MODE_DRY_RUN = 2, /* Network-free simulation on a virtual clock */
+        LOAD_MODE_POOL = 3, /* Fixed pool of connections with requests in flight */
 };
 
 #define LOAD_MODE_DEFAULT LOAD_MODE_HYPER
 
 extern int loading_mode;
 
+/*
+   Dry-run mode (-n): fake transfers complete after a latency, sampled
+   uniformly from the range in msec.
+ */
+extern unsigned long sim_latency_min;
+extern unsigned long sim_latency_max;
+
 /*
    Whether to include url name string to all log outputs. May be useful,
    normally used with verbose logging, like '-v -u' in command line.
@@ -106,6 +132,44 @@ extern int detailed_logging;
 
 extern int warnings_skip;
 
+/*
+   Whether client activities are logged asynchronously by a writer thread.
+ */
+extern int async_logging;
+
+/*
+   gzip compression level (1-9) of the logfile, statistics files and
+   the responses store, 0 - files are not compressed.
+ */
+extern int compress_level;
+
+/*
+   Tail-based sampled logging: traces of requests are written to the logfile
+   only for failed requests, requests slower than tail_latency_threshold msec
+   (0 - no threshold) and 1 of tail_sample_rate requests (0 - no sampling).
+ */
+extern int tail_logging;
+extern unsigned long tail_latency_threshold;
+extern unsigned int tail_sample_rate;
+
+/*
+   Number of the slowest requests per url, captured with timing details
+   for the final report and JSON output, 0 - no capture.
+ */
+extern int topk_slowest;
+
+/*
+   TCP_INFO of the connection is sampled at completion of 1 of
+   tcp_info_sample_rate transfers to histograms per url, 0 - no sampling.
+ */
+extern unsigned int tcp_info_sample_rate;
+
+/*
+   TLS handshake-rate mode: all urls use fresh connections, and full, resumed
+   and failed TLS handshakes with handshake time histograms are reported.
+ */
+extern int tls_handshake_mode;
+
 /*
    Name of the configuration file.
  */
@@ -0,0 +1,589 @@
+/*
+*     dns_pin.c
+*
+* 2006-2007 Copyright (c)
+* Robert Iakobashvili, <coroberti@gmail.com>
+* Michael Moser,  <moser.michael@gmail.com>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+// must be first include
+#include "fdsetsize.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+
+#include <ares.h>
+
+#include "dns_pin.h"
+#include "batch.h"
+#include "conf.h"
+#include "timer_tick.h"
+#include "url.h"
+
+/*
+   A hostname and port of the urls, resolved to an address of the family
+   of the client addresses.
+ */
+typedef struct dns_pin_entry
+{
+        char* host;
+        int port;
+
+        /* AF_INET or AF_INET6 */
+        int family;
+
+        /* The pinned address, empty when not resolved yet */
+        char addr[INET6_ADDRSTRLEN];
+
+        /* Result of the latest resolving, empty on failure */
+        char resolved[INET6_ADDRSTRLEN];
+} dns_pin_entry;
+
+/* Written by the main thread at the start and afterwards by the refresh thread */
+static dns_pin_entry* entries = NULL;
+static int entries_num = 0;
+
+/* The published CURLOPT_RESOLVE lists for IPv4 and IPv6 batches */
+static struct curl_slist* volatile lists[2] = {NULL, NULL};
+
+/* Lists replaced by the refresh, still referred by the handles */
+static struct curl_slist** retired = NULL;
+static int retired_num = 0;
+
+static int pin_started = 0;
+
+static pthread_t refresh_thread;
+static int refresh_started = 0;
+static int refresh_interval = 0;
+static int refresh_stopping = 0;
+static pthread_mutex_t refresh_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t refresh_cond = PTHREAD_COND_INITIALIZER;
+
+static int dns_pin_add_url (const char* url, int family);
+static int dns_pin_url_host (const char* url, char* host, size_t host_len, int* port);
+static int dns_pin_resolve (unsigned long timeout_msec);
+static void dns_pin_callback (void* arg, int status, int timeouts, struct hostent* he);
+static int dns_pin_publish (int verbose);
+static void* dns_pin_refresher (void* arg);
+
+
+/****************************************************************************************
+* Function name - dns_pin_start
+*
+* Description - Resolves the hostnames of the urls of the batches, configured with
+*               DNS_MODE PIN, and starts the refresh thread, when configured by
+*               DNS_REFRESH_INTERVAL.
+*
+* Input -       *bctx_array - pointer to the array of batch contexts
+*               bctx_num    - number of batch contexts in <bctx_array>
+* Return Code/Output - On Success - 0, on Error -1
+****************************************************************************************/
+int dns_pin_start (batch_context* bctx_array, int bctx_num)
+{
+        unsigned long start_time;
+        int b, i, k, status;
+
+        if (pin_started || loading_mode == LOAD_MODE_DRY_RUN)
+        {
+                return 0;
+        }
+
+        for (b = 0; b < bctx_num; b++)
+        {
+                batch_context* bctx = &bctx_array[b];
+                const int family = bctx->ipv6 ? AF_INET6 : AF_INET;
+
+                if (bctx->dns_mode != DNS_MODE_PIN)
+                        continue;
+
+                if (bctx->dns_refresh_interval &&
+                    (!refresh_interval || bctx->dns_refresh_interval < refresh_interval))
+                {
+                        refresh_interval = bctx->dns_refresh_interval;
+                }
+
+                for (i = 0; i < bctx->urls_num; i++)
+                {
+                        url_context* url = &bctx->url_ctx_array[i];
+
+                        if (dns_pin_add_url (url->url_str, family) == -1 ||
+                            dns_pin_add_url (url->template.string, family) == -1)
+                        {
+                                return -1;
+                        }
+
+                        for (k = 0; k < url->set.n_urles; k++)
+                        {
+                                if (dns_pin_add_url (url->set.urles[k].string, family) == -1)
+                                        return -1;
+                        }
+                }
+        }
+
+        if (!entries_num)
+        {
+                return 0;
+        }
+
+        if ((status = ares_library_init (ARES_LIB_INIT_ALL)) != ARES_SUCCESS)
+        {
+                fprintf (stderr, "%s - error: ares_library_init () failed with \"%s\".\n",
+                         __func__, ares_strerror (status));
+                return -1;
+        }
+
+        pin_started = 1;
+        atexit (dns_pin_stop);
+
+        /* All the hostnames are resolved in parallel */
+        start_time = get_tick_count ();
+
+        if (dns_pin_resolve (DNS_PIN_WARMUP_MSEC) == -1)
+        {
+                return -1;
+        }
+
+        if (dns_pin_publish (1) == -1)
+        {
+                return -1;
+        }
+
+        fprintf (stderr, "%s - %d hostnames resolved in %lu msec.\n",
+                 __func__, entries_num, get_tick_count () - start_time);
+
+        if (refresh_interval)
+        {
+                if (pthread_create (&refresh_thread, NULL, dns_pin_refresher, NULL))
+                {
+                        fprintf (stderr, "%s - error: pthread_create () failed with errno %d.\n",
+                                 __func__, errno);
+                        return -1;
+                }
+                refresh_started = 1;
+        }
+
+        return 0;
+}
+
+/****************************************************************************************
+* Function name - dns_pin_stop
+*
+* Description - Stops the refresh thread and frees the pinned addresses.
+*               Registered by dns_pin_start () to run at exit.
+*
+* Return Code/Output - None
+****************************************************************************************/
+void dns_pin_stop ()
+{
+        int i;
+
+        if (!pin_started)
+                return;
+
+        if (refresh_started)
+        {
+                pthread_mutex_lock (&refresh_mutex);
+                refresh_stopping = 1;
+                pthread_cond_signal (&refresh_cond);
+                pthread_mutex_unlock (&refresh_mutex);
+
+                pthread_join (refresh_thread, NULL);
+                refresh_started = 0;
+        }
+
+        for (i = 0; i < 2; i++)
+        {
+                curl_slist_free_all (lists[i]);
+                lists[i] = NULL;
+        }
+
+        for (i = 0; i < retired_num; i++)
+        {
+                curl_slist_free_all (retired[i]);
+        }
+        free (retired);
+        retired = NULL;
+        retired_num = 0;
+
+        for (i = 0; i < entries_num; i++)
+        {
+                free (entries[i].host);
+        }
+        free (entries);
+        entries = NULL;
+        entries_num = 0;
+
+        ares_library_cleanup ();
+        pin_started = 0;
+}
+
+/****************************************************************************************
+* Function name - dns_pin_handle_setup
+*
+* Description - Applies DNS_MODE of the batch to the handle before a transfer:
+*               passes the pinned addresses by CURLOPT_RESOLVE, or disables DNS
+*               cache to measure the lookups.
+*
+* Input -       *bctx   - pointer to the batch context
+*               *handle - the CURL handle of a client
+* Return Code/Output - None
+****************************************************************************************/
+void dns_pin_handle_setup (batch_context* bctx, CURL* handle)
+{
+        struct curl_slist* list;
+
+        if (bctx->dns_mode == DNS_MODE_PHASE)
+        {
+                /* Each new connection resolves its hostname */
+                curl_easy_setopt (handle, CURLOPT_DNS_CACHE_TIMEOUT, 0L);
+                return;
+        }
+
+        if (bctx->dns_mode != DNS_MODE_PIN || !(list = lists[bctx->ipv6 ? 1 : 0]))
+        {
+                return;
+        }
+
+        /*
+           libcurl loads the list to the DNS cache at the start of the transfer.
+           The pinned entries never expire and are replaced by a new address
+           of the list (patches/curl-resolve-replace.patch).
+         */
+        curl_easy_setopt (handle, CURLOPT_DNS_CACHE_TIMEOUT, -1L);
+        curl_easy_setopt (handle, CURLOPT_RESOLVE, list);
+}
+
+/*
+   Adds the hostname of the url to the entries, unless it is an address,
+   a templated name or already added.
+ */
+static int dns_pin_add_url (const char* url, int family)
+{
+        char host[256];
+        int port, i;
+        dns_pin_entry* e;
+
+        if (!url || dns_pin_url_host (url, host, sizeof (host), &port) == -1)
+        {
+                return 0;
+        }
+
+        for (i = 0; i < entries_num; i++)
+        {
+                if (entries[i].port == port && entries[i].family == family &&
+                    !strcasecmp (entries[i].host, host))
+                        return 0;
+        }
+
+        if (!(e = realloc (entries, (entries_num + 1) * sizeof (dns_pin_entry))))
+        {
+                fprintf (stderr, "%s - error: realloc () failed.\n", __func__);
+                return -1;
+        }
+        entries = e;
+
+        e = &entries[entries_num];
+        memset (e, 0, sizeof (*e));
+
+        if (!(e->host = strdup (host)))
+        {
+                fprintf (stderr, "%s - error: strdup () failed.\n", __func__);
+                return -1;
+        }
+
+        e->port = port;
+        e->family = family;
+        entries_num++;
+
+        return 0;
+}
+
+/*
+   Extracts the hostname and port from the url. Returns -1, when there is no
+   hostname to resolve.
+ */
+static int dns_pin_url_host (const char* url, char* host, size_t host_len, int* port)
+{
+        const char* p = strstr (url, "://");
+        const char* end;
+        const char* at;
+        const char* colon;
+        size_t len;
+        struct in_addr in4;
+
+        *port = 80;
+
+        if (p)
+        {
+                const size_t scheme_len = p - url;
+
+                if (scheme_len == 5 && !strncasecmp (url, "https", 5))
+                        *port = 443;
+                else if (scheme_len == 3 && !strncasecmp (url, "ftp", 3))
+                        *port = 21;
+                else if (scheme_len == 4 && !strncasecmp (url, "ftps", 4))
+                        *port = 990;
+
+                url = p + 3;
+        }
+
+        end = url + strcspn (url, "/?#");
+
+        /* Skip user credentials */
+        for (at = url; at < end; at++)
+        {
+                if (*at == '@')
+                        url = at + 1;
+        }
+
+        /* IPv6 literal */
+        if (*url == '[')
+        {
+                return -1;
+        }
+
+        if ((colon = memchr (url, ':', end - url)))
+        {
+                *port = atoi (colon + 1);
+                end = colon;
+        }
+
+        len = end - url;
+
+        if (!len || len >= host_len || memchr (url, '%', len))
+        {
+                return -1;
+        }
+
+        memcpy (host, url, len);
+        host[len] = '\0';
+
+        /* Address literal */
+        if (inet_pton (AF_INET, host, &in4) == 1)
+        {
+                return -1;
+        }
+
+        return 0;
+}
+
+/*
+   Resolves all the entries in parallel to their <resolved> addresses.
+   Zero timeout waits for the timeouts of c-ares.
+ */
+static int dns_pin_resolve (unsigned long timeout_msec)
+{
+        const unsigned long start_time = get_tick_count ();
+        ares_channel channel;
+        int i, status;
+
+        if ((status = ares_init (&channel)) != ARES_SUCCESS)
+        {
+                fprintf (stderr, "%s - error: ares_init () failed with \"%s\".\n",
+                         __func__, ares_strerror (status));
+                return -1;
+        }
+
+        for (i = 0; i < entries_num; i++)
+        {
+                entries[i].resolved[0] = '\0';
+                ares_gethostbyname (channel, entries[i].host, entries[i].family,
+                                    dns_pin_callback, &entries[i]);
+        }
+
+        for (;;)
+        {
+                fd_set read_fds, write_fds;
+                struct timeval tv, *tvp;
+                int nfds;
+
+                FD_ZERO (&read_fds);
+                FD_ZERO (&write_fds);
+
+                if (!(nfds = ares_fds (channel, &read_fds, &write_fds)))
+                        break;
+
+                if (timeout_msec && get_tick_count () - start_time >= timeout_msec)
+                {
+                        fprintf (stderr, "%s - error: resolving timed out.\n", __func__);
+                        break;
+                }
+
+                tvp = ares_timeout (channel, NULL, &tv);
+
+                if (select (nfds, &read_fds, &write_fds, NULL, tvp) == -1 && errno != EINTR)
+                {
+                        fprintf (stderr, "%s - error: select () failed with errno %d.\n",
+                                 __func__, errno);
+                        break;
+                }
+
+                ares_process (channel, &read_fds, &write_fds);
+        }
+
+        /* Completes the queries still pending as failed */
+        ares_destroy (channel);
+
+        return 0;
+}
+
+static void dns_pin_callback (void* arg, int status, int timeouts, struct hostent* he)
+{
+        dns_pin_entry* e = (dns_pin_entry *) arg;
+
+        (void) timeouts;
+
+        if (status != ARES_SUCCESS || !he || !he->h_addr_list[0])
+        {
+                if (status != ARES_EDESTRUCTION)
+                        fprintf (stderr, "%s - error: resolving of %s failed with \"%s\".\n",
+                                 __func__, e->host, ares_strerror (status));
+                return;
+        }
+
+        if (!inet_ntop (he->h_addrtype, he->h_addr_list[0], e->resolved, sizeof (e->resolved)))
+        {
+                e->resolved[0] = '\0';
+        }
+}
+
+/*
+   Pins the resolved addresses and publishes new lists, when an address
+   changed. A failed resolving keeps the former address.
+ */
+static int dns_pin_publish (int verbose)
+{
+        struct curl_slist* new_lists[2] = {NULL, NULL};
+        char pair[512];
+        int i, f, changed = 0;
+
+        for (i = 0; i < entries_num; i++)
+        {
+                dns_pin_entry* e = &entries[i];
+
+                if (!e->resolved[0] || !strcmp (e->addr, e->resolved))
+                        continue;
+
+                if (verbose || e->addr[0])
+                {
+                        fprintf (stderr, "%s - %s:%d pinned to %s%s%s.\n", __func__,
+                                 e->host, e->port, e->resolved,
+                                 e->addr[0] ? ", formerly " : "", e->addr);
+                }
+
+                strcpy (e->addr, e->resolved);
+                changed = 1;
+        }
+
+        if (!changed)
+        {
+                return 0;
+        }
+
+        for (i = 0; i < entries_num; i++)
+        {
+                dns_pin_entry* e = &entries[i];
+                struct curl_slist* l;
+
+                if (!e->addr[0])
+                        continue;
+
+                f = (e->family == AF_INET6);
+
+                snprintf (pair, sizeof (pair), "%s:%d:%s", e->host, e->port, e->addr);
+
+                if (!(l = curl_slist_append (new_lists[f], pair)))
+                {
+                        fprintf (stderr, "%s - error: curl_slist_append () failed.\n", __func__);
+                        curl_slist_free_all (new_lists[0]);
+                        curl_slist_free_all (new_lists[1]);
+                        return -1;
+                }
+                new_lists[f] = l;
+        }
+
+        for (f = 0; f < 2; f++)
+        {
+                if (lists[f])
+                {
+                        struct curl_slist** r = realloc (retired,
+                                                         (retired_num + 1) * sizeof (*retired));
+                        if (!r)
+                        {
+                                fprintf (stderr, "%s - error: realloc () failed.\n", __func__);
+                                curl_slist_free_all (new_lists[f]);
+                                continue;
+                        }
+                        retired = r;
+                        retired[retired_num++] = lists[f];
+                }
+
+                /* The list is complete before the loading threads see it */
+                __sync_synchronize ();
+                lists[f] = new_lists[f];
+        }
+
+        return 0;
+}
+
+/*
+   Re-resolves the hostnames each DNS_REFRESH_INTERVAL seconds.
+ */
+static void* dns_pin_refresher (void* arg)
+{
+        struct timespec ts;
+
+        (void) arg;
+
+        pthread_mutex_lock (&refresh_mutex);
+
+        while (!refresh_stopping)
+        {
+                clock_gettime (CLOCK_REALTIME, &ts);
+                ts.tv_sec += refresh_interval;
+
+                while (!refresh_stopping &&
+                       pthread_cond_timedwait (&refresh_cond, &refresh_mutex, &ts) != ETIMEDOUT)
+                        ;
+
+                if (refresh_stopping)
+                        break;
+
+                pthread_mutex_unlock (&refresh_mutex);
+
+                if (dns_pin_resolve (0) == 0)
+                {
+                        dns_pin_publish (0);
+                }
+
+                pthread_mutex_lock (&refresh_mutex);
+        }
+
+        pthread_mutex_unlock (&refresh_mutex);
+        return NULL;
+}
@@ -0,0 +1,90 @@
+/*
+*     dns_pin.h
+*
+* 2006-2007 Copyright (c)
+* Robert Iakobashvili, <coroberti@gmail.com>
+* Michael Moser,  <moser.michael@gmail.com>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef DNS_PIN_H
+#define DNS_PIN_H
+
+#include <curl/curl.h>
+
+/*
+   Resolving of the url hostnames out of the measured requests (DNS_MODE tag
+   of the general section).
+
+   PIN: before the load all the hostnames of the urls, url sets and templates
+   are resolved in parallel by c-ares and pinned to the handles by
+   CURLOPT_RESOLVE, so that no request waits for DNS. When DNS_REFRESH_INTERVAL
+   is configured, a background thread re-resolves them and publishes new
+   lists on a change. Published lists are kept until the exit, while
+   handles may still refer them.
+
+   PHASE: DNS cache of libcurl is disabled and the name lookup of each new
+   connection is counted as a phase of its own in the statistics.
+ */
+
+/* Values of DNS_MODE tag */
+#define DNS_MODE_DEFAULT 0
+#define DNS_MODE_PIN 1
+#define DNS_MODE_PHASE 2
+
+/* Time to wait for the resolving of all the hostnames at the start */
+#define DNS_PIN_WARMUP_MSEC 10000
+
+struct batch_context;
+
+/****************************************************************************************
+* Function name - dns_pin_start
+*
+* Description - Resolves the hostnames of the urls of the batches, configured with
+*               DNS_MODE PIN, and starts the refresh thread, when configured by
+*               DNS_REFRESH_INTERVAL.
+*
+* Input -       *bctx_array - pointer to the array of batch contexts
+*               bctx_num    - number of batch contexts in <bctx_array>
+* Return Code/Output - On Success - 0, on Error -1
+****************************************************************************************/
+int dns_pin_start (struct batch_context* bctx_array, int bctx_num);
+
+/****************************************************************************************
+* Function name - dns_pin_stop
+*
+* Description - Stops the refresh thread and frees the pinned addresses.
+*               Registered by dns_pin_start () to run at exit.
+*
+* Return Code/Output - None
+****************************************************************************************/
+void dns_pin_stop ();
+
+/****************************************************************************************
+* Function name - dns_pin_handle_setup
+*
+* Description - Applies DNS_MODE of the batch to the handle before a transfer:
+*               passes the pinned addresses by CURLOPT_RESOLVE, or disables DNS
+*               cache to measure the lookups.
+*
+* Input -       *bctx   - pointer to the batch context
+*               *handle - the CURL handle of a client
+* Return Code/Output - None
+****************************************************************************************/
+void dns_pin_handle_setup (struct batch_context* bctx, CURL* handle);
+
+#endif /* DNS_PIN_H */
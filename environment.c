@@ -46,6 +46,19 @@ int test_environment (batch_context* bctx)
         struct rlimit file_limit;
         int ret;
 
+        if (bctx->clients_rampup_period == 0)
+        {
+                bctx->clients_rampup_period = DEFAULT_RAMPUP_PERIOD;
+        }
+
+        /*
+           Dry run opens no sockets: descriptor limits and TCP tuning are not relevant.
+         */
+        if (loading_mode == LOAD_MODE_DRY_RUN)
+        {
+                return 0;
+        }
+
         ret = getrlimit(RLIMIT_NOFILE, &file_limit);
 
         /*
@@ -101,7 +114,9 @@ int test_environment (batch_context* bctx)
                         {
                                 fprintf(stderr, "and/or changing temporarily TCP stack defaults by running as a su:\n"
                                         "echo 1 > /proc/sys/net/ipv4/tcp_tw_recycle and/or\n"
-                                        "echo 1 > /proc/sys/net/ipv4/tcp_tw_reuse\n");
+                                        "echo 1 > /proc/sys/net/ipv4/tcp_tw_reuse\n"
+                                        "and/or closing connections without TIME_WAIT by SOCKET_LINGER_RST=Y\n"
+                                        "and sharing local ports by IP_BIND_ADDRESS_NO_PORT=Y in the batch file.\n");
                         }
 
                         fprintf (stderr, "Skip all warnings and suggestions by adding -w to command line.\n"
@@ -132,10 +147,5 @@ int test_environment (batch_context* bctx)
                 }
         }
 
-        if (bctx->clients_rampup_period == 0)
-        {
-                bctx->clients_rampup_period = DEFAULT_RAMPUP_PERIOD;
-        }
-
         return 0;
 }
@@ -0,0 +1,1601 @@
+/*
+*     fast.c
+*
+* 2006-2007 Copyright (c)
+* Robert Iakobashvili, <coroberti@gmail.com>
+* Michael Moser,  <moser.michael@gmail.com>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/* strcasestr () */
+#define _GNU_SOURCE
+
+// must be first include
+#include "fdsetsize.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <event.h>
+
+#include "fast.h"
+#include "batch.h"
+#include "client.h"
+#include "loader.h"
+#include "conf.h"
+#include "cl_alloc.h"
+#include "dns_pin.h"
+#include "timer_tick.h"
+
+/* Response lines are kept up to this size: status, headers and chunk sizes */
+#define FAST_LINE_MAX 256
+
+/* Size of the receive buffer of a batch */
+#define FAST_RECV_BUF_SIZE 65536
+
+/*
+   A compiled request of a url.
+ */
+typedef struct fast_req
+{
+        /* Request head and the POST body */
+        struct iovec iov[2];
+        int iovcnt;
+
+        /* Total bytes of the request */
+        size_t len;
+
+        /* Resolved address of the server */
+        struct sockaddr_storage addr;
+        socklen_t addr_len;
+
+} fast_req;
+
+/*
+   Compiled requests of a url: one, or one per url of an url set.
+ */
+typedef struct fast_url
+{
+        /* NULL, when the url is served by libcurl */
+        fast_req* reqs;
+        int reqs_num;
+
+} fast_url;
+
+typedef enum fast_conn_state
+{
+        FAST_CONN_CLOSED = 0,
+        FAST_CONN_IDLE,       /* Kept alive between transfers */
+        FAST_CONN_CONNECTING,
+        FAST_CONN_SENDING,
+        FAST_CONN_RECEIVING,
+        FAST_CONN_FAILED,     /* Failed at the start, completed from the loop */
+} fast_conn_state;
+
+typedef enum fast_parse_state
+{
+        FAST_PARSE_STATUS = 0,
+        FAST_PARSE_HEADERS,
+        FAST_PARSE_BODY,        /* Content-Length bytes of the body */
+        FAST_PARSE_CHUNK_SIZE,
+        FAST_PARSE_CHUNK_DATA,
+        FAST_PARSE_CHUNK_END,   /* CRLF after the chunk data */
+        FAST_PARSE_TRAILERS,
+        FAST_PARSE_UNTIL_CLOSE, /* Body without framing, up to the close */
+} fast_parse_state;
+
+struct fast_engine;
+
+/*
+   Connection of a client.
+ */
+typedef struct fast_conn
+{
+        int fd;
+
+        fast_conn_state state;
+
+        client_context* cctx;
+        struct fast_engine* fe;
+
+        /* Request of the current url and bytes of it sent */
+        fast_req* req;
+        size_t sent;
+
+        /* Peer of the connection, to tell, whether it can be re-used */
+        struct sockaddr_storage peer;
+        socklen_t peer_len;
+
+        /* Time, when connecting started, msec */
+        unsigned long connect_start;
+
+        /* The transfer: is on a kept-alive connection, has been re-tried on
+           a new one, counted as a request and got connected */
+        int reused;
+        int retried;
+        int requested;
+        int connected;
+
+        /* Error of a transfer, failed at the start */
+        CURLcode error;
+
+        /* Response parsing */
+        fast_parse_state pstate;
+        char line[FAST_LINE_MAX];
+        size_t line_len;
+        size_t received;
+        long status;
+        long long clen;
+        long long remain;
+        int chunked;
+        int close;
+
+        /* Libevent event in hyper mode */
+        struct event ev;
+        int evset;
+        short evkind;
+        int evtimeout;
+
+        /* Links of the active connections list of the engine */
+        struct fast_conn* active_prev;
+        struct fast_conn* active_next;
+
+} fast_conn;
+
+/*
+   Fast engine of a batch.
+ */
+typedef struct fast_engine
+{
+        /* Libevent event base in hyper mode, NULL in smooth mode */
+        struct event_base* eb;
+
+        /* Compiled urls, indexed by url index */
+        fast_url* urls;
+        int urls_num;
+
+        /* Connections, indexed by client index */
+        fast_conn* conns;
+        int conns_num;
+
+        /*
+           Connections connecting, sending, receiving or failed at the start,
+           served in smooth mode by fast_fdset () and fast_fdset_process ()
+         */
+        fast_conn* active;
+
+        /* Totals, reported at the release */
+        unsigned long long requests;
+        unsigned long long connects;
+        unsigned long long reuses;
+
+        char buf[FAST_RECV_BUF_SIZE];
+
+} fast_engine;
+
+static const char* fast_batch_unsupported (batch_context* bctx);
+static const char* fast_url_unsupported (url_context* url);
+static const char* fast_url_compile (batch_context* bctx, url_context* url, fast_url* fu);
+static const char* fast_req_compile (batch_context* bctx,
+                                     url_context* url,
+                                     const char* str,
+                                     fast_req* req);
+static int fast_hdr_custom (url_context* url, const char* name);
+static void fast_free (fast_engine* fe);
+static void fast_conn_cb (int fd, short kind, void *userp);
+static void fast_conn_process (fast_conn* c,
+                               int rd,
+                               int wr,
+                               int timeout,
+                               unsigned long now_time);
+static void fast_conn_connect (fast_conn* c, unsigned long now_time);
+static int fast_conn_send (fast_conn* c);
+static void fast_conn_recv (fast_conn* c, unsigned long now_time);
+static int fast_parse (fast_conn* c, const char* p, size_t n);
+static int fast_parse_line (fast_conn* c);
+static void fast_status_count (fast_conn* c);
+static void fast_conn_error (fast_conn* c, CURLcode code, unsigned long now_time);
+static void fast_conn_defer (fast_conn* c, CURLcode code);
+static void fast_transfer_done (fast_conn* c, CURLcode code, unsigned long now_time);
+static void fast_conn_close (fast_conn* c);
+static void fast_conn_state_set (fast_conn* c, fast_conn_state state);
+static void fast_conn_events (fast_conn* c);
+
+
+/****************************************************************************************
+* Function name - fast_init
+*
+* Description - Compiles the urls of the batch, configured with ENGINE FAST, and
+*               allocates connections of the clients. When <eb> is not NULL, the
+*               connections are served by libevent, otherwise by fast_fdset ().
+*               To be called before the first client is added to the load.
+*
+* Input -       *bctx - pointer to the batch context
+*               *eb   - libevent event base of the batch (hyper mode) or NULL
+* Return Code/Output - On Success - 0, on Error -1
+****************************************************************************************/
+int fast_init (batch_context* bctx, struct event_base* eb)
+{
+        fast_engine* fe;
+        const char* reason;
+        int i, compiled = 0;
+
+        if (bctx->engine != ENGINE_FAST || bctx->fast)
+        {
+                return 0;
+        }
+
+        if ((reason = fast_batch_unsupported (bctx)))
+        {
+                fprintf (stderr, "%s - \"%s\" - all urls fall back to libcurl: %s.\n",
+                         __func__, bctx->batch_name, reason);
+                return 0;
+        }
+
+        if (!(fe = cl_calloc (1, sizeof (fast_engine))) ||
+            !(fe->urls = cl_calloc (bctx->urls_num, sizeof (fast_url))) ||
+            !(fe->conns = cl_calloc (bctx->client_num_max, sizeof (fast_conn))))
+        {
+                fprintf (stderr, "%s - error: allocation of the fast engine failed.\n",
+                         __func__);
+                fast_free (fe);
+                return -1;
+        }
+
+        fe->eb = eb;
+        fe->urls_num = bctx->urls_num;
+        fe->conns_num = bctx->client_num_max;
+
+        for (i = 0; i < fe->conns_num; i++)
+        {
+                fe->conns[i].fd = -1;
+                fe->conns[i].fe = fe;
+                fe->conns[i].cctx = &bctx->cctx_array[i];
+        }
+
+        for (i = 0; i < fe->urls_num; i++)
+        {
+                url_context* url = &bctx->url_ctx_array[i];
+
+                if ((reason = fast_url_unsupported (url)) ||
+                    (reason = fast_url_compile (bctx, url, &fe->urls[i])))
+                {
+                        fprintf (stderr, "%s - \"%s\" - url %d falls back to libcurl: %s.\n",
+                                 __func__, bctx->batch_name, i, reason);
+                        continue;
+                }
+
+                compiled++;
+        }
+
+        if (!compiled)
+        {
+                fast_free (fe);
+                return 0;
+        }
+
+        fprintf (stderr, "%s - \"%s\" - %d of %d urls are served by the fast engine.\n",
+                 __func__, bctx->batch_name, compiled, bctx->urls_num);
+
+        bctx->fast = fe;
+        return 0;
+}
+
+/****************************************************************************************
+* Function name - fast_release
+*
+* Description - Closes the connections of the clients, reports the totals of the
+*               engine and frees the compiled urls.
+*
+* Input -       *bctx - pointer to the batch context
+* Return Code/Output - None
+****************************************************************************************/
+void fast_release (batch_context* bctx)
+{
+        fast_engine* fe = bctx->fast;
+
+        if (!fe)
+        {
+                return;
+        }
+
+        fprintf (stderr, "%s - \"%s\" - %llu requests, %llu connections, "
+                 "%llu requests on kept-alive connections.\n",
+                 __func__, bctx->batch_name, fe->requests, fe->connects, fe->reuses);
+
+        bctx->fast = NULL;
+        fast_free (fe);
+}
+
+/****************************************************************************************
+* Function name - fast_url_setup
+*
+* Description - Setup of a url for the client instead of setup_curl_handle_init (),
+*               when the url is compiled: picks the request of an url set.
+*
+* Input -       *cctx - pointer to the client context
+*               *url  - pointer to the url context
+* Return Code/Output - 1, when the url is served by the fast engine, 0 - by libcurl
+****************************************************************************************/
+int fast_url_setup (client_context* cctx, url_context* url)
+{
+        batch_context* bctx = cctx->bctx;
+        fast_engine* fe = bctx->fast;
+        fast_url* fu;
+        int k = 0;
+
+        cctx->fast = 0;
+
+        if (!fe || !(fu = &fe->urls[url - bctx->url_ctx_array])->reqs)
+        {
+                return 0;
+        }
+
+        /* As pick_url_from_set () does for libcurl */
+        if (fu->reqs_num > 1)
+        {
+                url_set* set = &url->set;
+
+                if (!url->url_cycling)
+                {
+                        set->index = cctx->client_index % set->n_urles;
+                }
+                else if (++set->index >= set->n_urles)
+                {
+                        set->index = 0;
+                }
+
+                k = set->index;
+        }
+
+        fe->conns[cctx->client_index].req = &fu->reqs[k];
+
+        cctx->is_https = 0;
+
+        if (url->url_ind >= 0)
+        {
+                cctx->url_curr_index = url->url_ind;
+        }
+
+        bctx->url_index = url->url_ind;
+
+        cctx->fast = 1;
+        return 1;
+}
+
+/****************************************************************************************
+* Function name - fast_transfer_start
+*
+* Description - Starts the transfer of the client on its kept-alive connection, or
+*               on a new one. Used instead of curl_multi_add_handle (). The transfer
+*               is never completed from the call.
+*
+* Input -       *bctx    - pointer to the batch context
+*               *cctx    - pointer to the client context
+*               now_time - current time in msec
+* Return Code/Output - On Success - 0, on Error -1
+****************************************************************************************/
+int fast_transfer_start (batch_context* bctx,
+                         client_context* cctx,
+                         unsigned long now_time)
+{
+        fast_engine* fe = bctx->fast;
+        fast_conn* c = &fe->conns[cctx->client_index];
+        fast_req* req = c->req;
+
+        if (!req)
+        {
+                fprintf (stderr, "%s - error: no request of client %s.\n",
+                         __func__, client_name (cctx));
+                return -1;
+        }
+
+        c->retried = 0;
+        c->requested = 0;
+        c->error = CURLE_OK;
+
+        /* As the response, timed by the clock and not by the loop time */
+        cctx->req_sent_timestamp = get_tick_count ();
+
+        /* A kept-alive connection to another server is not re-used */
+        if (c->state == FAST_CONN_IDLE &&
+            (c->peer_len != req->addr_len || memcmp (&c->peer, &req->addr, req->addr_len)))
+        {
+                fast_conn_close (c);
+        }
+
+        if (c->state != FAST_CONN_IDLE)
+        {
+                fast_conn_close (c);
+                fast_conn_connect (c, now_time);
+                return 0;
+        }
+
+        fe->reuses++;
+
+        c->reused = 1;
+        c->connected = 1;
+        c->sent = 0;
+        fast_conn_state_set (c, FAST_CONN_SENDING);
+
+        /*
+           The server may have closed the kept-alive connection. Re-try once
+           on a new one.
+         */
+        if (fast_conn_send (c) == -1)
+        {
+                c->retried = 1;
+                fast_conn_close (c);
+                fast_conn_connect (c, now_time);
+        }
+
+        return 0;
+}
+
+/****************************************************************************************
+* Function name - fast_transfer_cancel
+*
+* Description - Used instead of curl_multi_remove_handle (). Closes the connection of
+*               the client, when its transfer has not been completed, e.g. on url
+*               completion timeout, and keeps it alive otherwise.
+*
+* Input -       *cctx - pointer to the client context
+* Return Code/Output - On Success - 0, on Error -1
+****************************************************************************************/
+int fast_transfer_cancel (client_context* cctx)
+{
+        fast_conn* c = &cctx->bctx->fast->conns[cctx->client_index];
+
+        if (c->state != FAST_CONN_IDLE)
+        {
+                fast_conn_close (c);
+        }
+
+        return 0;
+}
+
+/****************************************************************************************
+* Function name - fast_fdset
+*
+* Description - Smooth mode: adds descriptors of the transfers in progress to the
+*               select () sets.
+*
+* Input -       *bctx     - pointer to the batch context
+* Input/Output - *rd, *wr - read and write descriptor sets
+*                *maxfd   - the maximum descriptor, updated
+* Return Code/Output - None
+****************************************************************************************/
+void fast_fdset (batch_context* bctx, fd_set* rd, fd_set* wr, int* maxfd)
+{
+        fast_engine* fe = bctx->fast;
+        fast_conn* c;
+
+        if (!fe || fe->eb)
+                return;
+
+        for (c = fe->active; c; c = c->active_next)
+        {
+                switch (c->state)
+                {
+                case FAST_CONN_CONNECTING:
+                case FAST_CONN_SENDING:
+                        FD_SET (c->fd, wr);
+                        break;
+
+                case FAST_CONN_RECEIVING:
+                        FD_SET (c->fd, rd);
+                        break;
+
+                default:
+                        continue;
+                }
+
+                if (c->fd > *maxfd)
+                        *maxfd = c->fd;
+        }
+}
+
+/****************************************************************************************
+* Function name - fast_fdset_process
+*
+* Description - Smooth mode: serves the descriptors, reported by select (), fails
+*               connections, not established within the connect timeout, and
+*               transfers, failed at the start.
+*
+* Input -       *bctx    - pointer to the batch context
+*               *rd, *wr - read and write descriptor sets, NULL on select () error
+*               now_time - current time in msec
+* Return Code/Output - None
+****************************************************************************************/
+void fast_fdset_process (batch_context* bctx,
+                         fd_set* rd,
+                         fd_set* wr,
+                         unsigned long now_time)
+{
+        fast_engine* fe = bctx->fast;
+        fast_conn* c;
+        fast_conn* next;
+
+        if (!fe || fe->eb)
+                return;
+
+        /*
+           Processing may take the connection off the list, or put it back at the
+           head for the next transfer of the client, not served in this pass.
+         */
+        for (c = fe->active; c; c = next)
+        {
+                next = c->active_next;
+
+                fast_conn_process (c,
+                                   c->fd != -1 && rd && FD_ISSET (c->fd, rd),
+                                   c->fd != -1 && wr && FD_ISSET (c->fd, wr),
+                                   0,
+                                   now_time);
+        }
+}
+
+/*================= STATIC FUNCTIONS =================== */
+
+/*
+   Features of the batch, reading the transfer info of libcurl handles.
+ */
+static const char* fast_batch_unsupported (batch_context* bctx)
+{
+        if (redis_samples)
+                return "REDIS samples";
+        if (bctx->topk)
+                return "top-K slowest requests";
+        if (tcp_info_sample_rate)
+                return "TCP_INFO sampling";
+        if (bctx->dns_mode == DNS_MODE_PHASE)
+                return "DNS_MODE PHASE";
+        if (tls_handshake_mode)
+                return "TLS handshake-rate mode";
+        if (bctx->log_resp_segments)
+                return "LOG_RESP_SEGMENTS";
+
+        return NULL;
+}
+
+/*
+   Returns, why the url cannot be served by the engine, or NULL.
+ */
+static const char* fast_url_unsupported (url_context* url)
+{
+        if (url->url_appl_type != URL_APPL_HTTP)
+                return "not plain HTTP";
+        if (url->url_use_current)
+                return "URL_USE_CURRENT";
+
+        if (url->req_type == HTTP_REQ_TYPE_GET)
+        {
+                if (url->form_str)
+                        return "GET with form fields";
+        }
+        else if (url->req_type == HTTP_REQ_TYPE_POST)
+        {
+                if (!url->form_str || url->form_usage_type != FORM_USAGETYPE_AS_IS ||
+                    url->mpart_form_post)
+                        return "POST of client-specific or multipart data";
+        }
+        else
+                return "request type other than GET or POST";
+
+        if (url->upload_file)
+                return "upload";
+        if (url->web_auth_method || url->proxy_auth_method || config_proxy[0])
+                return "authentication or proxy";
+        if (url->log_resp_bodies || url->log_resp_headers)
+                return "logging of responses";
+        if (url->fresh_connect)
+                return "FRESH_CONNECT";
+        if (url->transfer_limit_rate)
+                return "TRANSFER_LIMIT_RATE";
+        if (url->response.n_tokens || (is_template (url) && !url->set.n_urles))
+                return "template, completed from responses";
+        if (url->random_hrange > 0)
+                return "URL_RANDOM_RANGE";
+
+        return NULL;
+}
+
+/*
+   Compiles the url or the urls of its set. Returns, why the url cannot be
+   compiled, or NULL.
+ */
+static const char* fast_url_compile (batch_context* bctx, url_context* url, fast_url* fu)
+{
+        const int num = url->set.n_urles ? url->set.n_urles : 1;
+        const char* reason = NULL;
+        int k;
+
+        if (!(fu->reqs = cl_calloc (num, sizeof (fast_req))))
+        {
+                return "allocation failed";
+        }
+
+        fu->reqs_num = num;
+
+        for (k = 0; k < num && !reason; k++)
+        {
+                if (!url->set.n_urles)
+                        reason = fast_req_compile (bctx, url, url->url_str, &fu->reqs[k]);
+                else if (url->set.urles[k].cookie)
+                        reason = "cookies of the url set";
+                else
+                        reason = fast_req_compile (bctx, url, url->set.urles[k].string,
+                                                   &fu->reqs[k]);
+        }
+
+        if (reason)
+        {
+                for (k = 0; k < num; k++)
+                {
+                        free (fu->reqs[k].iov[0].iov_base);
+                }
+
+                free (fu->reqs);
+                fu->reqs = NULL;
+                fu->reqs_num = 0;
+        }
+
+        return reason;
+}
+
+/*
+   Compiles a request to http://host[:port][/path] into the request head and
+   the POST body, and resolves the host. Returns, why the request cannot be
+   compiled, or NULL.
+ */
+static const char* fast_req_compile (batch_context* bctx,
+                                     url_context* url,
+                                     const char* str,
+                                     fast_req* req)
+{
+        const char* const post = (url->req_type == HTTP_REQ_TYPE_POST) ? url->form_str : NULL;
+        const char *auth, *path;
+        size_t auth_len, path_len, host_len, size;
+        char host[256], port[8] = "80";
+        struct addrinfo hints, *ai = NULL;
+        struct curl_slist* hdr;
+        char* head;
+        int off, rc;
+
+        if (!str || strncasecmp (str, "http://", 7))
+                return "not an http:// url";
+
+        auth = str + 7;
+        auth_len = strcspn (auth, "/? \t\r\n");
+        path = auth + auth_len;
+        path_len = strcspn (path, " \t\r\n");
+
+        if (!auth_len || memchr (auth, '@', auth_len))
+                return "no host or credentials in the url";
+
+        /* Host, IPv6 literal in brackets, and the port */
+        if (auth[0] == '[')
+        {
+                const char* end = memchr (auth, ']', auth_len);
+
+                if (!end)
+                        return "wrong IPv6 address";
+
+                host_len = end - auth - 1;
+                memcpy (host, auth + 1, host_len < sizeof (host) ? host_len : 0);
+                end++;
+
+                if (end < auth + auth_len && *end == ':')
+                        snprintf (port, sizeof (port), "%.*s", (int) (auth + auth_len - end - 1), end + 1);
+        }
+        else
+        {
+                const char* colon = memchr (auth, ':', auth_len);
+
+                host_len = colon ? (size_t) (colon - auth) : auth_len;
+                memcpy (host, auth, host_len < sizeof (host) ? host_len : 0);
+
+                if (colon)
+                        snprintf (port, sizeof (port), "%.*s", (int) (auth + auth_len - colon - 1), colon + 1);
+        }
+
+        if (!host_len || host_len >= sizeof (host))
+                return "wrong host";
+
+        host[host_len] = '\0';
+
+        /*
+           Resolved once for the run. DNS_MODE PIN does the same for libcurl.
+         */
+        memset (&hints, 0, sizeof (hints));
+        hints.ai_family = bctx->ipv6 ? AF_INET6 : AF_INET;
+        hints.ai_socktype = SOCK_STREAM;
+
+        if ((rc = getaddrinfo (host, port, &hints, &ai)) || !ai)
+        {
+                fprintf (stderr, "%s - error: failed to resolve %s:%s - %s.\n",
+                         __func__, host, port, gai_strerror (rc));
+                return "failed to resolve the host";
+        }
+
+        memcpy (&req->addr, ai->ai_addr, ai->ai_addrlen);
+        req->addr_len = ai->ai_addrlen;
+        freeaddrinfo (ai);
+
+        /* The head: request line, headers of libcurl and the custom headers */
+        size = path_len + auth_len + strlen (bctx->user_agent) + 256;
+
+        for (hdr = url->custom_http_hdrs; hdr; hdr = hdr->next)
+        {
+                size += strlen (hdr->data) + 2;
+        }
+
+        if (!(head = malloc (size)))
+                return "allocation failed";
+
+        off = snprintf (head, size, "%s %s%.*s HTTP/1.1\r\n",
+                        post ? "POST" : "GET", path[0] == '/' ? "" : "/",
+                        (int) path_len, path);
+
+        if (!fast_hdr_custom (url, "Host"))
+                off += snprintf (head + off, size - off, "Host: %.*s\r\n", (int) auth_len, auth);
+        if (!fast_hdr_custom (url, "User-Agent"))
+                off += snprintf (head + off, size - off, "User-Agent: %s\r\n", bctx->user_agent);
+        if (!fast_hdr_custom (url, "Accept"))
+                off += snprintf (head + off, size - off, "Accept: */*\r\n");
+
+        if (post)
+        {
+                if (!fast_hdr_custom (url, "Content-Type"))
+                        off += snprintf (head + off, size - off,
+                                         "Content-Type: application/x-www-form-urlencoded\r\n");
+
+                off += snprintf (head + off, size - off, "Content-Length: %lu\r\n",
+                                 (unsigned long) strlen (post));
+        }
+
+        /* As libcurl, "Name:" custom headers just remove the default ones */
+        for (hdr = url->custom_http_hdrs; hdr; hdr = hdr->next)
+        {
+                const char* colon = strchr (hdr->data, ':');
+
+                if (colon && colon[1 + strspn (colon + 1, " \t")] == '\0')
+                        continue;
+
+                off += snprintf (head + off, size - off, "%s\r\n", hdr->data);
+        }
+
+        off += snprintf (head + off, size - off, "\r\n");
+
+        req->iov[0].iov_base = head;
+        req->iov[0].iov_len = off;
+        req->iovcnt = 1;
+
+        if (post && post[0])
+        {
+                req->iov[1].iov_base = (char *) post;
+                req->iov[1].iov_len = strlen (post);
+                req->iovcnt = 2;
+        }
+
+        req->len = req->iov[0].iov_len + (req->iovcnt > 1 ? req->iov[1].iov_len : 0);
+
+        return NULL;
+}
+
+/*
+   Whether a custom header of the url replaces the default header <name>.
+ */
+static int fast_hdr_custom (url_context* url, const char* name)
+{
+        const size_t len = strlen (name);
+        struct curl_slist* hdr;
+
+        for (hdr = url->custom_http_hdrs; hdr; hdr = hdr->next)
+        {
+                if (!strncasecmp (hdr->data, name, len) && hdr->data[len] == ':')
+                        return 1;
+        }
+
+        return 0;
+}
+
+static void fast_free (fast_engine* fe)
+{
+        int i, k;
+
+        if (!fe)
+        {
+                return;
+        }
+
+        if (fe->conns)
+        {
+                for (i = 0; i < fe->conns_num; i++)
+                {
+                        fast_conn_close (&fe->conns[i]);
+                }
+
+                free (fe->conns);
+        }
+
+        if (fe->urls)
+        {
+                for (i = 0; i < fe->urls_num; i++)
+                {
+                        for (k = 0; k < fe->urls[i].reqs_num; k++)
+                        {
+                                free (fe->urls[i].reqs[k].iov[0].iov_base);
+                        }
+
+                        free (fe->urls[i].reqs);
+                }
+
+                free (fe->urls);
+        }
+
+        free (fe);
+}
+
+/****************************************************************************************
+* Function name - fast_conn_cb
+*
+* Description - A libevent callback for a connection of a client
+*
+* Input -       fd     - descriptor (socket)
+*               kind   - a bitmask of events from libevent
+*               *userp - pointer to the connection
+* Return Code/Output - None
+****************************************************************************************/
+static void fast_conn_cb (int fd, short kind, void *userp)
+{
+        (void) fd;
+
+        fast_conn_process ((fast_conn *) userp,
+                           kind & EV_READ,
+                           kind & EV_WRITE,
+                           kind & EV_TIMEOUT,
+                           get_tick_count ());
+}
+
+/****************************************************************************************
+* Function name - fast_conn_process
+*
+* Description - Advances the transfer of a connection on its socket events
+*
+* Input -       *c       - pointer to the connection
+*               rd, wr   - the socket is readable, writable
+*               timeout  - the connect timer has expired (hyper mode)
+*               now_time - current time in msec
+* Return Code/Output - None
+****************************************************************************************/
+static void fast_conn_process (fast_conn* c,
+                               int rd,
+                               int wr,
+                               int timeout,
+                               unsigned long now_time)
+{
+        switch (c->state)
+        {
+        case FAST_CONN_FAILED:
+                fast_transfer_done (c, c->error, now_time);
+                break;
+
+        case FAST_CONN_CONNECTING:
+                if (wr)
+                {
+                        int err = 0;
+                        socklen_t len = sizeof (err);
+
+                        if (getsockopt (c->fd, SOL_SOCKET, SO_ERROR, &err, &len) == -1 || err)
+                        {
+                                fast_conn_error (c, CURLE_COULDNT_CONNECT, now_time);
+                                break;
+                        }
+
+                        c->fe->connects++;
+                        c->connected = 1;
+                        fast_conn_state_set (c, FAST_CONN_SENDING);
+
+                        if (fast_conn_send (c) == -1)
+                                fast_conn_error (c, CURLE_SEND_ERROR, now_time);
+                }
+                else
+                {
+                        const url_context* url =
+                                &c->cctx->bctx->url_ctx_array[c->cctx->url_curr_index];
+                        const long secs = url->connect_timeout ? url->connect_timeout : connect_timeout;
+
+                        if (timeout || now_time - c->connect_start >= (unsigned long) secs * 1000)
+                                fast_conn_error (c, CURLE_OPERATION_TIMEDOUT, now_time);
+                }
+                break;
+
+        case FAST_CONN_SENDING:
+                if (wr && fast_conn_send (c) == -1)
+                        fast_conn_error (c, CURLE_SEND_ERROR, now_time);
+                break;
+
+        case FAST_CONN_RECEIVING:
+                if (rd)
+                        fast_conn_recv (c, now_time);
+                break;
+
+        default:
+                break;
+        }
+}
+
+/****************************************************************************************
+* Function name - fast_conn_connect
+*
+* Description - Opens a non-blocking socket, bound as the sockets of libcurl to the
+*               client address and ports, and starts connecting to the server.
+*               Failures are completed later from the loop.
+*
+* Input -       *c       - pointer to the closed connection
+*               now_time - current time in msec
+* Return Code/Output - None
+****************************************************************************************/
+static void fast_conn_connect (fast_conn* c, unsigned long now_time)
+{
+        client_context* cctx = c->cctx;
+        fast_req* req = c->req;
+        struct curl_sockaddr csa;
+        curl_socket_t fd;
+
+        c->reused = 0;
+        c->connected = 0;
+        c->sent = 0;
+        c->connect_start = now_time;
+
+        memset (&csa, 0, sizeof (csa));
+        csa.family = req->addr.ss_family;
+        csa.socktype = SOCK_STREAM;
+        csa.protocol = IPPROTO_TCP;
+        csa.addrlen = req->addr_len;
+
+        if ((fd = opensocket_function (cctx, CURLSOCKTYPE_IPCXN, &csa)) == CURL_SOCKET_BAD)
+        {
+                fast_conn_defer (c, CURLE_COULDNT_CONNECT);
+                return;
+        }
+
+        sockopt_function (cctx->bctx, fd, CURLSOCKTYPE_IPCXN);
+        fcntl (fd, F_SETFL, fcntl (fd, F_GETFL) | O_NONBLOCK);
+
+        c->fd = fd;
+        memcpy (&c->peer, &req->addr, req->addr_len);
+        c->peer_len = req->addr_len;
+
+        if (connect (fd, (struct sockaddr *) &req->addr, req->addr_len) == -1 &&
+            errno != EINPROGRESS)
+        {
+                fast_conn_close (c);
+                fast_conn_defer (c, CURLE_COULDNT_CONNECT);
+                return;
+        }
+
+        /* Connected or not, the socket gets writable */
+        fast_conn_state_set (c, FAST_CONN_CONNECTING);
+        fast_conn_events (c);
+}
+
+/****************************************************************************************
+* Function name - fast_conn_send
+*
+* Description - Sends as much of the request as the socket accepts by writev (), and
+*               switches to receiving of the response, when all is sent.
+*
+* Input -       *c - pointer to the connection
+* Return Code/Output - On Success - 0, on Error -1
+****************************************************************************************/
+static int fast_conn_send (fast_conn* c)
+{
+        const fast_req* req = c->req;
+
+        while (c->sent < req->len)
+        {
+                struct iovec iov[2];
+                size_t skip = c->sent;
+                int i, cnt = 0;
+                ssize_t rc;
+
+                for (i = 0; i < req->iovcnt; i++)
+                {
+                        if (skip >= req->iov[i].iov_len)
+                        {
+                                skip -= req->iov[i].iov_len;
+                                continue;
+                        }
+
+                        iov[cnt].iov_base = (char *) req->iov[i].iov_base + skip;
+                        iov[cnt].iov_len = req->iov[i].iov_len - skip;
+                        skip = 0;
+                        cnt++;
+                }
+
+                if ((rc = writev (c->fd, iov, cnt)) == -1)
+                {
+                        if (errno != EAGAIN && errno != EINTR)
+                                return -1;
+
+                        fast_conn_state_set (c, FAST_CONN_SENDING);
+                        fast_conn_events (c);
+                        return 0;
+                }
+
+                if (!c->requested)
+                {
+                        c->requested = 1;
+                        stat_req_inc (c->cctx);
+                }
+
+                stat_data_out_add (c->cctx, (unsigned long) rc);
+                c->sent += rc;
+        }
+
+        c->pstate = FAST_PARSE_STATUS;
+        c->line_len = 0;
+        c->received = 0;
+        c->status = 0;
+        c->close = 0;
+
+        fast_conn_state_set (c, FAST_CONN_RECEIVING);
+        fast_conn_events (c);
+        return 0;
+}
+
+/****************************************************************************************
+* Function name - fast_conn_recv
+*
+* Description - Reads the response and parses it. Completes the transfer, when the
+*               response is complete, or fails it.
+*
+* Input -       *c       - pointer to the connection
+*               now_time - current time in msec
+* Return Code/Output - None
+****************************************************************************************/
+static void fast_conn_recv (fast_conn* c, unsigned long now_time)
+{
+        fast_engine* fe = c->fe;
+
+        for (;;)
+        {
+                const ssize_t rc = recv (c->fd, fe->buf, sizeof (fe->buf), 0);
+                int parsed;
+
+                if (rc == 0)
+                {
+                        if (c->pstate == FAST_PARSE_UNTIL_CLOSE)
+                                fast_transfer_done (c, CURLE_OK, now_time);
+                        else
+                                fast_conn_error (c, c->received ? CURLE_PARTIAL_FILE :
+                                                 CURLE_GOT_NOTHING, now_time);
+                        return;
+                }
+                else if (rc == -1)
+                {
+                        if (errno != EAGAIN && errno != EINTR)
+                                fast_conn_error (c, CURLE_RECV_ERROR, now_time);
+                        return;
+                }
+
+                stat_data_in_add (c->cctx, (unsigned long) rc);
+                c->received += rc;
+
+                if ((parsed = fast_parse (c, fe->buf, rc)) == 1)
+                {
+                        fast_transfer_done (c, CURLE_OK, now_time);
+                        return;
+                }
+                else if (parsed == -1)
+                {
+                        fast_conn_error (c, CURLE_RECV_ERROR, now_time);
+                        return;
+                }
+
+                /* Most probably drained */
+                if ((size_t) rc < sizeof (fe->buf))
+                        return;
+        }
+}
+
+/****************************************************************************************
+* Function name - fast_parse
+*
+* Description - Parses the received bytes of a response: collects the lines of the
+*               head and of the chunk sizes, and skips the body bytes.
+*
+* Input -       *c       - pointer to the connection
+*               *p       - the bytes
+*               n        - number of the bytes
+* Return Code/Output - 1 - the response is complete, 0 - to be continued, -1 - error
+****************************************************************************************/
+static int fast_parse (fast_conn* c, const char* p, size_t n)
+{
+        while (n > 0)
+        {
+                const char* nl;
+                size_t take;
+                int rc;
+
+                switch (c->pstate)
+                {
+                case FAST_PARSE_BODY:
+                case FAST_PARSE_CHUNK_DATA:
+                        take = (long long) n < c->remain ? n : (size_t) c->remain;
+                        p += take;
+                        n -= take;
+
+                        if ((c->remain -= take))
+                                return 0;
+
+                        if (c->pstate == FAST_PARSE_BODY)
+                                return 1;
+
+                        c->pstate = FAST_PARSE_CHUNK_END;
+                        break;
+
+                case FAST_PARSE_UNTIL_CLOSE:
+                        return 0;
+
+                default:
+                        nl = memchr (p, '\n', n);
+                        take = nl ? (size_t) (nl - p) : n;
+
+                        /* Only the beginning of a long line is kept */
+                        if (c->line_len < sizeof (c->line) - 1)
+                        {
+                                const size_t room = sizeof (c->line) - 1 - c->line_len;
+
+                                memcpy (c->line + c->line_len, p, take < room ? take : room);
+                                c->line_len += take < room ? take : room;
+                        }
+
+                        if (!nl)
+                                return 0;
+
+                        p = nl + 1;
+                        n -= take + 1;
+
+                        if (c->line_len && c->line[c->line_len - 1] == '\r')
+                                c->line_len--;
+
+                        c->line[c->line_len] = '\0';
+
+                        rc = fast_parse_line (c);
+                        c->line_len = 0;
+
+                        if (rc)
+                                return rc;
+                        break;
+                }
+        }
+
+        return 0;
+}
+
+/****************************************************************************************
+* Function name - fast_parse_line
+*
+* Description - Handles a line of a response: the status line, a header, a chunk size
+*               or a trailer.
+*
+* Input -       *c       - pointer to the connection, keeping the line
+* Return Code/Output - 1 - the response is complete, 0 - to be continued, -1 - error
+****************************************************************************************/
+static int fast_parse_line (fast_conn* c)
+{
+        char* line = c->line;
+        char* end;
+
+        switch (c->pstate)
+        {
+        case FAST_PARSE_STATUS:
+                if (!c->line_len)
+                        return 0;
+
+                if (c->line_len < 12 || strncmp (line, "HTTP/1.", 7))
+                        return -1;
+
+                c->status = strtol (line + 9, &end, 10);
+
+                if (end == line + 9 || c->status < 100 || c->status > 999)
+                        return -1;
+
+                /* HTTP/1.0 closes, unless tells keep-alive */
+                c->close = (line[7] == '0');
+                c->clen = -1;
+                c->chunked = 0;
+                c->pstate = FAST_PARSE_HEADERS;
+                return 0;
+
+        case FAST_PARSE_HEADERS:
+                if (c->line_len)
+                {
+                        if (!strncasecmp (line, "Content-Length:", 15))
+                                c->clen = strtoll (line + 15, NULL, 10);
+                        else if (!strncasecmp (line, "Transfer-Encoding:", 18))
+                                c->chunked = (strcasestr (line + 18, "chunked") != NULL);
+                        else if (!strncasecmp (line, "Connection:", 11))
+                        {
+                                if (strcasestr (line + 11, "close"))
+                                        c->close = 1;
+                                else if (strcasestr (line + 11, "keep-alive"))
+                                        c->close = 0;
+                        }
+                        return 0;
+                }
+
+                fast_status_count (c);
+
+                /* 100-Continue and 101 responses are followed by the final one */
+                if (c->status < 200)
+                {
+                        c->pstate = FAST_PARSE_STATUS;
+                        return 0;
+                }
+
+                if (c->status == 204 || c->status == 304)
+                        return 1;
+
+                if (c->chunked)
+                {
+                        c->pstate = FAST_PARSE_CHUNK_SIZE;
+                }
+                else if (c->clen >= 0)
+                {
+                        if (!c->clen)
+                                return 1;
+
+                        c->remain = c->clen;
+                        c->pstate = FAST_PARSE_BODY;
+                }
+                else
+                {
+                        c->close = 1;
+                        c->pstate = FAST_PARSE_UNTIL_CLOSE;
+                }
+                return 0;
+
+        case FAST_PARSE_CHUNK_SIZE:
+                c->remain = strtoll (line, &end, 16);
+
+                if (end == line || c->remain < 0)
+                        return -1;
+
+                c->pstate = c->remain ? FAST_PARSE_CHUNK_DATA : FAST_PARSE_TRAILERS;
+                return 0;
+
+        case FAST_PARSE_CHUNK_END:
+                if (c->line_len)
+                        return -1;
+
+                c->pstate = FAST_PARSE_CHUNK_SIZE;
+                return 0;
+
+        case FAST_PARSE_TRAILERS:
+                return c->line_len ? 0 : 1;
+
+        default:
+                return -1;
+        }
+}
+
+/****************************************************************************************
+* Function name - fast_status_count
+*
+* Description - Counts the response status and the server delay, and marks the client
+*               failed by the error statuses of the url, as the tracing function of
+*               libcurl transfers does. The delay is taken by the clock, since the
+*               time of the smooth-mode loop is refreshed only once in a while.
+*
+* Input -       *c       - pointer to the connection
+* Return Code/Output - None
+****************************************************************************************/
+static void fast_status_count (fast_conn* c)
+{
+        client_context* cctx = c->cctx;
+        url_context* url = &cctx->bctx->url_ctx_array[cctx->url_curr_index];
+        const long status = c->status;
+        const unsigned long resp_time = get_tick_count ();
+
+        switch (status / 100)
+        {
+        case 1:
+                stat_1xx_inc (cctx);
+                stat_appl_delay_add (cctx, resp_time);
+                break;
+
+        case 2:
+                stat_2xx_inc (cctx);
+                stat_appl_delay_2xx_add (cctx, resp_time);
+                stat_appl_delay_add (cctx, resp_time);
+                break;
+
+        case 3:
+                stat_3xx_inc (cctx);
+                stat_appl_delay_add (cctx, resp_time);
+                break;
+
+        case 4:
+                stat_4xx_inc (cctx);
+                stat_appl_delay_add (cctx, resp_time);
+                break;
+
+        case 5:
+                stat_5xx_inc (cctx);
+                stat_appl_delay_add (cctx, resp_time);
+                break;
+
+        default:
+                break;
+        }
+
+        if (url->resp_status_errors_tbl)
+        {
+                if (status >= URL_RESPONSE_STATUS_ERRORS_TABLE_SIZE ||
+                    url->resp_status_errors_tbl[status])
+                {
+                        cctx->client_state = CSTATE_ERROR;
+                }
+        }
+        else if (status >= 400 && status != 401 && status != 407)
+        {
+                cctx->client_state = CSTATE_ERROR;
+        }
+}
+
+/****************************************************************************************
+* Function name - fast_conn_error
+*
+* Description - Fails the transfer of a connection. A request on a kept-alive
+*               connection without any response is re-tried once on a new one,
+*               since the server may have closed it in between.
+*
+* Input -       *c       - pointer to the connection
+*               code     - CURLcode of the failure
+*               now_time - current time in msec
+* Return Code/Output - None
+****************************************************************************************/
+static void fast_conn_error (fast_conn* c, CURLcode code, unsigned long now_time)
+{
+        if (c->reused && !c->retried && !c->received)
+        {
+                c->retried = 1;
+                fast_conn_close (c);
+                fast_conn_connect (c, now_time);
+                return;
+        }
+
+        fast_transfer_done (c, code, now_time);
+}
+
+/*
+   Keeps the failure of a transfer at the start, to be completed from the loop.
+ */
+static void fast_conn_defer (fast_conn* c, CURLcode code)
+{
+        c->error = code;
+        fast_conn_state_set (c, FAST_CONN_FAILED);
+        fast_conn_events (c);
+}
+
+/****************************************************************************************
+* Function name - fast_transfer_done
+*
+* Description - Completes the transfer of a client and proceeds with the client like on
+*               CURLMSG_DONE of a libcurl transfer. The connection is kept alive, unless
+*               failed or closed by the server.
+*
+* Input -       *c       - pointer to the connection
+*               code     - CURLcode of the transfer, CURLE_OK on success
+*               now_time - current time in msec
+* Return Code/Output - None
+****************************************************************************************/
+static void fast_transfer_done (fast_conn* c, CURLcode code, unsigned long now_time)
+{
+        client_context* cctx = c->cctx;
+        batch_context* bctx = cctx->bctx;
+        int sched_now = 0;
+
+        if (code != CURLE_OK || c->close)
+        {
+                fast_conn_close (c);
+        }
+        else
+        {
+                fast_conn_state_set (c, FAST_CONN_IDLE);
+                fast_conn_events (c);
+        }
+
+        if (code != CURLE_OK)
+        {
+                cctx->client_state = CSTATE_ERROR;
+
+                stat_err_inc (cctx);
+                op_stat_error (&bctx->op_delta, cctx->url_curr_index, code, c->connected);
+        }
+
+        first_hdrs_clear_all (cctx);
+
+        /* Commit statistics of the accomplished request */
+        stat_request_commit (cctx);
+        c->fe->requests++;
+
+        /*
+           Load next step only if request rate is not specified.
+           Otherwise requests are made on a timer.
+         */
+        if (bctx->req_rate)
+        {
+                if (put_free_client (cctx) < 0)
+                {
+                        fprintf (stderr, "%s error: cannot free a client.\n", __func__);
+                }
+                return;
+        }
+
+        load_next_step (cctx, now_time, &sched_now);
+}
+
+/****************************************************************************************
+* Function name - fast_conn_close
+*
+* Description - Closes the socket of a connection
+*
+* Input -       *c - pointer to the connection
+* Return Code/Output - None
+****************************************************************************************/
+static void fast_conn_close (fast_conn* c)
+{
+        if (c->evset)
+        {
+                event_del (&c->ev);
+                c->evset = 0;
+        }
+
+        if (c->fd != -1)
+        {
+                close (c->fd);
+                c->fd = -1;
+        }
+
+        fast_conn_state_set (c, FAST_CONN_CLOSED);
+}
+
+/*
+   Sets the state of a connection, keeping the connection in the active list
+   of the engine in the states after FAST_CONN_IDLE.
+ */
+static void fast_conn_state_set (fast_conn* c, fast_conn_state state)
+{
+        fast_engine* fe = c->fe;
+        const int was_active = (c->state > FAST_CONN_IDLE);
+        const int active = (state > FAST_CONN_IDLE);
+
+        c->state = state;
+
+        if (active == was_active)
+        {
+                return;
+        }
+
+        if (active)
+        {
+                c->active_prev = NULL;
+                c->active_next = fe->active;
+
+                if (fe->active)
+                        fe->active->active_prev = c;
+
+                fe->active = c;
+        }
+        else
+        {
+                if (c->active_prev)
+                        c->active_prev->active_next = c->active_next;
+                else
+                        fe->active = c->active_next;
+
+                if (c->active_next)
+                        c->active_next->active_prev = c->active_prev;
+
+                c->active_prev = c->active_next = NULL;
+        }
+}
+
+/****************************************************************************************
+* Function name - fast_conn_events
+*
+* Description - Hyper mode: (re)registers libevent event of a connection according to
+*               its state. Transfers failed at the start are completed by a zero
+*               timer. In smooth mode the state is polled by fast_fdset ().
+*
+* Input -       *c - pointer to the connection
+* Return Code/Output - None
+****************************************************************************************/
+static void fast_conn_events (fast_conn* c)
+{
+        struct event_base* eb = c->fe->eb;
+        struct timeval tv, *tvp = NULL;
+        short kind = 0;
+
+        if (!eb)
+                return;
+
+        switch (c->state)
+        {
+        case FAST_CONN_CONNECTING:
+        {
+                const url_context* url = &c->cctx->bctx->url_ctx_array[c->cctx->url_curr_index];
+
+                kind = EV_WRITE;
+                tv.tv_sec = url->connect_timeout ? url->connect_timeout : connect_timeout;
+                tv.tv_usec = 0;
+                tvp = &tv;
+        }
+        break;
+
+        case FAST_CONN_SENDING:
+                kind = EV_WRITE;
+                break;
+
+        case FAST_CONN_RECEIVING:
+                kind = EV_READ;
+                break;
+
+        case FAST_CONN_FAILED:
+                timerclear (&tv);
+                tvp = &tv;
+                break;
+
+        default:
+                break;
+        }
+
+        if (c->evset)
+        {
+                /* The persistent event is kept, while waiting for the same */
+                if (kind && kind == c->evkind && !tvp && !c->evtimeout)
+                        return;
+
+                event_del (&c->ev);
+                c->evset = 0;
+        }
+
+        if (!kind && !tvp)
+                return;
+
+        event_set (&c->ev, kind ? c->fd : -1, kind ? (kind | EV_PERSIST) : 0,
+                   fast_conn_cb, c);
+        event_base_set (eb, &c->ev);
+        event_add (&c->ev, tvp);
+
+        c->evset = 1;
+        c->evkind = kind;
+        c->evtimeout = (tvp != NULL);
+}
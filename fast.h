@@ -0,0 +1,153 @@
+/*
+*     fast.h
+*
+* 2006-2007 Copyright (c)
+* Robert Iakobashvili, <coroberti@gmail.com>
+* Michael Moser,  <moser.michael@gmail.com>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef FAST_H
+#define FAST_H
+
+#include <sys/select.h>
+
+/*
+   Fast HTTP/1.1 engine (ENGINE FAST tag of the general section).
+
+   Plain HTTP GET and POST urls without per-client content are compiled at
+   the batch start into the request bytes and a resolved server address.
+   Their transfers are sent by writev () over non-blocking keep-alive
+   sockets of the clients, served from the loop of the batch: libevent in
+   hyper mode and select () in smooth mode. Only the status line and the
+   Content-Length or chunked framing of the responses are parsed, and the
+   bodies are skipped. The transfers feed the same statistics counters and
+   proceed with the clients by load_next_step (), as libcurl transfers.
+
+   Urls, that the engine cannot serve (HTTPS, FTP, authentication, proxy,
+   templates filled from responses, uploads, logging of responses, etc.)
+   fall back to libcurl, as do all the urls of a batch with features, that
+   read the libcurl transfer info (REDIS, top-K, TCP_INFO, DNS_MODE PHASE,
+   TLS handshake-rate mode and response segments). Redirects of 3xx
+   responses are counted, but not followed, and no cookies are kept.
+ */
+
+/* Values of ENGINE tag */
+#define ENGINE_CURL 0
+#define ENGINE_FAST 1
+
+struct batch_context;
+struct client_context;
+struct url_context;
+struct event_base;
+
+/****************************************************************************************
+* Function name - fast_init
+*
+* Description - Compiles the urls of the batch, configured with ENGINE FAST, and
+*               allocates connections of the clients. When <eb> is not NULL, the
+*               connections are served by libevent, otherwise by fast_fdset ().
+*               To be called before the first client is added to the load.
+*
+* Input -       *bctx - pointer to the batch context
+*               *eb   - libevent event base of the batch (hyper mode) or NULL
+* Return Code/Output - On Success - 0, on Error -1
+****************************************************************************************/
+int fast_init (struct batch_context* bctx, struct event_base* eb);
+
+/****************************************************************************************
+* Function name - fast_release
+*
+* Description - Closes the connections of the clients, reports the totals of the
+*               engine and frees the compiled urls.
+*
+* Input -       *bctx - pointer to the batch context
+* Return Code/Output - None
+****************************************************************************************/
+void fast_release (struct batch_context* bctx);
+
+/****************************************************************************************
+* Function name - fast_url_setup
+*
+* Description - Setup of a url for the client instead of setup_curl_handle_init (),
+*               when the url is compiled: picks the request of an url set.
+*
+* Input -       *cctx - pointer to the client context
+*               *url  - pointer to the url context
+* Return Code/Output - 1, when the url is served by the fast engine, 0 - by libcurl
+****************************************************************************************/
+int fast_url_setup (struct client_context* cctx, struct url_context* url);
+
+/****************************************************************************************
+* Function name - fast_transfer_start
+*
+* Description - Starts the transfer of the client on its kept-alive connection, or
+*               on a new one. Used instead of curl_multi_add_handle (). The transfer
+*               is never completed from the call.
+*
+* Input -       *bctx    - pointer to the batch context
+*               *cctx    - pointer to the client context
+*               now_time - current time in msec
+* Return Code/Output - On Success - 0, on Error -1
+****************************************************************************************/
+int fast_transfer_start (struct batch_context* bctx,
+                         struct client_context* cctx,
+                         unsigned long now_time);
+
+/****************************************************************************************
+* Function name - fast_transfer_cancel
+*
+* Description - Used instead of curl_multi_remove_handle (). Closes the connection of
+*               the client, when its transfer has not been completed, e.g. on url
+*               completion timeout, and keeps it alive otherwise.
+*
+* Input -       *cctx - pointer to the client context
+* Return Code/Output - On Success - 0, on Error -1
+****************************************************************************************/
+int fast_transfer_cancel (struct client_context* cctx);
+
+/****************************************************************************************
+* Function name - fast_fdset
+*
+* Description - Smooth mode: adds descriptors of the transfers in progress to the
+*               select () sets.
+*
+* Input -       *bctx     - pointer to the batch context
+* Input/Output - *rd, *wr - read and write descriptor sets
+*                *maxfd   - the maximum descriptor, updated
+* Return Code/Output - None
+****************************************************************************************/
+void fast_fdset (struct batch_context* bctx, fd_set* rd, fd_set* wr, int* maxfd);
+
+/****************************************************************************************
+* Function name - fast_fdset_process
+*
+* Description - Smooth mode: serves the descriptors, reported by select (), fails
+*               connections, not established within the connect timeout, and
+*               transfers, failed at the start.
+*
+* Input -       *bctx    - pointer to the batch context
+*               *rd, *wr - read and write descriptor sets, NULL on select () error
+*               now_time - current time in msec
+* Return Code/Output - None
+****************************************************************************************/
+void fast_fdset_process (struct batch_context* bctx,
+                         fd_set* rd,
+                         fd_set* wr,
+                         unsigned long now_time);
+
+#endif /* FAST_H */
@@ -0,0 +1,628 @@
+/*
+ *     keyval.c
+ *
+ * 2006-2007 Copyright (c)
+ * Robert Iakobashvili, <coroberti@gmail.com>
+ * All rights reserved.*
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// must be first include
+#include "fdsetsize.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "keyval.h"
+
+#define VALUE_SIZE  256
+
+typedef struct keyval
+{
+        struct  keyval* next;
+        void* context;
+
+        struct
+        {
+                char* word;
+                int index;
+                char last_c;
+                int found;
+
+        } key;
+
+        struct
+        {
+                char buf[VALUE_SIZE];
+                int index;
+                char quote;
+                int found;
+        } value;
+
+} keyval;
+
+
+typedef struct
+{
+        keyval* first;
+        keyval* last;
+} keyq;
+
+
+static keyq* que_array = 0;
+
+static int num_queues = 0;
+
+
+static int  kv_create(keyval* k, char* word);
+static void kv_scan(keyval* k, char* data, int size);
+static void scan_for_key(keyval* k, char c);
+static void scan_for_value(keyval *k, char c);
+static void add_to_value(keyval* k, char c);
+static void kv_init(keyval* k);
+static void kv_free(keyval* k);
+static void kv_flush(keyval* k);
+static void q_insert(keyq* q, keyval* k);
+static int err_out(const char* func, const char* msg);
+
+#define error(x) err_out(__func__, x)
+
+/*
+   Allocate an array of keyval queues, one for each possible context
+ */
+int
+keyval_start(int nqueues)
+{
+        if (que_array)
+                return 0;
+
+        if ((que_array = (keyq*) calloc(nqueues, sizeof (keyq))) == 0)
+                return error("cannot allocate que_array");
+
+        num_queues = nqueues;
+        return 0;
+}
+
+/*
+   Create a keyval for a given keyword
+ */
+int
+keyval_create(int index, void* context, char* word)
+{
+        keyval* k;
+
+        if (index >= num_queues)
+                return error("index out of range");
+
+        if ((k = calloc(1, sizeof *k)) == 0)
+                return error("cannot allocate keyval");
+
+        if (kv_create(k, word) < 0)
+                return -1;
+
+        k->context = context;
+        q_insert(&que_array[index], k);
+
+        return 0;
+}
+
+
+/*
+   Called when a previously-fetched URL is recycled,
+   and we want to capture new response values
+ */
+int
+keyval_init(int index, void* context)
+{
+        keyval* k;
+
+        if (index >= num_queues)
+                return error("index out of range");
+
+        for (k = que_array[index].first; k != 0; k = k->next)
+        {
+                if (k->context == context)
+                        kv_init (k);
+        }
+
+        return 0;
+}
+
+
+/*
+   Scan the given data for all the keyvals in the index
+ */
+void
+keyval_scan(int index, void* context, char* data, int size)
+{
+        keyval* k;
+
+        for (k = que_array[index].first; k != 0; k = k->next)
+        {
+                if (k->context == context)
+                        kv_scan(k, data, size);
+        }
+}
+
+void
+keyval_flush(int index, void* context)
+{
+        keyval* k;
+
+        for (k = que_array[index].first; k != 0; k = k->next)
+        {
+                if (k->context == context)
+                        kv_flush(k);
+        }
+}
+
+char*
+keyval_lookup(char* word, int index)
+{
+        keyval* k;
+
+        for (k = que_array[index].first; k != 0; k = k->next)
+        {
+                if (strcmp(k->key.word, word) == 0)
+                        return k->value.buf;
+        }
+        return 0;
+}
+
+void
+keyval_stop()
+{
+        int i; keyval *k, *next;
+
+        if (que_array == 0)
+                return;
+
+        for (i = 0; i < num_queues; i++)
+                for (k = que_array[i].first; k != 0; k = next)
+                {
+                        next = k->next;
+                        kv_free(k);
+                }
+
+        free(que_array);
+        que_array = 0;
+}
+
+static void
+q_insert(keyq* q, keyval* k)
+{
+        if (q->first == 0)
+        {
+                q->first = k;
+        }
+        else if (q->last != 0)
+        {
+                q->last->next = k;
+        }
+
+        q->last = k;
+        k->next = 0;
+}
+
+/*********************************************************
+   Low-level keyval implementation,
+   for word-boundry-only substring matching
+*********************************************************/
+static int
+kv_create(keyval* k, char* word)
+{
+        if ((k->key.word = strdup(word)) == 0)
+                return error("cannot allocate word");
+        return 0;
+}
+
+static void
+kv_scan(keyval* k, char* data, int size)
+{
+        if (k->value.found)
+                return;
+
+        for (; size > 0; data++, size--)
+        {
+                if (k->key.found == 0)
+                {
+                        scan_for_key(k, *data);
+                        k->key.last_c = *data;
+                }
+                else if (k->value.found == 0)
+                {
+                        scan_for_value(k, *data);
+                }
+                else
+                        break;
+        }
+}
+
+/*
+   Alphanumeric characters plus @, underscore, and dot.
+ */
+static const char
+        alphanum_plus[] =
+{
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /*   0 -  15 */
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /*  16 -  31 */
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, /*  32 -  47 */
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, /*  48 -  63 */
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, /*  64 -  79 */
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 1, /*  80 -  95 */
+        0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, /*  96 - 111 */
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, /* 112 - 127 */
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* 128 - 143 */
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* 144 - 159 */
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* 160 - 175 */
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* 176 - 191 */
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* 192 - 207 */
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* 208 - 223 */
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* 224 - 239 */
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* 240 - 255 */
+};
+
+#define acceptable(x) (alphanum_plus[(unsigned char) (x)] == 1)
+
+static void
+scan_for_key(keyval* k, char c)
+{
+        if (k->key.index == 0)
+        {
+                /* No matching so far. If we're continuing a run of the same thing
+                   (alphanumeric or non), or we've switched to non-alphanumeric,
+                   just ignore the character and continue the non-matching run.
+                 */
+                if (acceptable(c) == acceptable(k->key.last_c) || !acceptable(c))
+                        return;
+
+                /* Otherwise we have just changed from non-alphanumeric to
+                   alphanumeric, so we fall through and start matching.
+                 */
+        }
+
+        if (k->key.word[k->key.index] == 0)
+        {
+                /* we're in a matching run, and we've finished matching the keyword */
+                if (acceptable(c))
+                {
+                        // if the next character alphanumeric, so the match is spoiled
+                        k->key.index = 0;
+                }
+                else
+                {
+                        // otherwise we decalre a match!
+                        k->key.found = 1;
+                }
+                return;
+        }
+
+        if (c != k->key.word[k->key.index])
+        {
+                /* Now we're in a matching run, and this character doesn't match,
+                   so switch to a non-matching run.
+                 */
+                k->key.index = 0;
+                return;
+        }
+
+        /* We've matched another character */
+        ++k->key.index;
+}
+
+#define is_quote(x) (x == '"' || x == '\'')
+
+/*
+   We've found the keyword, and now we're collecting the value string.
+   We'll first skip any non-aplhanumerics. Then we'll collect a quoted
+   string, or a string of alphanumerics.
+ */
+static void
+scan_for_value(keyval *k, char c)
+{
+        if (acceptable(c))
+        {
+                add_to_value(k, c); /* any alphanumeic is welcome */
+                return;
+        }
+
+        if (k->value.quote) /* we're in a quote run */
+        {
+                if (k->value.quote == c) /* we've found the terminating quote */
+                        k->value.found = 1;
+                else
+                        add_to_value(k, c); /* collect the character, whatever it is */
+                return;
+        }
+
+        if (is_quote(c) && k->value.index == 0)
+        {
+                k->value.quote = c; /* start a quote run */
+                return;
+        }
+
+        if (k->value.index > 0) /* we've collected non-quoted characters, and ... */
+        {
+                k->value.found = 1; /* this non-aplhanumeric ends the collection */
+                return;
+        }
+
+        /* we have an initial non-quote non-alphanumeric, which we'll ignore */
+}
+
+static void
+add_to_value(keyval* k, char c)
+{
+        if (k->value.index < VALUE_SIZE - 1)
+        {
+                k->value.buf[k->value.index++] = c;
+                k->value.buf[k->value.index] = 0;
+        }
+}
+
+static void
+kv_init(keyval* k)
+{
+        k->key.index = 0;
+        k->key.last_c = 0;
+        k->key.found = 0;
+
+        k->value.buf[0] = 0;
+        k->value.index = 0;
+        k->value.quote = 0;
+        k->value.found = 0;
+}
+
+static void
+kv_free(keyval* k)
+{
+        if (k != 0)
+        {
+                free(k->key.word);
+                free(k);
+        }
+}
+
+static void
+kv_flush(keyval* k)
+{
+        if (k->key.found || k->key.word[k->key.index] == 0)
+                k->value.found = 1;
+}
+
+
+#if 0
+/***** bitap version, for more general substring search *****/
+/*
+   Struct for keeping track of a bitap string search.
+   We use chars instead of bits for simplicity, but
+   bits would save space and run faster.
+ */
+typedef struct bitap
+{
+        char* word; /* pattern or word to be recognized */
+        int size; /* strlen(word) */
+        char* mark; /* array of size + 1 markers */
+} bitap;
+
+
+typedef enum
+{
+        init = 0,
+        inter,
+        found
+
+} state;
+
+
+#define VALUE_SIZE  256
+
+typedef struct keyval
+{
+        struct keyval* next;
+        void* context;
+
+        bitap key;
+        char* data;
+        int size;
+        char value[VALUE_SIZE + 1];
+        int length;
+        char quote;
+        state keystate;
+        state valstate;
+
+} keyval;
+
+
+static int    bitap_search(bitap* bp, char* stream, int length);
+static int    bitap_init(bitap* b, char* word);
+static int    bitap_refresh(bitap* b);
+static void bitap_free(bitap* b);
+
+static int kv_init (keyval* k)
+{
+        k->value[0] = 0;
+        k->length = 0;
+        k->quote = 0;
+        k->keystate = init;
+        k->valstate = init;
+        return bitap_refresh(&k->key);
+}
+
+static void kv_free (keyval* k)
+{
+        bitap_free(&k->key);
+}
+
+static void kv_flush (keyval* k)
+{
+        if (k->keystate == found)
+        {
+                k->valstate = found;
+                k->value[k->length] = 0;
+        }
+}
+
+static void kv_scan (keyval* k, char* data, int size)
+{
+        k->data = data;
+        k->size = size;
+
+        if (k->keystate != found)
+                scan_for_key(k);
+
+        if (k->keystate == found && k->valstate != found)
+                scan_for_value(k);
+}
+
+static void scan_for_key(keyval* k)
+{
+        int n = 0;
+
+        if (k->data == 0 || k->size == 0 || k->keystate == found)
+                return (void) error("bad initial conditions");
+
+        n = bitap_search(&k->key, k->data, k->size);
+
+        if (n > 0)
+        {
+                k->data += n;
+                k->size -= n;
+
+                k->keystate = found;
+        }
+}
+
+static void scan_for_value(keyval *k)
+{
+        if (k->data == 0 || k->size == 0 || k->valstate == found)
+                return (void) error("bad initial conditions");
+
+        if (k->valstate == init)
+        {
+                /* skip white space and equals signs */
+                for (; k->size > 0 && (is_white(*k->data) || *k->data == '='); k->size--, k->data++)
+                        ;
+
+                if (k->size == 0)
+                        return; /* we haven't found the beginning of the value yet */
+
+                k->valstate = inter;
+
+                if (*k->data == '"' || *k->data == '\'')
+                {
+                        k->quote = *k->data++;
+                        k->size--;
+                }
+
+                if (k->size == 0)
+                        return;
+        }
+
+        /* at this point we're collecting the value */
+        if (k->quote != 0)
+        {
+                for (; k->size > 0 && *k->data != k->quote; k->size--, k->data++)
+                        if (k->length < VALUE_SIZE)
+                                k->value[k->length++] = *k->data;
+
+                if (k->size > 0)
+                        k->valstate = found;
+        }
+        else
+        {
+                for (; k->size > 0 && !is_white(*k->data); k->size--, k->data++)
+                        if (k->length < VALUE_SIZE)
+                                k->value[k->length++] = *k->data;
+
+                if (k->size > 0)
+                        k->valstate = found;
+        }
+}
+
+
+static int
+is_white(char c)
+{
+        return (c == ' ' || c == '\t' || c == '\n' || c == '\r');
+}
+
+
+/***** Bitap stuff *****/
+
+static int
+bitap_search(bitap* bp, char* stream, int length)
+{
+        int i, j; char* b = bp->mark; char* p = bp->word;
+
+        for (j = 1; j <= length; j++, stream++)
+        {
+                for (i = bp->size; i > 0; i--)
+                        b[i] = b[i - 1] && (p[i - 1] == *stream);
+
+                if (b[bp->size] == 1)
+                        return j;
+        }
+
+        return 0;
+}
+
+static int
+bitap_init(bitap* b, char* word)
+{
+        if (word)
+        {
+                if ((b->word = strdup(word)) == 0)
+                        return error("cannot allocate word");
+
+                if ((b->mark = calloc((b->size + 1), sizeof (char))) == 0)
+                        return error("cannot allocate mark array");
+
+                b->size = strlen(word);
+        }
+
+        return bitap_refresh(b);
+}
+
+static int
+bitap_refresh(bitap* b)
+{
+        int i;
+
+        b->mark[0] = 1;
+
+        for (i = 1; i <= b->size; i++)
+                b->mark[i] = 0;
+
+        return 0;
+}
+
+static void
+bitap_free(bitap* b)
+{
+        free(b->word);
+        free(b->mark);
+}
+
+/***** end of bitap version *****/
+#endif
+
+static int err_out (const char* func, const char* msg)
+{
+        fprintf(stderr, "%s error: %s\n", func, msg);
+        return -1;
+}
@@ -0,0 +1,54 @@
+/*
+ *     keyval.h
+ *
+ * 2006-2007 Copyright (c)
+ * Robert Iakobashvili, <coroberti@gmail.com>
+ * All rights reserved.*
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef KEYVAL_H
+#define KEYVAL_H
+
+/*
+   Keyval engine: word-boundary matching of keywords in server responses
+   and collecting of the values following them, e.g. tokens for URL templates.
+   There is a queue of keyvals for each index (client), each keyval
+   belongs to a context (url).
+ */
+
+/* Allocate an array of keyval queues, one for each possible index */
+int    keyval_start(int nqueues);
+
+/* Create a keyval for a given keyword */
+int    keyval_create(int index, void* context, char* word);
+
+/* Reset keyvals of the context to capture new response values */
+int    keyval_init(int index, void* context);
+
+/* Scan the given data for all the keyvals of the index and context */
+void   keyval_scan(int index, void* context, char* data, int size);
+
+/* Complete values of the index and context at the end of response */
+void   keyval_flush(int index, void* context);
+
+/* Returns the value collected for the keyword, or NULL */
+char*  keyval_lookup(char* word, int index);
+
+/* Release all the keyvals */
+void   keyval_stop();
+
+#endif /* KEYVAL_H */
@@ -43,6 +43,7 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <netinet/tcp.h>
 
 #include <curl/curl.h>
 #include <curl/multi.h>
@@ -57,14 +58,17 @@
 #include "ssl_thr_lock.h"
 #include "screen.h"
 #include "url.h"
+#include "url_formatter.h"
+#include "alog.h"
+#include "rstore.h"
+#include "zout.h"
+#include "tlog.h"
 #include "cl_alloc.h"
+#include "redis_pub.h"
+#include "share.h"
+#include "tls_rate.h"
+#include "dns_pin.h"
 
-#define URL_S_DEFAULT 0
-#define URL_S_OPEN    1
-#define URL_S_CLOSE   2
-#define URL_S_DONE    3
-
-#define char_to_int(p) (p - '0')
 #define MAX(p,q) ((p >= q) ? p : q)
 
 static int client_tracing_function (CURL *handle,
@@ -84,6 +88,12 @@ static void* batch_function (void *batch_data);
 static int initial_handles_init (struct client_context*const cdata);
 static int setup_curl_handle_appl (struct client_context*const cctx,
                                    url_context* url_ctx);
+static void setup_curl_handle_url (batch_context* bctx, CURL* handle, url_context* url);
+static int url_templates_init (batch_context* bctx);
+static int handle_from_template (client_context* cctx, int url_index,
+                                 CURL* template, CURLSH* share);
+static void local_ports_range (client_context* cctx, long* port, long* range);
+static int local_ports_interface_setup (client_context* cctx, CURL* handle);
 static int init_client_formed_buffer (client_context* cctx,
                                       url_context* url,
                                       char* buffer,
@@ -94,13 +104,6 @@ static void free_url (url_context* url, int clients_max);
 static int ipv6_increment(const struct in6_addr *const src,
                           struct in6_addr *const dest);
 static int create_thr_subbatches (batch_context *bc_arr, int subbatches_num);
-static int ip_addr_str_allocate_init (batch_context* bctx,
-                                      int client_index,
-                                      char** addr_str);
-
-static void url_formatter (char *buffer, size_t maxlen, const char *format, const form_records_cdata*const fcd);
-
-static void url_formatter_append (char *buffer, size_t *currlen, size_t maxlen, char c);
 
 int stop_loading = 0;
 
@@ -121,18 +124,21 @@ static void sigint_handler (int signum)
 typedef int (*pf_user_activity) (struct client_context*const);
 
 /*
- * Batch functions for the 2 loading modes:
- * hyper (epoll-based) and smooth (poll-based).
+ * Batch functions for the 4 loading modes:
+ * hyper (epoll-based), smooth (poll-based), dry-run (no network) and
+ * connection pool (poll-based).
  */
-static pf_user_activity ua_array[2] =
+static pf_user_activity ua_array[4] =
 {
         user_activity_hyper,
-        user_activity_smooth
+        user_activity_smooth,
+        user_activity_sim,
+        user_activity_pool
 };
 
 static FILE *create_file (batch_context* bctx, char* fname)
 {
-        FILE *fp = fopen(fname,"w");
+        FILE *fp = zout_fopen (fname);
         if (!fp)
                 (void)fprintf(stderr,"%s, cannot create file \"%s\", %s\n",
                               bctx->batch_name,fname,strerror(errno));
@@ -189,7 +195,8 @@ int main (int argc, char *argv [])
                 return -1;
         }
 
-        if (geteuid())
+        /* Dry run adds no IP-addresses and opens no sockets */
+        if (geteuid() && loading_mode != LOAD_MODE_DRY_RUN)
         {
                 fprintf (stderr,
                          "%s - error: lacking root priviledges to run this program.\n", __func__);
@@ -236,6 +243,33 @@ int main (int argc, char *argv [])
                          __func__);
         }
 
+        /*
+           Resolve and pin the hostnames of the urls, when configured.
+         */
+        if (dns_pin_start (bc_arr, batches_num) == -1)
+        {
+                fprintf (stderr, "%s - error: dns_pin_start () failed.\n", __func__);
+                return -1;
+        }
+
+        if (redis_pub_start () == -1)
+        {
+                fprintf (stderr, "%s - error: redis_pub_start () failed.\n", __func__);
+                return -1;
+        }
+
+        if (zout_start () == -1)
+        {
+                fprintf (stderr, "%s - error: zout_start () failed.\n", __func__);
+                return -1;
+        }
+
+        if (alog_start () == -1)
+        {
+                fprintf (stderr, "%s - error: alog_start () failed.\n", __func__);
+                return -1;
+        }
+
         signal (SIGINT, sigint_handler);
 
         screen_init ();
@@ -366,6 +400,46 @@ static void* batch_function (void * batch_data)
                 goto cleanup;
         }
 
+        /*
+           Asynchronous client logging, when configured.
+         */
+        if (alog_open (bctx, stderr_print_client_msg ? stderr : log_file) == -1)
+        {
+                fprintf (stderr, "%s - \"%s\" - alog_open () failed.\n",
+                         __func__, bctx->batch_name);
+                goto cleanup;
+        }
+
+        /*
+           Tail-based sampled logging, when configured.
+         */
+        if (tlog_open (bctx) == -1)
+        {
+                fprintf (stderr, "%s - \"%s\" - tlog_open () failed.\n",
+                         __func__, bctx->batch_name);
+                goto cleanup;
+        }
+
+        /*
+           Segmented store of responses, when configured.
+         */
+        if (rstore_open (bctx) == -1)
+        {
+                fprintf (stderr, "%s - \"%s\" - rstore_open () failed.\n",
+                         __func__, bctx->batch_name);
+                goto cleanup;
+        }
+
+        /*
+           Shares of DNS cache, TLS sessions and cookies of the urls, when configured.
+         */
+        if (share_open (bctx) == -1)
+        {
+                fprintf (stderr, "%s - \"%s\" - share_open () failed.\n",
+                         __func__, bctx->batch_name);
+                goto cleanup;
+        }
+
         /*
            Init libcurl MCURL and CURL handles. Setup of the handles is delayed to
            the later step, depending on urls required.
@@ -377,6 +451,24 @@ static void* batch_function (void * batch_data)
                 goto cleanup;
         }
 
+        /*
+           Template handles of the urls, when configured.
+         */
+        if (url_templates_init (bctx) == -1)
+        {
+                fprintf (stderr, "%s - \"%s\" url_templates_init () failed.\n",
+                         __func__, bctx->batch_name);
+                goto cleanup;
+        }
+
+        /*
+           Report memory footprint of a client: client context and the allocated
+           side tables of the batch, not counting libcurl handles.
+         */
+        fprintf (stderr, "%s - \"%s\" - %d clients, %Zu bytes per client.\n",
+                 __func__, bctx->batch_name, bctx->client_num_max,
+                 client_bytes_per_client (bctx));
+
         /*
            Now run configuration-defined actions, like login, fetching various urls and and
            sleeping in between and loggoff.
@@ -397,6 +489,12 @@ cleanup:
         if (bctx->multiple_handle)
                 curl_multi_cleanup(bctx->multiple_handle);
 
+        tlog_close (bctx);
+
+        alog_close (bctx);
+
+        rstore_close (bctx);
+
         if (log_file)
                 fclose (log_file);
 
@@ -423,7 +521,6 @@ cleanup:
 static int initial_handles_init (client_context*const ctx_array)
 {
         batch_context* bctx = ctx_array->bctx;
-        int k = 0;
 
         /* Init CURL multi-handle. */
         if (!(bctx->multiple_handle = curl_multi_init()) )
@@ -434,20 +531,133 @@ static int initial_handles_init (client_context*const ctx_array)
                 return -1;
         }
 
-        /* Initialize all CURL handles */
-        for (k = 0; k < bctx->client_num_max; k++)
+        /*
+           Requests of the clients pipelined or multiplexed over shared connections.
+           The limits are options of libcurl 7.30, backported to the bundled one
+           by patches/curl-pipeline-limits.patch.
+         */
+        if (bctx->pipelining)
         {
-                if (!(bctx->cctx_array[k].handle = curl_easy_init ()))
+                const long pipelining =
+#ifdef CURLPIPE_MULTIPLEX
+                        bctx->pipelining == PIPELINING_MULTIPLEX ? CURLPIPE_MULTIPLEX :
+#endif
+                        1L;
+
+                if (curl_multi_setopt (bctx->multiple_handle, CURLMOPT_PIPELINING,
+                                       pipelining) != CURLM_OK ||
+                    (bctx->max_host_connections &&
+                     curl_multi_setopt (bctx->multiple_handle, CURLMOPT_MAX_HOST_CONNECTIONS,
+                                        (long) bctx->max_host_connections) != CURLM_OK) ||
+                    (bctx->max_pipeline_length &&
+                     curl_multi_setopt (bctx->multiple_handle, CURLMOPT_MAX_PIPELINE_LENGTH,
+                                        (long) bctx->max_pipeline_length) != CURLM_OK))
                 {
-                        fprintf (stderr,"%s - error: curl_easy_init () failed for k=%d.\n",
-                                 __func__, k);
+                        fprintf (stderr,
+                                 "%s - error: pipelining options are not supported by libcurl "
+                                 "for batch \"%s\".\n", __func__, bctx->batch_name);
                         return -1;
                 }
         }
 
+        /*
+           CURL handles are allocated on demand, when clients are scheduled,
+           by client_handle_acquire (). Handles of finished and failed clients
+           are kept for reuse in the free pool.
+         */
+        if (!(bctx->handle_pool = calloc (bctx->client_num_max, sizeof (CURL*))))
+        {
+                fprintf (stderr, "%s - error: calloc () of the handle pool failed.\n",
+                         __func__);
+                return -1;
+        }
+
+        bctx->handle_pool_num = 0;
+
         return 0;
 }
 
+/****************************************************************************************
+* Function name - client_handle_acquire
+*
+* Description - Provides a client without a CURL handle with a handle from the
+*               free pool of the batch or with a newly allocated one.
+*
+* Input -       *cctx - pointer to client context
+* Return Code/Output - On Success - 0, on Error -1
+****************************************************************************************/
+int client_handle_acquire (client_context* cctx)
+{
+        batch_context* bctx = cctx->bctx;
+
+        if (cctx->handle)
+        {
+                return 0;
+        }
+
+        if (bctx->handle_pool_num > 0)
+        {
+                cctx->handle = bctx->handle_pool[--bctx->handle_pool_num];
+                bctx->prof.handle_reuses++;
+                return 0;
+        }
+
+        if (!(cctx->handle = curl_easy_init ()))
+        {
+                fprintf (stderr,"%s - error: curl_easy_init () failed for client %d.\n",
+                         __func__, (int) cctx->client_index + 1);
+                return -1;
+        }
+
+        bctx->prof.handle_allocs++;
+        return 0;
+}
+
+/****************************************************************************************
+* Function name - client_handle_release
+*
+* Description - Takes the CURL handle from a finished or failed client, already
+*               removed from the multi-handle, and keeps it reset in the free
+*               pool of the batch for reuse by other clients.
+*
+* Input -       *cctx - pointer to client context
+* Return Code/Output - None
+****************************************************************************************/
+void client_handle_release (client_context* cctx)
+{
+        batch_context* bctx = cctx->bctx;
+        CURL* handle = cctx->handle;
+
+        if (!handle)
+        {
+                return;
+        }
+
+        cctx->handle = NULL;
+
+        /* Handles duplicated from url templates are kept by the client */
+        if (cctx->url_handles)
+        {
+                return;
+        }
+
+        if (!bctx->handle_pool || bctx->handle_pool_num >= bctx->client_num_max)
+        {
+                curl_easy_cleanup (handle);
+                return;
+        }
+
+        /*
+           Forget the client: its cookies share, cookies and options. Live
+           connections are kept by the multi-handle anyway.
+         */
+        curl_easy_setopt (handle, CURLOPT_SHARE, NULL);
+        curl_easy_setopt (handle, CURLOPT_COOKIELIST, "ALL");
+        curl_easy_reset (handle);
+
+        bctx->handle_pool[bctx->handle_pool_num++] = handle;
+}
+
 /*
    The callback to libcurl to write all bytes to ptr.
  */
@@ -497,7 +707,9 @@ int setup_curl_handle (client_context*const cctx, url_context* url)
  *
  * Description - Resets client context kept CURL handle and inits it locally, using
  *               setup_curl_handle_appl () function for the application-specific
- *               (HTTP/FTP) initialization.
+ *               (HTTP/FTP) initialization. With HANDLE_TEMPLATES the handle is
+ *               instead replaced by the client handle of the url, duplicated from
+ *               the url template handle, and only the client-specific options are set.
  *
  * Input -       *cctx- pointer to client context, containing CURL handle pointer;
  *               *url - pointer to url-context, containing all url-related information;
@@ -512,9 +724,34 @@ int setup_curl_handle_init (client_context*const cctx, url_context* url)
         }
 
         batch_context* bctx = cctx->bctx;
-        CURL* handle = cctx->handle;
+        CURL* handle;
 
-        curl_easy_reset (handle);
+        if (bctx->url_templates && bctx->url_templates[url - bctx->url_ctx_array])
+        {
+                int url_index = (int) (url - bctx->url_ctx_array);
+
+                if (handle_from_template (cctx, url_index, bctx->url_templates[url_index],
+                                          share_handle (bctx, url)) == -1)
+                {
+                        fprintf (stderr,"%s - error: handle_from_template () failed\n", __func__);
+                        return -1;
+                }
+
+                handle = cctx->handle;
+        }
+        else
+        {
+                if (client_handle_acquire (cctx) == -1)
+                {
+                        return -1;
+                }
+
+                handle = cctx->handle;
+
+                curl_easy_reset (handle);
+
+                setup_curl_handle_url (bctx, handle, url);
+        }
 
         /*
            Choose the next URL from an url set, or complete the url template from
@@ -528,17 +765,18 @@ int setup_curl_handle_init (client_context*const cctx, url_context* url)
                 return -1;
         }
 
-        if (bctx->ipv6)
-                curl_easy_setopt (handle, CURLOPT_IPRESOLVE, CURL_IPRESOLVE_V6);
-
-        /* Bind the handle to a certain IP-address */
-        curl_easy_setopt (handle, CURLOPT_INTERFACE,
-                          bctx->ip_addr_array [cctx->client_index]);
-
-        curl_easy_setopt (handle, CURLOPT_NOSIGNAL, 1);
+        /*
+           Bind the handle to the IP-address of the client and to its local ports,
+           when partitioned. libcurl re-uses a connection only for the handles
+           with the same interface and ports.
+         */
+        if (local_ports_interface_setup (cctx, handle) == -1)
+        {
+                return -1;
+        }
 
-        /* set|unset the curl proxy */
-        curl_easy_setopt (handle, CURLOPT_PROXY, config_proxy);
+        /* Pinned addresses of the hostnames, DNS_MODE */
+        dns_pin_handle_setup (bctx, handle);
 
         /* Set the url */
         if (url->url_str && url->url_str_len)
@@ -556,19 +794,21 @@ int setup_curl_handle_init (client_context*const cctx, url_context* url)
                            GET url with form fields. If not making searches with a search
                            engine, better to do it encrypted by HTTPS.
                          */
-                        if (!cctx->get_url_form_data || !cctx->get_url_form_data_len)
+                        client_forms* cf = client_forms_get (cctx);
+
+                        if (!cf || !cf->get_url_form_data || !cf->get_url_form_data_len)
                         {
                                 fprintf (stderr,"%s - error: get_url_form_data not allocated/initialized.\n",
                                          __func__);
                                 return -1;
                         }
 
-                        strcpy (cctx->get_url_form_data, url->url_str);
+                        strcpy (cf->get_url_form_data, url->url_str);
 
                         if (init_client_formed_buffer (cctx,
                                                        url,
-                                                       cctx->get_url_form_data + url->url_str_len -1,
-                                                       cctx->get_url_form_data_len - url->url_str_len) == -1)
+                                                       cf->get_url_form_data + url->url_str_len -1,
+                                                       cf->get_url_form_data_len - url->url_str_len) == -1)
                         {
                                 fprintf (stderr,
                                          "%s - error: init_client_formed_buffer() failed for GET form fields.\n",
@@ -576,7 +816,7 @@ int setup_curl_handle_init (client_context*const cctx, url_context* url)
                                 return -1;
                         }
 
-                        curl_easy_setopt (handle, CURLOPT_URL, cctx->get_url_form_data);
+                        curl_easy_setopt (handle, CURLOPT_URL, cf->get_url_form_data);
                 }
                 else
                 {
@@ -587,7 +827,7 @@ int setup_curl_handle_init (client_context*const cctx, url_context* url)
                                 char buf[1000];
                                 sprintf(buf,"%s.%ld.%ld.%s",url->url_str,
                                         cctx->cycle_num,cctx->url_curr_index,
-                                        cctx->client_name);
+                                        client_name (cctx));
                                 buf[strlen(buf)-1] = '\0'; // suppress space
                                 curl_easy_setopt (handle, CURLOPT_URL, buf);
 #else
@@ -617,34 +857,6 @@ int setup_curl_handle_init (client_context*const cctx, url_context* url)
 
         bctx->url_index = url->url_ind;
 
-        curl_easy_setopt (handle, CURLOPT_DNS_CACHE_TIMEOUT, -1);
-
-        /* Set the connection timeout */
-        curl_easy_setopt (handle,
-                          CURLOPT_CONNECTTIMEOUT,
-                          url->connect_timeout ? url->connect_timeout : connect_timeout);
-
-        /* Define the connection re-use policy. When passed 1, re-establish */
-        curl_easy_setopt (handle, CURLOPT_FRESH_CONNECT, url->fresh_connect);
-
-        if (url->fresh_connect)
-        {
-                curl_easy_setopt (handle, CURLOPT_FORBID_REUSE, 1);
-        }
-
-        /*
-           If DNS resolving is necesary, global DNS cache is enough,
-           otherwise compile libcurl with ares (cares) library support.
-           Attention: DNS global cache is not thread-safe, therefore use
-           cares for asynchronous DNS lookups.
-
-           curl_easy_setopt (handle, CURLOPT_DNS_USE_GLOBAL_CACHE, 1);
-         */
-
-        curl_easy_setopt (handle, CURLOPT_VERBOSE, 1);
-        curl_easy_setopt (handle, CURLOPT_DEBUGFUNCTION,
-                          client_tracing_function);
-
         /*
            This is to return cctx pointer as the void* userp to the
            tracing function.
@@ -669,27 +881,13 @@ int setup_curl_handle_init (client_context*const cctx, url_context* url)
                         return -1;
                 }
         }
-        else
-        {
-                curl_easy_setopt (handle, CURLOPT_WRITEFUNCTION,
-                                  do_nothing_write_func);
-        }
-
-        curl_easy_setopt (handle, CURLOPT_SSL_VERIFYPEER, 0);
-        curl_easy_setopt (handle, CURLOPT_SSL_VERIFYHOST, 0);
 
         /* Set the private pointer to be used by the smooth-mode. */
         curl_easy_setopt (handle, CURLOPT_PRIVATE, cctx);
 
-        /* Without the buffer set, we do not get any errors in tracing function. */
-        curl_easy_setopt (handle, CURLOPT_ERRORBUFFER, bctx->error_buffer);
-
-        /* set ignore_content_length
-         */
-        if (url->ignore_content_length)
-        {
-                curl_easy_setopt (handle, CURLOPT_IGNORE_CONTENT_LENGTH, 1);
-        }
+        /* Outcome of TLS handshakes of the client, when counted */
+        if (tls_handshake_mode)
+                tls_rate_handle_setup (cctx, handle);
 
   #if 0
         if (url->upload_file)
@@ -718,44 +916,502 @@ int setup_curl_handle_init (client_context*const cctx, url_context* url)
                 curl_easy_setopt(handle, CURLOPT_READDATA,
                                  url->upload_file_ptr);
 
-                /* Provide the size of the upload */
-                curl_easy_setopt(handle, CURLOPT_INFILESIZE,
-                                 (long) url->upload_file_size);
+                /* Provide the size of the upload */
+                curl_easy_setopt(handle, CURLOPT_INFILESIZE,
+                                 (long) url->upload_file_size);
+
+                if (url->transfer_limit_rate)
+                {
+                        curl_easy_setopt(handle, CURLOPT_MAX_SEND_SPEED_LARGE,
+                                         (curl_off_t) url->transfer_limit_rate);
+                }
+        }
+  #endif
+
+        /* GF  */
+        if (url->upload_file)
+        {
+                if (upload_file_stream_init (cctx, url) < 0)
+                        return -1;
+        }
+
+        /*
+           Application (url) specific setups, like HTTP-specific, FTP-specific, etc.
+         */
+        if (setup_curl_handle_appl (cctx, url) == -1)
+        {
+                fprintf (stderr,
+                         "%s - error: setup_curl_handle_appl () failed .\n",
+                         __func__);
+                return -1;
+        }
+
+        return 0;
+}
+
+/****************************************************************************
+ * Function name - setup_curl_handle_url
+ *
+ * Description - Sets to a CURL handle the options, that depend only on the batch
+ *               and the url, and not on the client. Used by setup_curl_handle_init ()
+ *               and for the url template handles.
+ *
+ * Input -       *bctx   - pointer to the batch context
+ *               *handle - the CURL handle
+ *               *url    - pointer to url-context
+ * Return Code/Output - None
+ ******************************************************************************/
+static void setup_curl_handle_url (batch_context* bctx, CURL* handle, url_context* url)
+{
+        if (bctx->ipv6)
+                curl_easy_setopt (handle, CURLOPT_IPRESOLVE, CURL_IPRESOLVE_V6);
+
+        curl_easy_setopt (handle, CURLOPT_NOSIGNAL, 1);
+
+        /* set|unset the curl proxy */
+        curl_easy_setopt (handle, CURLOPT_PROXY, config_proxy);
+
+        curl_easy_setopt (handle, CURLOPT_DNS_CACHE_TIMEOUT, -1);
+
+        /*
+           DNS cache, TLS sessions and cookies, shared by the url (SHARE tag),
+           or detach a recycled handle from the share of its previous url.
+         */
+        curl_easy_setopt (handle, CURLOPT_SHARE, share_handle (bctx, url));
+
+        /* Set the connection timeout */
+        curl_easy_setopt (handle,
+                          CURLOPT_CONNECTTIMEOUT,
+                          url->connect_timeout ? url->connect_timeout : connect_timeout);
+
+        /*
+           Define the connection re-use policy. When passed 1, re-establish.
+           TLS handshake-rate mode makes each request on a new connection.
+         */
+        const long fresh_connect = url->fresh_connect || tls_handshake_mode;
+
+        curl_easy_setopt (handle, CURLOPT_FRESH_CONNECT, fresh_connect);
+
+        if (fresh_connect)
+        {
+                curl_easy_setopt (handle, CURLOPT_FORBID_REUSE, 1);
+        }
+
+#ifdef CURLPIPE_MULTIPLEX
+        /* HTTP/2 streams of the clients wait for a multiplexed connection */
+        if (bctx->pipelining == PIPELINING_MULTIPLEX)
+        {
+                curl_easy_setopt (handle, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2_0);
+                curl_easy_setopt (handle, CURLOPT_PIPEWAIT, 1L);
+        }
+#endif
+
+        /*
+           If DNS resolving is necesary, pin the addresses by DNS_MODE PIN or share
+           the DNS cache by SHARE tag of the url, otherwise compile libcurl with
+           ares (cares) library support.
+           Attention: DNS global cache is not thread-safe, the shares of SHARE_SCOPE
+           GLOBAL are locked instead.
+
+           curl_easy_setopt (handle, CURLOPT_DNS_USE_GLOBAL_CACHE, 1);
+         */
+
+        /* Socket tuning of the batch connections */
+        if (bctx->sock_linger_rst || bctx->sock_nodelay || bctx->sock_sndbuf ||
+            bctx->sock_rcvbuf || bctx->sock_bind_no_port)
+        {
+                curl_easy_setopt (handle, CURLOPT_SOCKOPTFUNCTION, sockopt_function);
+                curl_easy_setopt (handle, CURLOPT_SOCKOPTDATA, bctx);
+        }
+
+        curl_easy_setopt (handle, CURLOPT_VERBOSE, 1);
+        curl_easy_setopt (handle, CURLOPT_DEBUGFUNCTION,
+                          client_tracing_function);
+
+        if (!url->log_resp_bodies && !url->log_resp_headers)
+        {
+                curl_easy_setopt (handle, CURLOPT_WRITEFUNCTION,
+                                  do_nothing_write_func);
+        }
+
+        curl_easy_setopt (handle, CURLOPT_SSL_VERIFYPEER, 0);
+        curl_easy_setopt (handle, CURLOPT_SSL_VERIFYHOST, 0);
+
+        /* Full TLS handshakes without session resumption, when required */
+        if (url->tls_handshake == TLS_HANDSHAKE_FULL)
+                curl_easy_setopt (handle, CURLOPT_SSL_SESSIONID_CACHE, 0);
+
+        if (url->tls_ciphers)
+                curl_easy_setopt (handle, CURLOPT_SSL_CIPHER_LIST, url->tls_ciphers);
+
+        /* Without the buffer set, we do not get any errors in tracing function. */
+        curl_easy_setopt (handle, CURLOPT_ERRORBUFFER, bctx->error_buffer);
+
+        /* set ignore_content_length
+         */
+        if (url->ignore_content_length)
+        {
+                curl_easy_setopt (handle, CURLOPT_IGNORE_CONTENT_LENGTH, 1);
+        }
+
+        if (!url->upload_file && url->transfer_limit_rate)
+        {
+                curl_easy_setopt(handle, CURLOPT_MAX_RECV_SPEED_LARGE,
+                                 (curl_off_t) url->transfer_limit_rate);
+        }
+}
+
+/****************************************************************************************
+* Function name - url_templates_init
+*
+* Description - With HANDLE_TEMPLATES builds a template CURL handle for each url
+*               of the batch with the options, not depending on a client. Cookies
+*               are enabled in all the templates, since the cookies of a client are
+*               kept in its share, attached to each handle duplicated.
+*
+* Input -       *bctx - pointer to the batch context
+* Return Code/Output - On Success - 0, on Error -1
+****************************************************************************************/
+static int url_templates_init (batch_context* bctx)
+{
+        int i;
+
+        if (!bctx->use_handle_templates)
+        {
+                return 0;
+        }
+
+        if (!(bctx->url_templates = calloc (bctx->urls_num, sizeof (CURL*))))
+        {
+                fprintf (stderr, "%s - error: calloc () failed.\n", __func__);
+                return -1;
+        }
+
+        for (i = 0; i < bctx->urls_num; i++)
+        {
+                url_context* url = &bctx->url_ctx_array[i];
+
+                /* The current url is kept in the handle of the client */
+                if (url->url_use_current)
+                        continue;
+
+                if (!(bctx->url_templates[i] = curl_easy_init ()))
+                {
+                        fprintf (stderr,"%s - error: curl_easy_init () failed for url %d.\n",
+                                 __func__, i);
+                        return -1;
+                }
+
+                setup_curl_handle_url (bctx, bctx->url_templates[i], url);
+
+                curl_easy_setopt (bctx->url_templates[i], CURLOPT_COOKIEFILE, "");
+        }
+
+        return 0;
+}
+
+/****************************************************************************************
+* Function name - handle_from_template
+*
+* Description - Replaces the CURL handle of a client, already removed from the
+*               multi-handle, by the client handle of the url. The handle is
+*               duplicated from the url template handle on the first use and kept
+*               for the next cycles. The client cookies are kept in a share of the
+*               client, allocated on the first use, unless the url has a share of
+*               its own.
+*
+* Input -       *cctx     - pointer to the client context
+*               url_index - index of the url
+*               template  - the url template handle
+*               share     - the share of the url or NULL
+* Return Code/Output - On Success - 0, on Error -1
+****************************************************************************************/
+static int handle_from_template (client_context* cctx, int url_index,
+                                 CURL* template, CURLSH* share)
+{
+        batch_context* bctx = cctx->bctx;
+        CURL* handle;
+
+        if (!cctx->url_handles &&
+            !(cctx->url_handles = calloc (bctx->urls_num, sizeof (CURL*))))
+        {
+                fprintf (stderr, "%s - error: calloc () failed.\n", __func__);
+                return -1;
+        }
+
+        if ((handle = cctx->url_handles[url_index]))
+        {
+                /*
+                   The handle keeps the options of the previous cycle, set again
+                   by the caller. Only a URL_USE_CURRENT url after this one may
+                   have switched it to POST.
+                 */
+                curl_easy_setopt (handle, CURLOPT_HTTPGET, 1L);
+
+                bctx->prof.handle_reuses++;
+                cctx->handle = handle;
+                return 0;
+        }
+
+        if (!share && !cctx->cookie_share)
+        {
+                if (!(cctx->cookie_share = curl_share_init ()))
+                {
+                        fprintf (stderr, "%s - error: curl_share_init () failed.\n", __func__);
+                        return -1;
+                }
+
+                curl_share_setopt (cctx->cookie_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_COOKIE);
+        }
+
+        if (!(handle = curl_easy_duphandle (template)))
+        {
+                fprintf (stderr, "%s - error: curl_easy_duphandle () failed.\n", __func__);
+                return -1;
+        }
+
+        curl_easy_setopt (handle, CURLOPT_SHARE, share ? share : cctx->cookie_share);
+
+        bctx->prof.handle_allocs++;
+
+        cctx->url_handles[url_index] = handle;
+        cctx->handle = handle;
+        return 0;
+}
+
+/****************************************************************************************
+* Function name - sockopt_function
+*
+* Description - CURLOPT_SOCKOPTFUNCTION callback, applying socket tuning of the batch
+*               to a new socket before it is connected: SO_LINGER {1,0} to close
+*               by RST without TIME_WAIT, TCP_NODELAY, buffer sizes and
+*               IP_BIND_ADDRESS_NO_PORT to choose the local port at connect, so
+*               that a port of a shared IP-address is re-used for other servers.
+*
+* Input -       *clientp - pointer to the batch context
+*               fd       - the socket
+*               purpose  - purpose of the socket
+* Return Code/Output - 0 - success, errors are logged and ignored
+****************************************************************************************/
+int sockopt_function (void* clientp, curl_socket_t fd, curlsocktype purpose)
+{
+        batch_context* bctx = (batch_context *) clientp;
+
+        if (purpose != CURLSOCKTYPE_IPCXN)
+        {
+                return 0;
+        }
+
+        if (bctx->sock_linger_rst)
+        {
+                struct linger lin = {1, 0};
+
+                if (setsockopt (fd, SOL_SOCKET, SO_LINGER, &lin, sizeof (lin)) == -1)
+                        fprintf (stderr, "%s - SO_LINGER failed, errno %d.\n", __func__, errno);
+        }
+
+        if (bctx->sock_nodelay)
+        {
+                int on = (bctx->sock_nodelay > 0);
+
+                if (setsockopt (fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof (on)) == -1)
+                        fprintf (stderr, "%s - TCP_NODELAY failed, errno %d.\n", __func__, errno);
+        }
+
+        if (bctx->sock_sndbuf &&
+            setsockopt (fd, SOL_SOCKET, SO_SNDBUF, &bctx->sock_sndbuf, sizeof (int)) == -1)
+        {
+                fprintf (stderr, "%s - SO_SNDBUF failed, errno %d.\n", __func__, errno);
+        }
+
+        if (bctx->sock_rcvbuf &&
+            setsockopt (fd, SOL_SOCKET, SO_RCVBUF, &bctx->sock_rcvbuf, sizeof (int)) == -1)
+        {
+                fprintf (stderr, "%s - SO_RCVBUF failed, errno %d.\n", __func__, errno);
+        }
+
+#if defined (IP_BIND_ADDRESS_NO_PORT)
+        /* Explicit local ports are bound by libcurl */
+        if (bctx->sock_bind_no_port && !bctx->local_port_min)
+        {
+                int on = 1;
+
+                if (setsockopt (fd, IPPROTO_IP, IP_BIND_ADDRESS_NO_PORT, &on, sizeof (on)) == -1)
+                        fprintf (stderr, "%s - IP_BIND_ADDRESS_NO_PORT failed, errno %d.\n",
+                                 __func__, errno);
+        }
+#endif
+
+        return 0;
+}
+
+/****************************************************************************************
+* Function name - opensocket_function
+*
+* Description - Opens a socket of the fast engine and binds it to the source
+*               IP-address of the client, computed from the batch range, and to
+*               a local port of the client, when LOCAL_PORT_MIN is configured.
+*               Otherwise IP_BIND_ADDRESS_NO_PORT, when configured, defers choosing
+*               of the port to connect, so that a port of a shared IP-address is
+*               re-used for other servers. CURL handles are bound by libcurl.
+*
+* Input -       *clientp - pointer to the client context
+*               purpose  - purpose of the socket
+*               *address - address family, socket type, protocol and the peer address
+* Return Code/Output - On Success - the socket, on Error - CURL_SOCKET_BAD
+****************************************************************************************/
+curl_socket_t opensocket_function (void* clientp,
+                                   curlsocktype purpose,
+                                   struct curl_sockaddr* address)
+{
+        client_context* cctx = (client_context *) clientp;
+        batch_context* bctx = cctx->bctx;
+        struct sockaddr_storage ss;
+        socklen_t ss_len;
+        curl_socket_t fd;
+
+        (void) purpose;
+
+        if (client_ip_sockaddr (bctx, cctx->client_index, &ss, &ss_len) == -1)
+        {
+                fprintf (stderr, "%s - error: no IP-address for client %s.\n",
+                         __func__, client_name (cctx));
+                return CURL_SOCKET_BAD;
+        }
+
+        /* Let libcurl try the next resolved address of the matching family */
+        if (ss.ss_family != address->family)
+        {
+                return CURL_SOCKET_BAD;
+        }
+
+        if ((fd = socket (address->family, address->socktype, address->protocol)) == -1)
+        {
+                fprintf (stderr, "%s - error: socket () failed, errno %d.\n", __func__, errno);
+                return CURL_SOCKET_BAD;
+        }
+
+        if (!bctx->local_port_min)
+        {
+#if defined (IP_BIND_ADDRESS_NO_PORT)
+                if (bctx->sock_bind_no_port)
+                {
+                        int on = 1;
+
+                        if (setsockopt (fd, IPPROTO_IP, IP_BIND_ADDRESS_NO_PORT, &on, sizeof (on)) == -1)
+                                fprintf (stderr, "%s - IP_BIND_ADDRESS_NO_PORT failed, errno %d.\n",
+                                         __func__, errno);
+                }
+#endif
+                if (bind (fd, (struct sockaddr *) &ss, ss_len) == 0)
+                {
+                        return fd;
+                }
+        }
+        else
+        {
+                long port, range;
+
+                local_ports_range (cctx, &port, &range);
+
+                /* As libcurl, take the first free port of the range */
+                for (; range > 0; port++, range--)
+                {
+                        if (ss.ss_family == AF_INET)
+                                ((struct sockaddr_in *) &ss)->sin_port = htons ((unsigned short) port);
+                        else
+                                ((struct sockaddr_in6 *) &ss)->sin6_port = htons ((unsigned short) port);
+
+                        if (bind (fd, (struct sockaddr *) &ss, ss_len) == 0)
+                        {
+                                return fd;
+                        }
+
+                        if (errno != EADDRINUSE)
+                                break;
+                }
+        }
+
+        fprintf (stderr, "%s - error: bind () failed for client %s, errno %d.\n",
+                 __func__, client_name (cctx), errno);
+        close (fd);
+        return CURL_SOCKET_BAD;
+}
+
+/****************************************************************************************
+* Function name - local_ports_range
+*
+* Description - Gets the local ports range of a client. LOCAL_PORT_MIN - LOCAL_PORT_MAX
+*               range is divided between the threads, and the range of a thread
+*               either between its clients or used by all of them.
+*
+* Input -       *cctx   - pointer to the client context
+* Input/Output  *port_out  - the first port of the range
+*               *range_out - number of the ports in the range
+* Return Code/Output - None
+****************************************************************************************/
+static void local_ports_range (client_context* cctx, long* port_out, long* range_out)
+{
+        batch_context* bctx = cctx->bctx;
+        const long threads = threads_subbatches_num ? threads_subbatches_num : 1;
+        long range = (bctx->local_port_max - bctx->local_port_min + 1) / threads;
+        long port = bctx->local_port_min + (long) bctx->batch_id * range;
+
+        if (bctx->local_port_partition == LOCAL_PORT_PARTITION_CLIENT)
+        {
+                const long per_client = range / bctx->client_num_max;
 
-                if (url->transfer_limit_rate)
+                if (per_client > 0)
                 {
-                        curl_easy_setopt(handle, CURLOPT_MAX_SEND_SPEED_LARGE,
-                                         (curl_off_t) url->transfer_limit_rate);
+                        port += cctx->client_index * per_client;
+                        range = per_client;
                 }
-        }
-  #endif
-
-        /* GF  */
-        if (url->upload_file)
-        {
-                if (upload_file_stream_init (cctx, url) < 0)
-                        return -1;
-        }
-        else
-        {
-                if (url->transfer_limit_rate)
+                else
                 {
-                        curl_easy_setopt(handle, CURLOPT_MAX_RECV_SPEED_LARGE,
-                                         (curl_off_t) url->transfer_limit_rate);
+                        port += cctx->client_index % range;
+                        range = 1;
                 }
         }
 
-        /*
-           Application (url) specific setups, like HTTP-specific, FTP-specific, etc.
-         */
-        if (setup_curl_handle_appl (cctx, url) == -1)
+        *port_out = port;
+        *range_out = range;
+}
+
+/****************************************************************************************
+* Function name - local_ports_interface_setup
+*
+* Description - Sets to a CURL handle the source IP-address of the client as the
+*               interface, and the local ports range of the client, when
+*               LOCAL_PORT_MIN is configured.
+*
+* Input -       *cctx   - pointer to the client context
+*               *handle - the CURL handle of the client
+* Return Code/Output - On Success - 0, on Error -1
+****************************************************************************************/
+static int local_ports_interface_setup (client_context* cctx, CURL* handle)
+{
+        batch_context* bctx = cctx->bctx;
+        char ip_str[INET6_ADDRSTRLEN];
+        long port, range;
+
+        if (!client_ip_str (bctx, cctx->client_index, ip_str, sizeof (ip_str)))
         {
-                fprintf (stderr,
-                         "%s - error: setup_curl_handle_appl () failed .\n",
-                         __func__);
+                fprintf (stderr, "%s - error: no IP-address for client %s.\n",
+                         __func__, client_name (cctx));
                 return -1;
         }
 
+        /* libcurl keeps a copy of the string */
+        curl_easy_setopt (handle, CURLOPT_INTERFACE, ip_str);
+
+        if (bctx->local_port_min)
+        {
+                local_ports_range (cctx, &port, &range);
+
+                curl_easy_setopt (handle, CURLOPT_LOCALPORT, port);
+                curl_easy_setopt (handle, CURLOPT_LOCALPORTRANGE, range);
+        }
+
         return 0;
 }
 
@@ -817,14 +1473,17 @@ int setup_curl_handle_appl (client_context*const cctx, url_context* url)
 
                 if (url->req_type == HTTP_REQ_TYPE_POST)
                 {
+                        client_forms* cf = client_forms_get (cctx);
+                        char* post_data = cf ? cf->post_data : NULL;
+
                         /*
                            Make POST, using post buffer, if requested.
                          */
-                        if (url->upload_file && url->upload_file_ptr && (!cctx->post_data || !cctx->post_data[0]))
+                        if (url->upload_file && url->upload_file_ptr && (!post_data || !post_data[0]))
                         {
                                 curl_easy_setopt(handle, CURLOPT_POST, 1);
                         }
-                        else if (cctx->post_data || url->mpart_form_post)
+                        else if (post_data || url->mpart_form_post)
                         {
                                 /*
                                    Sets POST as the HTTP request method using either:
@@ -933,9 +1592,13 @@ int setup_curl_handle_appl (client_context*const cctx, url_context* url)
 
                 if (url->ftp_active)
                 {
+                        /* libcurl copies the string */
+                        char ip_str[INET6_ADDRSTRLEN];
+
                         curl_easy_setopt(handle,
                                          CURLOPT_FTPPORT,
-                                         bctx->ip_addr_array [cctx->client_index]);
+                                         client_ip_str (bctx, cctx->client_index,
+                                                        ip_str, sizeof (ip_str)));
                 }
 
                 /*
@@ -957,7 +1620,8 @@ int setup_curl_handle_appl (client_context*const cctx, url_context* url)
  * Description - Opens a logfile for responses to be used for a certain client
  *               and a certain url. A separate file to be opened for headers
  *               and bodies. Sets the files to the logging mechanism of
- *               libcurl.
+ *               libcurl. With the segmented store of the batch, collects the
+ *               response for the store instead.
  *
  * Input -       *cctx - pointer to client context
  *               *url  - pointer to url context
@@ -966,6 +1630,17 @@ int setup_curl_handle_appl (client_context*const cctx, url_context* url)
 int response_logfiles_set (client_context* cctx, url_context* url)
 {
         CURL* handle = cctx->handle;
+        client_resp_logs* logs = client_resp_logs_get (cctx);
+
+        if (!logs)
+        {
+                return 0;
+        }
+
+        if (cctx->bctx->rstore)
+        {
+                return rstore_response_begin (cctx, url);
+        }
 
         if (url->log_resp_bodies && url->dir_log)
         {
@@ -980,20 +1655,20 @@ int response_logfiles_set (client_context* cctx, url_context* url)
                           cctx->cycle_num
                           );
 
-                if (cctx->logfile_bodies)
+                if (logs->logfile_bodies)
                 {
-                        fclose (cctx->logfile_bodies);
-                        cctx->logfile_bodies = NULL;
+                        fclose (logs->logfile_bodies);
+                        logs->logfile_bodies = NULL;
                 }
 
-                if (!(cctx->logfile_bodies = fopen (body_file, "w")))
+                if (!(logs->logfile_bodies = fopen (body_file, "w")))
                 {
                         fprintf (stderr, "%s - error: fopen () failed with errno %d.\n",
                                  __func__, errno);
                         return -1;
                 }
 
-                curl_easy_setopt (handle, CURLOPT_WRITEDATA, cctx->logfile_bodies);
+                curl_easy_setopt (handle, CURLOPT_WRITEDATA, logs->logfile_bodies);
                 curl_easy_setopt (handle, CURLOPT_WRITEFUNCTION, writefunction);
         }
 
@@ -1010,20 +1685,20 @@ int response_logfiles_set (client_context* cctx, url_context* url)
                           cctx->cycle_num
                           );
 
-                if (cctx->logfile_headers)
+                if (logs->logfile_headers)
                 {
-                        fclose (cctx->logfile_headers);
-                        cctx->logfile_headers = NULL;
+                        fclose (logs->logfile_headers);
+                        logs->logfile_headers = NULL;
                 }
 
-                if (!(cctx->logfile_headers = fopen (hdr_file, "w")))
+                if (!(logs->logfile_headers = fopen (hdr_file, "w")))
                 {
                         fprintf (stderr, "%s - error: fopen () failed with errno %d.\n",
                                  __func__, errno);
                         return -1;
                 }
 
-                curl_easy_setopt (handle, CURLOPT_WRITEHEADER, cctx->logfile_headers);
+                curl_easy_setopt (handle, CURLOPT_WRITEHEADER, logs->logfile_headers);
                 curl_easy_setopt (handle, CURLOPT_HEADERFUNCTION, writefunction);
         }
 
@@ -1041,19 +1716,21 @@ int response_logfiles_set (client_context* cctx, url_context* url)
  ***********************************************************************/
 int init_client_url_post_data (client_context* cctx, url_context* url)
 {
-        if (url->form_str)
+        client_forms* cf = client_forms_get (cctx);
+
+        if (url->form_str && cf && cf->post_data)
         {
                 if (init_client_formed_buffer (cctx,
                                                url,
-                                               cctx->post_data,
-                                               cctx->post_data_len) == -1)
+                                               cf->post_data,
+                                               cf->post_data_len) == -1)
                 {
                         fprintf (stderr, "%s - error: init_client_formed_buffers() failed.\n",
                                  __func__);
                         return -1;
                 }
 
-                curl_easy_setopt (cctx->handle, CURLOPT_POSTFIELDS, cctx->post_data);
+                curl_easy_setopt (cctx->handle, CURLOPT_POSTFIELDS, cf->post_data);
         }
         else if (url->mpart_form_post)
         {
@@ -1204,17 +1881,25 @@ static int init_client_formed_buffer (client_context* cctx,
 
 #define write_log(ind, data) \
         if (1) { \
-                char *end = data+strlen(data)-1; \
-                if (*end == '\n') \
-                        *end = '\0'; \
-                (void)fprintf(cctx->file_output,"%ld %ld %ld %s%s %s", \
-                              offs_resp, cctx->cycle_num, cctx->url_curr_index, cctx->client_name, \
-                              ind, data); \
-                if (url_print) \
-                        (void)fprintf(cctx->file_output," eff-url: url %s",url); \
-                if (url_diff) \
-                        (void)fprintf(cctx->file_output," url: url %s",url_target); \
-                (void)fprintf(cctx->file_output,"\n"); \
+                if (cctx->bctx->tlog) { \
+                        tlog_line (cctx, offs_resp, ind, data, url_print ? url : NULL, \
+                                   url_diff ? url_target : NULL); \
+                } else if (cctx->bctx->alog) { \
+                        alog_line (cctx, offs_resp, ind, data, url_print ? url : NULL, \
+                                   url_diff ? url_target : NULL); \
+                } else { \
+                        char *end = data+strlen(data)-1; \
+                        if (*end == '\n') \
+                                *end = '\0'; \
+                        (void)fprintf(cctx->file_output,"%ld %ld %ld %s%s %s", \
+                                      offs_resp, cctx->cycle_num, cctx->url_curr_index, client_name (cctx), \
+                                      ind, data); \
+                        if (url_print) \
+                                (void)fprintf(cctx->file_output," eff-url: url %s",url); \
+                        if (url_diff) \
+                                (void)fprintf(cctx->file_output," url: url %s",url_target); \
+                        (void)fprintf(cctx->file_output,"\n"); \
+                } \
         }
 
 #define write_log_num(ind, num) \
@@ -1257,6 +1942,9 @@ static int client_tracing_function (CURL *handle,
         char*url_target = NULL, *url_effective = NULL;
         url_context* url_ctx = &cctx->bctx->url_ctx_array[cctx->url_curr_index];
 
+        /* Traces, kept for tail-based logging, are at least of -v level */
+        const int verbose = (cctx->bctx->tlog && !verbose_logging) ? 1 : verbose_logging;
+
 #if 0 /* GF moved to end of function */
         if (detailed_logging)
         {
@@ -1302,8 +1990,8 @@ static int client_tracing_function (CURL *handle,
         switch (type)
         {
         case CURLINFO_TEXT:
-                if (verbose_logging)
-                        if (verbose_logging > 1 || startswith(data,"About") ||
+                if (verbose)
+                        if (verbose > 1 || startswith(data,"About") ||
                             startswith(data,"Closing"))
                                 write_log("==",(char *)data);
                 break;
@@ -1318,7 +2006,7 @@ static int client_tracing_function (CURL *handle,
                 break;
 
         case CURLINFO_HEADER_OUT:
-                if (verbose_logging > 1)
+                if (verbose > 1)
                         write_log("=>","Send header");
 
                 stat_data_out_add (cctx, (unsigned long) size);
@@ -1328,12 +2016,15 @@ static int client_tracing_function (CURL *handle,
                         /* First header of the HTTP-request. */
                         first_hdr_req_inc (cctx);
                         stat_req_inc (cctx); /* Increment number of requests */
+
+                        cctx->req_queue_msec = time_resp > cctx->req_sent_timestamp ?
+                                time_resp - cctx->req_sent_timestamp : 0;
                 }
                 first_hdrs_clear_non_req (cctx);
                 break;
 
         case CURLINFO_DATA_OUT:
-                if (verbose_logging > 1)
+                if (verbose > 1)
                         write_log("=>","Send data");
 
                 stat_data_out_add (cctx, (unsigned long) size);
@@ -1341,7 +2032,7 @@ static int client_tracing_function (CURL *handle,
                 break;
 
         case CURLINFO_SSL_DATA_OUT:
-                if (verbose_logging > 1)
+                if (verbose > 1)
                         write_log("=>","Send ssl data");
 
                 stat_data_out_add (cctx, (unsigned long) size);
@@ -1360,7 +2051,7 @@ static int client_tracing_function (CURL *handle,
 
                         curl_easy_getinfo (handle, CURLINFO_RESPONSE_CODE, &response_status);
 
-                        if (verbose_logging > 1)
+                        if (verbose > 1)
                                 write_log_num("<= Recv header:",response_status);
 
                         response_module = response_status / (long)100;
@@ -1452,7 +2143,7 @@ static int client_tracing_function (CURL *handle,
                 if (url_ctx->resp_status_errors_tbl)
                 {
                         if (response_status < 0 ||
-                            response_status > URL_RESPONSE_STATUS_ERRORS_TABLE_SIZE ||
+                            response_status >= URL_RESPONSE_STATUS_ERRORS_TABLE_SIZE ||
                             url_ctx->resp_status_errors_tbl[response_status])
                         {
                                 cctx->client_state = CSTATE_ERROR;
@@ -1474,11 +2165,20 @@ static int client_tracing_function (CURL *handle,
                 break;
 
         case CURLINFO_DATA_IN:
-                if (verbose_logging > 1)
+                if (verbose > 1 && cctx->bctx->tlog)
+                {
+                        write_log("<=","Recv data");
+                }
+                else if (verbose > 1 && cctx->bctx->alog)
+                        alog_printf (cctx, "%ld %ld %ld %s<= Recv data: eff-url: %s, url: %s\n",
+                                     offs_resp, cctx->cycle_num, cctx->url_curr_index,
+                                     client_name (cctx),
+                                     url_print ? url : "", url_diff ? url_target : "");
+                else if (verbose > 1)
                         (void)fprintf(cctx->file_output,
                                       "%ld %ld %ld %s<= Recv data: eff-url: %s, url: %s\n",
                                       offs_resp, cctx->cycle_num, cctx->url_curr_index,
-                                      cctx->client_name,
+                                      client_name (cctx),
                                       url_print ? url : "", url_diff ? url_target : "");
 
                 stat_data_in_add (cctx,  (unsigned long) size);
@@ -1486,7 +2186,7 @@ static int client_tracing_function (CURL *handle,
                 break;
 
         case CURLINFO_SSL_DATA_IN:
-                if (verbose_logging > 1)
+                if (verbose > 1)
                         write_log("<=","Recv ssl data");
 
                 stat_data_in_add (cctx,  (unsigned long) size);
@@ -1501,15 +2201,39 @@ static int client_tracing_function (CURL *handle,
            GF
            Show the data after the header label
          */
-        if (detailed_logging)
+        if (cctx->bctx->tlog &&
+            (type == CURLINFO_HEADER_IN || type == CURLINFO_HEADER_OUT))
+        {
+                /* Headers are kept with the trace of the request as is */
+                tlog_text (cctx, (const char *) data, size);
+        }
+        else if (detailed_logging && cctx->bctx->tlog)
+        {
+                const size_t nbytes = (size <= CURL_ERROR_SIZE) ? size : CURL_ERROR_SIZE;
+
+                tlog_text (cctx, (const char *) data, nbytes);
+                tlog_text (cctx, nbytes < size ? "...\n\n" : "\n\n", nbytes < size ? 5 : 2);
+        }
+        else if (detailed_logging)
         {
                 char detailed_buff[CURL_ERROR_SIZE +1]; size_t nbytes;
 
                 nbytes = (size <= CURL_ERROR_SIZE) ? size : CURL_ERROR_SIZE;
-                memcpy (detailed_buff, data, nbytes);
+                if (!cctx->bctx->alog)
+                        memcpy (detailed_buff, data, nbytes);
 
-                detailed_buff[nbytes] = '\0';
-                fprintf(cctx->file_output, "%s%s\n\n", detailed_buff, nbytes < size ? "..." : "");
+                if (cctx->bctx->alog)
+                {
+                        alog_text (cctx, (const char *) data, nbytes);
+                        alog_text (cctx, nbytes < size ? "...\n\n" : "\n\n",
+                                   nbytes < size ? 5 : 2);
+                }
+                else
+                {
+                        detailed_buff[nbytes] = '\0';
+                        fprintf(cctx->file_output, "%s%s\n\n", detailed_buff,
+                                nbytes < size ? "..." : "");
+                }
         }
 
         // fflush (cctx->file_output); // Don't do it
@@ -1539,22 +2263,8 @@ static int init_client_contexts (batch_context* bctx,
         {
                 client_context* cctx = &bctx->cctx_array[i];
 
-                /*
-                   Build client name for logging, based on sequence number and
-                   ip-address for each simulated client.
-                 */
                 cctx->cycle_num = 0;
 
-                if (verbose_logging > 1)
-                        snprintf(cctx->client_name, sizeof(cctx->client_name) - 1,
-                                 "%d (%s) ",
-                                 i + 1,
-                                 bctx->ip_addr_array[i]);
-                else
-                        /* Shorten client name for low logging */
-                        snprintf(cctx->client_name, sizeof(cctx->client_name) - 1,
-                                 "%d ",i+1);
-
                 /* Mark timer-ids as non-valid. */
                 cctx->tid_sleeping = cctx->tid_url_completion = -1;
 
@@ -1587,7 +2297,7 @@ static int init_client_contexts (batch_context* bctx,
 ****************************************************************************************/
 static void free_batch_data_allocations (batch_context* bctx)
 {
-        int i;
+        int i, j;
 
         if (!bctx)
         {
@@ -1606,40 +2316,119 @@ static void free_batch_data_allocations (batch_context* bctx)
                 {
                         client_context* cctx = &bctx->cctx_array[i];
 
-                        if (cctx->handle)
+                        if (cctx->url_handles)
+                        {
+                                for (j = 0; j < bctx->urls_num; j++)
+                                {
+                                        if (cctx->url_handles[j])
+                                        {
+                                                curl_easy_cleanup (cctx->url_handles[j]);
+                                        }
+                                }
+
+                                free (cctx->url_handles);
+                                cctx->url_handles = NULL;
+                                cctx->handle = NULL;
+                        }
+                        else if (cctx->handle)
                         {
                                 curl_easy_cleanup (cctx->handle);
                                 cctx->handle = NULL;
                         }
 
+                        /* The share is released after its handles */
+                        if (cctx->cookie_share)
+                        {
+                                curl_share_cleanup (cctx->cookie_share);
+                                cctx->cookie_share = NULL;
+                        }
+                } /* from for */
+
+                free(bctx->cctx_array);
+                bctx->cctx_array = NULL;
+        }
+
+        if (bctx->handle_pool)
+        {
+                for (i = 0; i < bctx->handle_pool_num; i++)
+                {
+                        curl_easy_cleanup (bctx->handle_pool[i]);
+                }
+
+                free (bctx->handle_pool);
+                bctx->handle_pool = NULL;
+                bctx->handle_pool_num = 0;
+        }
+
+        if (bctx->url_templates)
+        {
+                for (i = 0; i < bctx->urls_num; i++)
+                {
+                        if (bctx->url_templates[i])
+                        {
+                                curl_easy_cleanup (bctx->url_templates[i]);
+                        }
+                }
+
+                free (bctx->url_templates);
+                bctx->url_templates = NULL;
+        }
+
+        /* The shares are released after all their handles */
+        share_close (bctx);
+
+        /*
+           Free side tables of the clients
+         */
+        if (bctx->cforms)
+        {
+                for (i = 0; i < bctx->client_num_max; i++)
+                {
                         /* Free client POST-buffers */
-                        if (cctx->post_data)
+                        if (bctx->cforms[i].post_data)
                         {
-                                free (cctx->post_data);
-                                cctx->post_data = NULL;
+                                free (bctx->cforms[i].post_data);
                         }
 
-                        if (cctx->logfile_headers)
+                        if (bctx->cforms[i].get_url_form_data)
                         {
-                                fclose (cctx->logfile_headers);
-                                cctx->logfile_headers= NULL;
+                                free (bctx->cforms[i].get_url_form_data);
                         }
+                }
+
+                free (bctx->cforms);
+                bctx->cforms = NULL;
+        }
 
-                        if (cctx->logfile_bodies)
+        if (bctx->cresp_logs)
+        {
+                for (i = 0; i < bctx->client_num_max; i++)
+                {
+                        if (bctx->cresp_logs[i].logfile_headers)
                         {
-                                fclose (cctx->logfile_bodies);
-                                cctx->logfile_bodies = NULL;
+                                fclose (bctx->cresp_logs[i].logfile_headers);
                         }
 
-                        if (cctx->url_fetch_decision)
+                        if (bctx->cresp_logs[i].logfile_bodies)
                         {
-                                free (cctx->url_fetch_decision);
-                                cctx->url_fetch_decision = NULL;
+                                fclose (bctx->cresp_logs[i].logfile_bodies);
                         }
-                } /* from for */
+                }
 
-                free(bctx->cctx_array);
-                bctx->cctx_array = NULL;
+                free (bctx->cresp_logs);
+                bctx->cresp_logs = NULL;
+        }
+
+        if (bctx->cstats)
+        {
+                free (bctx->cstats);
+                bctx->cstats = NULL;
+        }
+
+        if (bctx->fetch_decisions)
+        {
+                free (bctx->fetch_decisions);
+                bctx->fetch_decisions = NULL;
         }
 
         /*
@@ -1755,6 +2544,12 @@ static void free_url (url_context* url, int clients_max)
                 free (url->resp_status_errors_tbl);
                 url->resp_status_errors_tbl = 0;
         }
+
+        if (url->tls_ciphers)
+        {
+                free (url->tls_ciphers);
+                url->tls_ciphers = 0;
+        }
 }
 
 /*****************************************************************************
@@ -1767,25 +2562,38 @@ static void free_url (url_context* url, int clients_max)
  *******************************************************************************/
 static int create_ip_addrs (batch_context* bctx_array, int bctx_num)
 {
-        int batch_index, client_index; /* Batch and client indexes */
-        char*** ip_addresses =0;
+        int batch_index, addr_index; /* Batch and address indexes */
+        char ip_str[INET6_ADDRSTRLEN];
 
-        /*
-           Add secondary IP-addresses to the "loading" network interface.
-         */
-        if (!(ip_addresses = (char***)calloc (bctx_num, sizeof (char**))))
+        if (loading_mode == LOAD_MODE_DRY_RUN)
         {
-                fprintf (stderr, "%s - error: failed to allocate ip_addresses.\n", __func__);
-                return -1;
+                return 0;
         }
 
         for (batch_index = 0; batch_index < bctx_num; batch_index++)
         {
+                batch_context* bctx = &bctx_array[batch_index];
+                char** ip_addresses = 0;
+                int addr_num = bctx->client_num_max;
+                int rval = 0;
+
+                /* Shared addresses are added once */
+                if (bctx->ip_shared_num && bctx->ip_shared_num < addr_num)
+                {
+                        addr_num = bctx->ip_shared_num;
+                }
+
+                /* Pipelining clients share the minimal address */
+                if (bctx->pipelining)
+                {
+                        addr_num = 1;
+                }
+
                 /*
-                   Allocate the array of IP-addresses
+                   Render text presentations of the distinct addresses only for
+                   the netlink call. Clients compute their binary addresses on the fly.
                  */
-                if (!(ip_addresses[batch_index] = (char**)calloc (bctx_array[batch_index].client_num_max,
-                                                                  sizeof (char *))))
+                if (!(ip_addresses = (char**)calloc (addr_num, sizeof (char *))))
                 {
                         fprintf (stderr,
                                  "%s - error: failed to allocate array of ip-addresses for batch %d.\n",
@@ -1793,27 +2601,16 @@ static int create_ip_addrs (batch_context* bctx_array, int bctx_num)
                         return -1;
                 }
 
-                batch_context* bctx = &bctx_array[batch_index];
-
-                /*
-                   Set them to the batch contexts to remember them.
-                 */
-                bctx->ip_addr_array = ip_addresses[batch_index];
-
-                /*
-                   Allocate for each client a buffer and snprintf to it the IP-address string.
-                 */
-                for (client_index = 0; client_index < bctx->client_num_max; client_index++)
+                for (addr_index = 0; addr_index < addr_num; addr_index++)
                 {
-                        if (ip_addr_str_allocate_init (bctx,
-                                                       client_index,
-                                                       &ip_addresses[batch_index][client_index]) == -1)
+                        if (!client_ip_str (bctx, addr_index, ip_str, sizeof (ip_str)) ||
+                            !(ip_addresses[addr_index] = strdup (ip_str)))
                         {
-
                                 fprintf (stderr,
-                                         "%s - error: ip_addr_str_allocate_init () - failed, batch [%d], client [%d]\n",
-                                         __func__, batch_index, client_index);
-                                return -1;
+                                         "%s - error: failed to print ip-address, batch [%d], client [%d]\n",
+                                         __func__, batch_index, addr_index);
+                                rval = -1;
+                                break;
                         }
                 }
 
@@ -1821,128 +2618,31 @@ static int create_ip_addrs (batch_context* bctx_array, int bctx_num)
                    Add all the addresses to the network interface as the secondary
                    ip-addresses, using netlink userland-kernel interface.
                  */
-                if (add_secondary_ip_addrs (bctx->net_interface,
-                                            bctx->client_num_max,
-                                            (const char** const) ip_addresses[batch_index],
+                if (rval == 0 &&
+                    add_secondary_ip_addrs (bctx->net_interface,
+                                            addr_num,
+                                            (const char** const) ip_addresses,
                                             bctx->cidr_netmask,
                                             bctx->scope) == -1)
                 {
                         fprintf (stderr,
                                  "%s - error: add_secondary_ip_addrs() - failed for batch = %d\n",
                                  __func__, batch_index);
-                        return -1;
-                }
-        }
-
-        return 0;
-}
-
-/*****************************************************************************
- * Function name - ip_addr_str_allocate_init
- *
- * Description - Allocates a single string and inits it by printing a text presentation
- *               of an IP-address (either IPv4 or IPv6).
- *
- * Input -       *bctx        - pointer to a batch context
- *               client_index - number of client in the client-array
- * Input/Output **addr_str - second pointer a string for IP-address, allocated by the
- *                           function.
- * Return Code/Output - None
- *******************************************************************************/
-static int ip_addr_str_allocate_init (batch_context* bctx,
-                                      int client_index,
-                                      char** addr_str)
-{
-        struct in_addr in_address;
-        char ipv6_string[INET6_ADDRSTRLEN+1];
-        char* ipv4_string = 0;
-        char* ipaddrstr = 0;
-
-        *addr_str = NULL;
-
-        if (!(ipaddrstr = (char *)calloc (bctx->ipv6 ? INET6_ADDRSTRLEN + 1 :
-                                          INET_ADDRSTRLEN + 1, sizeof (char))))
-        {
-                fprintf (stderr, "%s - allocation of ipaddrstr failed for client %d.\n",
-                         __func__, client_index);
-                return -1;
-        }
-
-        if (bctx->ipv6 == 0)
-        {
-                /*
-                   When clients are not using common IP, advance the
-                   IPv4-address, using client index as the offset.
-                 */
-                in_address.s_addr = htonl (bctx->ip_addr_min +
-                                           (bctx->ip_shared_num ? next_ipv4_shared_index(bctx) :  (size_t) client_index));
-
-                if (!(ipv4_string = inet_ntoa (in_address)))
-                {
-                        fprintf (stderr, "%s - inet_ntoa() failed for ip_addresses of client [%d]\n",
-                                 __func__, client_index);
-                        return -1;
+                        rval = -1;
                 }
-        }
-        else
-        {
-                ///------------------------------------------------ IPv6 -----------------------------------------------------------------///
 
-                /*
-                   Non-shared IPv6. Advance the IPv6-address by incrementing previous address.
-                 */
-                if (!bctx->ip_shared_num)
-                {
-                        if (client_index == 0)
-                        {
-                                memcpy (&bctx->in6_prev, &bctx->ipv6_addr_min, sizeof (bctx->in6_prev));
-                                memcpy (&bctx->in6_new, &bctx->ipv6_addr_min, sizeof (bctx->in6_new));
-                        }
-                        else
-                        {
-                                if (ipv6_increment (&bctx->in6_prev, &bctx->in6_new) == -1)
-                                {
-                                        fprintf (stderr, "%s - ipv6_increment() failed for ip_address of client [%d]\n",
-                                                 __func__, client_index);
-                                        return -1;
-                                }
-                        }
-                        memcpy (&bctx->in6_prev, &bctx->in6_new, sizeof (bctx->in6_prev));
-                }
-                else
+                for (addr_index = 0; addr_index < addr_num; addr_index++)
                 {
-                        /* Shared IP-addresses */
-                        memcpy (&bctx->in6_prev, &bctx->ipv6_addr_min, sizeof (bctx->in6_prev));
-                        memcpy (&bctx->in6_new, &bctx->ipv6_addr_min, sizeof (bctx->in6_new));
-
-                        size_t index_step = next_ipv6_shared_index (bctx);
-
-                        size_t k;
-                        for (k = 0; k < index_step; k++)
-                        {
-                                if (ipv6_increment (&bctx->in6_prev, &bctx->in6_new) == -1)
-                                {
-                                        fprintf (stderr, "%s - ipv6_increment() failed \n", __func__);
-                                        return -1;
-                                }
-                                memcpy (&bctx->in6_prev, &bctx->in6_new, sizeof (bctx->in6_prev));
-                        }
+                        free (ip_addresses[addr_index]);
                 }
+                free (ip_addresses);
 
-                /* All IPv6 addresses */
-                if (!inet_ntop (AF_INET6, &bctx->in6_new, ipv6_string, sizeof (ipv6_string)))
+                if (rval == -1)
                 {
-                        fprintf (stderr, "%s - inet_ntoa() failed for ip_addresses of client [%d]\n",
-                                 __func__, client_index);
                         return -1;
                 }
         }
 
-        snprintf (ipaddrstr, bctx->ipv6 ? INET6_ADDRSTRLEN : INET_ADDRSTRLEN,
-                  "%s", bctx->ipv6 ? ipv6_string : ipv4_string);
-
-        *addr_str = ipaddrstr;
-
         return 0;
 }
 
@@ -1961,7 +2661,8 @@ int rewind_logfile_above_maxsize (FILE* filepointer)
         if (!filepointer)
                 return -1;
 
-        if (filepointer == stderr)
+        /* Neither stderr, nor a compressed logfile can be rewound */
+        if (filepointer == stderr || zout_file (filepointer))
                 return 0;
 
         if ((position = ftell (filepointer)) == -1)
@@ -2198,41 +2899,31 @@ static int create_thr_subbatches (batch_context *bc_arr, int subbatches_num)
 
                 bc_arr[i].cycling_completed = master.cycling_completed;
 
-                /* Zero the pointer to be initialized. */
-                bc_arr[i].multiple_handle = 0;
+                bc_arr[i].dump_clients = master.dump_clients;
 
-                /*
-                   Allocate the array of IP-addresses.
-                   TODO: memory leak of ip-addresses with the batch bc_arr[0]
-                 */
+                bc_arr[i].log_resp_segments = master.log_resp_segments;
 
-                bc_arr[i].ip_addr_array = 0;
+                bc_arr[i].use_handle_templates = master.use_handle_templates;
 
-                if (!(bc_arr[i].ip_addr_array = (char**)calloc (bc_arr[i].client_num_max,
-                                                                sizeof (char *))))
-                {
-                        fprintf (stderr,
-                                 "%s - error: failed to allocate array of ip-addresses for batch %d.\n",
-                                 __func__, i);
-                        return -1;
-                }
-                else
-                {
-                        int j;
+                bc_arr[i].share_scope = master.share_scope;
 
-                        for (j = 0; j < bc_arr[i].client_num_max; j++)
-                        {
-                                if (ip_addr_str_allocate_init (&bc_arr[i], j,
-                                                               &bc_arr[i].ip_addr_array[j]) == -1)
-                                {
-                                        fprintf (stderr,
-                                                 "%s - error: ip_addr_str_allocate_init () - failed, "
-                                                 "batch [%d], client [%d]\n",
-                                                 __func__, i, j);
-                                        return -1;
-                                }
-                        }
-                }
+                bc_arr[i].sock_linger_rst = master.sock_linger_rst;
+                bc_arr[i].sock_nodelay = master.sock_nodelay;
+                bc_arr[i].sock_sndbuf = master.sock_sndbuf;
+                bc_arr[i].sock_rcvbuf = master.sock_rcvbuf;
+                bc_arr[i].sock_bind_no_port = master.sock_bind_no_port;
+                bc_arr[i].local_port_min = master.local_port_min;
+                bc_arr[i].local_port_max = master.local_port_max;
+                bc_arr[i].local_port_partition = master.local_port_partition;
+                bc_arr[i].dns_mode = master.dns_mode;
+                bc_arr[i].dns_refresh_interval = master.dns_refresh_interval;
+                bc_arr[i].engine = master.engine;
+                bc_arr[i].pipelining = master.pipelining;
+                bc_arr[i].max_host_connections = master.max_host_connections;
+                bc_arr[i].max_pipeline_length = master.max_pipeline_length;
+
+                /* Zero the pointer to be initialized. */
+                bc_arr[i].multiple_handle = 0;
 
                 if (i)
                 {
@@ -2319,87 +3010,3 @@ static int create_thr_subbatches (batch_context *bc_arr, int subbatches_num)
 
         return 0;
 }
-
-static void url_formatter (char *buffer, size_t maxlen, const char *format, const form_records_cdata*const fcd) {
-        char ch;
-        long value;
-        char *strvalue;
-        int min;
-        int max;
-        int cnt;
-        int state;
-        size_t currlen;
-
-        state = URL_S_DEFAULT;
-        currlen = min = cnt = 0;
-        max = maxlen;
-        ch = *format++;
-
-        while (state != URL_S_DONE)
-        {
-                if ((ch == '\0') || (currlen >= maxlen))
-                        state = URL_S_DONE;
-
-                switch(state)
-                {
-                case URL_S_DEFAULT:
-                        if (ch == '{')
-                                state = URL_S_OPEN;
-                        else
-                                url_formatter_append (buffer, &currlen, maxlen, ch);
-                        ch = *format++;
-                        break;
-                case URL_S_OPEN:
-                        if (isdigit(ch))
-                        {
-                                min = 10*min + char_to_int (ch);
-                                ch = *format++;
-                        }
-                        else if (ch == '}')
-                        {
-                                state = URL_S_CLOSE;
-                        }
-                        else
-                        {
-                                min = 0;
-                                state = URL_S_DEFAULT;
-                        }
-
-                        break;
-
-                case URL_S_CLOSE:
-                        fprintf (stderr, "\"%s\" - Convert the variable: %d \n",
-                                 __func__, min);
-
-                        strvalue = fcd->form_tokens[min] ? fcd->form_tokens[min] : "";
-
-                        fprintf (stderr, "\"%s\" - Variable value: %s \n",
-                                 __func__, strvalue);
-
-                        while (*strvalue)
-                        {
-                                url_formatter_append (buffer, &currlen, maxlen, *strvalue++);
-                        }
-
-                        ch = *format++;
-                        state = URL_S_DEFAULT;
-                        min = cnt = 0;
-                        break;
-                case URL_S_DONE:
-                        break;
-                default:
-                        // hmm?
-                        break; // some picky compilers need this
-                }
-        }
-        if (currlen < maxlen - 1)
-                buffer[currlen] = '\0';
-        else
-                buffer[maxlen - 1] = '\0';
-}
-
-static void url_formatter_append (char *buffer, size_t *currlen, size_t maxlen, char c)
-{
-        if (*currlen < maxlen)
-                buffer[(*currlen)++] = c;
-}
@@ -75,6 +75,58 @@ int setup_curl_handle (struct client_context*const cctx, struct url_context* url
 */
 int setup_curl_handle_init (struct client_context*const cctx, struct url_context* url_ctx);
 
+/***************************************************************************
+* Function name - client_handle_acquire
+*
+* Description - Provides a client without a CURL handle with a handle from the
+*               free pool of the batch or with a newly allocated one.
+*
+* Input -       *cctx - pointer to client context
+* Return Code/Output - On Success - 0, on Error -1
+****************************************************************************/
+int client_handle_acquire (struct client_context* cctx);
+
+/***************************************************************************
+* Function name - client_handle_release
+*
+* Description - Takes the CURL handle from a finished or failed client, already
+*               removed from the multi-handle, and keeps it reset in the free
+*               pool of the batch for reuse by other clients.
+*
+* Input -       *cctx - pointer to client context
+* Return Code/Output - None
+****************************************************************************/
+void client_handle_release (struct client_context* cctx);
+
+/****************************************************************************************
+* Function name - sockopt_function
+*
+* Description - CURLOPT_SOCKOPTFUNCTION callback, applying socket tuning of the batch
+*               to a new socket before it is connected. Used also by the fast engine.
+*
+* Input -       *clientp - pointer to the batch context
+*               fd       - the socket
+*               purpose  - purpose of the socket
+* Return Code/Output - 0 - success, errors are logged and ignored
+****************************************************************************************/
+int sockopt_function (void* clientp, curl_socket_t fd, curlsocktype purpose);
+
+/****************************************************************************************
+* Function name - opensocket_function
+*
+* Description - Opens a socket of the fast engine, bound to the source IP-address
+*               and the local ports of the client. CURL handles are bound by libcurl
+*               to the same address and ports.
+*
+* Input -       *clientp - pointer to the client context
+*               purpose  - purpose of the socket
+*               *address - address family, socket type, protocol and the peer address
+* Return Code/Output - On Success - the socket, on Error - CURL_SOCKET_BAD
+****************************************************************************************/
+curl_socket_t opensocket_function (void* clientp,
+                                   curlsocktype purpose,
+                                   struct curl_sockaddr* address);
+
 
 /**********************************************************************
 * Function name - init_client_url_post_data
@@ -93,7 +145,8 @@ int init_client_url_post_data (struct client_context* cctx, struct url_context*
 * Description - Opens a logfile for responses to be used for a certain client
 *               and a certain url. A separate file to be opened for headers
 *               and bodies. Sets the files to the logging mechanism of
-*               libcurl.
+*               libcurl. With the segmented store of the batch, collects the
+*               response for the store instead.
 *
 * Input -       *cctx - pointer to client context
 *               *url  - pointer to url context
@@ -315,6 +368,63 @@ int user_activity_hyper (struct client_context*const cctx_array);
 ****************************************************************************************/
 int user_activity_smooth (struct client_context*const cctx_array);
 
+/*-------------- Dry-run loading function ----------------*/
+
+/****************************************************************************************
+* Function name - user_activity_sim
+*
+* Description - Simulates user-activities without network (DRY-RUN mode): transfers
+*               are replaced by in-process fakes, completed after a sampled latency,
+*               and the loop runs on a virtual clock.
+* Input -       *cctx_array - array of client contexts (related to a certain batch of clients)
+* Return Code/Output - On Success - 0, on Error -1
+****************************************************************************************/
+int user_activity_sim (struct client_context*const cctx_array);
+
+/*-------------- Connection-pool loading function ----------------*/
+
+/****************************************************************************************
+* Function name - user_activity_pool
+*
+* Description - Loads a fixed pool of keep-alive connections with a fixed number of
+*               requests in flight on each one (POOL mode), in steps of the number
+*               of connections, and reports the throughput of each step.
+* Input -       *cctx_array - array of client contexts (related to a certain batch of clients)
+* Return Code/Output - On Success - 0, on Error -1
+****************************************************************************************/
+int user_activity_pool (struct client_context*const cctx_array);
+
+/****************************************************************************************
+* Function name - sim_transfer_start
+*
+* Description - DRY-RUN mode: starts a fake transfer of the client, to be completed
+*               after a sampled latency. Used instead of curl_multi_add_handle ().
+*
+* Input -       *bctx    - pointer to the batch context
+*               *cctx    - pointer to the client context
+*               now_time - current virtual time in msec
+* Return Code/Output - On Success - 0, on Error -1
+****************************************************************************************/
+int sim_transfer_start (struct batch_context* bctx,
+                        struct client_context* cctx,
+                        unsigned long now_time);
+
+/****************************************************************************************
+* Function name - sim_transfer_cancel
+*
+* Description - DRY-RUN mode: cancels fake transfer of the client, if any. Used
+*               instead of curl_multi_remove_handle ().
+*
+* Input -       *cctx - pointer to the client context
+* Return Code/Output - On Success - 0, on Error -1
+****************************************************************************************/
+int sim_transfer_cancel (struct client_context* cctx);
+
+/*
+  Virtual clock of DRY-RUN mode in msec, returned by get_tick_count (), when set.
+*/
+extern unsigned long sim_clock;
+
 
 int update_url_from_set_or_template (CURL* handle, struct client_context* client, struct url_context* url);
 
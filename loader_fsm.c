@@ -33,6 +33,8 @@
 #include "heap.h"
 #include "screen.h"
 #include "cl_alloc.h"
+#include "alog.h"
+#include "fast.h"
 
 /*
    Number of request rate timer invocations per second used to
@@ -247,8 +249,9 @@ int init_timers_and_add_initial_clients_to_load (batch_context* bctx,
                    Schedule fixed request rate timer.
                  */
                 bctx->req_rate_timer_node.next_timer = now_time + 1000;
+                /* Virtual clock of dry run has no timer lateness to compensate */
                 bctx->req_rate_timer_node.period = 1000/req_rate_timer_invs_per_sec -
-                                                   req_rate_timer_fudge;
+                        (loading_mode == LOAD_MODE_DRY_RUN ? 0 : req_rate_timer_fudge);
                 bctx->req_rate_timer_node.func_timer = handle_req_rate_timer;
                 if (tq_schedule_timer (bctx->waiting_queue,
                                        &bctx->req_rate_timer_node) == -1)
@@ -406,27 +409,11 @@ int load_next_step (client_context* cctx,
                 /*
                    GF
                    At this point this client is finished, and there are no more URLs to fetch.
-                   But the client may still be holding a connection open, which may prevent other
-                   clients in the batch from connecting to the server. If we wait until the end-of-batch
-                   general cleanup to close connections, then these other clients may never connect, and
-                   the only way the batch will end is to have all these waiting clients time out. So we
-                   should close out this client's connections here. Setting client->handle = 0 will prevent
-                   curl_easy_cleanup from being called again in the general cleanup.
+                   The handle of the client is reset and returned to the free pool of the
+                   batch for other clients; a client in CSTATE_ERROR, scheduled again,
+                   gets a handle from the pool on its next url setup.
                  */
-                // cleanup of each handle is a hint to multi-handle to
-                // decrease the num of connections to server
-                if (cctx->handle)
-                {
-                        curl_easy_cleanup (cctx->handle);
-                        cctx->handle = 0;
-                }
-
-                if (rval_load == CSTATE_ERROR)
-                {
-                        // Re-init clients in CSTATE_ERROR state to enable their optional
-                        // scheduling
-                        cctx->handle = curl_easy_init ();
-                }
+                client_handle_release (cctx);
 
                 return rval_load;
         }
@@ -650,6 +637,8 @@ dispatch_expired_timers (batch_context* bctx, unsigned long now_time)
 
                 if (time_nearest <= now_time)
                 {
+                        loop_prof_timer_late (&bctx->prof, now_time - time_nearest);
+
                         if (tq_dispatch_nearest_timer (tq, bctx, now_time) == -1)
                         {
                                 // fprintf (stderr, "%s - error: tq_dispatch_nearest_timer () failed "
@@ -689,7 +678,17 @@ static int client_add_to_load (batch_context* bctx,
 
         /* Schedule the client immediately */
         cctx->req_sent_timestamp = now_time;
-        if (curl_multi_add_handle (bctx->multiple_handle, cctx->handle) ==  CURLM_OK)
+
+        /*
+           Dry run replaces the transfer by a fake one, urls compiled by the fast
+           engine are run without libcurl.
+         */
+        const int added = (loading_mode == LOAD_MODE_DRY_RUN) ?
+                (sim_transfer_start (bctx, cctx, now_time) == 0) : cctx->fast ?
+                (fast_transfer_start (bctx, cctx, now_time) == 0) :
+                (curl_multi_add_handle (bctx->multiple_handle, cctx->handle) == CURLM_OK);
+
+        if (added)
         {
                 unsigned long timer_url_completion = 0;
 
@@ -753,7 +752,12 @@ static int client_add_to_load (batch_context* bctx,
  *****************************************************************************/
 static int client_remove_from_load (batch_context* bctx, client_context* cctx)
 {
-        if (curl_multi_remove_handle (bctx->multiple_handle, cctx->handle) == CURLM_OK)
+        const int removed = (loading_mode == LOAD_MODE_DRY_RUN) ?
+                (sim_transfer_cancel (cctx) == 0) : cctx->fast ?
+                (fast_transfer_cancel (cctx) == 0) :
+                (curl_multi_remove_handle (bctx->multiple_handle, cctx->handle) == CURLM_OK);
+
+        if (removed)
         {
                 if (bctx->active_clients_count > 0)
                 {
@@ -822,6 +826,10 @@ static int handle_logfile_rewinding_timer (timer_node* timer_node,
         (void) timer_node;
         (void) ulong_param;
 
+        /* The writer thread of asynchronous logging rewinds the logfile */
+        if (bctx->alog)
+                return 0;
+
         if (rewind_logfile_above_maxsize (bctx->cctx_array->file_output) == -1)
         {
                 fprintf (stderr, "%s - rewind_logfile_above_maxsize() failed .\n",
@@ -971,15 +979,24 @@ static int handle_cctx_url_completion_timer (timer_node* tn,
         // Considering url completion timeout as an error
         // TODO - make it configurable
         stat_url_timeout_err_inc (cctx);
+        stat_request_commit (cctx);
         cctx->client_state = CSTATE_ERROR;
 
         const unsigned long now_time = get_tick_count ();
-        if (verbose_logging)
+        if (verbose_logging && bctx->alog)
+        {
+                alog_printf (cctx,
+                             "%ld %ld %ld %s !! ERUT url completion timeout: url: %s\n",
+                             now_time - bctx->start_time,
+                             cctx->cycle_num, cctx->url_curr_index, client_name (cctx),
+                             bctx->url_ctx_array[cctx->url_curr_index].url_str);
+        }
+        else if (verbose_logging)
         {
                 fprintf (cctx->file_output,
                          "%ld %ld %ld %s !! ERUT url completion timeout: url: %s\n",
                          now_time - bctx->start_time,
-                         cctx->cycle_num, cctx->url_curr_index, cctx->client_name,
+                         cctx->cycle_num, cctx->url_curr_index, client_name (cctx),
                          bctx->url_ctx_array[cctx->url_curr_index].url_str);
         }
 
@@ -1096,6 +1113,12 @@ static int setup_url (client_context* cctx)
         batch_context* bctx = cctx->bctx;
         url_context* url = &bctx->url_ctx_array[cctx->url_curr_index];
 
+        /* Urls compiled by the fast engine need no CURL handle */
+        if (fast_url_setup (cctx, url))
+        {
+                return cctx->client_state = CSTATE_URLS;
+        }
+
         if (!url->url_use_current)
         {
                 /*
@@ -1283,23 +1306,25 @@ static int fetching_decision (client_context* cctx, url_context* url)
                 return 1;
         }
 
-        if (cctx->url_fetch_decision && cctx->url_fetch_decision[cctx->url_curr_index] != -1)
+        char* decisions = client_fetch_decisions (cctx);
+
+        if (decisions && url->fetch_probability_once)
         {
                 // Using FETCH_PROBABILITY_ONCE, which allocates
                 // fetching decision array to cache the decision and to decrease calls to random ()
                 //
-                if (cctx->url_fetch_decision[cctx->url_curr_index] != -1)
+                if (decisions[cctx->url_curr_index] != -1)
                 {
-                        return cctx->url_fetch_decision[cctx->url_curr_index];
+                        return decisions[cctx->url_curr_index];
                 }
 
                 if (get_prob() <= url->fetch_probability)
                 {
-                        return (cctx->url_fetch_decision[cctx->url_curr_index] = 1);
+                        return (decisions[cctx->url_curr_index] = 1);
                 }
                 else
                 {
-                        return (cctx->url_fetch_decision[cctx->url_curr_index] = 0);
+                        return (decisions[cctx->url_curr_index] = 0);
                 }
         }
         else
@@ -1363,7 +1388,8 @@ static int load_urls_state (client_context* cctx,
                            Postpone the call to setup_url (cctx) and make it in the
                            timer handler.
                          */
-                        curl_easy_reset (handle);
+                        if (handle)
+                                curl_easy_reset (handle);
                 }
                 else
                 {
@@ -37,6 +37,10 @@
 #include "conf.h"
 #include "cl_alloc.h"
 #include "screen.h"
+#include "metrics.h"
+#include "redis_pub.h"
+#include "tls_rate.h"
+#include "fast.h"
 
 
 #define TIMER_NEXT_LOAD 20000
@@ -92,6 +96,7 @@ static int on_exit_hyper (batch_context* bctx);
 static void event_cb_hyper (int fd, short kind, void *userp)
 {
         batch_context *bctx = (batch_context *) userp;
+        const unsigned long long start_usec = loop_prof_usec ();
         int st;
         CURLMcode rc;
 
@@ -131,6 +136,8 @@ static void event_cb_hyper (int fd, short kind, void *userp)
                 }
 #endif
         }
+
+        loop_prof_iteration (&bctx->prof, start_usec);
         PRINTF("event_cb_hyper exit\n");
 }
 
@@ -148,6 +155,7 @@ static void timer_cb_hyper (int fd, short kind, void *userp)
         (void)fd;
         (void)kind;
         batch_context *bctx = (batch_context *)userp;
+        const unsigned long long start_usec = loop_prof_usec ();
         CURLMcode rc;
         int st;
 
@@ -164,6 +172,8 @@ static void timer_cb_hyper (int fd, short kind, void *userp)
                 update_timeout_hyper(bctx);
         }
 
+        loop_prof_iteration (&bctx->prof, start_usec);
+
         //PRINTF("timer_cb_hyper exit\n");
 }
 
@@ -385,6 +395,7 @@ static void next_load_cb_hyper (int fd, short kind, void *userp)
         (void)fd;
         (void)kind;
         batch_context *bctx = (batch_context *)userp;
+        const unsigned long long start_usec = loop_prof_usec ();
         int st;
 
         PRINTF("next_load_cb_hyper\n");
@@ -402,6 +413,8 @@ static void next_load_cb_hyper (int fd, short kind, void *userp)
         tv.tv_usec = TIMER_NEXT_LOAD;
 
         event_add (bctx->timer_next_load_event, &tv);
+
+        loop_prof_iteration (&bctx->prof, start_usec);
 }
 
 /****************************************************************************************
@@ -469,6 +482,12 @@ int user_activity_hyper (client_context* cctx_array)
                 return -1;
         }
 
+        if (fast_init (bctx, bctx->eb) == -1)
+        {
+                fprintf (stderr, "%s - error: fast_init () failed.\n", __func__);
+                return -1;
+        }
+
         const unsigned long now_time = get_tick_count ();
 
         if (init_timers_and_add_initial_clients_to_load (bctx,
@@ -497,6 +516,12 @@ int user_activity_hyper (client_context* cctx_array)
 
         if (is_batch_group_leader (bctx))
         {
+                if (metrics_init (bctx, bctx->eb) == -1)
+                {
+                        fprintf (stderr, "%s - error: metrics_init () failed.\n", __func__);
+                        return -1;
+                }
+
                 dump_snapshot_interval (bctx, now_time);
         }
 
@@ -522,6 +547,13 @@ static int on_exit_hyper (batch_context* bctx)
         dump_final_statistics (bctx->cctx_array);
         screen_release ();
 
+        if (is_batch_group_leader (bctx))
+        {
+                metrics_release ();
+        }
+
+        fast_release (bctx);
+
         /*
            ======= Release resources =========================
          */
@@ -585,6 +617,7 @@ static int mperform_hyper (batch_context* bctx, int* still_running)
         unsigned long now_time;
         CURLMsg *msg;
         int scheduled_now_count = 0, scheduled_now = 0;
+        unsigned long msgs_drained = 0;
 
         (void)still_running;
 
@@ -608,11 +641,11 @@ static int mperform_hyper (batch_context* bctx, int* still_running)
         {
                 if (msg->msg == CURLMSG_DONE)
                 {
-                        /* TODO: CURLMsg returns 'result' field as curl return code. We may wish to use it. */
-
                         CURL *handle = msg->easy_handle;
                         client_context *cctx = NULL;
 
+                        msgs_drained++;
+
                         curl_easy_getinfo (handle, CURLINFO_PRIVATE, &cctx);
 
                         if (!cctx)
@@ -623,11 +656,34 @@ static int mperform_hyper (batch_context* bctx, int* still_running)
 
                         if (msg->data.result)
                         {
-                                // fprintf (stderr, "res is %d ", msg->data.result);
+                                double connect_time = 0.0;
+
                                 cctx->client_state = CSTATE_ERROR;
 
-                                // fprintf(cctx->file_output, "%ld %s !! ERROR: %d - %s\n", cctx->cycle_num,
-                                // cctx->client_name, msg->data.result, curl_easy_strerror(msg->data.result ));
+                                /*
+                                   Count the failure by class of its CURLcode. Timeouts
+                                   before connection established are told apart from
+                                   timeouts of connected transfers.
+                                 */
+                                curl_easy_getinfo (handle, CURLINFO_CONNECT_TIME, &connect_time);
+
+                                op_stat_error (&bctx->op_delta,
+                                               cctx->url_curr_index,
+                                               msg->data.result,
+                                               connect_time > 0.0);
+
+                                if (tls_handshake_mode)
+                                {
+                                        tls_rate_error (cctx, msg->data.result, connect_time > 0.0);
+                                }
+                        }
+
+                        /* Commit statistics of the accomplished request */
+                        stat_request_commit (cctx);
+
+                        if (redis_samples)
+                        {
+                                redis_pub_request (cctx, msg->data.result, now_time);
                         }
 
                         if (!(++cycle_counter % TIME_RECALCULATION_MSG_NUM))
@@ -670,6 +726,11 @@ static int mperform_hyper (batch_context* bctx, int* still_running)
                 }
         }
 
+        if (msgs_drained)
+        {
+                loop_prof_drain (&bctx->prof, msgs_drained);
+        }
+
         if (dispatch_expired_timers (bctx, now_time) > 0 || scheduled_now_count)
         {
                 while (CURLM_CALL_MULTI_PERFORM ==
@@ -0,0 +1,521 @@
+/*
+ *     loader_pool.c
+ *
+ * 2006 - 2007 Copyright (c)
+ * Robert Iakobashvili, <coroberti@gmail.com>
+ * Michael Moser, <moser.michael@gmail.com>
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// must be first include
+#include "fdsetsize.h"
+
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "batch.h"
+#include "client.h"
+#include "loader.h"
+#include "conf.h"
+#include "screen.h"
+#include "redis_pub.h"
+#include "tls_rate.h"
+
+/*
+   Connection-pool mode (-m 3). A fixed number of keep-alive connections is
+   kept loaded by a fixed number of requests in flight on each of them, to
+   find the maximum throughput, that a server sustains with the number of
+   connections.
+
+   Each request in flight is a slot: a client context with its CURL handle,
+   started again on the next url of the batch, taken round-robin, as soon as
+   its previous request completes. There are no think-times, cycles or
+   ramp-up, and the clients of the batch are the slots.
+
+   The steps of POOL_CONNECTIONS run one after another, each for
+   POOL_STEP_DURATION seconds on a multi handle of its own, so that a step
+   starts with no connections left by the previous one. More than a single
+   request in flight on a connection is pipelined by libcurl, limited to
+   POOL_IN_FLIGHT requests on a connection and to the connections of the
+   step to a host (CURLMOPT_MAX_PIPELINE_LENGTH and
+   CURLMOPT_MAX_HOST_CONNECTIONS of patches/curl-pipeline-limits.patch).
+   libcurl pipelines GET requests only, other requests take a connection
+   of their own.
+ */
+
+/* Error ratio in percents, up to which a step throughput is sustainable */
+#define POOL_ERRORS_SUSTAINABLE_PERCENT 1.0
+
+/* Results of a step */
+typedef struct pool_step
+{
+        int conns;
+
+        /* Requests completed and failed within the step duration */
+        unsigned long long requests;
+        unsigned long long errors;
+
+        /* Sum of the completed requests latencies in seconds */
+        double latency_sum;
+
+        unsigned long duration_msec;
+} pool_step;
+
+static pool_step pool_steps[POOL_STEPS_MAX];
+
+/* Shared iterator over the urls of the batch */
+static int pool_url_next = 0;
+
+static int pool_step_run (batch_context* bctx,
+                          client_context* cctx_array,
+                          pool_step* step);
+static int pool_multi_init (batch_context* bctx, int conns, int slots);
+static int pool_request_start (batch_context* bctx,
+                               client_context* cctx,
+                               unsigned long now_time);
+static int pool_perform (batch_context* bctx,
+                         pool_step* step,
+                         unsigned long* now_time,
+                         unsigned long step_end,
+                         int* slots_active);
+static void pool_step_report (batch_context* bctx, pool_step* step);
+static void pool_report (batch_context* bctx);
+
+/******************************************************************************
+ * Function name - user_activity_pool
+ *
+ * Description - Loads a fixed pool of connections with a fixed number of
+ *               requests in flight on each one in steps of POOL_CONNECTIONS
+ * Input -       *cctx_array - array of client contexts (related to a certain
+ *                             batch of clients)
+ * Return Code/Output - On Success - 0, on Error -1
+ *******************************************************************************/
+int user_activity_pool (client_context* cctx_array)
+{
+        batch_context* bctx = cctx_array->bctx;
+        const unsigned long now_time = get_tick_count ();
+        int i;
+
+        if (!bctx)
+        {
+                fprintf (stderr, "%s - error: bctx is a NULL pointer.\n", __func__);
+                return -1;
+        }
+
+        bctx->start_time = bctx->last_measure = now_time;
+        bctx->active_clients_count = bctx->sleeping_clients_count = 0;
+
+        dump_snapshot_interval (bctx, now_time);
+
+        /*
+           ========= Run the loading machinery ================
+         */
+        for (i = 0; i < bctx->pool_conns_num; i++)
+        {
+                pool_steps[i].conns = bctx->pool_conns[i];
+
+                if (pool_step_run (bctx, cctx_array, &pool_steps[i]) == -1)
+                {
+                        fprintf (stderr, "%s - error: step of %d connections failed.\n",
+                                 __func__, pool_steps[i].conns);
+                        return -1;
+                }
+
+                pool_step_report (bctx, &pool_steps[i]);
+        }
+
+        dump_final_statistics (cctx_array);
+        screen_release ();
+
+        pool_report (bctx);
+
+        return 0;
+}
+
+/*******************************************************************************
+ * Function name - pool_step_run
+ *
+ * Description - Runs a step: starts all the slots of the step connections,
+ *               restarts the slots on completion till the step duration
+ *               elapses and waits for the requests in flight to complete.
+ *
+ * Input -       *bctx       - pointer to the batch of contexts
+ *               *cctx_array - array of client contexts of the batch
+ * Input/Output  *step       - the step with its connections number, results
+ *
+ * Return Code/Output - On Success - 0, on Error -1
+ ********************************************************************************/
+static int pool_step_run (batch_context* bctx,
+                          client_context* cctx_array,
+                          pool_step* step)
+{
+        const int slots = step->conns * bctx->pool_in_flight;
+        unsigned long now_time, step_start, step_end;
+        int slots_active = 0;
+        int i;
+
+        if (pool_multi_init (bctx, step->conns, slots) == -1)
+        {
+                return -1;
+        }
+
+        now_time = step_start = get_tick_count ();
+        step_end = step_start + bctx->pool_step_duration * 1000;
+
+        for (i = 0; i < slots; i++)
+        {
+                if (pool_request_start (bctx, &cctx_array[i], now_time) == -1)
+                {
+                        return -1;
+                }
+                slots_active++;
+        }
+
+        while (slots_active > 0)
+        {
+                int rc, maxfd;
+                fd_set fdread, fdwrite, fdexcep;
+                struct timeval timeout;
+
+                if (pool_perform (bctx, step, &now_time, step_end, &slots_active) == -1)
+                {
+                        return -1;
+                }
+
+                FD_ZERO(&fdread); FD_ZERO(&fdwrite); FD_ZERO(&fdexcep);
+                timeout.tv_sec = 0;
+                timeout.tv_usec = 250000;
+
+                curl_multi_fdset (bctx->multiple_handle, &fdread, &fdwrite, &fdexcep, &maxfd);
+
+                rc = select (maxfd + 1, &fdread, &fdwrite, &fdexcep, &timeout);
+
+                if (rc == -1 && errno != EINTR)
+                {
+                        fprintf (stderr, "%s - error: select () failed with errno %d.\n",
+                                 __func__, errno);
+                        return -1;
+                }
+
+                now_time = get_tick_count ();
+        }
+
+        step->duration_msec = step_end - step_start;
+
+        return 0;
+}
+
+/*******************************************************************************
+ * Function name - pool_multi_init
+ *
+ * Description - Replaces the multi handle of the batch by a new one, closing
+ *               connections of the previous step, and limits its connections
+ *               and pipelines to the step.
+ *
+ * Input -       *bctx - pointer to the batch of contexts
+ *               conns - number of connections of the step
+ *               slots - number of requests in flight of the step
+ *
+ * Return Code/Output - On Success - 0, on Error -1
+ ********************************************************************************/
+static int pool_multi_init (batch_context* bctx, int conns, int slots)
+{
+        if (bctx->multiple_handle)
+        {
+                curl_multi_cleanup (bctx->multiple_handle);
+        }
+
+        if (!(bctx->multiple_handle = curl_multi_init ()))
+        {
+                fprintf (stderr, "%s - error: curl_multi_init () failed.\n", __func__);
+                return -1;
+        }
+
+        curl_multi_setopt (bctx->multiple_handle, CURLMOPT_MAXCONNECTS, (long) slots);
+
+        if (bctx->pool_in_flight > 1)
+        {
+                if (curl_multi_setopt (bctx->multiple_handle,
+                                       CURLMOPT_PIPELINING, 1L) != CURLM_OK ||
+                    curl_multi_setopt (bctx->multiple_handle,
+                                       CURLMOPT_MAX_HOST_CONNECTIONS,
+                                       (long) conns) != CURLM_OK ||
+                    curl_multi_setopt (bctx->multiple_handle,
+                                       CURLMOPT_MAX_PIPELINE_LENGTH,
+                                       (long) bctx->pool_in_flight) != CURLM_OK)
+                {
+                        fprintf (stderr,
+                                 "%s - error: libcurl does not limit pipelines, "
+                                 "build it with patches/curl-pipeline-limits.patch.\n",
+                                 __func__);
+                        return -1;
+                }
+        }
+
+        return 0;
+}
+
+/*******************************************************************************
+ * Function name - pool_request_start
+ *
+ * Description - Sets up the handle of a slot for the next url of the batch
+ *               and adds it to the multi handle.
+ *
+ * Input -       *bctx    - pointer to the batch of contexts
+ *               *cctx    - pointer to the client context of the slot
+ *               now_time - current time in msec
+ *
+ * Return Code/Output - On Success - 0, on Error -1
+ ********************************************************************************/
+static int pool_request_start (batch_context* bctx,
+                               client_context* cctx,
+                               unsigned long now_time)
+{
+        url_context* url = &bctx->url_ctx_array[pool_url_next];
+        unsigned long timer_url_completion = 0;
+
+        pool_url_next = (pool_url_next + 1) % bctx->urls_num;
+
+        cctx->url_curr_index = url - bctx->url_ctx_array;
+        cctx->client_state = CSTATE_URLS;
+
+        if (setup_curl_handle_init (cctx, url) == -1)
+        {
+                fprintf (stderr, "%s - error: setup_curl_handle_init () failed.\n", __func__);
+                return -1;
+        }
+
+        /* Url completion timeout is kept by libcurl, there are no timers */
+        current_url_completion_timeout (&timer_url_completion, url, now_time);
+
+        if (timer_url_completion)
+        {
+                curl_easy_setopt (cctx->handle, CURLOPT_TIMEOUT_MS, (long) timer_url_completion);
+        }
+
+        cctx->req_sent_timestamp = now_time;
+
+        if (curl_multi_add_handle (bctx->multiple_handle, cctx->handle) != CURLM_OK)
+        {
+                fprintf (stderr, "%s - error: curl_multi_add_handle () failed.\n", __func__);
+                return -1;
+        }
+
+        bctx->active_clients_count++;
+
+        return 0;
+}
+
+/****************************************************************************************
+* Function name - pool_perform
+*
+* Description - Uses curl_multi_perform () to react on socket events, commits the
+*               statistics of the completed requests and restarts their slots, while
+*               the step lasts.
+*
+* Input -       *bctx         - pointer to the batch of contexts
+*               *step         - the running step
+*               *now_time     - current time in msec, updated
+*               step_end      - time in msec, when the slots stop to be restarted
+*               *slots_active - number of slots with requests in flight, updated
+*
+* Return Code/Output - On Success - 0, on Error -1
+****************************************************************************************/
+static int pool_perform (batch_context* bctx,
+                         pool_step* step,
+                         unsigned long* now_time,
+                         unsigned long step_end,
+                         int* slots_active)
+{
+        CURLM *mhandle = bctx->multiple_handle;
+        const unsigned long snapshot_timeout = snapshot_statistics_timeout*1000;
+        int still_running = 0;
+        int msg_num = 0;
+        CURLMsg *msg;
+
+        while (CURLM_CALL_MULTI_PERFORM ==
+               curl_multi_perform (mhandle, &still_running))
+                ;
+
+        while ((msg = curl_multi_info_read (mhandle, &msg_num)) != 0)
+        {
+                client_context *cctx = NULL;
+                double total_time = 0.0;
+
+                if (msg->msg != CURLMSG_DONE)
+                {
+                        continue;
+                }
+
+                curl_easy_getinfo (msg->easy_handle, CURLINFO_PRIVATE, &cctx);
+
+                if (!cctx)
+                {
+                        fprintf (stderr, "%s - error: cctx is a NULL pointer.\n", __func__);
+                        return -1;
+                }
+
+                if (msg->data.result)
+                {
+                        double connect_time = 0.0;
+
+                        cctx->client_state = CSTATE_ERROR;
+
+                        curl_easy_getinfo (msg->easy_handle, CURLINFO_CONNECT_TIME, &connect_time);
+
+                        op_stat_error (&bctx->op_delta,
+                                       cctx->url_curr_index,
+                                       msg->data.result,
+                                       connect_time > 0.0);
+
+                        if (tls_handshake_mode)
+                        {
+                                tls_rate_error (cctx, msg->data.result, connect_time > 0.0);
+                        }
+                }
+
+                /* Includes the time in the queue of a pipeline */
+                curl_easy_getinfo (msg->easy_handle, CURLINFO_TOTAL_TIME, &total_time);
+
+                /* Commit statistics of the accomplished request */
+                stat_request_commit (cctx);
+
+                op_stat_update (&bctx->op_delta,
+                                cctx->client_state,
+                                CSTATE_URLS,
+                                cctx->url_curr_index,
+                                cctx->url_curr_index);
+
+                if (redis_samples)
+                {
+                        redis_pub_request (cctx, msg->data.result, *now_time);
+                }
+
+                if (*now_time < step_end)
+                {
+                        step->requests++;
+                        step->latency_sum += total_time;
+
+                        if (cctx->client_state == CSTATE_ERROR)
+                        {
+                                step->errors++;
+                        }
+                }
+
+                curl_multi_remove_handle (mhandle, cctx->handle);
+                bctx->active_clients_count--;
+                (*slots_active)--;
+
+                if (*now_time < step_end)
+                {
+                        if (pool_request_start (bctx, cctx, *now_time) == -1)
+                        {
+                                return -1;
+                        }
+                        (*slots_active)++;
+                }
+        }
+
+        if (*now_time - bctx->last_measure > snapshot_timeout)
+        {
+                if (is_batch_group_leader (bctx))
+                {
+                        dump_snapshot_interval (bctx, *now_time);
+                }
+        }
+
+        return 0;
+}
+
+/****************************************************************************************
+* Function name - pool_step_report
+*
+* Description - Prints the throughput and the latency of a step
+*
+* Input -       *bctx - pointer to the batch context
+*               *step - pointer to the completed step
+* Return Code/Output - None
+****************************************************************************************/
+static void pool_step_report (batch_context* bctx, pool_step* step)
+{
+        const double sec = step->duration_msec ? step->duration_msec / 1000.0 : 1.0;
+        const double rate = step->requests / sec;
+
+        fprintf (stderr, "%s - pool step: %d connections x %d in flight: %.0f req/s, "
+                 "%.1f req/s per connection, latency %.2f ms, %llu errors of %llu requests\n",
+                 bctx->batch_name, step->conns, bctx->pool_in_flight,
+                 rate, rate / step->conns,
+                 step->requests ? step->latency_sum * 1000.0 / step->requests : 0.0,
+                 step->errors, step->requests);
+}
+
+/****************************************************************************************
+* Function name - pool_report
+*
+* Description - Prints the throughput of the steps by the number of connections and
+*               the maximum one among the steps with the errors ratio sustainable.
+*
+* Input -       *bctx - pointer to the batch context
+* Return Code/Output - None
+****************************************************************************************/
+static void pool_report (batch_context* bctx)
+{
+        double rate_max = 0.0;
+        int conns_max = 0;
+        int i;
+
+        fprintf (stderr, "\n============ Connection pool of batch: %-10.10s ============\n",
+                 bctx->batch_name);
+        fprintf (stderr, "%12s %10s %12s %14s %12s %8s\n",
+                 "Connections", "In-flight", "Req/s", "Req/s per conn",
+                 "Latency ms", "Errors%");
+
+        for (i = 0; i < bctx->pool_conns_num; i++)
+        {
+                const pool_step* step = &pool_steps[i];
+                const double sec = step->duration_msec ? step->duration_msec / 1000.0 : 1.0;
+                const double rate = step->requests / sec;
+                const double errors_percent = step->requests ?
+                        step->errors * 100.0 / step->requests : 0.0;
+
+                fprintf (stderr, "%12d %10d %12.0f %14.1f %12.2f %8.2f\n",
+                         step->conns, bctx->pool_in_flight, rate, rate / step->conns,
+                         step->requests ? step->latency_sum * 1000.0 / step->requests : 0.0,
+                         errors_percent);
+
+                if (step->requests &&
+                    errors_percent <= POOL_ERRORS_SUSTAINABLE_PERCENT &&
+                    rate > rate_max)
+                {
+                        rate_max = rate;
+                        conns_max = step->conns;
+                }
+        }
+
+        if (conns_max)
+        {
+                fprintf (stderr, "Maximum sustainable throughput: %.0f req/s with %d connections "
+                         "(errors up to %.0f%%)\n",
+                         rate_max, conns_max, POOL_ERRORS_SUSTAINABLE_PERCENT);
+        }
+        else
+        {
+                fprintf (stderr, "No step sustained the load with errors up to %.0f%%\n",
+                         POOL_ERRORS_SUSTAINABLE_PERCENT);
+        }
+}
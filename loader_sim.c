@@ -0,0 +1,460 @@
+/*
+ *     loader_sim.c
+ *
+ * 2006-2007 Copyright (c)
+ * Michael Moser, <moser.michael@gmail.com>
+ * Robert Iakobashvili, <coroberti@gmail.com>
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Cooked using CURL-project example hypev.c with thanks to the
+ * great CURL-project authors and contributors.
+ */
+
+// must be first include
+#include "fdsetsize.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "batch.h"
+#include "client.h"
+#include "loader.h"
+#include "conf.h"
+#include "cl_alloc.h"
+#include "screen.h"
+#include "redis_pub.h"
+
+/*
+   Dry-run (simulation) mode. Transfers of libcurl are replaced by fakes,
+   completed after a latency sampled from the -n range. The loop runs on
+   a virtual clock, jumping from one timer or fake completion to the next
+   one, so that hours of load by hundreds of thousands of clients are
+   simulated in seconds, exercising load_next_step (), the timer queue and
+   the statistics. The run is single-threaded.
+ */
+
+/*
+   Fake transfer of a client. The timer node is the first field, so that
+   the queue returns the transfer.
+ */
+typedef struct sim_transfer
+{
+        timer_node tn;
+        client_context* cctx;
+        long tid;
+} sim_transfer;
+
+/* Virtual clock in msec, zero when not running */
+unsigned long sim_clock = 0;
+
+/* Queue of the fake transfers by their completion time */
+static timer_queue* sim_queue = NULL;
+
+/* Fake transfers, indexed by client index */
+static sim_transfer* sim_transfers = NULL;
+
+/* Counters of the run, kept for the final report */
+static unsigned long long sim_requests = 0;
+static unsigned long long sim_events = 0;
+
+static int sim_transfer_complete (timer_node* tn,
+                                  void* pvoid_param,
+                                  unsigned long ulong_param);
+static unsigned long sim_latency_sample ();
+static void sim_report (batch_context* bctx,
+                        unsigned long long real_usec,
+                        unsigned long rampup_done_time,
+                        unsigned long long rampup_done_requests);
+
+/******************************************************************************
+ * Function name - user_activity_sim
+ *
+ * Description - Simulates user-activities in DRY-RUN mode on a virtual clock
+ * Input -       *cctx_array - array of client contexts (related to a certain
+ *                             batch of clients)
+ * Return Code/Output - On Success - 0, on Error -1
+ *******************************************************************************/
+int user_activity_sim (client_context* cctx_array)
+{
+        batch_context* bctx = cctx_array->bctx;
+        const unsigned long snapshot_timeout = snapshot_statistics_timeout*1000;
+        unsigned long rampup_done_time = 0;
+        unsigned long long rampup_done_requests = 0;
+        unsigned long long real_start_usec;
+        int i;
+
+        if (!bctx)
+        {
+                fprintf (stderr, "%s - error: bctx is a NULL pointer.\n", __func__);
+                return -1;
+        }
+
+        if (alloc_init_timer_waiting_queue (bctx->client_num_max + PERIODIC_TIMERS_NUMBER + 1,
+                                            &bctx->waiting_queue) == -1 ||
+            alloc_init_timer_waiting_queue (bctx->client_num_max + 1, &sim_queue) == -1)
+        {
+                fprintf (stderr,
+                         "%s - error: failed to alloc or init timer waiting queue.\n",
+                         __func__);
+                return -1;
+        }
+
+        if (! (sim_transfers = cl_calloc (bctx->client_num_max, sizeof (sim_transfer))))
+        {
+                fprintf (stderr, "%s - error: allocation of fake transfers failed.\n",
+                         __func__);
+                return -1;
+        }
+
+        for (i = 0; i < bctx->client_num_max; i++)
+        {
+                sim_transfers[i].cctx = &cctx_array[i];
+                sim_transfers[i].tid = -1;
+        }
+
+        /* The virtual clock starts from the real time */
+        sim_clock = get_tick_count ();
+        real_start_usec = loop_prof_usec ();
+
+        if (init_timers_and_add_initial_clients_to_load (bctx, sim_clock) == -1)
+        {
+                fprintf (stderr,
+                         "%s - error: init_timers_and_add_initial_clients_to_load () failed.\n",
+                         __func__);
+                return -1;
+        }
+
+        dump_snapshot_interval (bctx, sim_clock);
+
+        /*
+           ========= Run the loading machinery ================
+         */
+        while ((pending_active_and_waiting_clients_num (bctx)) ||
+               bctx->do_client_num_gradual_increase)
+        {
+                const unsigned long next_timer = tq_time_to_nearest_timer (bctx->waiting_queue);
+                const unsigned long next_done = tq_time_to_nearest_timer (sim_queue);
+                const unsigned long next = next_timer < next_done ? next_timer : next_done;
+                unsigned long long start_usec;
+                unsigned long msgs_drained = 0;
+                int timers;
+
+                if (next == ULONG_MAX)
+                {
+                        fprintf (stderr, "%s - error: no timers and no transfers pending.\n",
+                                 __func__);
+                        return -1;
+                }
+
+                /* Jump the virtual clock to the next event */
+                if (next > sim_clock)
+                {
+                        sim_clock = next;
+                }
+
+                start_usec = loop_prof_usec ();
+
+                while (tq_time_to_nearest_timer (sim_queue) <= sim_clock)
+                {
+                        if (tq_dispatch_nearest_timer (sim_queue, bctx, sim_clock) == -1)
+                        {
+                                fprintf (stderr, "%s - error: fake transfer completion failed.\n",
+                                         __func__);
+                                return -1;
+                        }
+                        msgs_drained++;
+                }
+
+                if ((timers = dispatch_expired_timers (bctx, sim_clock)) > 0)
+                {
+                        sim_events += timers;
+                }
+                sim_events += msgs_drained;
+
+                if (sim_clock - bctx->last_measure > snapshot_timeout)
+                {
+                        dump_snapshot_interval (bctx, sim_clock);
+                }
+
+                if (!rampup_done_time &&
+                    bctx->clients_current_sched_num >= bctx->client_num_max)
+                {
+                        rampup_done_time = sim_clock;
+                        rampup_done_requests = sim_requests;
+                }
+
+                if (msgs_drained)
+                {
+                        loop_prof_drain (&bctx->prof, msgs_drained);
+                }
+                loop_prof_iteration (&bctx->prof, start_usec);
+        }
+
+        dump_final_statistics (cctx_array);
+        screen_release ();
+
+        sim_report (bctx, loop_prof_usec () - real_start_usec,
+                    rampup_done_time, rampup_done_requests);
+
+        /*
+           ======= Release resources =========================
+         */
+        if (bctx->waiting_queue)
+        {
+                /* Cancel periodic timers */
+                cancel_periodic_timers (bctx);
+
+                tq_release (bctx->waiting_queue);
+                free (bctx->waiting_queue);
+                bctx->waiting_queue = 0;
+        }
+
+        tq_release (sim_queue);
+        free (sim_queue);
+        sim_queue = NULL;
+
+        free (sim_transfers);
+        sim_transfers = NULL;
+
+        sim_clock = 0;
+
+        return 0;
+}
+
+/****************************************************************************************
+* Function name - sim_transfer_start
+*
+* Description - Schedules completion of a fake transfer of the client after a
+*               sampled latency
+*
+* Input -       *bctx    - pointer to the batch context
+*               *cctx    - pointer to the client context
+*               now_time - current virtual time in msec
+* Return Code/Output - On Success - 0, on Error -1
+****************************************************************************************/
+int sim_transfer_start (batch_context* bctx,
+                        client_context* cctx,
+                        unsigned long now_time)
+{
+        sim_transfer* st = &sim_transfers[cctx->client_index];
+        (void) bctx;
+
+        st->tn.next_timer = now_time + sim_latency_sample ();
+        st->tn.period = 0;
+        st->tn.func_timer = sim_transfer_complete;
+
+        if ((st->tid = tq_schedule_timer (sim_queue, &st->tn)) == -1)
+        {
+                fprintf (stderr, "%s - error: tq_schedule_timer () failed.\n", __func__);
+                return -1;
+        }
+
+        return 0;
+}
+
+/****************************************************************************************
+* Function name - sim_transfer_cancel
+*
+* Description - Cancels a fake transfer of the client, when it has not been completed,
+*               e.g. on url completion timeout
+*
+* Input -       *cctx - pointer to the client context
+* Return Code/Output - On Success - 0, on Error -1
+****************************************************************************************/
+int sim_transfer_cancel (client_context* cctx)
+{
+        sim_transfer* st = &sim_transfers[cctx->client_index];
+
+        if (st->tid != -1)
+        {
+                tq_cancel_timer (sim_queue, st->tid);
+                st->tid = -1;
+        }
+
+        return 0;
+}
+
+/****************************************************************************************
+* Function name - sim_transfer_complete
+*
+* Description - Timer handler of fake transfer completion. Counts a 2xx response
+*               and proceeds with the client like on CURLMSG_DONE of a real transfer.
+*
+* Input -       *tn          - pointer to the timer node of the fake transfer
+*               *pvoid_param - pointer to the batch context
+*               ulong_param  - current virtual time in msec
+* Return Code/Output - On success - 0, on error -1
+****************************************************************************************/
+static int sim_transfer_complete (timer_node* tn,
+                                  void* pvoid_param,
+                                  unsigned long ulong_param)
+{
+        sim_transfer* st = (sim_transfer *) tn;
+        client_context* cctx = st->cctx;
+        batch_context* bctx = (batch_context *) pvoid_param;
+        const unsigned long now_time = ulong_param;
+        int sched_now = 0;
+
+        st->tid = -1;
+
+        stat_req_inc (cctx);
+        stat_2xx_inc (cctx);
+        stat_appl_delay_2xx_add (cctx, now_time);
+        stat_appl_delay_add (cctx, now_time);
+        first_hdrs_clear_all (cctx);
+
+        stat_request_commit (cctx);
+        sim_requests++;
+
+        if (redis_samples)
+        {
+                redis_pub_request (cctx, CURLE_OK, now_time);
+        }
+
+        if (bctx->req_rate)
+        {
+                return put_free_client (cctx);
+        }
+
+        return load_next_step (cctx, now_time, &sched_now) == -1 ? -1 : 0;
+}
+
+static unsigned long sim_latency_sample ()
+{
+        if (sim_latency_max == sim_latency_min)
+                return sim_latency_min;
+
+        return sim_latency_min +
+                (unsigned long) ((sim_latency_max - sim_latency_min + 1) * get_random ());
+}
+
+/****************************************************************************************
+* Function name - sim_report
+*
+* Description - Prints scheduling throughput of the dry run and compares the achieved
+*               rates with the configured ones: ramp-up duration and either the fixed
+*               request rate, or the rate expected from latency and think-times.
+*
+* Input -       *bctx                - pointer to the batch context
+*               real_usec            - real duration of the run in usec
+*               rampup_done_time     - virtual time, when all clients were scheduled
+*               rampup_done_requests - requests completed at that time
+* Return Code/Output - None
+****************************************************************************************/
+static void sim_report (batch_context* bctx,
+                        unsigned long long real_usec,
+                        unsigned long rampup_done_time,
+                        unsigned long long rampup_done_requests)
+{
+        const double real_sec = real_usec ? real_usec / 1e6 : 1e-6;
+        const double virt_sec = (sim_clock - bctx->start_time) / 1000.0;
+        const double latency_avg = (sim_latency_min + sim_latency_max) / 2.0;
+        double expected_rate = 0.0, achieved_rate = 0.0, steady_sec = 0.0;
+        int i;
+
+        fprintf (stderr, "\n============ Dry run of batch: %-10.10s ====================\n",
+                 bctx->batch_name);
+
+        fprintf (stderr, "Virtual time: %.1f sec, real time: %.2f sec, speed-up: x%.0f\n",
+                 virt_sec, real_sec, virt_sec / real_sec);
+
+        fprintf (stderr, "Scheduling throughput: %.0f requests/sec, %.0f events/sec "
+                 "(%llu requests, %llu timers and completions)\n",
+                 sim_requests / real_sec, sim_events / real_sec, sim_requests, sim_events);
+
+        /*
+           Ramp-up: clients_rampup_inc clients each clients_rampup_period msec,
+           starting a second after the start.
+         */
+        if (bctx->clients_rampup_inc && bctx->client_num_max > bctx->client_num_start)
+        {
+                const long steps = (bctx->client_num_max - bctx->client_num_start +
+                                    bctx->clients_rampup_inc - 1) / bctx->clients_rampup_inc;
+                const double expected_sec =
+                        1.0 + (steps - 1) * bctx->clients_rampup_period / 1000.0;
+
+                if (rampup_done_time)
+                {
+                        const double achieved_sec =
+                                (rampup_done_time - bctx->start_time) / 1000.0;
+
+                        fprintf (stderr, "Ramp-up to %d clients: expected %.1f sec, "
+                                 "achieved %.1f sec (%+.1f%%)\n",
+                                 bctx->client_num_max, expected_sec, achieved_sec,
+                                 (achieved_sec - expected_sec) * 100.0 / expected_sec);
+                }
+                else
+                {
+                        fprintf (stderr, "Ramp-up to %d clients: expected %.1f sec, "
+                                 "not accomplished\n", bctx->client_num_max, expected_sec);
+                }
+        }
+
+        /*
+           Steady state rate is measured after the ramp-up.
+         */
+        if (rampup_done_time)
+        {
+                steady_sec = (sim_clock - rampup_done_time) / 1000.0;
+                if (steady_sec > 0)
+                {
+                        achieved_rate = (sim_requests - rampup_done_requests) / steady_sec;
+                }
+        }
+
+        if (bctx->req_rate)
+        {
+                expected_rate = bctx->req_rate;
+        }
+        else
+        {
+                /*
+                   Each client fetches the urls one by one, sleeping after each
+                   one the average think-time of the url.
+                 */
+                double cycle_msec = 0.0;
+
+                for (i = 0; i < bctx->urls_num; i++)
+                {
+                        url_context* url = &bctx->url_ctx_array[i];
+
+                        cycle_msec += latency_avg + url->timer_after_url_sleep_lrange +
+                                url->timer_after_url_sleep_hrange / 2.0;
+                }
+
+                if (cycle_msec > 0)
+                {
+                        expected_rate = bctx->client_num_max * bctx->urls_num * 1000.0 /
+                                cycle_msec;
+                }
+        }
+
+        if (steady_sec > 0 && expected_rate > 0)
+        {
+                fprintf (stderr, "Steady request rate (%.1f sec): expected %.1f/sec, "
+                         "achieved %.1f/sec (%+.1f%%)\n",
+                         steady_sec, expected_rate, achieved_rate,
+                         (achieved_rate - expected_rate) * 100.0 / expected_rate);
+        }
+        else
+        {
+                fprintf (stderr, "Steady request rate: not reached\n");
+        }
+
+        fprintf (stderr, "=============================================================\n");
+}
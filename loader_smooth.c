@@ -37,6 +37,10 @@
 #include "loader.h"
 #include "conf.h"
 #include "screen.h"
+#include "metrics.h"
+#include "redis_pub.h"
+#include "tls_rate.h"
+#include "fast.h"
 
 
 static int mget_url_smooth (batch_context* bctx);
@@ -71,6 +75,12 @@ int user_activity_smooth (client_context* cctx_array)
                 return -1;
         }
 
+        if (fast_init (bctx, NULL) == -1)
+        {
+                fprintf (stderr, "%s - error: fast_init () failed.\n", __func__);
+                return -1;
+        }
+
         const unsigned long now_time = get_tick_count ();
 
         if (init_timers_and_add_initial_clients_to_load (bctx, now_time) == -1)
@@ -83,6 +93,12 @@ int user_activity_smooth (client_context* cctx_array)
 
         if (is_batch_group_leader (bctx))
         {
+                if (metrics_init (bctx, NULL) == -1)
+                {
+                        fprintf (stderr, "%s - error: metrics_init () failed.\n", __func__);
+                        return -1;
+                }
+
                 dump_snapshot_interval (bctx, now_time);
         }
 
@@ -102,6 +118,13 @@ int user_activity_smooth (client_context* cctx_array)
         dump_final_statistics (cctx_array);
         screen_release ();
 
+        if (is_batch_group_leader (bctx))
+        {
+                metrics_release ();
+        }
+
+        fast_release (bctx);
+
         /*
            ======= Release resources =========================
          */
@@ -146,6 +169,7 @@ static int mget_url_smooth (batch_context* bctx)
         {
                 int rc, maxfd;
                 fd_set fdread, fdwrite, fdexcep;
+                unsigned long long start_usec;
 
                 FD_ZERO(&fdread); FD_ZERO(&fdwrite); FD_ZERO(&fdexcep);
                 timeout.tv_sec = 0;
@@ -155,11 +179,20 @@ static int mget_url_smooth (batch_context* bctx)
 
                 curl_multi_fdset(bctx->multiple_handle, &fdread, &fdwrite, &fdexcep, &maxfd);
 
+                fast_fdset (bctx, &fdread, &fdwrite, &maxfd);
+
+                if (is_batch_group_leader (bctx))
+                {
+                        metrics_fdset (&fdread, &fdwrite, &maxfd);
+                }
+
                 //fprintf (stderr, "%s - Waiting for %d clients with seconds %f.\n",
                 //name, still_running, max_timeout);
 
                 rc = select (maxfd + 1, &fdread, &fdwrite, &fdexcep, &timeout);
 
+                start_usec = loop_prof_usec ();
+
                 switch(rc)
                 {
                 case -1: /* select error */
@@ -172,12 +205,25 @@ static int mget_url_smooth (batch_context* bctx)
                         break;
                 }
 
+                if (rc > 0 && is_batch_group_leader (bctx))
+                {
+                        metrics_fdset_process (&fdread, &fdwrite);
+                }
+
+                /* Connect timeouts and failed starts are served on any outcome */
+                fast_fdset_process (bctx,
+                                    rc == -1 ? NULL : &fdread,
+                                    rc == -1 ? NULL : &fdwrite,
+                                    now_time);
+
                 if (!(++cycle_counter % TIME_RECALCULATION_CYCLES_NUM))
                 {
                         now_time = get_tick_count ();
                 }
 
                 dispatch_expired_timers (bctx, now_time);
+
+                loop_prof_iteration (&bctx->prof, start_usec);
         }
 
         return 0;
@@ -206,6 +252,7 @@ static int mperform_smooth (batch_context* bctx,
         const int snapshot_timeout = snapshot_statistics_timeout*1000;
         CURLMsg *msg;
         int sched_now = 0;
+        unsigned long msgs_drained = 0;
 
         while (CURLM_CALL_MULTI_PERFORM ==
                curl_multi_perform(mhandle, still_running))
@@ -223,14 +270,11 @@ static int mperform_smooth (batch_context* bctx,
         {
                 if (msg->msg == CURLMSG_DONE)
                 {
-                        /*
-                         * TODO: CURLMsg returns 'result' field as curl return code.
-                         * We may wish to use it.
-                         */
-
                         CURL *handle = msg->easy_handle;
                         client_context *cctx = NULL;
 
+                        msgs_drained++;
+
                         curl_easy_getinfo (handle, CURLINFO_PRIVATE, &cctx);
 
                         if (!cctx)
@@ -241,11 +285,34 @@ static int mperform_smooth (batch_context* bctx,
 
                         if (msg->data.result)
                         {
-                                // fprintf (stderr, "res is %d ", msg->data.result);
+                                double connect_time = 0.0;
+
                                 cctx->client_state = CSTATE_ERROR;
 
-                                // fprintf(cctx->file_output, "%ld %s !! ERROR: %d - %s\n", cctx->cycle_num,
-                                // cctx->client_name, msg->data.result, curl_easy_strerror(msg->data.result ));
+                                /*
+                                   Count the failure by class of its CURLcode. Timeouts
+                                   before connection established are told apart from
+                                   timeouts of connected transfers.
+                                 */
+                                curl_easy_getinfo (handle, CURLINFO_CONNECT_TIME, &connect_time);
+
+                                op_stat_error (&bctx->op_delta,
+                                               cctx->url_curr_index,
+                                               msg->data.result,
+                                               connect_time > 0.0);
+
+                                if (tls_handshake_mode)
+                                {
+                                        tls_rate_error (cctx, msg->data.result, connect_time > 0.0);
+                                }
+                        }
+
+                        /* Commit statistics of the accomplished request */
+                        stat_request_commit (cctx);
+
+                        if (redis_samples)
+                        {
+                                redis_pub_request (cctx, msg->data.result, *now_time);
                         }
 
                         if (!(++cycle_counter % TIME_RECALCULATION_MSG_NUM))
@@ -283,5 +350,10 @@ static int mperform_smooth (batch_context* bctx,
                 }
         }
 
+        if (msgs_drained)
+        {
+                loop_prof_drain (&bctx->prof, msgs_drained);
+        }
+
         return 0;
 }
@@ -0,0 +1,1146 @@
+/*
+*     metrics.c
+*
+* 2006-2007 Copyright (c)
+* Robert Iakobashvili, <coroberti@gmail.com>
+* Michael Moser,  <moser.michael@gmail.com>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+// must be first include
+#include "fdsetsize.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <event.h>
+
+#include "batch.h"
+#include "conf.h"
+#include "metrics.h"
+#include "statistics.h"
+
+/* Maximum number of simultaneous scrape connections */
+#define METRICS_CONN_MAX 8
+
+/* Maximum size of an HTTP request head we are ready to read */
+#define METRICS_REQ_MAX 2048
+
+#define METRICS_CONTENT_TYPE \
+        "application/openmetrics-text; version=1.0.0; charset=utf-8"
+
+/*
+   Per-url part of a snapshot.
+ */
+typedef struct metrics_url_point
+{
+        /* Totals of the url summed over all sub-batches */
+        stat_point st;
+
+        /* Operational totals of the url */
+        unsigned long ok;
+        unsigned long failed;
+        unsigned long timeouted;
+
+        /* Failed fetches of the url by error class */
+        unsigned long errs[OP_ERR_CLASSES_NUM];
+
+} metrics_url_point;
+
+/*
+   A consistent copy of the counters, published by the batch group leader
+   at each statistics interval.
+ */
+typedef struct metrics_snapshot
+{
+        /* Time of the snapshot in msec since the epoch */
+        unsigned long timestamp;
+
+        /* Seconds since the load start */
+        unsigned long seconds_run;
+
+        /* Clients doing requests */
+        int clients_active;
+
+        /* Clients sleeping after url timeouts */
+        int clients_sleeping;
+
+        /* Active plus waiting (for load scheduling) clients */
+        int clients_total;
+
+        /* Call attempts per second of the latest interval */
+        unsigned long caps;
+
+        /* Call attempts since the load start */
+        unsigned long calls_total;
+
+        /* Protocol totals */
+        stat_point http;
+        stat_point https;
+
+        /* Array of urls_num url totals */
+        metrics_url_point* urls;
+
+} metrics_snapshot;
+
+typedef enum metrics_conn_state
+{
+        METRICS_CONN_FREE = 0,
+        METRICS_CONN_READING,
+        METRICS_CONN_WRITING,
+} metrics_conn_state;
+
+/*
+   A scrape connection.
+ */
+typedef struct metrics_conn
+{
+        int fd;
+
+        metrics_conn_state state;
+
+        /* Request head collected so far */
+        char req[METRICS_REQ_MAX];
+        size_t req_len;
+
+        /* Response to send */
+        char* resp;
+        size_t resp_len;
+        size_t resp_sent;
+
+        /* Libevent event in hyper mode */
+        struct event ev;
+        int evset;
+
+} metrics_conn;
+
+/*
+   Growing output buffer for the page rendering.
+ */
+typedef struct metrics_buf
+{
+        char* data;
+        size_t len;
+        size_t size;
+} metrics_buf;
+
+
+static int listen_fd = -1;
+static struct event_base* metrics_eb = NULL;
+static struct event listen_ev;
+static int listen_evset = 0;
+
+static metrics_conn conns[METRICS_CONN_MAX];
+
+/* Urls configuration of the leader batch */
+static url_context* metrics_urls = NULL;
+static int metrics_urls_num = 0;
+
+/*
+   Double buffered snapshots. The leader fills the spare one and publishes
+   it by the pointer swap, so that rendering never sees a partial update.
+ */
+static metrics_snapshot snapshots[2];
+static metrics_snapshot* volatile snapshot_current = NULL;
+
+
+static void metrics_accept (void);
+static void metrics_conn_read (metrics_conn* conn);
+static void metrics_conn_write (metrics_conn* conn);
+static void metrics_conn_close (metrics_conn* conn);
+static void metrics_conn_events (metrics_conn* conn);
+static int metrics_render (metrics_buf* buf, metrics_snapshot* snap);
+static int metrics_respond (metrics_conn* conn);
+
+
+/****************************************************************************************
+* Function name - metrics_listen_cb
+*
+* Description - A libevent callback for the listening socket
+*
+* Input -       fd    - descriptor (socket)
+*               kind  - a bitmask of events from libevent
+*               *userp - not used
+* Return Code/Output - None
+****************************************************************************************/
+static void metrics_listen_cb (int fd, short kind, void *userp)
+{
+        (void) fd;
+        (void) kind;
+        (void) userp;
+
+        metrics_accept ();
+}
+
+/****************************************************************************************
+* Function name - metrics_conn_cb
+*
+* Description - A libevent callback for a scrape connection
+*
+* Input -       fd     - descriptor (socket)
+*               kind   - a bitmask of events from libevent
+*               *userp - pointer to the metrics connection
+* Return Code/Output - None
+****************************************************************************************/
+static void metrics_conn_cb (int fd, short kind, void *userp)
+{
+        metrics_conn* conn = (metrics_conn *) userp;
+
+        (void) fd;
+
+        if ((kind & EV_READ) && conn->state == METRICS_CONN_READING)
+        {
+                metrics_conn_read (conn);
+        }
+        else if ((kind & EV_WRITE) && conn->state == METRICS_CONN_WRITING)
+        {
+                metrics_conn_write (conn);
+        }
+}
+
+/****************************************************************************************
+* Function name - metrics_init
+*
+* Description - Opens the listening socket on metrics_port and allocates the
+*               snapshot buffers. When <eb> is not NULL, the listener is
+*               served by libevent, otherwise by metrics_fdset ().
+*
+* Input -       *bctx - pointer to the batch group leader context
+*               *eb   - libevent event base of the leader (hyper mode) or NULL
+* Return Code/Output - On Success - 0, on Error -1
+****************************************************************************************/
+int metrics_init (batch_context* bctx, struct event_base* eb)
+{
+        struct sockaddr_in addr;
+        int on = 1, i;
+
+        if (!metrics_port || listen_fd != -1)
+                return 0;
+
+        metrics_urls = bctx->url_ctx_array;
+        metrics_urls_num = bctx->urls_num;
+
+        for (i = 0; i < 2; i++)
+        {
+                if (!(snapshots[i].urls = calloc (metrics_urls_num,
+                                                  sizeof (metrics_url_point))))
+                {
+                        fprintf (stderr, "%s - error: calloc () failed with errno %d.\n",
+                                 __func__, errno);
+                        return -1;
+                }
+        }
+
+        for (i = 0; i < METRICS_CONN_MAX; i++)
+        {
+                conns[i].fd = -1;
+        }
+
+        memset (&addr, 0, sizeof (addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons (metrics_port);
+
+        if (!inet_aton (metrics_bind_addr, &addr.sin_addr))
+        {
+                fprintf (stderr, "%s - error: wrong metrics address \"%s\".\n",
+                         __func__, metrics_bind_addr);
+                return -1;
+        }
+
+        if ((listen_fd = socket (AF_INET, SOCK_STREAM, 0)) == -1)
+        {
+                fprintf (stderr, "%s - error: socket () failed with errno %d.\n",
+                         __func__, errno);
+                return -1;
+        }
+
+        setsockopt (listen_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof (on));
+        fcntl (listen_fd, F_SETFL, fcntl (listen_fd, F_GETFL) | O_NONBLOCK);
+
+        if (bind (listen_fd, (struct sockaddr *) &addr, sizeof (addr)) == -1 ||
+            listen (listen_fd, METRICS_CONN_MAX) == -1)
+        {
+                fprintf (stderr, "%s - error: failed to listen on %s:%d, errno %d.\n",
+                         __func__, metrics_bind_addr, metrics_port, errno);
+                close (listen_fd);
+                listen_fd = -1;
+                return -1;
+        }
+
+        if ((metrics_eb = eb))
+        {
+                event_set (&listen_ev, listen_fd, EV_READ | EV_PERSIST,
+                           metrics_listen_cb, NULL);
+                event_base_set (metrics_eb, &listen_ev);
+                event_add (&listen_ev, NULL);
+                listen_evset = 1;
+        }
+
+        fprintf (stderr, "%s - serving metrics on http://%s:%d/metrics\n",
+                 __func__, metrics_bind_addr, metrics_port);
+
+        return 0;
+}
+
+/****************************************************************************************
+* Function name - metrics_release
+*
+* Description - Closes the listener and its connections, frees snapshots
+*
+* Return Code/Output - None
+****************************************************************************************/
+void metrics_release ()
+{
+        int i;
+
+        if (listen_fd == -1)
+                return;
+
+        for (i = 0; i < METRICS_CONN_MAX; i++)
+        {
+                metrics_conn_close (&conns[i]);
+        }
+
+        if (listen_evset)
+        {
+                event_del (&listen_ev);
+                listen_evset = 0;
+        }
+
+        close (listen_fd);
+        listen_fd = -1;
+
+        snapshot_current = NULL;
+
+        for (i = 0; i < 2; i++)
+        {
+                free (snapshots[i].urls);
+                snapshots[i].urls = NULL;
+        }
+}
+
+/****************************************************************************************
+* Function name - metrics_snapshot_publish
+*
+* Description - Copies the total counters of all sub-batches to the spare snapshot
+*               and makes it the current one for scrapes. Per-url counters of the
+*               sub-batches are read racily, while their threads update them.
+*
+* Input -       *bctx         - pointer to the batch group leader context
+*               now           - current time in msec since the epoch
+*               clients_total - number of active and waiting clients of all batches
+*               caps          - call attempts per second of the latest interval
+* Return Code/Output - None
+****************************************************************************************/
+void metrics_snapshot_publish (batch_context* bctx,
+                               unsigned long now,
+                               int clients_total,
+                               unsigned long caps)
+{
+        metrics_snapshot* snap;
+        int i, k;
+        const int batches_num = threads_subbatches_num ? threads_subbatches_num : 1;
+
+        if (listen_fd == -1)
+                return;
+
+        snap = (snapshot_current == &snapshots[0]) ? &snapshots[1] : &snapshots[0];
+
+        snap->timestamp = now;
+        snap->seconds_run = (now - bctx->start_time) / 1000;
+        snap->clients_total = clients_total;
+        snap->caps = caps;
+        snap->calls_total = bctx->op_total.call_init_count;
+        snap->http = bctx->http_total;
+        snap->https = bctx->https_total;
+        snap->clients_active = snap->clients_sleeping = 0;
+
+        memset (snap->urls, 0, metrics_urls_num * sizeof (metrics_url_point));
+
+        for (i = 0; i < batches_num; i++)
+        {
+                batch_context* sub = bctx + i;
+
+                snap->clients_active += sub->active_clients_count;
+                snap->clients_sleeping += sub->sleeping_clients_count;
+
+                if (!sub->url_stats)
+                        continue;
+
+                for (k = 0; k < metrics_urls_num && k < sub->urls_num; k++)
+                {
+                        stat_point_add (&snap->urls[k].st, &sub->url_stats[k]);
+                }
+        }
+
+        for (k = 0; k < metrics_urls_num && k < (int) bctx->op_total.url_num; k++)
+        {
+                snap->urls[k].ok = bctx->op_total.url_ok[k];
+                snap->urls[k].failed = bctx->op_total.url_failed[k];
+                snap->urls[k].timeouted = bctx->op_total.url_timeouted[k];
+                memcpy (snap->urls[k].errs,
+                        &bctx->op_total.url_errs[k * OP_ERR_CLASSES_NUM],
+                        sizeof (snap->urls[k].errs));
+        }
+
+        __sync_synchronize ();
+        snapshot_current = snap;
+}
+
+/****************************************************************************************
+* Function name - metrics_fdset
+*
+* Description - Smooth mode: adds descriptors of the listener and its connections
+*               to the select () sets.
+*
+* Input/Output - *rd, *wr - read and write descriptor sets
+*                *maxfd   - the maximum descriptor, updated
+* Return Code/Output - None
+****************************************************************************************/
+void metrics_fdset (fd_set* rd, fd_set* wr, int* maxfd)
+{
+        int i;
+
+        if (listen_fd == -1 || metrics_eb)
+                return;
+
+        FD_SET (listen_fd, rd);
+        if (listen_fd > *maxfd)
+                *maxfd = listen_fd;
+
+        for (i = 0; i < METRICS_CONN_MAX; i++)
+        {
+                metrics_conn* conn = &conns[i];
+
+                if (conn->state == METRICS_CONN_FREE)
+                        continue;
+
+                FD_SET (conn->fd, conn->state == METRICS_CONN_READING ? rd : wr);
+
+                if (conn->fd > *maxfd)
+                        *maxfd = conn->fd;
+        }
+}
+
+/****************************************************************************************
+* Function name - metrics_fdset_process
+*
+* Description - Smooth mode: serves the listener descriptors, reported by select ()
+*
+* Input -       *rd, *wr - read and write descriptor sets
+* Return Code/Output - None
+****************************************************************************************/
+void metrics_fdset_process (fd_set* rd, fd_set* wr)
+{
+        int i;
+
+        if (listen_fd == -1 || metrics_eb)
+                return;
+
+        for (i = 0; i < METRICS_CONN_MAX; i++)
+        {
+                metrics_conn* conn = &conns[i];
+
+                if (conn->state == METRICS_CONN_READING && FD_ISSET (conn->fd, rd))
+                {
+                        metrics_conn_read (conn);
+                }
+                else if (conn->state == METRICS_CONN_WRITING && FD_ISSET (conn->fd, wr))
+                {
+                        metrics_conn_write (conn);
+                }
+        }
+
+        if (FD_ISSET (listen_fd, rd))
+        {
+                metrics_accept ();
+        }
+}
+
+/*================= STATIC FUNCTIONS =================== */
+
+/****************************************************************************************
+* Function name - metrics_accept
+*
+* Description - Accepts scrape connections, while there are free connection slots
+*
+* Return Code/Output - None
+****************************************************************************************/
+static void metrics_accept (void)
+{
+        int fd, i;
+
+        while ((fd = accept (listen_fd, NULL, NULL)) != -1)
+        {
+                metrics_conn* conn = NULL;
+
+                for (i = 0; i < METRICS_CONN_MAX; i++)
+                {
+                        if (conns[i].state == METRICS_CONN_FREE)
+                        {
+                                conn = &conns[i];
+                                break;
+                        }
+                }
+
+                if (!conn)
+                {
+                        /* Too many scrapers. Drop it. */
+                        close (fd);
+                        continue;
+                }
+
+                fcntl (fd, F_SETFL, fcntl (fd, F_GETFL) | O_NONBLOCK);
+
+                conn->fd = fd;
+                conn->state = METRICS_CONN_READING;
+                conn->req_len = 0;
+
+                metrics_conn_events (conn);
+        }
+}
+
+/****************************************************************************************
+* Function name - metrics_conn_read
+*
+* Description - Reads request head from a scrape connection and, when the head is
+*               complete, prepares the response and switches to writing.
+*
+* Input -       *conn - pointer to the metrics connection
+* Return Code/Output - None
+****************************************************************************************/
+static void metrics_conn_read (metrics_conn* conn)
+{
+        ssize_t rc;
+
+        rc = recv (conn->fd, conn->req + conn->req_len,
+                   sizeof (conn->req) - conn->req_len - 1, 0);
+
+        if (rc == 0 || (rc == -1 && errno != EAGAIN && errno != EINTR))
+        {
+                metrics_conn_close (conn);
+                return;
+        }
+        else if (rc == -1)
+        {
+                return;
+        }
+
+        conn->req_len += rc;
+        conn->req[conn->req_len] = '\0';
+
+        if (!strstr (conn->req, "\r\n\r\n") && !strstr (conn->req, "\n\n"))
+        {
+                if (conn->req_len >= sizeof (conn->req) - 1)
+                {
+                        metrics_conn_close (conn);
+                }
+                return;
+        }
+
+        if (metrics_respond (conn) == -1)
+        {
+                metrics_conn_close (conn);
+                return;
+        }
+
+        conn->state = METRICS_CONN_WRITING;
+        metrics_conn_events (conn);
+        metrics_conn_write (conn);
+}
+
+/****************************************************************************************
+* Function name - metrics_conn_write
+*
+* Description - Sends as much of the response as the socket accepts. Closes the
+*               connection, when all is sent.
+*
+* Input -       *conn - pointer to the metrics connection
+* Return Code/Output - None
+****************************************************************************************/
+static void metrics_conn_write (metrics_conn* conn)
+{
+        ssize_t rc;
+
+        while (conn->resp_sent < conn->resp_len)
+        {
+                rc = send (conn->fd, conn->resp + conn->resp_sent,
+                           conn->resp_len - conn->resp_sent, MSG_NOSIGNAL);
+
+                if (rc == -1)
+                {
+                        if (errno == EAGAIN || errno == EINTR)
+                                return;
+                        break;
+                }
+
+                conn->resp_sent += rc;
+        }
+
+        metrics_conn_close (conn);
+}
+
+/****************************************************************************************
+* Function name - metrics_conn_close
+*
+* Description - Closes a scrape connection and frees its slot
+*
+* Input -       *conn - pointer to the metrics connection
+* Return Code/Output - None
+****************************************************************************************/
+static void metrics_conn_close (metrics_conn* conn)
+{
+        if (conn->state == METRICS_CONN_FREE)
+                return;
+
+        if (conn->evset)
+        {
+                event_del (&conn->ev);
+                conn->evset = 0;
+        }
+
+        close (conn->fd);
+        conn->fd = -1;
+
+        free (conn->resp);
+        conn->resp = NULL;
+        conn->resp_len = conn->resp_sent = 0;
+        conn->req_len = 0;
+
+        conn->state = METRICS_CONN_FREE;
+}
+
+/****************************************************************************************
+* Function name - metrics_conn_events
+*
+* Description - Hyper mode: (re)registers libevent event of a connection according
+*               to its state. In smooth mode the state is polled by metrics_fdset ().
+*
+* Input -       *conn - pointer to the metrics connection
+* Return Code/Output - None
+****************************************************************************************/
+static void metrics_conn_events (metrics_conn* conn)
+{
+        if (!metrics_eb)
+                return;
+
+        if (conn->evset)
+        {
+                event_del (&conn->ev);
+        }
+
+        event_set (&conn->ev, conn->fd,
+                   (conn->state == METRICS_CONN_READING ? EV_READ : EV_WRITE) | EV_PERSIST,
+                   metrics_conn_cb, conn);
+        event_base_set (metrics_eb, &conn->ev);
+        event_add (&conn->ev, NULL);
+        conn->evset = 1;
+}
+
+/****************************************************************************************
+* Function name - metrics_buf_printf
+*
+* Description - Appends formatted output to the rendering buffer
+*
+* Input -       *buf - pointer to the buffer
+*               *fmt - printf format
+* Return Code/Output - On Success - 0, on Error -1
+****************************************************************************************/
+static int metrics_buf_printf (metrics_buf* buf, const char* fmt, ...)
+{
+        va_list ap;
+        int n;
+
+        for (;;)
+        {
+                if (buf->size - buf->len < 256)
+                {
+                        size_t size = buf->size ? buf->size * 2 : 16384;
+                        char* data = realloc (buf->data, size);
+
+                        if (!data)
+                                return -1;
+
+                        buf->data = data;
+                        buf->size = size;
+                }
+
+                va_start (ap, fmt);
+                n = vsnprintf (buf->data + buf->len, buf->size - buf->len, fmt, ap);
+                va_end (ap);
+
+                if (n < 0)
+                        return -1;
+
+                if ((size_t) n < buf->size - buf->len)
+                {
+                        buf->len += n;
+                        return 0;
+                }
+
+                {
+                        const size_t size = buf->len + n + 1;
+                        char* data = realloc (buf->data, size);
+
+                        if (!data)
+                                return -1;
+
+                        buf->data = data;
+                        buf->size = size;
+                }
+        }
+}
+
+/****************************************************************************************
+* Function name - metrics_label_escape
+*
+* Description - Escapes a label value according to the exposition format
+*
+* Input -       *in  - label value
+*               *out - output buffer
+*               size - size of the output buffer
+* Return Code/Output - pointer to the output buffer
+****************************************************************************************/
+static char* metrics_label_escape (const char* in, char* out, size_t size)
+{
+        size_t j = 0;
+
+        for (; in && *in && j + 2 < size; in++)
+        {
+                if (*in == '\\' || *in == '"')
+                {
+                        out[j++] = '\\';
+                        out[j++] = *in;
+                }
+                else if (*in == '\n')
+                {
+                        out[j++] = '\\';
+                        out[j++] = 'n';
+                }
+                else
+                {
+                        out[j++] = *in;
+                }
+        }
+        out[j] = '\0';
+
+        return out;
+}
+
+/****************************************************************************************
+* Function name - metrics_render_histogram
+*
+* Description - Renders response time histogram of a stat_point with the given labels
+*
+* Input -       *buf    - pointer to the rendering buffer
+*               *labels - labels string without braces
+*               *sp     - pointer to the stat_point
+* Return Code/Output - On Success - 0, on Error -1
+****************************************************************************************/
+static int metrics_render_histogram (metrics_buf* buf,
+                                     const char* labels,
+                                     stat_point* sp)
+{
+        unsigned long long cumulative = 0;
+        int k;
+
+        for (k = 0; k < STAT_RESP_HIST_BUCKETS; k++)
+        {
+                const unsigned long bound = stat_resp_hist_bound (k);
+
+                cumulative += sp->resp_hist[k];
+
+                if (k < STAT_RESP_HIST_BUCKETS - 1)
+                {
+                        if (metrics_buf_printf (buf,
+                                                "curl_loader_response_time_seconds_bucket{%s,le=\"%lu.%03lu\"} %llu\n",
+                                                labels, bound / 1000, bound % 1000, cumulative) == -1)
+                                return -1;
+                }
+                else
+                {
+                        if (metrics_buf_printf (buf,
+                                                "curl_loader_response_time_seconds_bucket{%s,le=\"+Inf\"} %llu\n",
+                                                labels, cumulative) == -1)
+                                return -1;
+                }
+        }
+
+        return metrics_buf_printf (buf,
+                                   "curl_loader_response_time_seconds_count{%s} %llu\n"
+                                   "curl_loader_response_time_seconds_sum{%s} %llu.%03llu\n",
+                                   labels, cumulative,
+                                   labels, sp->resp_hist_sum / 1000, sp->resp_hist_sum % 1000);
+}
+
+/****************************************************************************************
+* Function name - metrics_render_tcpi_histogram
+*
+* Description - Renders histogram of a TCP_INFO metric of an url with the given labels
+*
+* Input -       *buf    - pointer to the rendering buffer
+*               *name   - name of the family
+*               *labels - labels string without braces
+*               *hist   - pointer to the histogram
+*               metric  - the metric; RTT metrics are rendered in seconds
+* Return Code/Output - On Success - 0, on Error -1
+****************************************************************************************/
+static int metrics_render_tcpi_histogram (metrics_buf* buf,
+                                          const char* name,
+                                          const char* labels,
+                                          tcpi_hist* hist,
+                                          tcpi_metric metric)
+{
+        const int usec = (metric == TCPI_RTT || metric == TCPI_RTTVAR);
+        unsigned long long cumulative = 0;
+        int k;
+
+        for (k = 0; k < STAT_TCPI_HIST_BUCKETS; k++)
+        {
+                const unsigned long bound = stat_tcpi_hist_bound (metric, k);
+                int rval;
+
+                cumulative += hist->count[k];
+
+                if (k == STAT_TCPI_HIST_BUCKETS - 1)
+                        rval = metrics_buf_printf (buf, "curl_loader_%s_bucket{%s,le=\"+Inf\"} %llu\n",
+                                                   name, labels, cumulative);
+                else if (usec)
+                        rval = metrics_buf_printf (buf, "curl_loader_%s_bucket{%s,le=\"%lu.%06lu\"} %llu\n",
+                                                   name, labels, bound / 1000000, bound % 1000000,
+                                                   cumulative);
+                else
+                        rval = metrics_buf_printf (buf, "curl_loader_%s_bucket{%s,le=\"%lu\"} %llu\n",
+                                                   name, labels, bound, cumulative);
+                if (rval == -1)
+                        return -1;
+        }
+
+        if (usec)
+                return metrics_buf_printf (buf,
+                                           "curl_loader_%s_count{%s} %llu\n"
+                                           "curl_loader_%s_sum{%s} %llu.%06llu\n",
+                                           name, labels, cumulative,
+                                           name, labels, hist->sum / 1000000, hist->sum % 1000000);
+
+        return metrics_buf_printf (buf,
+                                   "curl_loader_%s_count{%s} %llu\n"
+                                   "curl_loader_%s_sum{%s} %llu\n",
+                                   name, labels, cumulative,
+                                   name, labels, hist->sum);
+}
+
+/****************************************************************************************
+* Function name - metrics_render_family
+*
+* Description - Renders samples of a counter family for both protocols and all urls
+*
+* Input -       *buf  - pointer to the rendering buffer
+*               *snap - pointer to the snapshot
+*               *name - name of the family
+*               *help - help string
+*               offset - offset of the counter field in stat_point
+*               is_64  - the field is unsigned long long
+* Return Code/Output - On Success - 0, on Error -1
+****************************************************************************************/
+static int metrics_render_family (metrics_buf* buf,
+                                  metrics_snapshot* snap,
+                                  const char* name,
+                                  const char* help,
+                                  size_t offset,
+                                  int is_64)
+{
+        char esc[2 * (URL_SHORT_NAME_LEN + 1)];
+        int k;
+
+#define STAT_FIELD(sp) (is_64 ? *(unsigned long long *)((char *)(sp) + offset) : \
+                        (unsigned long long) *(unsigned long *)((char *)(sp) + offset))
+
+        if (metrics_buf_printf (buf,
+                                "# TYPE curl_loader_%s counter\n"
+                                "# HELP curl_loader_%s %s\n"
+                                "curl_loader_%s_total{proto=\"http\"} %llu\n"
+                                "curl_loader_%s_total{proto=\"https\"} %llu\n",
+                                name, name, help,
+                                name, STAT_FIELD (&snap->http),
+                                name, STAT_FIELD (&snap->https)) == -1)
+                return -1;
+
+        for (k = 0; k < metrics_urls_num; k++)
+        {
+                if (metrics_buf_printf (buf,
+                                        "curl_loader_%s_total{url=\"%d\",name=\"%s\"} %llu\n",
+                                        name, k,
+                                        metrics_label_escape (metrics_urls[k].url_short_name,
+                                                              esc, sizeof (esc)),
+                                        STAT_FIELD (&snap->urls[k].st)) == -1)
+                        return -1;
+        }
+
+#undef STAT_FIELD
+
+        return 0;
+}
+
+/****************************************************************************************
+* Function name - metrics_render
+*
+* Description - Renders the snapshot in OpenMetrics text format
+*
+* Input -       *buf  - pointer to the rendering buffer
+*               *snap - pointer to the snapshot; may be NULL before the first interval
+* Return Code/Output - On Success - 0, on Error -1
+****************************************************************************************/
+static int metrics_render (metrics_buf* buf, metrics_snapshot* snap)
+{
+        static const struct
+        {
+                const char* name;
+                const char* help;
+                size_t offset;
+                int is_64;
+        } families[] =
+        {
+                {"requests", "Requests sent.", offsetof (stat_point, requests), 0},
+                {"responses_1xx", "1xx responses.", offsetof (stat_point, resp_1xx), 0},
+                {"responses_2xx", "2xx responses.", offsetof (stat_point, resp_2xx), 0},
+                {"responses_3xx", "3xx responses.", offsetof (stat_point, resp_3xx), 0},
+                {"responses_4xx", "4xx responses.", offsetof (stat_point, resp_4xx), 0},
+                {"responses_5xx", "5xx responses.", offsetof (stat_point, resp_5xx), 0},
+                {"errors", "Resolving, connecting and other errors.",
+                 offsetof (stat_point, other_errs), 0},
+                {"url_timeouts", "Url completion timeouts.",
+                 offsetof (stat_point, url_timeout_errs), 0},
+                {"received_bytes", "Inbound bytes.", offsetof (stat_point, data_in), 1},
+                {"sent_bytes", "Outbound bytes.", offsetof (stat_point, data_out), 1},
+        };
+        static const struct
+        {
+                const char* name;
+                const char* unit;
+                const char* help;
+                tcpi_metric metric;
+        } tcpi_families[] =
+        {
+                {"tcp_rtt_seconds", "# UNIT curl_loader_tcp_rtt_seconds seconds\n",
+                 "Smoothed RTT of connections at transfer completion.", TCPI_RTT},
+                {"tcp_rttvar_seconds", "# UNIT curl_loader_tcp_rttvar_seconds seconds\n",
+                 "RTT variance of connections at transfer completion.", TCPI_RTTVAR},
+                {"tcp_retransmits", "",
+                 "Retransmitted segments of connections at transfer completion.", TCPI_RETRANS},
+                {"tcp_cwnd_segments", "",
+                 "Congestion window of connections at transfer completion.", TCPI_CWND},
+        };
+        char esc[2 * (URL_SHORT_NAME_LEN + 1)];
+        char labels[64 + sizeof (esc)];
+        size_t i;
+        int k;
+
+        if (!snap)
+        {
+                return metrics_buf_printf (buf, "# EOF\n");
+        }
+
+        if (metrics_buf_printf (buf,
+                                "# TYPE curl_loader_clients_active gauge\n"
+                                "# HELP curl_loader_clients_active Clients doing requests.\n"
+                                "curl_loader_clients_active %d\n"
+                                "# TYPE curl_loader_clients_sleeping gauge\n"
+                                "# HELP curl_loader_clients_sleeping Clients sleeping after url timeouts.\n"
+                                "curl_loader_clients_sleeping %d\n"
+                                "# TYPE curl_loader_clients gauge\n"
+                                "# HELP curl_loader_clients Active and waiting clients.\n"
+                                "curl_loader_clients %d\n"
+                                "# TYPE curl_loader_caps gauge\n"
+                                "# HELP curl_loader_caps Call attempts per second in the latest interval.\n"
+                                "curl_loader_caps %lu\n"
+                                "# TYPE curl_loader_calls counter\n"
+                                "# HELP curl_loader_calls Call attempts since the load start.\n"
+                                "curl_loader_calls_total %lu\n"
+                                "# TYPE curl_loader_run_seconds gauge\n"
+                                "# HELP curl_loader_run_seconds Seconds since the load start.\n"
+                                "curl_loader_run_seconds %lu\n",
+                                snap->clients_active,
+                                snap->clients_sleeping,
+                                snap->clients_total,
+                                snap->caps,
+                                snap->calls_total,
+                                snap->seconds_run) == -1)
+                return -1;
+
+        for (i = 0; i < sizeof (families) / sizeof (families[0]); i++)
+        {
+                if (metrics_render_family (buf, snap,
+                                           families[i].name,
+                                           families[i].help,
+                                           families[i].offset,
+                                           families[i].is_64) == -1)
+                        return -1;
+        }
+
+        if (metrics_buf_printf (buf,
+                                "# TYPE curl_loader_url_operations counter\n"
+                                "# HELP curl_loader_url_operations Url fetches by result.\n") == -1)
+                return -1;
+
+        for (k = 0; k < metrics_urls_num; k++)
+        {
+                metrics_label_escape (metrics_urls[k].url_short_name, esc, sizeof (esc));
+
+                if (metrics_buf_printf (buf,
+                                        "curl_loader_url_operations_total{url=\"%d\",name=\"%s\",result=\"ok\"} %lu\n"
+                                        "curl_loader_url_operations_total{url=\"%d\",name=\"%s\",result=\"failed\"} %lu\n"
+                                        "curl_loader_url_operations_total{url=\"%d\",name=\"%s\",result=\"timeouted\"} %lu\n",
+                                        k, esc, snap->urls[k].ok,
+                                        k, esc, snap->urls[k].failed,
+                                        k, esc, snap->urls[k].timeouted) == -1)
+                        return -1;
+        }
+
+        if (metrics_buf_printf (buf,
+                                "# TYPE curl_loader_url_errors counter\n"
+                                "# HELP curl_loader_url_errors Failed url fetches by error class.\n") == -1)
+                return -1;
+
+        for (k = 0; k < metrics_urls_num; k++)
+        {
+                int e;
+
+                metrics_label_escape (metrics_urls[k].url_short_name, esc, sizeof (esc));
+
+                for (e = 0; e < OP_ERR_CLASSES_NUM; e++)
+                {
+                        if (metrics_buf_printf (buf,
+                                                "curl_loader_url_errors_total{url=\"%d\",name=\"%s\",class=\"%s\"} %lu\n",
+                                                k, esc, op_err_class_name (e),
+                                                snap->urls[k].errs[e]) == -1)
+                                return -1;
+                }
+        }
+
+        if (metrics_buf_printf (buf,
+                                "# TYPE curl_loader_response_time_seconds histogram\n"
+                                "# UNIT curl_loader_response_time_seconds seconds\n"
+                                "# HELP curl_loader_response_time_seconds Delay between request and response.\n") == -1)
+                return -1;
+
+        if (metrics_render_histogram (buf, "proto=\"http\"", &snap->http) == -1 ||
+            metrics_render_histogram (buf, "proto=\"https\"", &snap->https) == -1)
+                return -1;
+
+        for (k = 0; k < metrics_urls_num; k++)
+        {
+                snprintf (labels, sizeof (labels), "url=\"%d\",name=\"%s\"", k,
+                          metrics_label_escape (metrics_urls[k].url_short_name,
+                                                esc, sizeof (esc)));
+
+                if (metrics_render_histogram (buf, labels, &snap->urls[k].st) == -1)
+                        return -1;
+        }
+
+        for (i = 0; tcp_info_sample_rate && i < sizeof (tcpi_families) / sizeof (*tcpi_families); i++)
+        {
+                const tcpi_metric m = tcpi_families[i].metric;
+
+                if (metrics_buf_printf (buf,
+                                        "# TYPE curl_loader_%s histogram\n"
+                                        "%s"
+                                        "# HELP curl_loader_%s %s\n",
+                                        tcpi_families[i].name,
+                                        tcpi_families[i].unit,
+                                        tcpi_families[i].name, tcpi_families[i].help) == -1)
+                        return -1;
+
+                for (k = 0; k < metrics_urls_num; k++)
+                {
+                        snprintf (labels, sizeof (labels), "url=\"%d\",name=\"%s\"", k,
+                                  metrics_label_escape (metrics_urls[k].url_short_name,
+                                                        esc, sizeof (esc)));
+
+                        if (metrics_render_tcpi_histogram (buf, tcpi_families[i].name, labels,
+                                                           &snap->urls[k].st.tcpi[m], m) == -1)
+                                return -1;
+                }
+        }
+
+        return metrics_buf_printf (buf, "# EOF\n");
+}
+
+/****************************************************************************************
+* Function name - metrics_respond
+*
+* Description - Prepares HTTP response for a complete request head. GET of
+*               /metrics is rendered from the current snapshot; anything else
+*               gets 404.
+*
+* Input -       *conn - pointer to the metrics connection
+* Return Code/Output - On Success - 0, on Error -1
+****************************************************************************************/
+static int metrics_respond (metrics_conn* conn)
+{
+        metrics_buf body;
+        char head[256];
+        int head_len;
+        const int found = !strncmp (conn->req, "GET /metrics ", 13) ||
+                          !strncmp (conn->req, "GET /metrics?", 13) ||
+                          !strncmp (conn->req, "GET / ", 6);
+
+        memset (&body, 0, sizeof (body));
+
+        if (found)
+        {
+                if (metrics_render (&body, snapshot_current) == -1)
+                {
+                        free (body.data);
+                        return -1;
+                }
+        }
+
+        head_len = snprintf (head, sizeof (head),
+                             "HTTP/1.1 %s\r\n"
+                             "Content-Type: %s\r\n"
+                             "Content-Length: %lu\r\n"
+                             "Connection: close\r\n\r\n",
+                             found ? "200 OK" : "404 Not Found",
+                             found ? METRICS_CONTENT_TYPE : "text/plain",
+                             (unsigned long) body.len);
+
+        if (!(conn->resp = malloc (head_len + body.len)))
+        {
+                free (body.data);
+                return -1;
+        }
+
+        memcpy (conn->resp, head, head_len);
+        if (body.len)
+        {
+                memcpy (conn->resp + head_len, body.data, body.len);
+        }
+
+        conn->resp_len = head_len + body.len;
+        conn->resp_sent = 0;
+
+        free (body.data);
+        return 0;
+}
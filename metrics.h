@@ -0,0 +1,104 @@
+/*
+*     metrics.h
+*
+* 2006-2007 Copyright (c)
+* Robert Iakobashvili, <coroberti@gmail.com>
+* Michael Moser,  <moser.michael@gmail.com>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <sys/select.h>
+
+/*
+   Embedded HTTP listener, exposing loading statistics in OpenMetrics
+   (Prometheus) text format. The listener is run only by the batch group
+   leader from its own event loop: libevent in hyper mode and select ()
+   in smooth mode. Scrapes are served from a snapshot, published by the
+   leader at each statistics interval, and never touch the live counters.
+   The per-url counters of the other threads are copied to the snapshot
+   without locking, as the statistics intervals collect them, and may be
+   read in the middle of an update.
+ */
+
+struct batch_context;
+struct event_base;
+
+/****************************************************************************************
+* Function name - metrics_init
+*
+* Description - Opens the listening socket on metrics_port and allocates the
+*               snapshot buffers. When <eb> is not NULL, the listener is
+*               served by libevent, otherwise by metrics_fdset ().
+*
+* Input -       *bctx - pointer to the batch group leader context
+*               *eb   - libevent event base of the leader (hyper mode) or NULL
+* Return Code/Output - On Success - 0, on Error -1
+****************************************************************************************/
+int metrics_init (struct batch_context* bctx, struct event_base* eb);
+
+/****************************************************************************************
+* Function name - metrics_release
+*
+* Description - Closes the listener and its connections, frees snapshots
+*
+* Return Code/Output - None
+****************************************************************************************/
+void metrics_release ();
+
+/****************************************************************************************
+* Function name - metrics_snapshot_publish
+*
+* Description - Copies the total counters of all sub-batches to the spare snapshot
+*               and makes it the current one for scrapes.
+*
+* Input -       *bctx         - pointer to the batch group leader context
+*               now           - current time in msec since the epoch
+*               clients_total - number of active and waiting clients of all batches
+*               caps          - call attempts per second of the latest interval
+* Return Code/Output - None
+****************************************************************************************/
+void metrics_snapshot_publish (struct batch_context* bctx,
+                               unsigned long now,
+                               int clients_total,
+                               unsigned long caps);
+
+/****************************************************************************************
+* Function name - metrics_fdset
+*
+* Description - Smooth mode: adds descriptors of the listener and its connections
+*               to the select () sets.
+*
+* Input/Output - *rd, *wr - read and write descriptor sets
+*                *maxfd   - the maximum descriptor, updated
+* Return Code/Output - None
+****************************************************************************************/
+void metrics_fdset (fd_set* rd, fd_set* wr, int* maxfd);
+
+/****************************************************************************************
+* Function name - metrics_fdset_process
+*
+* Description - Smooth mode: serves the listener descriptors, reported by select ()
+*
+* Input -       *rd, *wr - read and write descriptor sets
+* Return Code/Output - None
+****************************************************************************************/
+void metrics_fdset_process (fd_set* rd, fd_set* wr);
+
+#endif /* METRICS_H */
@@ -45,6 +45,12 @@
 #include "client.h"
 #include "cl_alloc.h"
 #include "url.h"
+#include "keyval.h"
+#include "topk.h"
+#include "share.h"
+#include "tls_rate.h"
+#include "dns_pin.h"
+#include "fast.h"
 
 extern char * strcasestr(const char *, const char *);
 
@@ -115,6 +121,27 @@ static int run_time_parser (batch_context*const bctx, char*const value);
 static int user_agent_parser (batch_context*const bctx, char*const value);
 static int urls_num_parser (batch_context*const bctx, char*const value);
 static int dump_opstats_parser (batch_context*const bctx, char*const value);
+static int dump_clients_parser (batch_context*const bctx, char*const value);
+static int log_resp_segments_parser (batch_context*const bctx, char*const value);
+static int handle_templates_parser (batch_context*const bctx, char*const value);
+static int share_scope_parser (batch_context*const bctx, char*const value);
+static int socket_linger_rst_parser (batch_context*const bctx, char*const value);
+static int tcp_nodelay_parser (batch_context*const bctx, char*const value);
+static int socket_sndbuf_parser (batch_context*const bctx, char*const value);
+static int socket_rcvbuf_parser (batch_context*const bctx, char*const value);
+static int ip_bind_address_no_port_parser (batch_context*const bctx, char*const value);
+static int local_port_min_parser (batch_context*const bctx, char*const value);
+static int local_port_max_parser (batch_context*const bctx, char*const value);
+static int local_port_partition_parser (batch_context*const bctx, char*const value);
+static int dns_mode_parser (batch_context*const bctx, char*const value);
+static int dns_refresh_interval_parser (batch_context*const bctx, char*const value);
+static int engine_parser (batch_context*const bctx, char*const value);
+static int pool_connections_parser (batch_context*const bctx, char*const value);
+static int pool_in_flight_parser (batch_context*const bctx, char*const value);
+static int pool_step_duration_parser (batch_context*const bctx, char*const value);
+static int pipelining_parser (batch_context*const bctx, char*const value);
+static int max_host_connections_parser (batch_context*const bctx, char*const value);
+static int max_pipeline_length_parser (batch_context*const bctx, char*const value);
 static int req_rate_parser (batch_context*const bctx, char*const value);
 
 /*
@@ -143,6 +170,9 @@ static int proxy_auth_method_parser (batch_context*const bctx, char*const value)
 static int proxy_auth_credentials_parser (batch_context*const bctx, char*const value);
 
 static int fresh_connect_parser (batch_context*const bctx, char*const value);
+static int share_parser (batch_context*const bctx, char*const value);
+static int tls_handshake_parser (batch_context*const bctx, char*const value);
+static int tls_ciphers_parser (batch_context*const bctx, char*const value);
 
 static int timer_tcp_conn_setup_parser (batch_context*const bctx, char*const value);
 static int timer_url_completion_parser (batch_context*const bctx, char*const value);
@@ -193,6 +223,27 @@ static const tag_parser_pair tp_map [] =
         {"USER_AGENT", user_agent_parser},
         {"URLS_NUM", urls_num_parser},
         {"DUMP_OPSTATS", dump_opstats_parser},
+        {"DUMP_CLIENTS", dump_clients_parser},
+        {"LOG_RESP_SEGMENTS", log_resp_segments_parser},
+        {"HANDLE_TEMPLATES", handle_templates_parser},
+        {"SHARE_SCOPE", share_scope_parser},
+        {"SOCKET_LINGER_RST", socket_linger_rst_parser},
+        {"TCP_NODELAY", tcp_nodelay_parser},
+        {"SOCKET_SNDBUF", socket_sndbuf_parser},
+        {"SOCKET_RCVBUF", socket_rcvbuf_parser},
+        {"IP_BIND_ADDRESS_NO_PORT", ip_bind_address_no_port_parser},
+        {"LOCAL_PORT_MIN", local_port_min_parser},
+        {"LOCAL_PORT_MAX", local_port_max_parser},
+        {"LOCAL_PORT_PARTITION", local_port_partition_parser},
+        {"DNS_MODE", dns_mode_parser},
+        {"DNS_REFRESH_INTERVAL", dns_refresh_interval_parser},
+        {"ENGINE", engine_parser},
+        {"POOL_CONNECTIONS", pool_connections_parser},
+        {"POOL_IN_FLIGHT", pool_in_flight_parser},
+        {"POOL_STEP_DURATION", pool_step_duration_parser},
+        {"PIPELINING", pipelining_parser},
+        {"MAX_HOST_CONNECTIONS", max_host_connections_parser},
+        {"MAX_PIPELINE_LENGTH", max_pipeline_length_parser},
         {"REQ_RATE", req_rate_parser},
 
 
@@ -221,6 +272,9 @@ static const tag_parser_pair tp_map [] =
         {"PROXY_AUTH_CREDENTIALS", proxy_auth_credentials_parser},
 
         {"FRESH_CONNECT", fresh_connect_parser},
+        {"SHARE", share_parser},
+        {"TLS_HANDSHAKE", tls_handshake_parser},
+        {"TLS_CIPHERS", tls_ciphers_parser},
 
         {"TIMER_TCP_CONN_SETUP", timer_tcp_conn_setup_parser},
         {"TIMER_URL_COMPLETION", timer_url_completion_parser},
@@ -1022,6 +1076,339 @@ static int dump_opstats_parser (batch_context*const bctx, char*const value)
         return 0;
 }
 
+static int dump_clients_parser (batch_context*const bctx, char*const value)
+{
+        if (value[0] == 'Y' || value[0] == 'y' ||
+            value[0] == 'N' || value[0] == 'n')
+                bctx->dump_clients = (value[0] == 'Y' || value[0] == 'y');
+        else
+        {
+                fprintf (stderr,
+                         "%s - error: DUMP_CLIENTS value (%s) must start with Y|y|N|n.\n",
+                         __func__, value);
+                return -1;
+        }
+        return 0;
+}
+
+static int log_resp_segments_parser (batch_context*const bctx, char*const value)
+{
+        if (value[0] == 'Y' || value[0] == 'y' ||
+            value[0] == 'N' || value[0] == 'n')
+                bctx->log_resp_segments = (value[0] == 'Y' || value[0] == 'y');
+        else
+        {
+                fprintf (stderr,
+                         "%s - error: LOG_RESP_SEGMENTS value (%s) must start with Y|y|N|n.\n",
+                         __func__, value);
+                return -1;
+        }
+        return 0;
+}
+
+static int handle_templates_parser (batch_context*const bctx, char*const value)
+{
+        if (value[0] == 'Y' || value[0] == 'y' ||
+            value[0] == 'N' || value[0] == 'n')
+                bctx->use_handle_templates = (value[0] == 'Y' || value[0] == 'y');
+        else
+        {
+                fprintf (stderr,
+                         "%s - error: HANDLE_TEMPLATES value (%s) must start with Y|y|N|n.\n",
+                         __func__, value);
+                return -1;
+        }
+        return 0;
+}
+
+static int share_scope_parser (batch_context*const bctx, char*const value)
+{
+        if (!strcmp (value, "BATCH"))
+                bctx->share_scope = SHARE_SCOPE_BATCH;
+        else if (!strcmp (value, "GLOBAL"))
+                bctx->share_scope = SHARE_SCOPE_GLOBAL;
+        else
+        {
+                fprintf (stderr,
+                         "%s - error: SHARE_SCOPE value (%s) must be BATCH or GLOBAL.\n",
+                         __func__, value);
+                return -1;
+        }
+        return 0;
+}
+
+static int socket_linger_rst_parser (batch_context*const bctx, char*const value)
+{
+        if (value[0] == 'Y' || value[0] == 'y' ||
+            value[0] == 'N' || value[0] == 'n')
+                bctx->sock_linger_rst = (value[0] == 'Y' || value[0] == 'y');
+        else
+        {
+                fprintf (stderr,
+                         "%s - error: SOCKET_LINGER_RST value (%s) must start with Y|y|N|n.\n",
+                         __func__, value);
+                return -1;
+        }
+        return 0;
+}
+
+static int tcp_nodelay_parser (batch_context*const bctx, char*const value)
+{
+        if (value[0] == 'Y' || value[0] == 'y' ||
+            value[0] == 'N' || value[0] == 'n')
+                bctx->sock_nodelay = (value[0] == 'Y' || value[0] == 'y') ? 1 : -1;
+        else
+        {
+                fprintf (stderr,
+                         "%s - error: TCP_NODELAY value (%s) must start with Y|y|N|n.\n",
+                         __func__, value);
+                return -1;
+        }
+        return 0;
+}
+
+static int socket_sndbuf_parser (batch_context*const bctx, char*const value)
+{
+        bctx->sock_sndbuf = atoi (value);
+        if (bctx->sock_sndbuf < 0)
+        {
+                fprintf (stderr,
+                         "%s - error: SOCKET_SNDBUF value (%s) must be a number of bytes.\n",
+                         __func__, value);
+                return -1;
+        }
+        return 0;
+}
+
+static int socket_rcvbuf_parser (batch_context*const bctx, char*const value)
+{
+        bctx->sock_rcvbuf = atoi (value);
+        if (bctx->sock_rcvbuf < 0)
+        {
+                fprintf (stderr,
+                         "%s - error: SOCKET_RCVBUF value (%s) must be a number of bytes.\n",
+                         __func__, value);
+                return -1;
+        }
+        return 0;
+}
+
+static int ip_bind_address_no_port_parser (batch_context*const bctx, char*const value)
+{
+        if (value[0] == 'Y' || value[0] == 'y' ||
+            value[0] == 'N' || value[0] == 'n')
+                bctx->sock_bind_no_port = (value[0] == 'Y' || value[0] == 'y');
+        else
+        {
+                fprintf (stderr,
+                         "%s - error: IP_BIND_ADDRESS_NO_PORT value (%s) must start with Y|y|N|n.\n",
+                         __func__, value);
+                return -1;
+        }
+        return 0;
+}
+
+static int local_port_min_parser (batch_context*const bctx, char*const value)
+{
+        bctx->local_port_min = atoi (value);
+        if (bctx->local_port_min < 1 || bctx->local_port_min > 65535)
+        {
+                fprintf (stderr,
+                         "%s - error: LOCAL_PORT_MIN value (%s) must be from 1 to 65535.\n",
+                         __func__, value);
+                return -1;
+        }
+        return 0;
+}
+
+static int local_port_max_parser (batch_context*const bctx, char*const value)
+{
+        bctx->local_port_max = atoi (value);
+        if (bctx->local_port_max < 1 || bctx->local_port_max > 65535)
+        {
+                fprintf (stderr,
+                         "%s - error: LOCAL_PORT_MAX value (%s) must be from 1 to 65535.\n",
+                         __func__, value);
+                return -1;
+        }
+        return 0;
+}
+
+static int local_port_partition_parser (batch_context*const bctx, char*const value)
+{
+        if (!strcmp (value, "CLIENT"))
+                bctx->local_port_partition = LOCAL_PORT_PARTITION_CLIENT;
+        else if (!strcmp (value, "THREAD"))
+                bctx->local_port_partition = LOCAL_PORT_PARTITION_THREAD;
+        else
+        {
+                fprintf (stderr,
+                         "%s - error: LOCAL_PORT_PARTITION value (%s) must be CLIENT or THREAD.\n",
+                         __func__, value);
+                return -1;
+        }
+        return 0;
+}
+
+static int dns_mode_parser (batch_context*const bctx, char*const value)
+{
+        if (!strcmp (value, "DEFAULT"))
+                bctx->dns_mode = DNS_MODE_DEFAULT;
+        else if (!strcmp (value, "PIN"))
+                bctx->dns_mode = DNS_MODE_PIN;
+        else if (!strcmp (value, "PHASE"))
+                bctx->dns_mode = DNS_MODE_PHASE;
+        else
+        {
+                fprintf (stderr,
+                         "%s - error: DNS_MODE value (%s) must be DEFAULT, PIN or PHASE.\n",
+                         __func__, value);
+                return -1;
+        }
+        return 0;
+}
+
+static int dns_refresh_interval_parser (batch_context*const bctx, char*const value)
+{
+        bctx->dns_refresh_interval = atoi (value);
+        if (bctx->dns_refresh_interval < 0)
+        {
+                fprintf (stderr,
+                         "%s - error: DNS_REFRESH_INTERVAL value (%s) must be a number of seconds.\n",
+                         __func__, value);
+                return -1;
+        }
+        return 0;
+}
+
+static int engine_parser (batch_context*const bctx, char*const value)
+{
+        if (!strcmp (value, "CURL"))
+                bctx->engine = ENGINE_CURL;
+        else if (!strcmp (value, "FAST"))
+                bctx->engine = ENGINE_FAST;
+        else
+        {
+                fprintf (stderr,
+                         "%s - error: ENGINE value (%s) must be CURL or FAST.\n",
+                         __func__, value);
+                return -1;
+        }
+        return 0;
+}
+
+/*
+   POOL_CONNECTIONS value is a comma-separated list of the numbers of
+   connections of the steps, e.g. 8,16,32.
+ */
+static int pool_connections_parser (batch_context*const bctx, char*const value)
+{
+        char* token;
+        char* saveptr = NULL;
+
+        bctx->pool_conns_num = 0;
+
+        for (token = strtok_r (value, ", ", &saveptr); token;
+             token = strtok_r (NULL, ", ", &saveptr))
+        {
+                if (bctx->pool_conns_num == POOL_STEPS_MAX)
+                {
+                        fprintf (stderr,
+                                 "%s - error: POOL_CONNECTIONS has more than %d steps.\n",
+                                 __func__, POOL_STEPS_MAX);
+                        return -1;
+                }
+
+                if ((bctx->pool_conns[bctx->pool_conns_num++] = atoi (token)) < 1)
+                {
+                        fprintf (stderr,
+                                 "%s - error: POOL_CONNECTIONS value (%s) is not a positive number.\n",
+                                 __func__, token);
+                        return -1;
+                }
+        }
+        return 0;
+}
+
+static int pool_in_flight_parser (batch_context*const bctx, char*const value)
+{
+        bctx->pool_in_flight = atoi (value);
+        if (bctx->pool_in_flight < 1)
+        {
+                fprintf (stderr,
+                         "%s - error: POOL_IN_FLIGHT value (%s) must be a positive number.\n",
+                         __func__, value);
+                return -1;
+        }
+        return 0;
+}
+
+static int pool_step_duration_parser (batch_context*const bctx, char*const value)
+{
+        bctx->pool_step_duration = atoi (value);
+        if (bctx->pool_step_duration < 1)
+        {
+                fprintf (stderr,
+                         "%s - error: POOL_STEP_DURATION value (%s) must be a positive number of seconds.\n",
+                         __func__, value);
+                return -1;
+        }
+        return 0;
+}
+
+static int pipelining_parser (batch_context*const bctx, char*const value)
+{
+        if (!strcmp (value, "NO"))
+                bctx->pipelining = PIPELINING_OFF;
+        else if (!strcmp (value, "YES"))
+                bctx->pipelining = PIPELINING_ON;
+        else if (!strcmp (value, "MULTIPLEX"))
+        {
+#ifdef CURLPIPE_MULTIPLEX
+                bctx->pipelining = PIPELINING_MULTIPLEX;
+#else
+                fprintf (stderr,
+                         "%s - error: PIPELINING MULTIPLEX requires libcurl with HTTP/2 multiplexing.\n",
+                         __func__);
+                return -1;
+#endif
+        }
+        else
+        {
+                fprintf (stderr,
+                         "%s - error: PIPELINING value (%s) must be NO, YES or MULTIPLEX.\n",
+                         __func__, value);
+                return -1;
+        }
+        return 0;
+}
+
+static int max_host_connections_parser (batch_context*const bctx, char*const value)
+{
+        bctx->max_host_connections = atoi (value);
+        if (bctx->max_host_connections < 0)
+        {
+                fprintf (stderr,
+                         "%s - error: MAX_HOST_CONNECTIONS value (%s) must be a number of connections.\n",
+                         __func__, value);
+                return -1;
+        }
+        return 0;
+}
+
+static int max_pipeline_length_parser (batch_context*const bctx, char*const value)
+{
+        bctx->max_pipeline_length = atoi (value);
+        if (bctx->max_pipeline_length < 0)
+        {
+                fprintf (stderr,
+                         "%s - error: MAX_PIPELINE_LENGTH value (%s) must be a number of requests.\n",
+                         __func__, value);
+                return -1;
+        }
+        return 0;
+}
+
 static int req_rate_parser (batch_context*const bctx, char*const value)
 {
         bctx->req_rate = atol (value);
@@ -1878,26 +2265,91 @@ static int fresh_connect_parser (batch_context*const bctx, char*const value)
         return 0;
 }
 
-static int timer_tcp_conn_setup_parser (batch_context*const bctx, char*const value)
-{
-        long timer = atol (value);
+/*
+   SHARE value is a comma-separated list of DNS, SSL_SESSION and COOKIE,
+   or NONE.
+ */
+static int share_parser (batch_context*const bctx, char*const value)
+{
+        int share_data = 0;
+        char* token;
+        char* saveptr = NULL;
+
+        for (token = strtok_r (value, ", ", &saveptr); token;
+             token = strtok_r (NULL, ", ", &saveptr))
+        {
+                if (!strcmp (token, "DNS"))
+                        share_data |= SHARE_DATA_DNS;
+                else if (!strcmp (token, "SSL_SESSION"))
+                        share_data |= SHARE_DATA_SSL_SESSION;
+                else if (!strcmp (token, "COOKIE"))
+                        share_data |= SHARE_DATA_COOKIE;
+                else if (strcmp (token, "NONE"))
+                {
+                        fprintf (stderr,
+                                 "%s - error: SHARE value (%s) is not DNS, SSL_SESSION, "
+                                 "COOKIE or NONE.\n", __func__, token);
+                        return -1;
+                }
+        }
 
-        if (timer <= 0 || timer > 50)
+        bctx->url_ctx_array[bctx->url_index].share_data = share_data;
+        return 0;
+}
+
+static int tls_handshake_parser (batch_context*const bctx, char*const value)
+{
+        if (!strcmp (value, "FULL"))
+                bctx->url_ctx_array[bctx->url_index].tls_handshake = TLS_HANDSHAKE_FULL;
+        else if (!strcmp (value, "RESUMED"))
+                bctx->url_ctx_array[bctx->url_index].tls_handshake = TLS_HANDSHAKE_RESUMED;
+        else
         {
-                fprintf(stderr,
-                        "%s error: input of the timer is expected  to be from "
-                        "1 up to 50 seconds.\n", __func__);
+                fprintf (stderr,
+                         "%s - error: TLS_HANDSHAKE value (%s) must be FULL or RESUMED.\n",
+                         __func__, value);
                 return -1;
         }
-
-        bctx->url_ctx_array[bctx->url_index].connect_timeout= timer;
         return 0;
 }
-static int timer_url_completion_parser (batch_context*const bctx,
-                                        char*const value)
+
+static int tls_ciphers_parser (batch_context*const bctx, char*const value)
 {
-        long timer_lrange = 0;
-        long timer_hrange = 0;
+        if (!strlen (value))
+        {
+                fprintf(stderr, "%s - warning: empty TLS_CIPHERS\n", __func__);
+                return 0;
+        }
+
+        if (!(bctx->url_ctx_array[bctx->url_index].tls_ciphers = strdup (value)))
+        {
+                fprintf(stderr, "%s error: strdup () failed with errno %d.\n",
+                        __func__, errno);
+                return -1;
+        }
+        return 0;
+}
+
+static int timer_tcp_conn_setup_parser (batch_context*const bctx, char*const value)
+{
+        long timer = atol (value);
+
+        if (timer <= 0 || timer > 50)
+        {
+                fprintf(stderr,
+                        "%s error: input of the timer is expected  to be from "
+                        "1 up to 50 seconds.\n", __func__);
+                return -1;
+        }
+
+        bctx->url_ctx_array[bctx->url_index].connect_timeout= timer;
+        return 0;
+}
+static int timer_url_completion_parser (batch_context*const bctx,
+                                        char*const value)
+{
+        long timer_lrange = 0;
+        long timer_hrange = 0;
         size_t value_len = strlen (value) + 1;
 
         if (parse_timer_range (value,
@@ -2050,7 +2502,7 @@ static int response_status_errors_parser (batch_context*const bctx,
 
                 status = atol (token + 1);
 
-                if (status < 0 || status > URL_RESPONSE_STATUS_ERRORS_TABLE_SIZE)
+                if (status < 0 || status >= URL_RESPONSE_STATUS_ERRORS_TABLE_SIZE)
                 {
                         fprintf (stderr, "%s - error: token %s non valid.\n"
                                  "Each valid token should start from + or - with a following "
@@ -2205,6 +2657,62 @@ static int validate_batch_general (batch_context*const bctx)
                 return -1;
         }
 
+        /*
+           Connection-pool mode: the clients are the slots of the requests in
+           flight of the largest step, all taken at once.
+         */
+        if (loading_mode == LOAD_MODE_POOL)
+        {
+                int i, conns_max = 0;
+
+                if (!bctx->pool_conns_num)
+                {
+                        fprintf (stderr, "%s - error: POOL_CONNECTIONS is required by -m %d.\n",
+                                 __func__, LOAD_MODE_POOL);
+                        return -1;
+                }
+
+                if (bctx->engine == ENGINE_FAST)
+                {
+                        fprintf (stderr, "%s - error: ENGINE FAST is not supported by -m %d.\n",
+                                 __func__, LOAD_MODE_POOL);
+                        return -1;
+                }
+
+                if (!bctx->pool_in_flight)
+                        bctx->pool_in_flight = 1;
+
+                if (!bctx->pool_step_duration)
+                        bctx->pool_step_duration = POOL_STEP_DURATION_DEFAULT;
+
+                for (i = 0; i < bctx->pool_conns_num; i++)
+                {
+                        if (bctx->pool_conns[i] > conns_max)
+                                conns_max = bctx->pool_conns[i];
+                }
+
+                bctx->client_num_max = bctx->client_num_start =
+                        conns_max * bctx->pool_in_flight;
+                bctx->clients_rampup_inc = 0;
+                bctx->req_rate = 0;
+
+                /*
+                   Connections and pipelines are limited per step. The pipelining
+                   clients are bound to a single address and ports range, below,
+                   to share the connections.
+                 */
+                bctx->pipelining = bctx->pool_in_flight > 1 ? PIPELINING_ON : PIPELINING_OFF;
+        }
+
+        if (loading_mode != LOAD_MODE_POOL && !bctx->pipelining &&
+            (bctx->max_host_connections || bctx->max_pipeline_length))
+        {
+                fprintf (stderr,
+                         "%s - error: MAX_HOST_CONNECTIONS and MAX_PIPELINE_LENGTH require PIPELINING.\n",
+                         __func__);
+                return -1;
+        }
+
         if (bctx->client_num_max < 1)
         {
                 fprintf (stderr, "%s - error: CLIENT_NUM_MAX is less than 1.\n", __func__);
@@ -2268,7 +2776,7 @@ static int validate_batch_general (batch_context*const bctx)
                 }
                 else
                 {
-                        if (!bctx->ip_shared_num &&
+                        if (!bctx->ip_shared_num && !bctx->pipelining &&
                             ((bctx->ip_addr_max - bctx->ip_addr_min + 1) < bctx->client_num_max))
                         {
                                 fprintf (stderr, "%s - error: range of IPv4 addresses is less than number of clients.\n"
@@ -2310,6 +2818,37 @@ static int validate_batch_general (batch_context*const bctx)
                 return -1;
         }
 
+        /*
+           Pipelining clients share connections, and libcurl re-uses a connection
+           only for handles with the same local ports range.
+         */
+        if (bctx->pipelining)
+        {
+                bctx->local_port_partition = LOCAL_PORT_PARTITION_THREAD;
+        }
+
+        if (bctx->local_port_min || bctx->local_port_max)
+        {
+                if (!bctx->local_port_min || bctx->local_port_max < bctx->local_port_min)
+                {
+                        fprintf (stderr, "%s - error: both LOCAL_PORT_MIN and LOCAL_PORT_MAX "
+                                 "not less than LOCAL_PORT_MIN are required.\n", __func__);
+                        return -1;
+                }
+
+                /* At least a port per client, or per thread of -t option */
+                if (bctx->local_port_max - bctx->local_port_min + 1 <
+                    (bctx->local_port_partition == LOCAL_PORT_PARTITION_CLIENT ?
+                     bctx->client_num_max : (threads_subbatches_num ? threads_subbatches_num : 1)))
+                {
+                        fprintf (stderr, "%s - error: range of local ports is less than number of %s.\n"
+                                 "Please, increase LOCAL_PORT_MAX.\n", __func__,
+                                 bctx->local_port_partition == LOCAL_PORT_PARTITION_CLIENT ?
+                                 "clients" : "threads");
+                        return -1;
+                }
+        }
+
         return 0;
 }
 
@@ -2420,6 +2959,19 @@ static int validate_batch_url (batch_context*const bctx)
                 // Remember this url cycling status to prev_url_cycling tobe used the next time
                 prev_url_cycling = url->url_dont_cycle ? 0 : 1;
 
+                /*
+                   With HANDLE_TEMPLATES the cookies of a client are kept in the share
+                   of its handles, which is the share of the url, when it has one.
+                 */
+                if (bctx->use_handle_templates && url->share_data &&
+                    !(url->share_data & SHARE_DATA_COOKIE))
+                {
+                        fprintf (stderr,
+                                 "%s - error: SHARE without COOKIE of url %d is not supported "
+                                 "with HANDLE_TEMPLATES.\n", __func__, k);
+                        return -1;
+                }
+
 
                 if (!url->url_use_current)
                 {
@@ -2514,6 +3066,18 @@ int create_response_logfiles_dirs (batch_context* bctx)
 
                 if (url->log_resp_bodies || url->log_resp_headers)
                 {
+                        /*
+                           Allocate the side table of client response logfiles.
+                         */
+                        if (!bctx->cresp_logs &&
+                            !(bctx->cresp_logs = (client_resp_logs *) calloc (bctx->client_num_max,
+                                                                              sizeof (client_resp_logs))))
+                        {
+                                fprintf (stderr,
+                                         "%s - error: failed to allocate client response logfiles table.\n",
+                                         __func__);
+                                return -1;
+                        }
 
                         /* Create the directory, if not created before. */
                         if (!dir_created_flag)
@@ -2582,71 +3146,84 @@ int alloc_client_formed_buffers (batch_context* bctx)
         {
                 url_context* url = &bctx->url_ctx_array[k];
 
+                if (!url->form_str || !strlen (url->form_str))
+                {
+                        continue;
+                }
+
+                /*
+                   The side table of client buffers is allocated only, when
+                   at least a single url contains FORM_STRING.
+                 */
+                if (!bctx->cforms &&
+                    !(bctx->cforms = (client_forms *) calloc (bctx->client_num_max,
+                                                              sizeof (client_forms))))
+                {
+                        fprintf (stderr,
+                                 "\"%s\" error: failed to allocate client forms table.\n",
+                                 __func__);
+                        return -1;
+                }
+
                 /*
                    Allocate posting buffers for clients (login, logoff other posting),
                    if at least a single url contains method HTTP POST and
                    FORM_STRING.
                  */
-                if (url->req_type == HTTP_REQ_TYPE_POST && url->form_str)
+                if (url->req_type == HTTP_REQ_TYPE_POST)
                 {
                         int i;
                         for (i = 0; i < bctx->client_num_max; i++)
                         {
-                                client_context* cctx = &bctx->cctx_array[i];
+                                client_forms* cf = &bctx->cforms[i];
 
-                                if (!cctx->post_data && !cctx->post_data_len)
+                                if (!cf->post_data && !cf->post_data_len)
                                 {
                                         size_t form_string_len = strlen (url->form_str);
 
-                                        if (form_string_len)
+                                        cf->post_data_len = form_string_len + 1 +
+                                                FORM_RECORDS_MAX_TOKENS_NUM*
+                                                (FORM_RECORDS_TOKEN_MAX_LEN +
+                                                 FORM_RECORDS_SEQ_NUM_LEN);
+
+                                        if (!(cf->post_data =
+                                                      (char *) calloc (cf->post_data_len, sizeof (char))))
                                         {
-                                                cctx->post_data_len = form_string_len + 1 +
-                                                                      FORM_RECORDS_MAX_TOKENS_NUM*
-                                                                      (FORM_RECORDS_TOKEN_MAX_LEN +
-                                                                       FORM_RECORDS_SEQ_NUM_LEN);
-
-                                                if (!(cctx->post_data =
-                                                              (char *) calloc (cctx->post_data_len, sizeof (char))))
-                                                {
-                                                        fprintf (stderr,
-                                                                 "\"%s\" error: failed to allocate client "
-                                                                 "post_data buffer.\n",
-                                                                 __func__);
-                                                        return -1;
-                                                }
+                                                fprintf (stderr,
+                                                         "\"%s\" error: failed to allocate client "
+                                                         "post_data buffer.\n",
+                                                         __func__);
+                                                return -1;
                                         }
                                 }
                         }
                 } /* end of post-ing buffers allocation */
 
-                else if ((url->req_type == HTTP_REQ_TYPE_GET && url->form_str) ||
-                         (url->req_type == HTTP_REQ_TYPE_HEAD && url->form_str) ||
-                         (url->req_type == HTTP_REQ_TYPE_DELETE && url->form_str))
+                else if (url->req_type == HTTP_REQ_TYPE_GET ||
+                         url->req_type == HTTP_REQ_TYPE_HEAD ||
+                         url->req_type == HTTP_REQ_TYPE_DELETE)
                 {
                         int j;
                         for (j = 0; j < bctx->client_num_max; j++)
                         {
-                                client_context* cctx = &bctx->cctx_array[j];
+                                client_forms* cf = &bctx->cforms[j];
 
-                                if (!cctx->get_url_form_data && !cctx->get_url_form_data_len)
+                                if (!cf->get_url_form_data && !cf->get_url_form_data_len)
                                 {
                                         size_t form_string_len = strlen (url->form_str);
 
-                                        if (form_string_len)
+                                        cf->get_url_form_data_len = url->url_str_len +
+                                                form_string_len + 1 +
+                                                FORM_RECORDS_MAX_TOKENS_NUM*
+                                                (FORM_RECORDS_TOKEN_MAX_LEN + FORM_RECORDS_SEQ_NUM_LEN);
+
+                                        if (!(cf->get_url_form_data =
+                                                      (char *) calloc (cf->get_url_form_data_len, sizeof (char))))
                                         {
-                                                cctx->get_url_form_data_len = url->url_str_len +
-                                                                              form_string_len + 1 +
-                                                                              FORM_RECORDS_MAX_TOKENS_NUM*
-                                                                              (FORM_RECORDS_TOKEN_MAX_LEN + FORM_RECORDS_SEQ_NUM_LEN);
-
-                                                if (!(cctx->get_url_form_data =
-                                                              (char *) calloc (cctx->get_url_form_data_len, sizeof (char))))
-                                                {
-                                                        fprintf (stderr,
-                                                                 "\"%s\" error: failed to allocate client "
-                                                                 "get_url_form_data buffer.\n", __func__);
-                                                        return -1;
-                                                }
+                                                fprintf (stderr,
+                                                         "\"%s\" error: failed to allocate client "
+                                                         "get_url_form_data buffer.\n", __func__);
+                                                return -1;
                                         }
                                 }
                         }
@@ -2662,7 +3239,8 @@ int alloc_client_formed_buffers (batch_context* bctx)
  *
  * Description - Allocates client URL fetch decision arrays to be used, when
  *                    fetching decision to be done only during the first cycle
- *                    and remembered (in fetch_decision_array).
+ *                    and remembered (in fetch_decisions table of the batch,
+ *                    urls_num decisions per client).
  *
  * Input -      *bctx - pointer to the initialized batch context to validate
  * Return Code/Output - On success - 0, on failure - (-1)
@@ -2677,23 +3255,21 @@ int alloc_client_fetch_decision_array (batch_context* bctx)
 
                 if (url->fetch_probability && url->fetch_probability_once)
                 {
-                        int i;
-                        for (i = 0; i < bctx->client_num_max; i++)
+                        if (!bctx->fetch_decisions)
                         {
-                                client_context* cctx = &bctx->cctx_array[i];
+                                const size_t size = (size_t) bctx->client_num_max * bctx->urls_num;
 
-                                if (!cctx->url_fetch_decision)
+                                if (!(bctx->fetch_decisions = malloc (size)))
                                 {
-                                        if (!(cctx->url_fetch_decision = calloc (bctx->urls_num, sizeof (char))))
-                                        {
-                                                fprintf (stderr, "\"%s\" error: failed to allocate client url_fetch_decision buffer.\n", __func__);
-                                                return -1;
-                                        }
-                                        memset (cctx->url_fetch_decision, -1, bctx->urls_num);
+                                        fprintf (stderr, "\"%s\" error: failed to allocate client url_fetch_decision buffer.\n", __func__);
+                                        return -1;
                                 }
+                                memset (bctx->fetch_decisions, -1, size);
                         }
+                        break;
                 }
         }
+
         return 0;
 }
 
@@ -2730,6 +3306,29 @@ int init_operational_statistics(batch_context* bctx)
                 return -1;
         }
 
+        /*
+           Heaps of the slowest requests per url, when captured.
+         */
+        if (topk_init (bctx) == -1)
+        {
+                fprintf (stderr, "%s - error: init of the slowest requests heaps failed.\n",__func__);
+                return -1;
+        }
+
+        /*
+           Client statistics for the <batch-name>.ctx file are allocated, when
+           the clients dump is enabled.
+         */
+        if (bctx->dump_clients && !bctx->cstats)
+        {
+                if (!(bctx->cstats = (client_stat *) calloc (bctx->client_num_max,
+                                                             sizeof (client_stat))))
+                {
+                        fprintf (stderr, "%s - error: init of clients statistics failed.\n",__func__);
+                        return -1;
+                }
+        }
+
         return 0;
 }
 
@@ -2906,12 +3505,13 @@ int parse_config_file (char* const filename,
 
         set_default_response_errors_table ();
 
-        /* for compatibility with older configurations set default value
-           of dump_opstats to 1 ("yes") */
+        /* for compatibility with older configurations set default values
+           of dump_opstats and dump_clients to 1 ("yes") */
         unsigned i;
         for (i = 0; i < bctx_array_size; i++)
         {
                 bctx_array[i].dump_opstats = 1;
+                bctx_array[i].dump_clients = 1;
         }
 
         int line_no = 0;
@@ -3298,14 +3898,6 @@ static int    install_url(CURL* handle, url_context* url, char* s);
 static void   free_url_template(url_template* t);
 static void   free_url_set(url_set* set);
 
-static int    keyval_start(int nqueues);
-static int    keyval_create(int index, void* context, char* word);
-static int    keyval_init(int index, void* context);
-static void   keyval_scan(int index, void* context, char* data, int size);
-static void   keyval_flush(int index, void* context);
-static char*  keyval_lookup(char* word, int index);
-static void   keyval_stop();
-
 static char*  string_copy(char* src, char* dst);
 static char*  get_line(char* buf, int size, FILE* file);
 static char*  get_token(char** line_ptr);
@@ -4104,603 +4696,6 @@ free_url_set(url_set* set)
 }
 
 
-/*********************************************************
-   Outside keyval interface
-*********************************************************/
-
-#define VALUE_SIZE  256
-
-typedef struct keyval
-{
-        struct  keyval* next;
-        void* context;
-
-        struct
-        {
-                char* word;
-                int index;
-                char last_c;
-                int found;
-
-        } key;
-
-        struct
-        {
-                char buf[VALUE_SIZE];
-                int index;
-                char quote;
-                int found;
-        } value;
-
-} keyval;
-
-
-typedef struct
-{
-        keyval* first;
-        keyval* last;
-} keyq;
-
-
-static keyq* que_array = 0;
-
-static int num_queues = 0;
-
-
-static int  kv_create(keyval* k, char* word);
-static void kv_scan(keyval* k, char* data, int size);
-static void scan_for_key(keyval* k, char c);
-static void scan_for_value(keyval *k, char c);
-static void add_to_value(keyval* k, char c);
-static void kv_init(keyval* k);
-static void kv_free(keyval* k);
-static void kv_flush(keyval* k);
-static void q_insert(keyq* q, keyval* k);
-static int err_out(const char* func, char* fmt, ...);
-
-#define error(x) err_out(__func__, x)
-
-/*
-   Allocate an array of keyval queues, one for each possible context
- */
-static int
-keyval_start(int nqueues)
-{
-        if (que_array)
-                return 0;
-
-        if ((que_array = (keyq*) calloc(nqueues, sizeof (keyq))) == 0)
-                return error("cannot allocate que_array");
-
-        num_queues = nqueues;
-        return 0;
-}
-
-/*
-   Create a keyval for a given keyword
- */
-static int
-keyval_create(int index, void* context, char* word)
-{
-        keyval* k;
-
-        if (index >= num_queues)
-                return error("index out of range");
-
-        if ((k = calloc(1, sizeof *k)) == 0)
-                return error("cannot allocate keyval");
-
-        if (kv_create(k, word) < 0)
-                return -1;
-
-        k->context = context;
-        q_insert(&que_array[index], k);
-
-        return 0;
-}
-
-
-/*
-   Called when a previously-fetched URL is recycled,
-   and we want to capture new response values
- */
-static int
-keyval_init(int index, void* context)
-{
-        keyval* k;
-
-        if (index >= num_queues)
-                return error("index out of range");
-
-        for (k = que_array[index].first; k != 0; k = k->next)
-        {
-                if (k->context == context)
-                        kv_init (k);
-        }
-
-        return 0;
-}
-
-
-/*
-   Scan the given data for all the keyvals in the index
- */
-static void
-keyval_scan(int index, void* context, char* data, int size)
-{
-        keyval* k;
-
-        for (k = que_array[index].first; k != 0; k = k->next)
-        {
-                if (k->context == context)
-                        kv_scan(k, data, size);
-        }
-}
-
-static void
-keyval_flush(int index, void* context)
-{
-        keyval* k;
-
-        for (k = que_array[index].first; k != 0; k = k->next)
-        {
-                if (k->context == context)
-                        kv_flush(k);
-        }
-}
-
-static char*
-keyval_lookup(char* word, int index)
-{
-        keyval* k;
-
-        for (k = que_array[index].first; k != 0; k = k->next)
-        {
-                if (strcmp(k->key.word, word) == 0)
-                        return k->value.buf;
-        }
-        return 0;
-}
-
-static void
-keyval_stop()
-{
-        int i; keyval *k, *next;
-
-        if (que_array == 0)
-                return;
-
-        for (i = 0; i < num_queues; i++)
-                for (k = que_array[i].first; k != 0; k = next)
-                {
-                        next = k->next;
-                        kv_free(k);
-                }
-
-        free(que_array);
-        que_array = 0;
-}
-
-static void
-q_insert(keyq* q, keyval* k)
-{
-        if (q->first == 0)
-        {
-                q->first = k;
-        }
-        else if (q->last != 0)
-        {
-                q->last->next = k;
-        }
-
-        q->last = k;
-        k->next = 0;
-}
-
-/*********************************************************
-   Low-level keyval implementation,
-   for word-boundry-only substring matching
-*********************************************************/
-static int
-kv_create(keyval* k, char* word)
-{
-        if ((k->key.word = strdup(word)) == 0)
-                return error("cannot allocate word");
-        return 0;
-}
-
-static void
-kv_scan(keyval* k, char* data, int size)
-{
-        if (k->value.found)
-                return;
-
-        for (; size > 0; data++, size--)
-        {
-                if (k->key.found == 0)
-                {
-                        scan_for_key(k, *data);
-                        k->key.last_c = *data;
-                }
-                else if (k->value.found == 0)
-                {
-                        scan_for_value(k, *data);
-                }
-                else
-                        break;
-        }
-}
-
-/*
-   Alphanumeric characters plus @, underscore, and dot.
- */
-static const char
-        alphanum_plus[] =
-{
-        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /*   0 -  15 */
-        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /*  16 -  31 */
-        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, /*  32 -  47 */
-        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, /*  48 -  63 */
-        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, /*  64 -  79 */
-        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 1, /*  80 -  95 */
-        0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, /*  96 - 111 */
-        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, /* 112 - 127 */
-        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* 128 - 143 */
-        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* 144 - 159 */
-        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* 160 - 175 */
-        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* 176 - 191 */
-        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* 192 - 207 */
-        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* 208 - 223 */
-        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* 224 - 239 */
-        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* 240 - 255 */
-};
-
-#define acceptable(x) (alphanum_plus[(unsigned char) (x)] == 1)
-
-static void
-scan_for_key(keyval* k, char c)
-{
-        if (k->key.index == 0)
-        {
-                /* No matching so far. If we're continuing a run of the same thing
-                   (alphanumeric or non), or we've switched to non-alphanumeric,
-                   just ignore the character and continue the non-matching run.
-                 */
-                if (acceptable(c) == acceptable(k->key.last_c) || !acceptable(c))
-                        return;
-
-                /* Otherwise we have just changed from non-alphanumeric to
-                   alphanumeric, so we fall through and start matching.
-                 */
-        }
-
-        if (k->key.word[k->key.index] == 0)
-        {
-                /* we're in a matching run, and we've finished matching the keyword */
-                if (acceptable(c))
-                {
-                        // if the next character alphanumeric, so the match is spoiled
-                        k->key.index = 0;
-                }
-                else
-                {
-                        // otherwise we decalre a match!
-                        k->key.found = 1;
-                }
-                return;
-        }
-
-        if (c != k->key.word[k->key.index])
-        {
-                /* Now we're in a matching run, and this character doesn't match,
-                   so switch to a non-matching run.
-                 */
-                k->key.index = 0;
-                return;
-        }
-
-        /* We've matched another character */
-        ++k->key.index;
-}
-
-#define is_quote(x) (x == '"' || x == '\'')
-
-/*
-   We've found the keyword, and now we're collecting the value string.
-   We'll first skip any non-aplhanumerics. Then we'll collect a quoted
-   string, or a string of alphanumerics.
- */
-static void
-scan_for_value(keyval *k, char c)
-{
-        if (acceptable(c))
-        {
-                add_to_value(k, c); /* any alphanumeic is welcome */
-                return;
-        }
-
-        if (k->value.quote) /* we're in a quote run */
-        {
-                if (k->value.quote == c) /* we've found the terminating quote */
-                        k->value.found = 1;
-                else
-                        add_to_value(k, c); /* collect the character, whatever it is */
-                return;
-        }
-
-        if (is_quote(c) && k->value.index == 0)
-        {
-                k->value.quote = c; /* start a quote run */
-                return;
-        }
-
-        if (k->value.index > 0) /* we've collected non-quoted characters, and ... */
-        {
-                k->value.found = 1; /* this non-aplhanumeric ends the collection */
-                return;
-        }
-
-        /* we have an initial non-quote non-alphanumeric, which we'll ignore */
-}
-
-static void
-add_to_value(keyval* k, char c)
-{
-        if (k->value.index < VALUE_SIZE - 1)
-        {
-                k->value.buf[k->value.index++] = c;
-                k->value.buf[k->value.index] = 0;
-        }
-}
-
-static void
-kv_init(keyval* k)
-{
-        k->key.index = 0;
-        k->key.last_c = 0;
-        k->key.found = 0;
-
-        k->value.buf[0] = 0;
-        k->value.index = 0;
-        k->value.quote = 0;
-        k->value.found = 0;
-}
-
-static void
-kv_free(keyval* k)
-{
-        if (k != 0)
-        {
-                free(k->key.word);
-                free(k);
-        }
-}
-
-static void
-kv_flush(keyval* k)
-{
-        if (k->key.found || k->key.word[k->key.index] == 0)
-                k->value.found = 1;
-}
-
-
-#if 0
-/***** bitap version, for more general substring search *****/
-/*
-   Struct for keeping track of a bitap string search.
-   We use chars instead of bits for simplicity, but
-   bits would save space and run faster.
- */
-typedef struct bitap
-{
-        char* word; /* pattern or word to be recognized */
-        int size; /* strlen(word) */
-        char* mark; /* array of size + 1 markers */
-} bitap;
-
-
-typedef enum
-{
-        init = 0,
-        inter,
-        found
-
-} state;
-
-
-#define VALUE_SIZE  256
-
-typedef struct keyval
-{
-        struct keyval* next;
-        void* context;
-
-        bitap key;
-        char* data;
-        int size;
-        char value[VALUE_SIZE + 1];
-        int length;
-        char quote;
-        state keystate;
-        state valstate;
-
-} keyval;
-
-
-static int    bitap_search(bitap* bp, char* stream, int length);
-static int    bitap_init(bitap* b, char* word);
-static int    bitap_refresh(bitap* b);
-static void bitap_free(bitap* b);
-
-static int kv_init (keyval* k)
-{
-        k->value[0] = 0;
-        k->length = 0;
-        k->quote = 0;
-        k->keystate = init;
-        k->valstate = init;
-        return bitap_refresh(&k->key);
-}
-
-static void kv_free (keyval* k)
-{
-        bitap_free(&k->key);
-}
-
-static void kv_flush (keyval* k)
-{
-        if (k->keystate == found)
-        {
-                k->valstate = found;
-                k->value[k->length] = 0;
-        }
-}
-
-static void kv_scan (keyval* k, char* data, int size)
-{
-        k->data = data;
-        k->size = size;
-
-        if (k->keystate != found)
-                scan_for_key(k);
-
-        if (k->keystate == found && k->valstate != found)
-                scan_for_value(k);
-}
-
-static void scan_for_key(keyval* k)
-{
-        int n = 0;
-
-        if (k->data == 0 || k->size == 0 || k->keystate == found)
-                return (void) error("bad initial conditions");
-
-        n = bitap_search(&k->key, k->data, k->size);
-
-        if (n > 0)
-        {
-                k->data += n;
-                k->size -= n;
-
-                k->keystate = found;
-        }
-}
-
-static void scan_for_value(keyval *k)
-{
-        if (k->data == 0 || k->size == 0 || k->valstate == found)
-                return (void) error("bad initial conditions");
-
-        if (k->valstate == init)
-        {
-                /* skip white space and equals signs */
-                for (; k->size > 0 && (is_white(*k->data) || *k->data == '='); k->size--, k->data++)
-                        ;
-
-                if (k->size == 0)
-                        return; /* we haven't found the beginning of the value yet */
-
-                k->valstate = inter;
-
-                if (*k->data == '"' || *k->data == '\'')
-                {
-                        k->quote = *k->data++;
-                        k->size--;
-                }
-
-                if (k->size == 0)
-                        return;
-        }
-
-        /* at this point we're collecting the value */
-        if (k->quote != 0)
-        {
-                for (; k->size > 0 && *k->data != k->quote; k->size--, k->data++)
-                        if (k->length < VALUE_SIZE)
-                                k->value[k->length++] = *k->data;
-
-                if (k->size > 0)
-                        k->valstate = found;
-        }
-        else
-        {
-                for (; k->size > 0 && !is_white(*k->data); k->size--, k->data++)
-                        if (k->length < VALUE_SIZE)
-                                k->value[k->length++] = *k->data;
-
-                if (k->size > 0)
-                        k->valstate = found;
-        }
-}
-
-
-static int
-is_white(char c)
-{
-        return (c == ' ' || c == '\t' || c == '\n' || c == '\r');
-}
-
-
-/***** Bitap stuff *****/
-
-static int
-bitap_search(bitap* bp, char* stream, int length)
-{
-        int i, j; char* b = bp->mark; char* p = bp->word;
-
-        for (j = 1; j <= length; j++, stream++)
-        {
-                for (i = bp->size; i > 0; i--)
-                        b[i] = b[i - 1] && (p[i - 1] == *stream);
-
-                if (b[bp->size] == 1)
-                        return j;
-        }
-
-        return 0;
-}
-
-static int
-bitap_init(bitap* b, char* word)
-{
-        if (word)
-        {
-                if ((b->word = strdup(word)) == 0)
-                        return error("cannot allocate word");
-
-                if ((b->mark = calloc((b->size + 1), sizeof (char))) == 0)
-                        return error("cannot allocate mark array");
-
-                b->size = strlen(word);
-        }
-
-        return bitap_refresh(b);
-}
-
-static int
-bitap_refresh(bitap* b)
-{
-        int i;
-
-        b->mark[0] = 1;
-
-        for (i = 1; i <= b->size; i++)
-                b->mark[i] = 0;
-
-        return 0;
-}
-
-static void
-bitap_free(bitap* b)
-{
-        free(b->word);
-        free(b->mark);
-}
-
-/***** end of bitap version *****/
-#endif
-
-
 /*********************************************************
 
    Utilities
@@ -0,0 +1,702 @@
+/*
+*     redis_pub.c
+*
+* 2006-2007 Copyright (c)
+* Robert Iakobashvili, <coroberti@gmail.com>
+* Michael Moser,  <moser.michael@gmail.com>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+// must be first include
+#include "fdsetsize.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "hiredis.h"
+#include "async.h"
+
+#include "batch.h"
+#include "client.h"
+#include "conf.h"
+#include "redis_pub.h"
+#include "statistics.h"
+
+/* Number of records in the queue, should be a power of 2 */
+#define REDIS_QUEUE_SIZE 16384
+
+/* Maximum number of XADD commands sent and not replied yet */
+#define REDIS_PENDING_MAX 4096
+
+/* Approximate maximum length of the stream, trimmed by Redis */
+#define REDIS_STREAM_MAXLEN "1000000"
+
+/* Time to wait before reconnecting to Redis, msec */
+#define REDIS_RECONNECT_TIMEOUT 1000
+
+/* Time given to the publisher thread to flush the queue on exit, msec */
+#define REDIS_FLUSH_TIMEOUT 1000
+
+typedef enum redis_rec_type
+{
+        REDIS_REC_INTERVAL = 0,
+        REDIS_REC_REQUEST,
+} redis_rec_type;
+
+/*
+   A fixed-size record, passed by loading threads to the publisher thread.
+ */
+typedef struct redis_record
+{
+        redis_rec_type type;
+
+        /* Time in msec since the epoch */
+        unsigned long timestamp;
+
+        /* Batch (thread) id */
+        long batch_id;
+
+        union
+        {
+                struct
+                {
+                        unsigned long period;
+                        unsigned long run;
+                        long clients;
+                        unsigned long caps;
+                        unsigned long requests;
+                        unsigned long resp_1xx;
+                        unsigned long resp_2xx;
+                        unsigned long resp_3xx;
+                        unsigned long resp_4xx;
+                        unsigned long resp_5xx;
+                        unsigned long errs;
+                        unsigned long timeout_errs;
+                        unsigned long delay;
+                        unsigned long delay_2xx;
+                        unsigned long long data_in;
+                        unsigned long long data_out;
+                } interval;
+
+                struct
+                {
+                        long client;
+                        long cycle;
+                        long url;
+                        long status;
+                        long result;
+                        unsigned long duration;
+                        unsigned long long data_in;
+                } request;
+        } u;
+
+} redis_record;
+
+/*
+   Queue slot with a sequence number, used by the bounded multi-producer
+   single-consumer queue.
+ */
+typedef struct redis_slot
+{
+        volatile unsigned long seq;
+        redis_record rec;
+} redis_slot;
+
+/*
+   Hooks of the hiredis event adapter, driven by poll () in the publisher thread.
+ */
+typedef struct redis_poll_events
+{
+        int read;
+        int write;
+} redis_poll_events;
+
+
+static redis_slot* queue = NULL;
+static volatile unsigned long queue_tail = 0;
+static unsigned long queue_head = 0;
+
+static pthread_t pub_thread;
+static int pub_started = 0;
+static volatile int pub_stopping = 0;
+
+/* Accessed only by the publisher thread */
+static redisAsyncContext* redis_ctx = NULL;
+static redis_poll_events redis_events;
+static int redis_connected = 0;
+static long redis_pending = 0;
+static unsigned long published_num = 0;
+static unsigned long failed_num = 0;
+
+/* Records dropped by producers, when the queue is full */
+static volatile unsigned long dropped_num = 0;
+
+
+static void* redis_pub_thread (void* arg);
+static int redis_queue_put (redis_record* rec);
+static int redis_queue_get (redis_record* rec);
+static void redis_connect (void);
+static int redis_send (redis_record* rec);
+
+
+/****************************************************************************************
+* Function name - redis_pub_start
+*
+* Description - Allocates the queue and starts the publisher thread, when
+*               publishing to Redis is configured by -R command line option.
+*
+* Return Code/Output - On Success - 0, on Error -1
+****************************************************************************************/
+int redis_pub_start ()
+{
+        unsigned long i;
+
+        if (!redis_host[0] || pub_started)
+                return 0;
+
+        if (!(queue = calloc (REDIS_QUEUE_SIZE, sizeof (redis_slot))))
+        {
+                fprintf (stderr, "%s - error: calloc () failed with errno %d.\n",
+                         __func__, errno);
+                return -1;
+        }
+
+        for (i = 0; i < REDIS_QUEUE_SIZE; i++)
+        {
+                queue[i].seq = i;
+        }
+
+        if (pthread_create (&pub_thread, NULL, redis_pub_thread, NULL))
+        {
+                fprintf (stderr, "%s - error: pthread_create () failed with errno %d.\n",
+                         __func__, errno);
+                free (queue);
+                queue = NULL;
+                return -1;
+        }
+
+        pub_started = 1;
+        atexit (redis_pub_stop);
+
+        fprintf (stderr, "%s - publishing statistics to redis %s:%d, stream \"%s\"\n",
+                 __func__, redis_host, redis_port, redis_stream);
+
+        return 0;
+}
+
+/****************************************************************************************
+* Function name - redis_pub_stop
+*
+* Description - Lets the publisher thread to flush the queue for up to a second
+*               and joins it. Registered by redis_pub_start () to run at exit.
+*
+* Return Code/Output - None
+****************************************************************************************/
+void redis_pub_stop ()
+{
+        if (!pub_started)
+                return;
+
+        pub_started = 0;
+        pub_stopping = 1;
+
+        pthread_join (pub_thread, NULL);
+
+        fprintf (stderr, "%s - redis records published %lu, failed %lu, dropped %lu.\n",
+                 __func__, published_num, failed_num, dropped_num);
+
+        free (queue);
+        queue = NULL;
+}
+
+/****************************************************************************************
+* Function name - redis_pub_interval
+*
+* Description - Queues the latest interval statistics of the batch group leader
+*
+* Input -       *bctx    - pointer to the batch group leader context
+*               now      - current time in msec since the epoch
+*               clients  - number of active and waiting clients of all batches
+*               caps     - call attempts per second of the interval
+*               *http    - HTTP/FTP counters of the interval
+*               *https   - HTTPS/FTPS counters of the interval
+*               period   - interval duration in msec
+* Return Code/Output - None
+****************************************************************************************/
+void redis_pub_interval (batch_context* bctx,
+                         unsigned long now,
+                         int clients,
+                         unsigned long caps,
+                         stat_point* http,
+                         stat_point* https,
+                         unsigned long period)
+{
+        redis_record rec;
+        stat_point sum;
+
+        if (!pub_started)
+                return;
+
+        memset (&sum, 0, sizeof (sum));
+        stat_point_add (&sum, http);
+        stat_point_add (&sum, https);
+
+        rec.type = REDIS_REC_INTERVAL;
+        rec.timestamp = now;
+        rec.batch_id = bctx->batch_id;
+        rec.u.interval.period = period;
+        rec.u.interval.run = (now - bctx->start_time) / 1000;
+        rec.u.interval.clients = clients;
+        rec.u.interval.caps = caps;
+        rec.u.interval.requests = sum.requests;
+        rec.u.interval.resp_1xx = sum.resp_1xx;
+        rec.u.interval.resp_2xx = sum.resp_2xx;
+        rec.u.interval.resp_3xx = sum.resp_3xx;
+        rec.u.interval.resp_4xx = sum.resp_4xx;
+        rec.u.interval.resp_5xx = sum.resp_5xx;
+        rec.u.interval.errs = sum.other_errs;
+        rec.u.interval.timeout_errs = sum.url_timeout_errs;
+        rec.u.interval.delay = sum.appl_delay;
+        rec.u.interval.delay_2xx = sum.appl_delay_2xx;
+        rec.u.interval.data_in = sum.data_in;
+        rec.u.interval.data_out = sum.data_out;
+
+        redis_queue_put (&rec);
+}
+
+/****************************************************************************************
+* Function name - redis_pub_request
+*
+* Description - Queues a sample of an accomplished request, when -S command line
+*               option is used.
+*
+* Input -       *cctx  - pointer to the client context
+*               result - CURLcode of the transfer
+*               now    - current time in msec since the epoch
+* Return Code/Output - None
+****************************************************************************************/
+void redis_pub_request (client_context* cctx, int result, unsigned long now)
+{
+        redis_record rec;
+        long status = 0;
+        double total_time = 0.0, size_download = 0.0;
+
+        if (!pub_started || !redis_samples)
+                return;
+
+        curl_easy_getinfo (cctx->handle, CURLINFO_RESPONSE_CODE, &status);
+        curl_easy_getinfo (cctx->handle, CURLINFO_TOTAL_TIME, &total_time);
+        curl_easy_getinfo (cctx->handle, CURLINFO_SIZE_DOWNLOAD, &size_download);
+
+        rec.type = REDIS_REC_REQUEST;
+        rec.timestamp = now;
+        rec.batch_id = cctx->bctx->batch_id;
+        rec.u.request.client = cctx->client_index;
+        rec.u.request.cycle = cctx->cycle_num;
+        rec.u.request.url = cctx->url_curr_index;
+        rec.u.request.status = status;
+        rec.u.request.result = result;
+        rec.u.request.duration = (unsigned long) (total_time * 1000);
+        rec.u.request.data_in = (unsigned long long) size_download;
+
+        redis_queue_put (&rec);
+}
+
+/*================= STATIC FUNCTIONS =================== */
+
+/****************************************************************************************
+* Function name - redis_queue_put
+*
+* Description - Puts a record to the queue. Safe to be called by several threads.
+*               Never waits: when the queue is full, the record is dropped.
+*
+* Input -       *rec - pointer to the record to copy
+* Return Code/Output - On Success - 0, on Error (queue full) -1
+****************************************************************************************/
+static int redis_queue_put (redis_record* rec)
+{
+        redis_slot* slot;
+        unsigned long pos = queue_tail;
+
+        for (;;)
+        {
+                slot = &queue[pos & (REDIS_QUEUE_SIZE - 1)];
+
+                const long dif = (long) slot->seq - (long) pos;
+
+                if (dif == 0)
+                {
+                        if (__sync_bool_compare_and_swap (&queue_tail, pos, pos + 1))
+                                break;
+                }
+                else if (dif < 0)
+                {
+                        __sync_fetch_and_add (&dropped_num, 1);
+                        return -1;
+                }
+
+                pos = queue_tail;
+        }
+
+        slot->rec = *rec;
+        __sync_synchronize ();
+        slot->seq = pos + 1;
+
+        return 0;
+}
+
+/****************************************************************************************
+* Function name - redis_queue_get
+*
+* Description - Takes a record from the queue. Called only by the publisher thread.
+*
+* Input -       *rec - pointer to the record to fill
+* Return Code/Output - On Success - 0, when the queue is empty -1
+****************************************************************************************/
+static int redis_queue_get (redis_record* rec)
+{
+        redis_slot* slot = &queue[queue_head & (REDIS_QUEUE_SIZE - 1)];
+
+        if (slot->seq != queue_head + 1)
+                return -1;
+
+        __sync_synchronize ();
+        *rec = slot->rec;
+        __sync_synchronize ();
+
+        slot->seq = queue_head + REDIS_QUEUE_SIZE;
+        queue_head++;
+
+        return 0;
+}
+
+/*
+   hiredis event adapter hooks. The publisher thread polls the descriptor
+   of the context according to the flags.
+ */
+static void redis_add_read (void* privdata)
+{
+        ((redis_poll_events *) privdata)->read = 1;
+}
+
+static void redis_del_read (void* privdata)
+{
+        ((redis_poll_events *) privdata)->read = 0;
+}
+
+static void redis_add_write (void* privdata)
+{
+        ((redis_poll_events *) privdata)->write = 1;
+}
+
+static void redis_del_write (void* privdata)
+{
+        ((redis_poll_events *) privdata)->write = 0;
+}
+
+static void redis_cleanup (void* privdata)
+{
+        redis_poll_events* e = (redis_poll_events *) privdata;
+        e->read = e->write = 0;
+}
+
+/****************************************************************************************
+* Function name - redis_connect_cb
+*
+* Description - hiredis callback on the connection establishment
+*
+* Input -       *ac    - pointer to the async context
+*               status - REDIS_OK or REDIS_ERR
+* Return Code/Output - None
+****************************************************************************************/
+static void redis_connect_cb (const redisAsyncContext* ac, int status)
+{
+        if (status != REDIS_OK)
+        {
+                fprintf (stderr, "%s - error: failed to connect to redis: %s.\n",
+                         __func__, ac->errstr ? ac->errstr : "unknown");
+
+                /* The context is released by hiredis */
+                redis_ctx = NULL;
+                redis_connected = 0;
+                redis_pending = 0;
+                return;
+        }
+
+        redis_connected = 1;
+}
+
+/****************************************************************************************
+* Function name - redis_disconnect_cb
+*
+* Description - hiredis callback on disconnection. The context is released by hiredis.
+*
+* Input -       *ac    - pointer to the async context
+*               status - REDIS_OK or REDIS_ERR
+* Return Code/Output - None
+****************************************************************************************/
+static void redis_disconnect_cb (const redisAsyncContext* ac, int status)
+{
+        if (status != REDIS_OK)
+        {
+                fprintf (stderr, "%s - error: disconnected from redis: %s.\n",
+                         __func__, ac->errstr ? ac->errstr : "unknown");
+        }
+
+        redis_ctx = NULL;
+        redis_connected = 0;
+        redis_pending = 0;
+}
+
+/****************************************************************************************
+* Function name - redis_reply_cb
+*
+* Description - hiredis callback on XADD reply
+*
+* Input -       *ac       - pointer to the async context
+*               *r        - pointer to the reply, NULL on disconnection
+*               *privdata - not used
+* Return Code/Output - None
+****************************************************************************************/
+static void redis_reply_cb (redisAsyncContext* ac, void* r, void* privdata)
+{
+        redisReply* reply = (redisReply *) r;
+
+        (void) ac;
+        (void) privdata;
+
+        if (redis_pending > 0)
+                redis_pending--;
+
+        if (!reply || reply->type == REDIS_REPLY_ERROR)
+        {
+                if (reply && !failed_num)
+                {
+                        fprintf (stderr, "redis_reply_cb - error: XADD failed: %s\n",
+                                 reply->str);
+                }
+                failed_num++;
+                return;
+        }
+
+        published_num++;
+}
+
+/****************************************************************************************
+* Function name - redis_connect
+*
+* Description - Starts asynchronous connection to Redis and attaches the poll-based
+*               event adapter.
+*
+* Return Code/Output - None
+****************************************************************************************/
+static void redis_connect (void)
+{
+        redisAsyncContext* ac = redisAsyncConnect (redis_host, redis_port);
+
+        if (!ac)
+                return;
+
+        if (ac->err)
+        {
+                fprintf (stderr, "%s - error: redisAsyncConnect () failed: %s.\n",
+                         __func__, ac->errstr);
+                redisAsyncFree (ac);
+                return;
+        }
+
+        memset (&redis_events, 0, sizeof (redis_events));
+
+        ac->ev.data = &redis_events;
+        ac->ev.addRead = redis_add_read;
+        ac->ev.delRead = redis_del_read;
+        ac->ev.addWrite = redis_add_write;
+        ac->ev.delWrite = redis_del_write;
+        ac->ev.cleanup = redis_cleanup;
+
+        redisAsyncSetConnectCallback (ac, redis_connect_cb);
+        redisAsyncSetDisconnectCallback (ac, redis_disconnect_cb);
+
+        /* Wait for the connection establishment */
+        redis_events.write = 1;
+
+        redis_ctx = ac;
+}
+
+/****************************************************************************************
+* Function name - redis_send
+*
+* Description - Formats a record as XADD command and sends it asynchronously
+*
+* Input -       *rec - pointer to the record
+* Return Code/Output - On Success - 0, on Error -1
+****************************************************************************************/
+static int redis_send (redis_record* rec)
+{
+        const char* argv[48];
+        char values[20][24];
+        int argc = 0, v = 0;
+
+#define REDIS_FIELD(name, fmt, val)                                     \
+        do {                                                            \
+                snprintf (values[v], sizeof (values[v]), fmt, val);     \
+                argv[argc++] = name;                                    \
+                argv[argc++] = values[v++];                             \
+        } while (0)
+
+        argv[argc++] = "XADD";
+        argv[argc++] = redis_stream;
+        argv[argc++] = "MAXLEN";
+        argv[argc++] = "~";
+        argv[argc++] = REDIS_STREAM_MAXLEN;
+        argv[argc++] = "*";
+
+        if (rec->type == REDIS_REC_INTERVAL)
+        {
+                argv[argc++] = "type";
+                argv[argc++] = "interval";
+                REDIS_FIELD ("ts", "%lu", rec->timestamp);
+                REDIS_FIELD ("period", "%lu", rec->u.interval.period);
+                REDIS_FIELD ("run", "%lu", rec->u.interval.run);
+                REDIS_FIELD ("clients", "%ld", rec->u.interval.clients);
+                REDIS_FIELD ("caps", "%lu", rec->u.interval.caps);
+                REDIS_FIELD ("req", "%lu", rec->u.interval.requests);
+                REDIS_FIELD ("1xx", "%lu", rec->u.interval.resp_1xx);
+                REDIS_FIELD ("2xx", "%lu", rec->u.interval.resp_2xx);
+                REDIS_FIELD ("3xx", "%lu", rec->u.interval.resp_3xx);
+                REDIS_FIELD ("4xx", "%lu", rec->u.interval.resp_4xx);
+                REDIS_FIELD ("5xx", "%lu", rec->u.interval.resp_5xx);
+                REDIS_FIELD ("err", "%lu", rec->u.interval.errs);
+                REDIS_FIELD ("terr", "%lu", rec->u.interval.timeout_errs);
+                REDIS_FIELD ("delay", "%lu", rec->u.interval.delay);
+                REDIS_FIELD ("delay2xx", "%lu", rec->u.interval.delay_2xx);
+                REDIS_FIELD ("in", "%llu", rec->u.interval.data_in);
+                REDIS_FIELD ("out", "%llu", rec->u.interval.data_out);
+        }
+        else
+        {
+                argv[argc++] = "type";
+                argv[argc++] = "req";
+                REDIS_FIELD ("ts", "%lu", rec->timestamp);
+                REDIS_FIELD ("batch", "%ld", rec->batch_id);
+                REDIS_FIELD ("client", "%ld", rec->u.request.client);
+                REDIS_FIELD ("cycle", "%ld", rec->u.request.cycle);
+                REDIS_FIELD ("url", "%ld", rec->u.request.url);
+                REDIS_FIELD ("status", "%ld", rec->u.request.status);
+                REDIS_FIELD ("result", "%ld", rec->u.request.result);
+                REDIS_FIELD ("time", "%lu", rec->u.request.duration);
+                REDIS_FIELD ("in", "%llu", rec->u.request.data_in);
+        }
+
+#undef REDIS_FIELD
+
+        if (redisAsyncCommandArgv (redis_ctx, redis_reply_cb, NULL,
+                                   argc, argv, NULL) != REDIS_OK)
+        {
+                failed_num++;
+                return -1;
+        }
+
+        redis_pending++;
+        return 0;
+}
+
+/****************************************************************************************
+* Function name - redis_pub_thread
+*
+* Description - The publisher thread. Drains the queue to Redis and runs the
+*               hiredis asynchronous machinery on poll (). Reconnects on errors.
+*
+* Input -       *arg - not used
+* Return Code/Output - NULL
+****************************************************************************************/
+static void* redis_pub_thread (void* arg)
+{
+        unsigned long now, reconnect_time = 0, stop_time = 0;
+        redis_record rec;
+
+        (void) arg;
+
+        for (;;)
+        {
+                now = get_tick_count ();
+
+                if (pub_stopping && !stop_time)
+                        stop_time = now + REDIS_FLUSH_TIMEOUT;
+
+                if (!redis_ctx && now >= reconnect_time)
+                {
+                        if (stop_time)
+                                break;
+
+                        redis_connect ();
+                        reconnect_time = now + REDIS_RECONNECT_TIMEOUT;
+                }
+
+                while (redis_ctx && redis_connected &&
+                       redis_pending < REDIS_PENDING_MAX &&
+                       redis_queue_get (&rec) == 0)
+                {
+                        if (redis_send (&rec) == -1)
+                                break;
+                }
+
+                if (stop_time)
+                {
+                        const int flushed = queue[queue_head & (REDIS_QUEUE_SIZE - 1)].seq !=
+                                queue_head + 1 && !redis_pending;
+
+                        if (flushed || now >= stop_time)
+                                break;
+                }
+
+                if (!redis_ctx)
+                {
+                        usleep (10000);
+                        continue;
+                }
+
+                struct pollfd pfd;
+
+                pfd.fd = redis_ctx->c.fd;
+                pfd.events = (redis_events.read ? POLLIN : 0) |
+                        (redis_events.write ? POLLOUT : 0);
+                pfd.revents = 0;
+
+                if (poll (&pfd, 1, 10) <= 0)
+                        continue;
+
+                if (pfd.revents & (POLLIN | POLLERR | POLLHUP))
+                        redisAsyncHandleRead (redis_ctx);
+
+                if (redis_ctx && (pfd.revents & POLLOUT))
+                        redisAsyncHandleWrite (redis_ctx);
+        }
+
+        if (redis_ctx)
+        {
+                redisAsyncFree (redis_ctx);
+                redis_ctx = NULL;
+        }
+
+        return NULL;
+}
@@ -0,0 +1,95 @@
+/*
+*     redis_pub.h
+*
+* 2006-2007 Copyright (c)
+* Robert Iakobashvili, <coroberti@gmail.com>
+* Michael Moser,  <moser.michael@gmail.com>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef REDIS_PUB_H
+#define REDIS_PUB_H
+
+/*
+   Publisher of live statistics to a Redis stream (XADD).
+
+   Loading threads only put fixed-size records to a lock-free queue and
+   never wait. A dedicated thread takes the records from the queue and
+   sends them using the hiredis asynchronous API. When Redis is slow or
+   not reachable, the queue fills up and new records are dropped and counted.
+ */
+
+struct batch_context;
+struct client_context;
+struct stat_point;
+
+/****************************************************************************************
+* Function name - redis_pub_start
+*
+* Description - Allocates the queue and starts the publisher thread, when
+*               publishing to Redis is configured by -R command line option.
+*
+* Return Code/Output - On Success - 0, on Error -1
+****************************************************************************************/
+int redis_pub_start ();
+
+/****************************************************************************************
+* Function name - redis_pub_stop
+*
+* Description - Lets the publisher thread to flush the queue for up to a second
+*               and joins it. Registered by redis_pub_start () to run at exit.
+*
+* Return Code/Output - None
+****************************************************************************************/
+void redis_pub_stop ();
+
+/****************************************************************************************
+* Function name - redis_pub_interval
+*
+* Description - Queues the latest interval statistics of the batch group leader
+*
+* Input -       *bctx    - pointer to the batch group leader context
+*               now      - current time in msec since the epoch
+*               clients  - number of active and waiting clients of all batches
+*               caps     - call attempts per second of the interval
+*               *http    - HTTP/FTP counters of the interval
+*               *https   - HTTPS/FTPS counters of the interval
+*               period   - interval duration in msec
+* Return Code/Output - None
+****************************************************************************************/
+void redis_pub_interval (struct batch_context* bctx,
+                         unsigned long now,
+                         int clients,
+                         unsigned long caps,
+                         struct stat_point* http,
+                         struct stat_point* https,
+                         unsigned long period);
+
+/****************************************************************************************
+* Function name - redis_pub_request
+*
+* Description - Queues a sample of an accomplished request, when -S command line
+*               option is used.
+*
+* Input -       *cctx  - pointer to the client context
+*               result - CURLcode of the transfer
+*               now    - current time in msec since the epoch
+* Return Code/Output - None
+****************************************************************************************/
+void redis_pub_request (struct client_context* cctx, int result, unsigned long now);
+
+#endif /* REDIS_PUB_H */
@@ -0,0 +1,545 @@
+/*
+*     rstore.c
+*
+* 2006-2007 Copyright (c)
+* Robert Iakobashvili, <coroberti@gmail.com>
+* Michael Moser,  <moser.michael@gmail.com>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+// must be first include
+#include "fdsetsize.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include "rstore.h"
+#include "batch.h"
+#include "client.h"
+#include "url.h"
+#include "conf.h"
+#include "zout.h"
+
+/* Number of index records, buffered before written to the index file */
+#define RSTORE_INDEX_BUFFER_NUM 2048
+
+/* Client buffers above the size are freed after each response */
+#define RSTORE_CLIENT_KEEP_SIZE (64*1024)
+
+/* Initial size of a client buffer */
+#define RSTORE_CLIENT_MIN_SIZE 4096
+
+/*
+   Segmented store of a batch. Used only by the loading thread of the batch.
+ */
+typedef struct rstore
+{
+        /* Batch directory, containing the segments and the index */
+        char dir[256];
+
+        /* Descriptor, number and size of the current segment */
+        int seg_fd;
+        unsigned int segment;
+        uint64_t seg_offset;
+
+        /* The current segment, when compressed (-z), instead of the descriptor */
+        FILE* seg_file;
+
+        /* Descriptor of the index and the buffered index records */
+        int idx_fd;
+        rstore_index_rec* idx_buf;
+        int idx_num;
+
+        /* Responses stored, their bytes and responses failed to be stored */
+        unsigned long stored;
+        unsigned long long bytes;
+        unsigned long failed;
+} rstore;
+
+static int rstore_segment_open (rstore* rs);
+static void rstore_segment_close (rstore* rs);
+static int rstore_writev (int fd, struct iovec* iov, int iovcnt);
+static int rstore_index_flush (rstore* rs);
+static void rstore_response_flush (rstore* rs,
+                                   size_t client_index,
+                                   client_resp_logs* logs);
+static int rstore_buf_append (char** buf, size_t* len, size_t* size,
+                              const void* ptr, size_t bytes);
+static size_t rstore_hdr_write (void* ptr, size_t size, size_t nmemb, void* stream);
+static size_t rstore_body_write (void* ptr, size_t size, size_t nmemb, void* stream);
+
+
+/****************************************************************************************
+* Function name - rstore_open
+*
+* Description - Opens the index and the first segment of the batch, when the
+*               segmented store is configured and a url logs responses.
+*
+* Input -       *bctx - pointer to the batch context
+* Return Code/Output - On Success - 0, on Error -1
+****************************************************************************************/
+int rstore_open (batch_context* bctx)
+{
+        rstore* rs = NULL;
+        char fname[512];
+        rstore_index_hdr hdr;
+
+        if (!bctx->log_resp_segments || !bctx->cresp_logs || bctx->rstore)
+        {
+                return 0;
+        }
+
+        if (!(rs = calloc (1, sizeof (rstore))) ||
+            !(rs->idx_buf = calloc (RSTORE_INDEX_BUFFER_NUM, sizeof (rstore_index_rec))))
+        {
+                fprintf (stderr, "%s - error: calloc () failed with errno %d.\n",
+                         __func__, errno);
+                free (rs);
+                return -1;
+        }
+
+        rs->seg_fd = rs->idx_fd = -1;
+
+        snprintf (rs->dir, sizeof (rs->dir) - 1, "./%s", bctx->batch_name);
+        snprintf (fname, sizeof (fname) - 1, "%s/%s", rs->dir, RSTORE_INDEX_NAME);
+
+        if ((rs->idx_fd = open (fname, O_WRONLY | O_CREAT | O_TRUNC, 0644)) == -1)
+        {
+                fprintf (stderr, "%s - error: open () of \"%s\" failed with errno %d.\n",
+                         __func__, fname, errno);
+                goto error;
+        }
+
+        memset (&hdr, 0, sizeof (hdr));
+        memcpy (hdr.magic, RSTORE_INDEX_MAGIC, sizeof (hdr.magic));
+        hdr.rec_size = sizeof (rstore_index_rec);
+
+        if (write (rs->idx_fd, &hdr, sizeof (hdr)) != sizeof (hdr))
+        {
+                fprintf (stderr, "%s - error: write () of \"%s\" failed with errno %d.\n",
+                         __func__, fname, errno);
+                goto error;
+        }
+
+        if (rstore_segment_open (rs) == -1)
+        {
+                goto error;
+        }
+
+        bctx->rstore = rs;
+        return 0;
+
+error:
+        if (rs->idx_fd != -1)
+                close (rs->idx_fd);
+
+        free (rs->idx_buf);
+        free (rs);
+        return -1;
+}
+
+/****************************************************************************************
+* Function name - rstore_close
+*
+* Description - Appends responses still buffered by the clients, writes the rest
+*               of the index, closes the files and frees the client buffers.
+*
+* Input -       *bctx - pointer to the batch context
+* Return Code/Output - None
+****************************************************************************************/
+void rstore_close (batch_context* bctx)
+{
+        rstore* rs = bctx->rstore;
+        int i;
+
+        if (!rs)
+        {
+                return;
+        }
+
+        for (i = 0; i < bctx->client_num_max; i++)
+        {
+                client_resp_logs* logs = &bctx->cresp_logs[i];
+
+                rstore_response_flush (rs, i, logs);
+
+                free (logs->hdr_buf);
+                free (logs->body_buf);
+                logs->hdr_buf = logs->body_buf = NULL;
+                logs->hdr_size = logs->body_size = 0;
+        }
+
+        rstore_index_flush (rs);
+
+        rstore_segment_close (rs);
+
+        if (rs->idx_fd != -1)
+                close (rs->idx_fd);
+
+        fprintf (stderr, "%s - \"%s\" - %lu responses (%llu bytes) stored in %u segments, "
+                 "%lu failed.\n", __func__, bctx->batch_name, rs->stored, rs->bytes,
+                 rs->segment + 1, rs->failed);
+
+        free (rs->idx_buf);
+        free (rs);
+        bctx->rstore = NULL;
+}
+
+/****************************************************************************************
+* Function name - rstore_response_begin
+*
+* Description - Appends the previous response of the client to the store and
+*               sets libcurl to collect headers and/or body of the url to the
+*               client buffers.
+*
+* Input -       *cctx - pointer to the client context
+*               *url  - pointer to the url context
+* Return Code/Output - On Success - 0, on Error -1
+****************************************************************************************/
+int rstore_response_begin (client_context* cctx, url_context* url)
+{
+        CURL* handle = cctx->handle;
+        client_resp_logs* logs = client_resp_logs_get (cctx);
+
+        if (!logs)
+        {
+                return 0;
+        }
+
+        rstore_response_flush (cctx->bctx->rstore, cctx->client_index, logs);
+
+        logs->resp_cycle = cctx->cycle_num;
+        logs->resp_url = url->url_ind;
+        logs->resp_pending = 1;
+
+        if (url->log_resp_bodies)
+        {
+                curl_easy_setopt (handle, CURLOPT_WRITEDATA, logs);
+                curl_easy_setopt (handle, CURLOPT_WRITEFUNCTION, rstore_body_write);
+        }
+
+        if (url->log_resp_headers)
+        {
+                curl_easy_setopt (handle, CURLOPT_WRITEHEADER, logs);
+                curl_easy_setopt (handle, CURLOPT_HEADERFUNCTION, rstore_hdr_write);
+        }
+
+        return 0;
+}
+
+/****************************************************************************************
+* Function name - rstore_response_flush
+*
+* Description - Appends the buffered response of a client to the current segment
+*               by a single writev () and adds its index record. A response,
+*               truncated on a memory shortage, is counted as failed instead.
+*
+* Input -       *rs          - pointer to the store of the batch
+*               client_index - index of the client in the batch
+*               *logs        - pointer to the response buffers of the client
+* Return Code/Output - None
+****************************************************************************************/
+static void rstore_response_flush (rstore* rs,
+                                   size_t client_index,
+                                   client_resp_logs* logs)
+{
+        struct iovec iov[2];
+        const size_t len = logs->hdr_len + logs->body_len;
+
+        if (!logs->resp_pending)
+        {
+                return;
+        }
+
+        logs->resp_pending = 0;
+
+        /* A truncated response is not stored as if it were complete */
+        if (logs->resp_truncated)
+        {
+                rs->failed++;
+                goto reset;
+        }
+
+        if (rs->seg_offset && rs->seg_offset + len > RSTORE_SEGMENT_SIZE)
+        {
+                rstore_segment_close (rs);
+                rs->segment++;
+
+                if (rstore_segment_open (rs) == -1)
+                {
+                        rs->failed++;
+                        goto reset;
+                }
+        }
+
+        iov[0].iov_base = logs->hdr_buf;
+        iov[0].iov_len = logs->hdr_len;
+        iov[1].iov_base = logs->body_buf;
+        iov[1].iov_len = logs->body_len;
+
+        if (rs->seg_file)
+        {
+                /* Compressed segment: the bytes go to the compressor thread */
+                if (fwrite (logs->hdr_buf, 1, logs->hdr_len, rs->seg_file) != logs->hdr_len ||
+                    fwrite (logs->body_buf, 1, logs->body_len, rs->seg_file) != logs->body_len)
+                {
+                        rs->failed++;
+                        goto reset;
+                }
+        }
+        else if (rs->seg_fd == -1 || rstore_writev (rs->seg_fd, iov, 2) == -1)
+        {
+                rs->failed++;
+                goto reset;
+        }
+
+        rstore_index_rec* rec = &rs->idx_buf[rs->idx_num++];
+
+        rec->client_index = (uint32_t) client_index;
+        rec->cycle = (uint32_t) logs->resp_cycle;
+        rec->url_index = (uint32_t) logs->resp_url;
+        rec->segment = rs->segment;
+        rec->offset = rs->seg_offset;
+        rec->hdr_len = (uint32_t) logs->hdr_len;
+        rec->body_len = (uint32_t) logs->body_len;
+
+        rs->seg_offset += len;
+        rs->bytes += len;
+        rs->stored++;
+
+        if (rs->idx_num == RSTORE_INDEX_BUFFER_NUM)
+        {
+                rstore_index_flush (rs);
+        }
+
+reset:
+        logs->hdr_len = logs->body_len = 0;
+        logs->resp_truncated = 0;
+
+        /* Do not keep the memory of rare large responses for each client. */
+        if (logs->hdr_size > RSTORE_CLIENT_KEEP_SIZE)
+        {
+                free (logs->hdr_buf);
+                logs->hdr_buf = NULL;
+                logs->hdr_size = 0;
+        }
+
+        if (logs->body_size > RSTORE_CLIENT_KEEP_SIZE)
+        {
+                free (logs->body_buf);
+                logs->body_buf = NULL;
+                logs->body_size = 0;
+        }
+}
+
+/****************************************************************************************
+* Function name - rstore_segment_open
+*
+* Description - Creates the current segment file of the store, compressed
+*               as <segment>.gz with -z command line option.
+*
+* Input -       *rs - pointer to the store of the batch
+* Return Code/Output - On Success - 0, on Error -1
+****************************************************************************************/
+static int rstore_segment_open (rstore* rs)
+{
+        char fname[512];
+
+        snprintf (fname, sizeof (fname) - 1, "%s/" RSTORE_SEGMENT_NAME_FMT,
+                  rs->dir, rs->segment);
+
+        if (compress_level)
+        {
+                if (!(rs->seg_file = zout_fopen (fname)))
+                {
+                        fprintf (stderr, "%s - error: zout_fopen () of \"%s\" failed.\n",
+                                 __func__, fname);
+                        return -1;
+                }
+        }
+        else if ((rs->seg_fd = open (fname, O_WRONLY | O_CREAT | O_TRUNC, 0644)) == -1)
+        {
+                fprintf (stderr, "%s - error: open () of \"%s\" failed with errno %d.\n",
+                         __func__, fname, errno);
+                return -1;
+        }
+
+        rs->seg_offset = 0;
+        return 0;
+}
+
+/****************************************************************************************
+* Function name - rstore_segment_close
+*
+* Description - Closes the current segment file of the store
+*
+* Input -       *rs - pointer to the store of the batch
+* Return Code/Output - None
+****************************************************************************************/
+static void rstore_segment_close (rstore* rs)
+{
+        if (rs->seg_file)
+        {
+                fclose (rs->seg_file);
+                rs->seg_file = NULL;
+        }
+
+        if (rs->seg_fd != -1)
+        {
+                close (rs->seg_fd);
+                rs->seg_fd = -1;
+        }
+}
+
+/****************************************************************************************
+* Function name - rstore_writev
+*
+* Description - Writes all the buffers, continuing after partial writes
+*
+* Input -       fd      - file descriptor
+*               *iov    - array of buffers, modified
+*               iovcnt  - number of buffers
+* Return Code/Output - On Success - 0, on Error -1
+****************************************************************************************/
+static int rstore_writev (int fd, struct iovec* iov, int iovcnt)
+{
+        while (iovcnt > 0)
+        {
+                ssize_t n = writev (fd, iov, iovcnt);
+
+                if (n == -1)
+                {
+                        if (errno == EINTR)
+                                continue;
+
+                        fprintf (stderr, "%s - error: writev () failed with errno %d.\n",
+                                 __func__, errno);
+                        return -1;
+                }
+
+                while (iovcnt > 0 && (size_t) n >= iov->iov_len)
+                {
+                        n -= iov->iov_len;
+                        iov++;
+                        iovcnt--;
+                }
+
+                if (iovcnt > 0)
+                {
+                        iov->iov_base = (char *) iov->iov_base + n;
+                        iov->iov_len -= n;
+                }
+        }
+
+        return 0;
+}
+
+/****************************************************************************************
+* Function name - rstore_index_flush
+*
+* Description - Writes the buffered index records to the index file
+*
+* Input -       *rs - pointer to the store of the batch
+* Return Code/Output - On Success - 0, on Error -1
+****************************************************************************************/
+static int rstore_index_flush (rstore* rs)
+{
+        struct iovec iov;
+        int rval = 0;
+
+        if (!rs->idx_num)
+        {
+                return 0;
+        }
+
+        iov.iov_base = rs->idx_buf;
+        iov.iov_len = rs->idx_num * sizeof (rstore_index_rec);
+
+        if (rstore_writev (rs->idx_fd, &iov, 1) == -1)
+        {
+                rs->failed += rs->idx_num;
+                rval = -1;
+        }
+
+        rs->idx_num = 0;
+        return rval;
+}
+
+/*
+   Appends bytes to a growing client buffer. Returns 0 on success
+   and -1, when the buffer cannot be grown.
+ */
+static int rstore_buf_append (char** buf, size_t* len, size_t* size,
+                              const void* ptr, size_t bytes)
+{
+        if (*len + bytes > *size)
+        {
+                size_t new_size = *size ? *size : RSTORE_CLIENT_MIN_SIZE;
+                char* new_buf;
+
+                while (new_size < *len + bytes)
+                        new_size *= 2;
+
+                if (!(new_buf = realloc (*buf, new_size)))
+                {
+                        return -1;
+                }
+
+                *buf = new_buf;
+                *size = new_size;
+        }
+
+        memcpy (*buf + *len, ptr, bytes);
+        *len += bytes;
+        return 0;
+}
+
+/*
+   The callbacks to libcurl to collect response headers and body bytes.
+   On a memory shortage the bytes are skipped and the response is marked
+   truncated, to be counted as failed instead of stored, but the transfer
+   goes on.
+ */
+static size_t rstore_hdr_write (void* ptr, size_t size, size_t nmemb, void* stream)
+{
+        client_resp_logs* logs = (client_resp_logs *) stream;
+
+        if (rstore_buf_append (&logs->hdr_buf, &logs->hdr_len, &logs->hdr_size,
+                               ptr, size * nmemb) == -1)
+        {
+                logs->resp_truncated = 1;
+        }
+        return size * nmemb;
+}
+
+static size_t rstore_body_write (void* ptr, size_t size, size_t nmemb, void* stream)
+{
+        client_resp_logs* logs = (client_resp_logs *) stream;
+
+        if (rstore_buf_append (&logs->body_buf, &logs->body_len, &logs->body_size,
+                               ptr, size * nmemb) == -1)
+        {
+                logs->resp_truncated = 1;
+        }
+        return size * nmemb;
+}
@@ -0,0 +1,129 @@
+/*
+*     rstore.h
+*
+* 2006-2007 Copyright (c)
+* Robert Iakobashvili, <coroberti@gmail.com>
+* Michael Moser,  <moser.michael@gmail.com>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef RSTORE_H
+#define RSTORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+   Segmented append-only store of response headers and bodies
+   (LOG_RESP_SEGMENTS tag of the general section).
+
+   Instead of a file per client per cycle, each batch (loading thread)
+   appends responses to a few large segment files in the batch directory:
+
+   <batch-name>/responses-<segment>.seg - headers followed by the body of
+                                          each response, back to back, or
+                                          .seg.gz with -z compression;
+   <batch-name>/responses.idx           - a header and a fixed-size record
+                                          per response, locating it in the
+                                          segments.
+
+   Headers and body of a response are collected in buffers of the client
+   and appended by a single writev () either, when the client starts its
+   next logged response or at the end of the batch. The layout is shared
+   with tools/resp-extract, that lists and extracts the stored responses.
+ */
+
+#define RSTORE_INDEX_MAGIC "CLRSIDX1"
+
+#define RSTORE_INDEX_NAME "responses.idx"
+
+#define RSTORE_SEGMENT_NAME_FMT "responses-%u.seg"
+
+/* Maximum size of a segment file, the next segment is started above */
+#define RSTORE_SEGMENT_SIZE (1024UL*1024*1024)
+
+/* Header of the index file */
+typedef struct rstore_index_hdr
+{
+        char magic[8];
+
+        /* Size of an index record, sizeof (rstore_index_rec) */
+        uint32_t rec_size;
+
+        uint32_t reserved;
+} rstore_index_hdr;
+
+/* Index record of a stored response */
+typedef struct rstore_index_rec
+{
+        uint32_t client_index;
+        uint32_t cycle;
+        uint32_t url_index;
+
+        /* Number of the segment file */
+        uint32_t segment;
+
+        /*
+           Offset of the headers in the segment, the body follows them.
+           For a compressed segment, the offset in the uncompressed bytes.
+         */
+        uint64_t offset;
+
+        uint32_t hdr_len;
+        uint32_t body_len;
+} rstore_index_rec;
+
+struct batch_context;
+struct client_context;
+struct url_context;
+
+/****************************************************************************************
+* Function name - rstore_open
+*
+* Description - Opens the index and the first segment of the batch, when the
+*               segmented store is configured and a url logs responses.
+*
+* Input -       *bctx - pointer to the batch context
+* Return Code/Output - On Success - 0, on Error -1
+****************************************************************************************/
+int rstore_open (struct batch_context* bctx);
+
+/****************************************************************************************
+* Function name - rstore_close
+*
+* Description - Appends responses still buffered by the clients, writes the rest
+*               of the index, closes the files and frees the client buffers.
+*
+* Input -       *bctx - pointer to the batch context
+* Return Code/Output - None
+****************************************************************************************/
+void rstore_close (struct batch_context* bctx);
+
+/****************************************************************************************
+* Function name - rstore_response_begin
+*
+* Description - Appends the previous response of the client to the store and
+*               sets libcurl to collect headers and/or body of the url to the
+*               client buffers.
+*
+* Input -       *cctx - pointer to the client context
+*               *url  - pointer to the url context
+* Return Code/Output - On Success - 0, on Error -1
+****************************************************************************************/
+int rstore_response_begin (struct client_context* cctx, struct url_context* url);
+
+#endif /* RSTORE_H */
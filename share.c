@@ -0,0 +1,302 @@
+/*
+*     share.c
+*
+* 2006-2007 Copyright (c)
+* Robert Iakobashvili, <coroberti@gmail.com>
+* Michael Moser,  <moser.michael@gmail.com>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+// must be first include
+#include "fdsetsize.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "share.h"
+#include "batch.h"
+#include "conf.h"
+#include "url.h"
+
+/*
+   Shares of a batch or of all the batches, indexed by the url share mask.
+ */
+typedef struct share_set
+{
+        CURLSH* shares[SHARE_MASKS_NUM];
+
+        /* Locks of the shared data, indexed by curl_lock_data */
+        pthread_mutex_t locks[CURL_LOCK_DATA_LAST];
+
+        /* Number of the batches, using the set */
+        int refs;
+
+        /* The set is used by several loading threads */
+        int global;
+} share_set;
+
+/* Shares of SHARE_SCOPE GLOBAL, allocated by the first batch */
+static share_set* global_set = NULL;
+static pthread_mutex_t global_set_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static share_set* share_set_alloc (int global);
+static int share_set_add_masks (share_set* set, batch_context* bctx);
+static void share_set_free (share_set* set);
+static void share_lock_function (CURL* handle, curl_lock_data data,
+                                 curl_lock_access access, void* userptr);
+static void share_unlock_function (CURL* handle, curl_lock_data data, void* userptr);
+
+
+/****************************************************************************************
+* Function name - share_open
+*
+* Description - Allocates the shares for the masks of the batch urls, or attaches
+*               the batch to the global shares, allocating them by the first batch.
+*
+* Input -       *bctx - pointer to the batch context
+* Return Code/Output - On Success - 0, on Error -1
+****************************************************************************************/
+int share_open (batch_context* bctx)
+{
+        share_set* set;
+        int i, used = 0;
+
+        for (i = 0; i < bctx->urls_num; i++)
+        {
+                used |= bctx->url_ctx_array[i].share_data;
+        }
+
+        if (!used || bctx->share)
+        {
+                return 0;
+        }
+
+        if (bctx->share_scope != SHARE_SCOPE_GLOBAL || !threads_subbatches_num)
+        {
+                if (!(set = share_set_alloc (0)) || share_set_add_masks (set, bctx) == -1)
+                {
+                        share_set_free (set);
+                        return -1;
+                }
+
+                set->refs = 1;
+                bctx->share = set;
+                return 0;
+        }
+
+        pthread_mutex_lock (&global_set_mutex);
+
+        if (!global_set && !(global_set = share_set_alloc (1)))
+        {
+                pthread_mutex_unlock (&global_set_mutex);
+                return -1;
+        }
+
+        /* Handles of the global set are not used yet by other threads */
+        if (share_set_add_masks (global_set, bctx) == -1)
+        {
+                pthread_mutex_unlock (&global_set_mutex);
+                return -1;
+        }
+
+        global_set->refs++;
+        bctx->share = global_set;
+
+        pthread_mutex_unlock (&global_set_mutex);
+        return 0;
+}
+
+/****************************************************************************************
+* Function name - share_close
+*
+* Description - Detaches the batch from its shares and releases them, when not
+*               used by other batches. Called after all the batch handles are
+*               released.
+*
+* Input -       *bctx - pointer to the batch context
+* Return Code/Output - None
+****************************************************************************************/
+void share_close (batch_context* bctx)
+{
+        share_set* set = bctx->share;
+
+        if (!set)
+        {
+                return;
+        }
+
+        bctx->share = NULL;
+
+        if (!set->global)
+        {
+                share_set_free (set);
+                return;
+        }
+
+        pthread_mutex_lock (&global_set_mutex);
+
+        if (--set->refs == 0)
+        {
+                share_set_free (set);
+                global_set = NULL;
+        }
+
+        pthread_mutex_unlock (&global_set_mutex);
+}
+
+/****************************************************************************************
+* Function name - share_handle
+*
+* Description - Returns the share of the url for CURLOPT_SHARE.
+*
+* Input -       *bctx - pointer to the batch context
+*               *url  - pointer to the url context
+* Return Code/Output - The share or NULL, when the url shares nothing
+****************************************************************************************/
+CURLSH* share_handle (batch_context* bctx, url_context* url)
+{
+        if (!bctx->share || !url->share_data)
+        {
+                return NULL;
+        }
+
+        return bctx->share->shares[url->share_data];
+}
+
+static share_set* share_set_alloc (int global)
+{
+        share_set* set;
+        int i;
+
+        if (!(set = calloc (1, sizeof (share_set))))
+        {
+                fprintf (stderr, "%s - error: calloc () failed.\n", __func__);
+                return NULL;
+        }
+
+        for (i = 0; i < CURL_LOCK_DATA_LAST; i++)
+        {
+                pthread_mutex_init (&set->locks[i], NULL);
+        }
+
+        set->global = global;
+        return set;
+}
+
+/*
+   Allocates a share for each mask of the batch urls, not yet in the set.
+ */
+static int share_set_add_masks (share_set* set, batch_context* bctx)
+{
+        int i;
+
+        for (i = 0; i < bctx->urls_num; i++)
+        {
+                const int mask = bctx->url_ctx_array[i].share_data;
+                CURLSH* sh;
+                CURLSHcode rc = CURLSHE_OK;
+
+                if (!mask || set->shares[mask])
+                        continue;
+
+                if (!(sh = curl_share_init ()))
+                {
+                        fprintf (stderr, "%s - error: curl_share_init () failed.\n", __func__);
+                        return -1;
+                }
+
+                /*
+                   A share of a single loading thread is used without locking.
+                 */
+                if (set->global)
+                {
+                        curl_share_setopt (sh, CURLSHOPT_LOCKFUNC, share_lock_function);
+                        curl_share_setopt (sh, CURLSHOPT_UNLOCKFUNC, share_unlock_function);
+                        curl_share_setopt (sh, CURLSHOPT_USERDATA, set);
+                }
+
+                if (mask & SHARE_DATA_DNS)
+                        rc = curl_share_setopt (sh, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+                if (rc == CURLSHE_OK && (mask & SHARE_DATA_SSL_SESSION))
+                        rc = curl_share_setopt (sh, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+                if (rc == CURLSHE_OK && (mask & SHARE_DATA_COOKIE))
+                        rc = curl_share_setopt (sh, CURLSHOPT_SHARE, CURL_LOCK_DATA_COOKIE);
+
+                if (rc != CURLSHE_OK)
+                {
+                        fprintf (stderr, "%s - error: curl_share_setopt () failed for url %d "
+                                 "with \"%s\".\n", __func__, i, curl_share_strerror (rc));
+                        curl_share_cleanup (sh);
+                        return -1;
+                }
+
+                set->shares[mask] = sh;
+        }
+
+        return 0;
+}
+
+static void share_set_free (share_set* set)
+{
+        int i;
+
+        if (!set)
+        {
+                return;
+        }
+
+        for (i = 0; i < SHARE_MASKS_NUM; i++)
+        {
+                if (set->shares[i] && curl_share_cleanup (set->shares[i]) != CURLSHE_OK)
+                {
+                        fprintf (stderr, "%s - error: share of mask %d is still in use.\n",
+                                 __func__, i);
+                }
+        }
+
+        for (i = 0; i < CURL_LOCK_DATA_LAST; i++)
+        {
+                pthread_mutex_destroy (&set->locks[i]);
+        }
+
+        free (set);
+}
+
+/*
+   Lock callbacks of the global shares. libcurl takes all the locks with
+   single access.
+ */
+static void share_lock_function (CURL* handle, curl_lock_data data,
+                                 curl_lock_access access, void* userptr)
+{
+        share_set* set = userptr;
+
+        (void) handle;
+        (void) access;
+
+        pthread_mutex_lock (&set->locks[data]);
+}
+
+static void share_unlock_function (CURL* handle, curl_lock_data data, void* userptr)
+{
+        share_set* set = userptr;
+
+        (void) handle;
+
+        pthread_mutex_unlock (&set->locks[data]);
+}
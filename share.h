@@ -0,0 +1,91 @@
+/*
+*     share.h
+*
+* 2006-2007 Copyright (c)
+* Robert Iakobashvili, <coroberti@gmail.com>
+* Michael Moser,  <moser.michael@gmail.com>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef SHARE_H
+#define SHARE_H
+
+#include <curl/curl.h>
+
+/*
+   Sharing of DNS cache, TLS sessions and cookies between CURL handles
+   (SHARE tag of a url, SHARE_SCOPE tag of the general section).
+
+   A url configures the data shared by its handles as a mask of SHARE_DATA_*
+   flags. One CURLSH share is kept for each mask in use, either per batch
+   (a loading thread) or one for all the threads. Access to the shared data
+   is serialized by mutexes, one per libcurl lock data type.
+ */
+
+/* Flags of the url share mask */
+#define SHARE_DATA_DNS 0x1
+#define SHARE_DATA_SSL_SESSION 0x2
+#define SHARE_DATA_COOKIE 0x4
+
+/* Number of the share masks */
+#define SHARE_MASKS_NUM 8
+
+/* Values of SHARE_SCOPE tag */
+typedef enum share_scope
+{
+        SHARE_SCOPE_BATCH = 0,
+        SHARE_SCOPE_GLOBAL,
+} share_scope;
+
+struct batch_context;
+struct url_context;
+
+/****************************************************************************************
+* Function name - share_open
+*
+* Description - Allocates the shares for the masks of the batch urls, or attaches
+*               the batch to the global shares, allocating them by the first batch.
+*
+* Input -       *bctx - pointer to the batch context
+* Return Code/Output - On Success - 0, on Error -1
+****************************************************************************************/
+int share_open (struct batch_context* bctx);
+
+/****************************************************************************************
+* Function name - share_close
+*
+* Description - Detaches the batch from its shares and releases them, when not
+*               used by other batches. Called after all the batch handles are
+*               released.
+*
+* Input -       *bctx - pointer to the batch context
+* Return Code/Output - None
+****************************************************************************************/
+void share_close (struct batch_context* bctx);
+
+/****************************************************************************************
+* Function name - share_handle
+*
+* Description - Returns the share of the url for CURLOPT_SHARE.
+*
+* Input -       *bctx - pointer to the batch context
+*               *url  - pointer to the url context
+* Return Code/Output - The share or NULL, when the url shares nothing
+****************************************************************************************/
+CURLSH* share_handle (struct batch_context* bctx, struct url_context* url);
+
+#endif /* SHARE_H */
@@ -38,6 +38,11 @@
 
 #include "statistics.h"
 #include "screen.h"
+#include "metrics.h"
+#include "redis_pub.h"
+#include "zout.h"
+#include "topk.h"
+#include "dns_pin.h"
 
 #define UNSECURE_APPL_STR "H/F   "
 #define SECURE_APPL_STR "H/F/S "
@@ -72,6 +77,8 @@ static void dump_stat_to_screen (char* protocol,
 
 static void dump_clients (client_context* cctx_array);
 
+static void print_loop_profile (batch_context* bctx, unsigned long period);
+
 static void store_json_data (batch_context* bctx,
                              unsigned long now,
                              int clients_total_num,
@@ -79,6 +86,19 @@ static void store_json_data (batch_context* bctx,
                              stat_point *http,
                              stat_point *https);
 
+static json_object* slowest_json_array (batch_context* bctx,
+                                        size_t url_index,
+                                        int total,
+                                        topk_entry* entries);
+
+static json_object* tcpi_json_object (stat_point* sp);
+static json_object* tls_json_object (stat_point* sp);
+static void print_tls_handshakes (unsigned long period, stat_point* https);
+static json_object* dns_json_object (stat_point* sp);
+static json_object* conn_json_object (stat_point* sp);
+static void print_dns_lookups (unsigned long period, stat_point* http, stat_point* https);
+static void print_conn_reuse (unsigned long period, stat_point* http, stat_point* https);
+
 /****************************************************************************************
 * Function name - stat_point_add
 *
@@ -133,6 +153,43 @@ void stat_point_add (stat_point* left, stat_point* right)
                 left->appl_delay_2xx = 0;
         }
 
+        int k;
+        for (k = 0; k < STAT_RESP_HIST_BUCKETS; k++)
+        {
+                left->resp_hist[k] += right->resp_hist[k];
+        }
+        left->resp_hist_sum += right->resp_hist_sum;
+
+        int m;
+        for (m = 0; m < TCPI_METRICS_NUM; m++)
+        {
+                for (k = 0; k < STAT_TCPI_HIST_BUCKETS; k++)
+                {
+                        left->tcpi[m].count[k] += right->tcpi[m].count[k];
+                }
+                left->tcpi[m].sum += right->tcpi[m].sum;
+        }
+
+        left->tls_full += right->tls_full;
+        left->tls_resumed += right->tls_resumed;
+        left->tls_failed += right->tls_failed;
+
+        for (k = 0; k < STAT_TLS_HIST_BUCKETS; k++)
+        {
+                left->tls_hist[k] += right->tls_hist[k];
+        }
+        left->tls_hist_sum += right->tls_hist_sum;
+
+        left->dns_lookups += right->dns_lookups;
+        left->dns_usec_sum += right->dns_usec_sum;
+        if (right->dns_usec_max > left->dns_usec_max)
+                left->dns_usec_max = right->dns_usec_max;
+
+        left->conn_new += right->conn_new;
+        left->conn_reused += right->conn_reused;
+        left->queue_msec_sum += right->queue_msec_sum;
+        if (right->queue_msec_max > left->queue_msec_max)
+                left->queue_msec_max = right->queue_msec_max;
 }
 
 /****************************************************************************************
@@ -155,6 +212,283 @@ void stat_point_reset (stat_point* p)
         p->appl_delay_points = p->appl_delay_2xx_points = 0;
         p->appl_delay = p->appl_delay_2xx = 0;
 
+        memset (p->resp_hist, 0, sizeof (p->resp_hist));
+        p->resp_hist_sum = 0;
+
+        memset (p->tcpi, 0, sizeof (p->tcpi));
+
+        p->tls_full = p->tls_resumed = p->tls_failed = 0;
+        memset (p->tls_hist, 0, sizeof (p->tls_hist));
+        p->tls_hist_sum = 0;
+
+        p->dns_lookups = 0;
+        p->dns_usec_sum = 0;
+        p->dns_usec_max = 0;
+
+        p->conn_new = p->conn_reused = 0;
+        p->queue_msec_sum = 0;
+        p->queue_msec_max = 0;
+}
+
+/****************************************************************************************
+* Function name - stat_point_resp_hist_add
+*
+* Description - Accounts a response time in the histogram of a stat_point
+*
+* Input -       *point - pointer to the stat_point
+*               msec   - response time in msec
+* Return Code/Output - None
+****************************************************************************************/
+void stat_point_resp_hist_add (stat_point* p, unsigned long msec)
+{
+        static const unsigned long bounds[STAT_RESP_HIST_BUCKETS - 1] =
+                STAT_RESP_HIST_BOUNDS;
+        int k;
+
+        for (k = 0; k < STAT_RESP_HIST_BUCKETS - 1; k++)
+        {
+                if (msec <= bounds[k])
+                        break;
+        }
+
+        p->resp_hist[k]++;
+        p->resp_hist_sum += msec;
+}
+
+/****************************************************************************************
+* Function name - stat_resp_hist_bound
+*
+* Description - Returns upper bound in msec of a histogram bucket
+*
+* Input -       bucket - index of the bucket
+* Return Code/Output - bound in msec, or 0 for the last +Inf bucket
+****************************************************************************************/
+unsigned long stat_resp_hist_bound (int bucket)
+{
+        static const unsigned long bounds[STAT_RESP_HIST_BUCKETS - 1] =
+                STAT_RESP_HIST_BOUNDS;
+
+        if (bucket < 0 || bucket >= STAT_RESP_HIST_BUCKETS - 1)
+                return 0;
+
+        return bounds[bucket];
+}
+
+static const unsigned long tcpi_bounds[TCPI_METRICS_NUM][STAT_TCPI_HIST_BUCKETS - 1] =
+{
+        STAT_TCPI_RTT_BOUNDS,
+        STAT_TCPI_RTT_BOUNDS,
+        STAT_TCPI_RETRANS_BOUNDS,
+        STAT_TCPI_CWND_BOUNDS
+};
+
+/****************************************************************************************
+* Function name - stat_point_tcpi_add
+*
+* Description - Accounts a value of a TCP_INFO metric in its histogram
+*
+* Input -       *point - pointer to the stat_point
+*               metric - the metric
+*               value  - usec for RTT metrics, otherwise segments
+* Return Code/Output - None
+****************************************************************************************/
+void stat_point_tcpi_add (stat_point* p, tcpi_metric metric, unsigned long value)
+{
+        int k;
+
+        for (k = 0; k < STAT_TCPI_HIST_BUCKETS - 1; k++)
+        {
+                if (value <= tcpi_bounds[metric][k])
+                        break;
+        }
+
+        p->tcpi[metric].count[k]++;
+        p->tcpi[metric].sum += value;
+}
+
+/****************************************************************************************
+* Function name - stat_tcpi_hist_bound
+*
+* Description - Returns upper bound of a TCP_INFO histogram bucket
+*
+* Input -       metric - the metric
+*               bucket - index of the bucket
+* Return Code/Output - bound, or 0 for the last +Inf bucket
+****************************************************************************************/
+unsigned long stat_tcpi_hist_bound (tcpi_metric metric, int bucket)
+{
+        if (bucket < 0 || bucket >= STAT_TCPI_HIST_BUCKETS - 1)
+                return 0;
+
+        return tcpi_bounds[metric][bucket];
+}
+
+static const unsigned long tls_bounds[STAT_TLS_HIST_BUCKETS - 1] = STAT_TLS_HIST_BOUNDS;
+
+/****************************************************************************************
+* Function name - stat_point_tls_add
+*
+* Description - Accounts a TLS handshake time in the histogram
+*
+* Input -       *point - pointer to the stat_point
+*               usec   - handshake time in usec
+* Return Code/Output - None
+****************************************************************************************/
+void stat_point_tls_add (stat_point* p, unsigned long usec)
+{
+        int k;
+
+        for (k = 0; k < STAT_TLS_HIST_BUCKETS - 1; k++)
+        {
+                if (usec <= tls_bounds[k])
+                        break;
+        }
+
+        p->tls_hist[k]++;
+        p->tls_hist_sum += usec;
+}
+
+/****************************************************************************************
+* Function name - stat_tls_hist_bound
+*
+* Description - Returns upper bound in usec of a TLS handshake histogram bucket
+*
+* Input -       bucket - index of the bucket
+* Return Code/Output - bound, or 0 for the last +Inf bucket
+****************************************************************************************/
+unsigned long stat_tls_hist_bound (int bucket)
+{
+        if (bucket < 0 || bucket >= STAT_TLS_HIST_BUCKETS - 1)
+                return 0;
+
+        return tls_bounds[bucket];
+}
+
+/****************************************************************************************
+* Function name - stat_point_dns_add
+*
+* Description - Accounts a name lookup time of a new connection
+*
+* Input -       *point - pointer to the stat_point
+*               usec   - lookup time in usec
+* Return Code/Output - None
+****************************************************************************************/
+void stat_point_dns_add (stat_point* p, unsigned long usec)
+{
+        p->dns_lookups++;
+        p->dns_usec_sum += usec;
+
+        if (usec > p->dns_usec_max)
+                p->dns_usec_max = usec;
+}
+
+/****************************************************************************************
+* Function name - stat_point_conn_add
+*
+* Description - Accounts a transfer on a new or on a re-used connection with the
+*               queueing delay of its request
+*
+* Input -       *point     - pointer to the stat_point
+*               reused     - whether the connection has been re-used
+*               queue_msec - queueing delay in msec, counted for re-used connections
+* Return Code/Output - None
+****************************************************************************************/
+void stat_point_conn_add (stat_point* p, int reused, unsigned long queue_msec)
+{
+        if (!reused)
+        {
+                p->conn_new++;
+                return;
+        }
+
+        p->conn_reused++;
+        p->queue_msec_sum += queue_msec;
+
+        if (queue_msec > p->queue_msec_max)
+                p->queue_msec_max = queue_msec;
+}
+
+/****************************************************************************************
+* Function name - print_conn_reuse
+*
+* Description - Prints rate of new connections, ratio of the transfers on re-used
+*               connections and queueing delay of their requests (PIPELINING).
+*
+* Input -       period - time period in milliseconds
+*               *http  - pointer to stat_point with HTTP/FTP counters
+*               *https - pointer to stat_point with HTTPS/FTPS counters
+* Return Code/Output - None
+****************************************************************************************/
+static void print_conn_reuse (unsigned long period, stat_point* http, stat_point* https)
+{
+        const unsigned long created = http->conn_new + https->conn_new;
+        const unsigned long reused = http->conn_reused + https->conn_reused;
+        const unsigned long long sum = http->queue_msec_sum + https->queue_msec_sum;
+        const unsigned long max = http->queue_msec_max > https->queue_msec_max ?
+                http->queue_msec_max : https->queue_msec_max;
+
+        fprintf(stderr,
+                "Connections: new/s:%lu, reused:%.1f%%, queueing(ms) avg:%.2f, max:%lu\n",
+                period ? created * 1000 / period : 0,
+                created + reused ? reused * 100.0 / (created + reused) : 0.0,
+                reused ? (double) sum / reused : 0.0,
+                max);
+}
+
+/****************************************************************************************
+* Function name - print_dns_lookups
+*
+* Description - Prints rate and times of the name lookups of new connections
+*               (DNS_MODE PHASE).
+*
+* Input -       period - time period in milliseconds
+*               *http  - pointer to stat_point with HTTP/FTP counters
+*               *https - pointer to stat_point with HTTPS/FTPS counters
+* Return Code/Output - None
+****************************************************************************************/
+static void print_dns_lookups (unsigned long period, stat_point* http, stat_point* https)
+{
+        const unsigned long lookups = http->dns_lookups + https->dns_lookups;
+        const unsigned long long sum = http->dns_usec_sum + https->dns_usec_sum;
+        const unsigned long max = http->dns_usec_max > https->dns_usec_max ?
+                http->dns_usec_max : https->dns_usec_max;
+
+        fprintf(stderr,
+                "DNS: lookups/s:%lu, lookup(ms) avg:%.2f, max:%.2f\n",
+                period ? lookups * 1000 / period : 0,
+                lookups ? (double) sum / lookups / 1000 : 0.0,
+                (double) max / 1000);
+}
+
+/****************************************************************************************
+* Function name - print_tls_handshakes
+*
+* Description - Prints TLS handshakes rate of new connections, resumption ratio,
+*               failures and average handshake time (-H option).
+*
+* Input -       period - time period in milliseconds
+*               *https - pointer to stat_point with HTTPS/FTPS counters
+* Return Code/Output - None
+****************************************************************************************/
+static void print_tls_handshakes (unsigned long period, stat_point* https)
+{
+        const unsigned long done = https->tls_full + https->tls_resumed;
+        unsigned long timed = 0;
+        int k;
+
+        for (k = 0; k < STAT_TLS_HIST_BUCKETS; k++)
+        {
+                timed += https->tls_hist[k];
+        }
+
+        fprintf(stderr,
+                "TLS: handshakes/s:%lu (full:%lu, resumed:%lu), resumed:%lu%%, failed:%lu, "
+                "handshake(ms) avg:%.2f\n",
+                period ? done * 1000 / period : 0,
+                https->tls_full, https->tls_resumed,
+                done ? https->tls_resumed * 100 / done : 0,
+                https->tls_failed,
+                timed ? (double) https->tls_hist_sum / timed / 1000 : 0.0);
 }
 
 /****************************************************************************************
@@ -183,6 +517,11 @@ void op_stat_point_add (op_stat_point* left, op_stat_point* right)
                 left->url_timeouted[i] += right->url_timeouted[i];
         }
 
+        for ( i = 0; i < left->url_num * OP_ERR_CLASSES_NUM; i++)
+        {
+                left->url_errs[i] += right->url_errs[i];
+        }
+
         left->call_init_count += right->call_init_count;
 }
 
@@ -205,6 +544,9 @@ void op_stat_point_reset (op_stat_point* point)
                 {
                         point->url_ok[i] = point->url_failed[i] = point->url_timeouted[i] = 0;
                 }
+
+                memset (point->url_errs, 0,
+                        point->url_num * OP_ERR_CLASSES_NUM * sizeof (unsigned long));
         }
 
         /* Don't null point->url_num ! */
@@ -253,6 +595,12 @@ void op_stat_point_release (op_stat_point* point)
                 point->url_timeouted = NULL;
         }
 
+        if (point->url_errs)
+        {
+                free (point->url_errs);
+                point->url_errs = NULL;
+        }
+
         memset (point, 0, sizeof (op_stat_point));
 }
 
@@ -276,7 +624,9 @@ int op_stat_point_init (op_stat_point* point, size_t url_num)
         {
                 if (!(point->url_ok = calloc (url_num, sizeof (unsigned long))) ||
                     !(point->url_failed = calloc (url_num, sizeof (unsigned long))) ||
-                    !(point->url_timeouted = calloc (url_num, sizeof (unsigned long)))
+                    !(point->url_timeouted = calloc (url_num, sizeof (unsigned long))) ||
+                    !(point->url_errs = calloc (url_num * OP_ERR_CLASSES_NUM,
+                                                sizeof (unsigned long)))
                     )
                 {
                         goto allocation_failed;
@@ -339,15 +689,247 @@ void op_stat_timeouted (op_stat_point* op_stat, size_t url_index)
         op_stat->url_timeouted[url_index]++;
 }
 
+void op_stat_error (op_stat_point* op_stat,
+                    size_t url_index,
+                    int curl_code,
+                    int connected)
+{
+        if (!op_stat || !op_stat->url_errs || url_index >= op_stat->url_num)
+                return;
+
+        op_stat->url_errs[url_index * OP_ERR_CLASSES_NUM +
+                          op_err_class_of (curl_code, connected)]++;
+}
+
+op_err_class op_err_class_of (int curl_code, int connected)
+{
+        switch (curl_code)
+        {
+        case CURLE_COULDNT_RESOLVE_HOST:
+        case CURLE_COULDNT_RESOLVE_PROXY:
+                return OP_ERR_DNS;
+
+        case CURLE_COULDNT_CONNECT:
+                return OP_ERR_CONNECT_REFUSED;
+
+        case CURLE_OPERATION_TIMEDOUT:
+                return connected ? OP_ERR_TIMEOUT : OP_ERR_CONNECT_TIMEOUT;
+
+        case CURLE_SSL_CONNECT_ERROR:
+        case CURLE_SSL_ENGINE_NOTFOUND:
+        case CURLE_SSL_ENGINE_SETFAILED:
+        case CURLE_SSL_CERTPROBLEM:
+        case CURLE_SSL_CIPHER:
+        case CURLE_SSL_CACERT:
+        case CURLE_SSL_ENGINE_INITFAILED:
+        case CURLE_SSL_CACERT_BADFILE:
+        case CURLE_SSL_SHUTDOWN_FAILED:
+        case CURLE_SSL_CRL_BADFILE:
+        case CURLE_SSL_ISSUER_ERROR:
+        case CURLE_PEER_FAILED_VERIFICATION:
+        case CURLE_USE_SSL_FAILED:
+                return OP_ERR_SSL;
+
+        case CURLE_SEND_ERROR:
+                return OP_ERR_SEND;
+
+        case CURLE_RECV_ERROR:
+                return OP_ERR_RECV;
+
+        case CURLE_PARTIAL_FILE:
+                return OP_ERR_PARTIAL;
+
+        case CURLE_GOT_NOTHING:
+                return OP_ERR_EMPTY_REPLY;
+
+        case CURLE_HTTP_RETURNED_ERROR:
+                return OP_ERR_HTTP;
+
+        default:
+                return OP_ERR_OTHER;
+        }
+}
+
+const char* op_err_class_name (int err_class)
+{
+        static const char* names[OP_ERR_CLASSES_NUM] =
+        {
+                "dns",
+                "refused",
+                "conn_timeout",
+                "timeout",
+                "ssl",
+                "send",
+                "recv",
+                "partial",
+                "empty_reply",
+                "http",
+                "other"
+        };
+
+        if (err_class < 0 || err_class >= OP_ERR_CLASSES_NUM)
+                return "other";
+
+        return names[err_class];
+}
+
 void op_stat_call_init_count_inc (op_stat_point* op_stat)
 {
         op_stat->call_init_count++;
 }
 
+/****************************************************************************************
+* Function name - loop_prof_usec
+*
+* Description - Delivers monotonic timestamp in microseconds for loop profiling
+*
+* Return Code/Output - timestamp in microseconds
+****************************************************************************************/
+unsigned long long loop_prof_usec ()
+{
+        struct timespec ts;
+
+        clock_gettime (CLOCK_MONOTONIC, &ts);
+
+        return (unsigned long long) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void loop_prof_iteration (loop_prof* prof, unsigned long long start_usec)
+{
+        const unsigned long long now = loop_prof_usec ();
+        const unsigned long busy = (unsigned long) (now - start_usec);
+
+        prof->iterations++;
+        prof->busy_usec += busy;
+
+        if (busy > prof->busy_max_usec)
+                prof->busy_max_usec = busy;
+
+        /*
+           CPU time of a thread can be taken only by the thread itself,
+           do it about each second to keep the loop cheap.
+         */
+        if (now - prof->cpu_sampled_at >= 1000000)
+        {
+                struct timespec ts;
+
+                if (clock_gettime (CLOCK_THREAD_CPUTIME_ID, &ts) == 0)
+                {
+                        prof->cpu_usec = (unsigned long long) ts.tv_sec * 1000000 +
+                                ts.tv_nsec / 1000;
+                }
+                prof->cpu_sampled_at = now;
+        }
+}
+
+void loop_prof_drain (loop_prof* prof, unsigned long msgs)
+{
+        prof->drains++;
+        prof->drained_msgs += msgs;
+
+        if (msgs > prof->drain_max)
+                prof->drain_max = msgs;
+}
+
+void loop_prof_timer_late (loop_prof* prof, unsigned long late)
+{
+        prof->timers_fired++;
+        prof->timers_late_msec += late;
+
+        if (late > prof->timers_late_max)
+                prof->timers_late_max = late;
+}
+
+/****************************************************************************************
+* Function name - print_loop_profile
+*
+* Description - Collects and resets loop profiling counters of all sub-batches and
+*               outputs them with the loader saturation indicator.
+*
+* Input -       *bctx  - pointer to the batch group leader context
+*               period - latest time period in milliseconds
+* Return Code/Output - None
+****************************************************************************************/
+static void print_loop_profile (batch_context* bctx, unsigned long period)
+{
+        const int batches_num = threads_subbatches_num ? threads_subbatches_num : 1;
+        loop_prof sum;
+        unsigned long cpu_max_pct = 0, busy_max_pct = 0;
+        unsigned long late_avg;
+        int saturated;
+        int pooled = 0;
+        int i;
+
+        memset (&sum, 0, sizeof (sum));
+
+        for (i = 0; i < batches_num; i++)
+        {
+                loop_prof* prof = &(bctx + i)->prof;
+                const unsigned long long cpu_usec = prof->cpu_usec;
+                const unsigned long busy_pct =
+                        (unsigned long) (prof->busy_usec / (period * 10));
+                const unsigned long cpu_pct = cpu_usec > prof->cpu_usec_reported ?
+                        (unsigned long) ((cpu_usec - prof->cpu_usec_reported) / (period * 10)) : 0;
+
+                sum.iterations += prof->iterations;
+                sum.busy_usec += prof->busy_usec;
+                sum.timers_fired += prof->timers_fired;
+                sum.timers_late_msec += prof->timers_late_msec;
+                sum.drains += prof->drains;
+                sum.drained_msgs += prof->drained_msgs;
+                sum.handle_allocs += prof->handle_allocs;
+                sum.handle_reuses += prof->handle_reuses;
+                pooled += (bctx + i)->handle_pool_num;
+
+                if (prof->busy_max_usec > sum.busy_max_usec)
+                        sum.busy_max_usec = prof->busy_max_usec;
+                if (prof->timers_late_max > sum.timers_late_max)
+                        sum.timers_late_max = prof->timers_late_max;
+                if (prof->drain_max > sum.drain_max)
+                        sum.drain_max = prof->drain_max;
+                if (busy_pct > busy_max_pct)
+                        busy_max_pct = busy_pct;
+                if (cpu_pct > cpu_max_pct)
+                        cpu_max_pct = cpu_pct;
+
+                /* Other threads counters - reset just after collecting */
+                prof->cpu_usec_reported = cpu_usec;
+                prof->iterations = prof->timers_fired = prof->drains = 0;
+                prof->busy_usec = prof->timers_late_msec = 0;
+                prof->busy_max_usec = prof->timers_late_max = 0;
+                prof->drained_msgs = prof->drain_max = 0;
+                prof->handle_allocs = prof->handle_reuses = 0;
+        }
+
+        late_avg = sum.timers_fired ? sum.timers_late_msec / sum.timers_fired : 0;
+
+        saturated = busy_max_pct >= LOOP_PROF_SATURATED_PCT ||
+                cpu_max_pct >= LOOP_PROF_SATURATED_PCT ||
+                late_avg >= LOOP_PROF_SATURATED_LATE_MSEC;
+
+        fprintf(stderr,
+                "Loader: busy:%lu%%, CPU/thread:%lu%%, iter(us) avg:%llu max:%lu, "
+                "timer late(ms) avg:%lu max:%lu, msgs/drain avg:%lu max:%lu%s\n",
+                busy_max_pct, cpu_max_pct,
+                sum.iterations ? sum.busy_usec / sum.iterations : 0,
+                sum.busy_max_usec,
+                late_avg, sum.timers_late_max,
+                sum.drains ? sum.drained_msgs / sum.drains : 0,
+                sum.drain_max,
+                saturated ? "  ** LOADER SATURATED **" : "");
+
+        fprintf(stderr,
+                "Handles: allocs/s:%lu, reused/s:%lu, pooled:%d\n",
+                sum.handle_allocs * 1000 / period,
+                sum.handle_reuses * 1000 / period,
+                pooled);
+}
+
 /****************************************************************************************
 * Function name - get_tick_count
 *
-* Description - Delivers timestamp in milliseconds.
+* Description - Delivers timestamp in milliseconds. In dry-run mode delivers
+*               the virtual clock.
 *
 * Return Code/Output - timestamp in milliseconds or -1 on errors
 ****************************************************************************************/
@@ -355,6 +937,12 @@ unsigned long get_tick_count ()
 {
         struct timeval tval;
 
+        /* Virtual clock of dry-run mode, when running */
+        if (sim_clock)
+        {
+                return sim_clock;
+        }
+
         if (gettimeofday (&tval, NULL) == -1)
         {
                 fprintf(stderr, "%s - gettimeofday () failed with errno %d.\n",
@@ -421,6 +1009,21 @@ void dump_final_statistics (client_context* cctx)
                          &bctx->http_total,
                          &bctx->https_total);
 
+        if (tls_handshake_mode)
+        {
+                print_tls_handshakes (seconds_run * 1000UL, &bctx->https_total);
+        }
+
+        if (bctx->dns_mode == DNS_MODE_PHASE)
+        {
+                print_dns_lookups (seconds_run * 1000UL, &bctx->http_total, &bctx->https_total);
+        }
+
+        if (bctx->pipelining)
+        {
+                print_conn_reuse (seconds_run * 1000UL, &bctx->http_total, &bctx->https_total);
+        }
+
         for (i = 0; i <= threads_subbatches_num; i++)
         {
                 if (i)
@@ -439,6 +1042,9 @@ void dump_final_statistics (client_context* cctx)
                                       &bctx->op_total,
                                       bctx->url_ctx_array);
 
+        topk_advance (bctx);
+        topk_dump (bctx, stderr);
+
         store_json_data(bctx, now, 0, &bctx->op_total, &bctx->http_total, &bctx->https_total);
 
         if (bctx->statistics_file)
@@ -464,15 +1070,20 @@ void dump_final_statistics (client_context* cctx)
                                                loading_time);
         }
 
-        dump_clients (cctx);
+        if (bctx->dump_clients)
+                dump_clients (cctx);
         (void)fprintf (stderr, "\nExited. For details look in the files:\n"
                        "- %s.log for errors and traces;\n"
-                       "- %s.txt for loading statistics;\n"
-                       "- %s.ctx for virtual client based statistics.\n",
-                       bctx->batch_name, bctx->batch_name, bctx->batch_name);
+                       "- %s.txt for loading statistics;\n",
+                       bctx->batch_name, bctx->batch_name);
+        if (bctx->dump_clients)
+                (void)fprintf (stderr,"- %s.ctx for virtual client based statistics.\n",
+                               bctx->batch_name);
         if (bctx->dump_opstats)
                 (void)fprintf (stderr,"- %s.ops for operational statistics.\n",
                                bctx->batch_name);
+        if (compress_level)
+                (void)fprintf (stderr, "The files are gzip-compressed with .gz suffix.\n");
         (void)fprintf (stderr,
                        "Add -v and -u options to the command line for "
                        "verbose output to %s.log file.\n",bctx->batch_name);
@@ -660,9 +1271,10 @@ void dump_snapshot_interval_and_advance_total_statistics (batch_context* bctx,
 
         fprintf(stderr,"--------------------------------------------------------------------------------\n");
 
+        const unsigned long caps_curr = bctx->op_delta.call_init_count* 1000/delta_time;
+
         fprintf(stderr,"Interval stats (latest:%ld sec, clients:%d, CAPS-curr:%ld):\n",
-                (unsigned long ) delta_time/1000, clients_total_num,
-                bctx->op_delta.call_init_count* 1000/delta_time);
+                (unsigned long ) delta_time/1000, clients_total_num, caps_curr);
 
         op_stat_point_reset (&bctx->op_delta);
 
@@ -687,8 +1299,35 @@ void dump_snapshot_interval_and_advance_total_statistics (batch_context* bctx,
                                            &bctx->http_delta,
                                            &bctx->https_delta);
 
+        print_loop_profile (bctx, delta_time);
+
+        if (tls_handshake_mode)
+        {
+                print_tls_handshakes (delta_time, &bctx->https_delta);
+        }
+
+        if (bctx->dns_mode == DNS_MODE_PHASE)
+        {
+                print_dns_lookups (delta_time, &bctx->http_delta, &bctx->https_delta);
+        }
+
+        if (bctx->pipelining)
+        {
+                print_conn_reuse (delta_time, &bctx->http_delta, &bctx->https_delta);
+        }
+
+        topk_advance (bctx);
+
         store_json_data(bctx, now_time, clients_total_num, &bctx->op_total, &bctx->http_total, &bctx->https_total);
 
+        topk_interval_reset (bctx);
+
+        metrics_snapshot_publish (bctx, now_time, clients_total_num,
+                                  caps_curr);
+
+        redis_pub_interval (bctx, now_time, clients_total_num, caps_curr,
+                            &bctx->http_delta, &bctx->https_delta, delta_time);
+
         if (bctx->statistics_file)
         {
                 const unsigned long timestamp_sec =  (now_time - bctx->start_time) / 1000;
@@ -852,7 +1491,7 @@ static void dump_clients (client_context* cctx_array)
          */
         sprintf (client_table_filename, "%s.ctx", bctx->batch_name);
 
-        if (!(ct_file = fopen(client_table_filename, "w")))
+        if (!(ct_file = zout_fopen (client_table_filename)))
         {
                 fprintf (stderr,
                          "%s - \"%s\" - failed to open file \"%s\" with errno %d.\n",
@@ -903,9 +1542,207 @@ static void print_operational_statistics (FILE *opstats_file,
                                        osp_curr->url_failed[i], osp_total->url_failed[i],
                                        osp_curr->url_timeouted[i], osp_total->url_timeouted[i]);
                 }
+
+                /*
+                   Breakdown of failures by error class, only for the urls and
+                   classes with errors since the load start.
+                 */
+                for (i = 0; i < osp_curr->url_num; i++)
+                {
+                        unsigned long* errs_curr = &osp_curr->url_errs[i * OP_ERR_CLASSES_NUM];
+                        unsigned long* errs_total = &osp_total->url_errs[i * OP_ERR_CLASSES_NUM];
+                        int printed = 0;
+                        int k;
+
+                        for (k = 0; k < OP_ERR_CLASSES_NUM; k++)
+                        {
+                                if (!errs_total[k])
+                                        continue;
+
+                                if (!printed++)
+                                        (void)fprintf (opstats_file, "URL%ld:%-12.12s\tErrors:",
+                                                       i, url_arr[i].url_short_name);
+
+                                (void)fprintf (opstats_file, " %s %ld %ld;",
+                                               op_err_class_name (k), errs_curr[k], errs_total[k]);
+                        }
+
+                        if (printed)
+                                (void)fprintf (opstats_file, "\n");
+                }
         }
 }
 
+/***********************************************************************************
+ * * Function name - slowest_json_array
+ * *
+ * * Description - makes JSON array of the slowest requests of an url, timings in msec
+ * *
+ * * Input -       *bctx     - pointer to the batch group leader context
+ * *               url_index - index of the url
+ * *               total     - 1 - of the whole run, 0 - of the latest interval
+ * *               *entries  - scratch array of topk_slowest entries
+ * *
+ * * Return Code/Output - JSON array object
+ * *************************************************************************************/
+static json_object* slowest_json_array (batch_context* bctx,
+                                        size_t url_index,
+                                        int total,
+                                        topk_entry* entries)
+{
+        json_object* array = json_object_new_array();
+        int i, n = topk_sorted (bctx, url_index, total, entries);
+
+        for (i = 0; i < n; i++)
+        {
+                const topk_entry* e = &entries[i];
+                json_object* obj = json_object_new_object();
+
+                json_object_object_add(obj, "latency", json_object_new_int64(e->latency));
+                json_object_object_add(obj, "client", json_object_new_int64(e->client_index));
+                json_object_object_add(obj, "ip", json_object_new_string(e->ip));
+                json_object_object_add(obj, "cycle", json_object_new_int64(e->cycle));
+                json_object_object_add(obj, "url", json_object_new_string(e->url));
+                json_object_object_add(obj, "status", json_object_new_int(e->status));
+                json_object_object_add(obj, "dns", json_object_new_double(e->dns / 1000.0));
+                json_object_object_add(obj, "connect", json_object_new_double(e->connect / 1000.0));
+                json_object_object_add(obj, "appConnect", json_object_new_double(e->appconnect / 1000.0));
+                json_object_object_add(obj, "preTransfer", json_object_new_double(e->pretransfer / 1000.0));
+                json_object_object_add(obj, "startTransfer", json_object_new_double(e->starttransfer / 1000.0));
+                json_object_object_add(obj, "total", json_object_new_double(e->total / 1000.0));
+                json_object_object_add(obj, "dataIn", json_object_new_int64(e->data_in));
+                json_object_object_add(obj, "dataOut", json_object_new_int64(e->data_out));
+                json_object_array_add(array, obj);
+        }
+
+        return array;
+}
+
+/***********************************************************************************
+ * * Function name - tcpi_json_object
+ * *
+ * * Description - makes JSON object of the TCP_INFO histograms of a stat_point:
+ * *               number of samples and per metric the average and the bucket
+ * *               counters, RTT and RTT variance in usec
+ * *
+ * * Input -       *sp - pointer to the stat_point
+ * *
+ * * Return Code/Output - JSON object
+ * *************************************************************************************/
+static json_object* tcpi_json_object (stat_point* sp)
+{
+        static const char* names[TCPI_METRICS_NUM] =
+                {"rtt", "rttvar", "retransmits", "cwnd"};
+        json_object* obj = json_object_new_object();
+        unsigned long samples = 0;
+        int m, k;
+
+        for (k = 0; k < STAT_TCPI_HIST_BUCKETS; k++)
+        {
+                samples += sp->tcpi[TCPI_RTT].count[k];
+        }
+
+        json_object_object_add(obj, "samples", json_object_new_int64(samples));
+
+        for (m = 0; m < TCPI_METRICS_NUM; m++)
+        {
+                json_object* metric = json_object_new_object();
+                json_object* buckets = json_object_new_array();
+
+                for (k = 0; k < STAT_TCPI_HIST_BUCKETS; k++)
+                {
+                        json_object_array_add(buckets, json_object_new_int64(sp->tcpi[m].count[k]));
+                }
+
+                json_object_object_add(metric, "avg", json_object_new_double(
+                                               samples ? (double) sp->tcpi[m].sum / samples : 0.0));
+                json_object_object_add(metric, "buckets", buckets);
+                json_object_object_add(obj, names[m], metric);
+        }
+
+        return obj;
+}
+
+/***********************************************************************************
+ * * Function name - tls_json_object
+ * *
+ * * Description - makes JSON object of the TLS handshakes of a stat_point:
+ * *               numbers of full, resumed and failed handshakes, the average
+ * *               and the bucket counters of the handshake time in usec
+ * *
+ * * Input -       *sp - pointer to the stat_point
+ * *
+ * * Return Code/Output - JSON object
+ * *************************************************************************************/
+static json_object* tls_json_object (stat_point* sp)
+{
+        json_object* obj = json_object_new_object();
+        json_object* buckets = json_object_new_array();
+        unsigned long timed = 0;
+        int k;
+
+        for (k = 0; k < STAT_TLS_HIST_BUCKETS; k++)
+        {
+                timed += sp->tls_hist[k];
+                json_object_array_add(buckets, json_object_new_int64(sp->tls_hist[k]));
+        }
+
+        json_object_object_add(obj, "full", json_object_new_int64(sp->tls_full));
+        json_object_object_add(obj, "resumed", json_object_new_int64(sp->tls_resumed));
+        json_object_object_add(obj, "failed", json_object_new_int64(sp->tls_failed));
+        json_object_object_add(obj, "avg", json_object_new_double(
+                                       timed ? (double) sp->tls_hist_sum / timed : 0.0));
+        json_object_object_add(obj, "buckets", buckets);
+
+        return obj;
+}
+
+/***********************************************************************************
+ * * Function name - dns_json_object
+ * *
+ * * Description - makes JSON object of the name lookups of a stat_point:
+ * *               number of the lookups, the average and max time in usec
+ * *
+ * * Input -       *sp - pointer to the stat_point
+ * *
+ * * Return Code/Output - JSON object
+ * *************************************************************************************/
+static json_object* dns_json_object (stat_point* sp)
+{
+        json_object* obj = json_object_new_object();
+
+        json_object_object_add(obj, "lookups", json_object_new_int64(sp->dns_lookups));
+        json_object_object_add(obj, "avg", json_object_new_double(
+                                       sp->dns_lookups ? (double) sp->dns_usec_sum / sp->dns_lookups : 0.0));
+        json_object_object_add(obj, "max", json_object_new_int64(sp->dns_usec_max));
+
+        return obj;
+}
+
+/***********************************************************************************
+ * * Function name - conn_json_object
+ * *
+ * * Description - makes JSON object of the connections of a stat_point: transfers
+ * *               on new and re-used connections, the average and max queueing
+ * *               delay in msec
+ * *
+ * * Input -       *sp - pointer to the stat_point
+ * *
+ * * Return Code/Output - JSON object
+ * *************************************************************************************/
+static json_object* conn_json_object (stat_point* sp)
+{
+        json_object* obj = json_object_new_object();
+
+        json_object_object_add(obj, "new", json_object_new_int64(sp->conn_new));
+        json_object_object_add(obj, "reused", json_object_new_int64(sp->conn_reused));
+        json_object_object_add(obj, "queueAvg", json_object_new_double(
+                                       sp->conn_reused ? (double) sp->queue_msec_sum / sp->conn_reused : 0.0));
+        json_object_object_add(obj, "queueMax", json_object_new_int64(sp->queue_msec_max));
+
+        return obj;
+}
+
 /***********************************************************************************
  * * Function name - store_json_data
  * *
@@ -928,6 +1765,7 @@ static void store_json_data (batch_context* bctx,
         int seconds_run = (int)(now - bctx->start_time)/ 1000;
         url_context* url_arr = bctx->url_ctx_array;
         stat_point* url_stats = bctx->url_stats;
+        topk_entry* slowest = bctx->topk ? calloc (topk_slowest, sizeof (topk_entry)) : NULL;
 
         json_object *my_object, *my_array, *stat_object;
         my_object = json_object_new_object();
@@ -981,6 +1819,15 @@ static void store_json_data (batch_context* bctx,
                 json_object_object_add(my_url_object, "success", json_object_new_int(osp_total->url_ok[i]));
                 json_object_object_add(my_url_object, "fail", json_object_new_int(osp_total->url_failed[i]));
                 json_object_object_add(my_url_object, "timeout", json_object_new_int(osp_total->url_timeouted[i]));
+
+                json_object *my_errs_object = json_object_new_object();
+                int k;
+                for (k = 0; k < OP_ERR_CLASSES_NUM; k++)
+                {
+                        json_object_object_add(my_errs_object, op_err_class_name (k),
+                                               json_object_new_int(osp_total->url_errs[i * OP_ERR_CLASSES_NUM + k]));
+                }
+                json_object_object_add(my_url_object, "errors", my_errs_object);
                 json_object_object_add(my_url_object, "min", json_object_new_int(url_stats[i].min_resp));
                 json_object_object_add(my_url_object, "max", json_object_new_int(url_stats[i].max_resp));
                 json_object_object_add(my_url_object, "last", json_object_new_int(url_stats[i].last_resp));
@@ -997,9 +1844,39 @@ static void store_json_data (batch_context* bctx,
                 json_object_object_add(my_url_object, "5xxRequests", json_object_new_int(url_stats[i].resp_5xx));
                 json_object_object_add(my_url_object, "totalDataIn", json_object_new_int64(url_stats[i].data_in));
                 json_object_object_add(my_url_object, "totalDataOut", json_object_new_int64(url_stats[i].data_out));
+
+                if (tcp_info_sample_rate)
+                {
+                        json_object_object_add(my_url_object, "tcpInfo", tcpi_json_object (&url_stats[i]));
+                }
+
+                if (tls_handshake_mode)
+                {
+                        json_object_object_add(my_url_object, "tlsHandshakes", tls_json_object (&url_stats[i]));
+                }
+
+                if (bctx->dns_mode == DNS_MODE_PHASE)
+                {
+                        json_object_object_add(my_url_object, "dnsLookups", dns_json_object (&url_stats[i]));
+                }
+
+                if (bctx->pipelining)
+                {
+                        json_object_object_add(my_url_object, "connections", conn_json_object (&url_stats[i]));
+                }
+
+                if (slowest)
+                {
+                        json_object_object_add(my_url_object, "slowest",
+                                               slowest_json_array (bctx, i, 1, slowest));
+                        json_object_object_add(my_url_object, "slowestInterval",
+                                               slowest_json_array (bctx, i, 0, slowest));
+                }
                 json_object_array_add(my_array, my_url_object);
         }
 
+        free (slowest);
+
         json_object_object_add(my_object, "stat", stat_object);
         json_object_object_add(my_object, "urls", my_array);
 
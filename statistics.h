@@ -29,6 +29,54 @@
 
 #include "timer_tick.h"
 
+/*
+  Upper bounds in msec of the response time histogram buckets. The last
+  bucket is +Inf and collects everything above the last bound.
+*/
+#define STAT_RESP_HIST_BOUNDS {1, 2, 5, 10, 25, 50, 100, 250, 500, \
+                               1000, 2500, 5000, 10000}
+#define STAT_RESP_HIST_BUCKETS 14
+
+/*
+  Upper bounds of the TCP_INFO histogram buckets (-I option): RTT and RTT
+  variance in usec, retransmitted segments of the connection and congestion
+  window in segments. The last bucket is +Inf.
+*/
+#define STAT_TCPI_RTT_BOUNDS {100, 250, 500, 1000, 2500, 5000, 10000, \
+                              25000, 50000, 100000, 250000, 500000, 1000000}
+#define STAT_TCPI_RETRANS_BOUNDS {0, 1, 2, 3, 4, 5, 7, 10, 15, 20, 30, 50, 100}
+#define STAT_TCPI_CWND_BOUNDS {1, 2, 3, 4, 6, 8, 10, 16, 32, 64, 128, 256, 512}
+#define STAT_TCPI_HIST_BUCKETS 14
+
+/*
+  Upper bounds in usec of the TLS handshake time histogram buckets (-H option),
+  APPCONNECT_TIME less CONNECT_TIME of libcurl. The last bucket is +Inf.
+*/
+#define STAT_TLS_HIST_BOUNDS {250, 500, 1000, 2000, 5000, 10000, 25000, \
+                              50000, 100000, 250000, 500000, 1000000, 2500000}
+#define STAT_TLS_HIST_BUCKETS 14
+
+typedef enum tcpi_metric
+{
+    TCPI_RTT = 0,
+    TCPI_RTTVAR,
+    TCPI_RETRANS,
+    TCPI_CWND,
+    TCPI_METRICS_NUM
+} tcpi_metric;
+
+/*
+  Histogram of a TCP_INFO metric.
+*/
+typedef struct tcpi_hist
+{
+    /* Non-cumulative counters per bucket */
+    unsigned long count[STAT_TCPI_HIST_BUCKETS];
+
+    /* Sum of all the values counted */
+    unsigned long long sum;
+} tcpi_hist;
+
 /*
   stat_point -the structure is used to collect loading statistics.
   Two instances of the structure are kept by each batch context.
@@ -103,8 +151,108 @@ typedef struct stat_point
     /* Last 2xx response time */
     unsigned long last_resp_2xx;
 
+    /* Response time histogram, non-cumulative counters per bucket */
+    unsigned long resp_hist[STAT_RESP_HIST_BUCKETS];
+
+    /* Sum of all response times in msec, counted by resp_hist */
+    unsigned long long resp_hist_sum;
+
+    /* TCP_INFO of the connections sampled at transfer completion */
+    tcpi_hist tcpi[TCPI_METRICS_NUM];
+
+    /* TLS handshakes of new connections: full, resumed and failed */
+    unsigned long tls_full;
+    unsigned long tls_resumed;
+    unsigned long tls_failed;
+
+    /* TLS handshake time histogram in usec, non-cumulative counters per bucket */
+    unsigned long tls_hist[STAT_TLS_HIST_BUCKETS];
+
+    /* Sum of all handshake times in usec, counted by tls_hist */
+    unsigned long long tls_hist_sum;
+
+    /* Name lookups of new connections, their total and max time in usec */
+    unsigned long dns_lookups;
+    unsigned long long dns_usec_sum;
+    unsigned long dns_usec_max;
+
+    /*
+       Transfers on new and on re-used connections (PIPELINING), the total and
+       max queueing delay in msec of the re-used ones till the request was sent.
+     */
+    unsigned long conn_new;
+    unsigned long conn_reused;
+    unsigned long long queue_msec_sum;
+    unsigned long queue_msec_max;
+
 } stat_point;
 
+/*
+  Loader is considered saturated, when in the latest interval a loading
+  thread was busy or used CPU above the percentage, or timers were dispatched
+  late on average above the msec.
+*/
+#define LOOP_PROF_SATURATED_PCT 90
+#define LOOP_PROF_SATURATED_LATE_MSEC 50
+
+/*
+  loop_prof - self-profiling counters of a loading thread event loop.
+  Updated only by the thread running the batch; collected and reset
+  at each statistics interval by the batch group leader.
+*/
+typedef struct loop_prof
+{
+    /* Event loop iterations and their busy (not waiting) time */
+    unsigned long iterations;
+    unsigned long long busy_usec;
+    unsigned long busy_max_usec;
+
+    /* Expired timers dispatched and their lateness against next_timer */
+    unsigned long timers_fired;
+    unsigned long long timers_late_msec;
+    unsigned long timers_late_max;
+
+    /* Non-empty drains of curl_multi_info_read () and messages drained */
+    unsigned long drains;
+    unsigned long drained_msgs;
+    unsigned long drain_max;
+
+    /* Thread CPU time in usec, sampled by the thread about each second */
+    unsigned long long cpu_usec;
+    unsigned long long cpu_sampled_at;
+
+    /* Thread CPU time already reported by the leader, not reset */
+    unsigned long long cpu_usec_reported;
+
+    /*
+       CURL handles allocated or duplicated from url templates, and taken from
+       the free pool or from the url handles of a client
+     */
+    unsigned long handle_allocs;
+    unsigned long handle_reuses;
+
+} loop_prof;
+
+/*
+  Classes of transfer errors, reported by libcurl CURLcode on url-fetch
+  completion. Used for the per-url errors breakdown.
+*/
+typedef enum op_err_class
+{
+    OP_ERR_DNS = 0,           /* resolving of host or proxy failed */
+    OP_ERR_CONNECT_REFUSED,   /* connect failed, e.g. RST or unreachable */
+    OP_ERR_CONNECT_TIMEOUT,   /* timed out before connection established */
+    OP_ERR_TIMEOUT,           /* timed out on a connected transfer */
+    OP_ERR_SSL,               /* TLS handshake, certificate or cipher */
+    OP_ERR_SEND,              /* failed sending data to the peer */
+    OP_ERR_RECV,              /* failed receiving data from the peer */
+    OP_ERR_PARTIAL,           /* transfer shorter than expected */
+    OP_ERR_EMPTY_REPLY,       /* server closed connection with no reply */
+    OP_ERR_HTTP,              /* HTTP error returned by server (FAILONERROR) */
+    OP_ERR_OTHER,             /* any other CURLcode */
+    OP_ERR_CLASSES_NUM
+} op_err_class;
+
 /*
   op_stat_point - operation statistics point.
   Two instances are residing in each batch context and used:
@@ -125,6 +273,12 @@ typedef struct op_stat_point
     /* Array of url counters for timeouted fetches */
     unsigned long* url_timeouted;
 
+    /*
+       Array of url counters for failed fetches by error class,
+       OP_ERR_CLASSES_NUM counters per url.
+    */
+    unsigned long* url_errs;
+
     /* Used for CAPS calculation */
     unsigned long call_init_count;
 
@@ -151,6 +305,95 @@ void stat_point_add (stat_point* left, stat_point* right);
 *******************************************************************************/
 void stat_point_reset (stat_point* point);
 
+/******************************************************************************
+* Function name - stat_point_resp_hist_add
+*
+* Description - Accounts a response time in the histogram of a stat_point
+*
+* Input -       *point - pointer to the stat_point
+*               msec   - response time in msec
+* Return Code/Output - None
+*******************************************************************************/
+void stat_point_resp_hist_add (stat_point* point, unsigned long msec);
+
+/******************************************************************************
+* Function name - stat_resp_hist_bound
+*
+* Description - Returns upper bound in msec of a histogram bucket
+*
+* Input -       bucket - index of the bucket
+* Return Code/Output - bound in msec, or 0 for the last +Inf bucket
+*******************************************************************************/
+unsigned long stat_resp_hist_bound (int bucket);
+
+/******************************************************************************
+* Function name - stat_point_tcpi_add
+*
+* Description - Accounts a value of a TCP_INFO metric in its histogram
+*
+* Input -       *point - pointer to the stat_point
+*               metric - the metric
+*               value  - usec for RTT metrics, otherwise segments
+* Return Code/Output - None
+*******************************************************************************/
+void stat_point_tcpi_add (stat_point* point, tcpi_metric metric, unsigned long value);
+
+/******************************************************************************
+* Function name - stat_tcpi_hist_bound
+*
+* Description - Returns upper bound of a TCP_INFO histogram bucket
+*
+* Input -       metric - the metric
+*               bucket - index of the bucket
+* Return Code/Output - bound, or 0 for the last +Inf bucket
+*******************************************************************************/
+unsigned long stat_tcpi_hist_bound (tcpi_metric metric, int bucket);
+
+/******************************************************************************
+* Function name - stat_point_tls_add
+*
+* Description - Accounts a TLS handshake time in the histogram
+*
+* Input -       *point - pointer to the stat_point
+*               usec   - handshake time in usec
+* Return Code/Output - None
+*******************************************************************************/
+void stat_point_tls_add (stat_point* point, unsigned long usec);
+
+/******************************************************************************
+* Function name - stat_tls_hist_bound
+*
+* Description - Returns upper bound in usec of a TLS handshake histogram bucket
+*
+* Input -       bucket - index of the bucket
+* Return Code/Output - bound, or 0 for the last +Inf bucket
+*******************************************************************************/
+unsigned long stat_tls_hist_bound (int bucket);
+
+/******************************************************************************
+* Function name - stat_point_dns_add
+*
+* Description - Accounts a name lookup time of a new connection
+*
+* Input -       *point - pointer to the stat_point
+*               usec   - lookup time in usec
+* Return Code/Output - None
+*******************************************************************************/
+void stat_point_dns_add (stat_point* point, unsigned long usec);
+
+/****************************************************************************************
+* Function name - stat_point_conn_add
+*
+* Description - Accounts a transfer on a new or on a re-used connection with the
+*               queueing delay of its request
+*
+* Input -       *point     - pointer to the stat_point
+*               reused     - whether the connection has been re-used
+*               queue_msec - queueing delay in msec, counted for re-used connections
+* Return Code/Output - None
+****************************************************************************************/
+void stat_point_conn_add (stat_point* point, int reused, unsigned long queue_msec);
+
 
 /*******************************************************************************
 * Function name - op_stat_point_add
@@ -230,8 +473,85 @@ void op_stat_update (op_stat_point* op_stat,
 
 void op_stat_timeouted (op_stat_point* op_stat, size_t url_index);
 
+/*******************************************************************************
+* Function name -  op_stat_error
+*
+* Description - Counts failed url-fetch by class of its libcurl error
+*
+* Input -       *op_stat   - pointer to the op_stat_point
+*               url_index  - index of the url
+*               curl_code  - CURLcode of the transfer
+*               connected  - whether connection has been established
+* Return Code/Output - None
+*********************************************************************************/
+void op_stat_error (op_stat_point* op_stat,
+                    size_t url_index,
+                    int curl_code,
+                    int connected);
+
+/*******************************************************************************
+* Function name -  op_err_class_of
+*
+* Description - Maps CURLcode of a transfer to the error class
+*
+* Input -       curl_code  - CURLcode of the transfer
+*               connected  - whether connection has been established
+* Return Code/Output - op_err_class
+*********************************************************************************/
+op_err_class op_err_class_of (int curl_code, int connected);
+
+/*******************************************************************************
+* Function name -  op_err_class_name
+*
+* Description - Returns short name of the error class, e.g. "dns"
+*********************************************************************************/
+const char* op_err_class_name (int err_class);
+
 void op_stat_call_init_count_inc (op_stat_point* op_stat);
 
+/****************************************************************************************
+* Function name - loop_prof_usec
+*
+* Description - Delivers monotonic timestamp in microseconds for loop profiling
+*
+* Return Code/Output - timestamp in microseconds
+****************************************************************************************/
+unsigned long long loop_prof_usec ();
+
+/****************************************************************************************
+* Function name - loop_prof_iteration
+*
+* Description - Accounts an event loop iteration, which started being busy at
+*               <start_usec>. About each second samples the thread CPU time.
+*
+* Input -       *prof       - pointer to the loop profiling counters of the thread
+*               start_usec  - loop_prof_usec () timestamp, when the iteration started
+* Return Code/Output - None
+****************************************************************************************/
+void loop_prof_iteration (loop_prof* prof, unsigned long long start_usec);
+
+/****************************************************************************************
+* Function name - loop_prof_drain
+*
+* Description - Accounts a drain of curl_multi_info_read () messages
+*
+* Input -       *prof - pointer to the loop profiling counters of the thread
+*               msgs  - number of messages drained
+* Return Code/Output - None
+****************************************************************************************/
+void loop_prof_drain (loop_prof* prof, unsigned long msgs);
+
+/****************************************************************************************
+* Function name - loop_prof_timer_late
+*
+* Description - Accounts a dispatched timer and its lateness
+*
+* Input -       *prof - pointer to the loop profiling counters of the thread
+*               late  - msec between the timer due time and its dispatching
+* Return Code/Output - None
+****************************************************************************************/
+void loop_prof_timer_late (loop_prof* prof, unsigned long late);
+
 struct client_context;
 struct batch_context;
 
@@ -0,0 +1,307 @@
+/*
+*     tlog.c
+*
+* 2006-2007 Copyright (c)
+* Robert Iakobashvili, <coroberti@gmail.com>
+* Michael Moser,  <moser.michael@gmail.com>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+// must be first include
+#include "fdsetsize.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tlog.h"
+#include "alog.h"
+#include "batch.h"
+#include "client.h"
+#include "conf.h"
+#include "loader.h"
+
+/*
+   Trace buffer of a client. Allocated lazily by the first trace of the
+   client, so that clients, never traced, cost only the record.
+ */
+typedef struct tlog_buf
+{
+        char* buf;
+
+        unsigned short len;
+
+        /* Something did not fit into the buffer */
+        unsigned short truncated;
+} tlog_buf;
+
+/*
+   Tail-based logging state of a batch. Used only by the loading thread.
+ */
+typedef struct tlog
+{
+        /* Trace buffers, indexed by client_index */
+        tlog_buf* bufs;
+
+        /* State of the xorshift generator for 1-in-N sampling */
+        unsigned int rnd;
+
+        /* Traces kept by the reason and discarded */
+        unsigned long kept_failed;
+        unsigned long kept_slow;
+        unsigned long kept_sampled;
+        unsigned long discarded;
+} tlog;
+
+static void tlog_append (tlog_buf* tb, const char* text, size_t len);
+static void tlog_out (client_context* cctx, const char* text, size_t len);
+
+
+/****************************************************************************************
+* Function name - tlog_open
+*
+* Description - Allocates trace buffers of the batch clients, when tail-based
+*               logging is configured by -T command line option.
+*
+* Input -       *bctx - pointer to the batch context
+* Return Code/Output - On Success - 0, on Error -1
+****************************************************************************************/
+int tlog_open (batch_context* bctx)
+{
+        tlog* tl;
+
+        if (!tail_logging || bctx->tlog)
+        {
+                return 0;
+        }
+
+        if (!(tl = calloc (1, sizeof (tlog))) ||
+            !(tl->bufs = calloc (bctx->client_num_max, sizeof (tlog_buf))))
+        {
+                fprintf (stderr, "%s - error: calloc () failed.\n", __func__);
+                free (tl);
+                return -1;
+        }
+
+        tl->rnd = (unsigned int) (get_tick_count () ^ (unsigned long) bctx) | 1;
+
+        bctx->tlog = tl;
+        return 0;
+}
+
+/****************************************************************************************
+* Function name - tlog_close
+*
+* Description - Reports the numbers of kept and discarded traces and frees
+*               the trace buffers.
+*
+* Input -       *bctx - pointer to the batch context
+* Return Code/Output - None
+****************************************************************************************/
+void tlog_close (batch_context* bctx)
+{
+        tlog* tl = bctx->tlog;
+        int i;
+
+        if (!tl)
+        {
+                return;
+        }
+
+        fprintf (stderr, "%s - \"%s\" - traces kept: %lu failed, %lu slow, %lu sampled; "
+                 "%lu discarded.\n", __func__, bctx->batch_name,
+                 tl->kept_failed, tl->kept_slow, tl->kept_sampled, tl->discarded);
+
+        for (i = 0; i < bctx->client_num_max; i++)
+        {
+                free (tl->bufs[i].buf);
+        }
+
+        free (tl->bufs);
+        free (tl);
+        bctx->tlog = NULL;
+}
+
+/****************************************************************************************
+* Function name - tlog_line
+*
+* Description - Appends a client log line, formatted as the logfile line, to the
+*               trace buffer of the client.
+*
+* Input -       *cctx        - pointer to the client context
+*               offs         - msec since the start of the load
+*               *ind         - indication string, e.g. "!! OK"
+*               *data        - the logged data
+*               *url         - effective url or NULL
+*               *url_target  - configured url, when differs from the effective one, or NULL
+* Return Code/Output - None
+****************************************************************************************/
+void tlog_line (client_context* cctx,
+                long offs,
+                const char* ind,
+                const char* data,
+                const char* url,
+                const char* url_target)
+{
+        tlog_buf* tb = &cctx->bctx->tlog->bufs[cctx->client_index];
+        size_t data_len = strlen (data);
+        char line[TLOG_BUFFER_SIZE];
+        int n;
+
+        if (data_len && data[data_len - 1] == '\n')
+                data_len--;
+
+        n = snprintf (line, sizeof (line), "%ld %ld %ld %s%s %.*s%s%s%s%s\n",
+                      offs, cctx->cycle_num, cctx->url_curr_index, client_name (cctx),
+                      ind, (int) data_len, data,
+                      url ? " eff-url: url " : "", url ? url : "",
+                      url_target ? " url: url " : "", url_target ? url_target : "");
+
+        if (n > 0)
+        {
+                tlog_append (tb, line, (size_t) n < sizeof (line) ? (size_t) n : sizeof (line) - 1);
+        }
+}
+
+/****************************************************************************************
+* Function name - tlog_text
+*
+* Description - Appends text, like headers, to the trace buffer of the client as is
+*
+* Input -       *cctx - pointer to the client context
+*               *text - the text
+*               len   - length of the text
+* Return Code/Output - None
+****************************************************************************************/
+void tlog_text (client_context* cctx, const char* text, size_t len)
+{
+        tlog_append (&cctx->bctx->tlog->bufs[cctx->client_index], text, len);
+}
+
+/****************************************************************************************
+* Function name - tlog_request_done
+*
+* Description - Writes the trace of the accomplished request to the logfile, when
+*               the request failed, was slow or sampled, and resets the buffer.
+*               Called by stat_request_commit () before the scratch counters of
+*               the request are committed.
+*
+* Input -       *cctx - pointer to the client context
+* Return Code/Output - None
+****************************************************************************************/
+void tlog_request_done (client_context* cctx)
+{
+        batch_context* bctx = cctx->bctx;
+        tlog* tl = bctx->tlog;
+        tlog_buf* tb;
+        const client_req_stat* rs = &cctx->rs;
+        const char* reason = NULL;
+        unsigned long now, latency;
+        char line[256];
+        int n;
+
+        if (!tl)
+        {
+                return;
+        }
+
+        tb = &tl->bufs[cctx->client_index];
+
+        if (!tb->len)
+        {
+                return;
+        }
+
+        now = get_tick_count ();
+        latency = now > cctx->req_sent_timestamp ? now - cctx->req_sent_timestamp : 0;
+
+        if (rs->other_errs || rs->url_timeout_errs || rs->resp_4xx || rs->resp_5xx ||
+            cctx->client_state == CSTATE_ERROR)
+        {
+                reason = "failed";
+                tl->kept_failed++;
+        }
+        else if (tail_latency_threshold && latency > tail_latency_threshold)
+        {
+                reason = "slow";
+                tl->kept_slow++;
+        }
+        else if (tail_sample_rate)
+        {
+                /* xorshift32 */
+                tl->rnd ^= tl->rnd << 13;
+                tl->rnd ^= tl->rnd >> 17;
+                tl->rnd ^= tl->rnd << 5;
+
+                if (tl->rnd % tail_sample_rate == 0)
+                {
+                        reason = "sampled";
+                        tl->kept_sampled++;
+                }
+        }
+
+        if (!reason)
+        {
+                tl->discarded++;
+                tb->len = tb->truncated = 0;
+                return;
+        }
+
+        n = snprintf (line, sizeof (line), "%ld %ld %ld %s!! TAIL %s %lu msec%s\n",
+                      now - bctx->start_time, cctx->cycle_num, cctx->url_curr_index,
+                      client_name (cctx), reason, latency,
+                      tb->truncated ? " (trace truncated)" : "");
+
+        tlog_out (cctx, line, n < (int) sizeof (line) ? (size_t) n : sizeof (line) - 1);
+        tlog_out (cctx, tb->buf, tb->len);
+
+        tb->len = tb->truncated = 0;
+}
+
+static void tlog_append (tlog_buf* tb, const char* text, size_t len)
+{
+        if (!tb->buf && !(tb->buf = malloc (TLOG_BUFFER_SIZE)))
+        {
+                tb->truncated = 1;
+                return;
+        }
+
+        if (len > (size_t) (TLOG_BUFFER_SIZE - tb->len))
+        {
+                len = TLOG_BUFFER_SIZE - tb->len;
+                tb->truncated = 1;
+        }
+
+        memcpy (tb->buf + tb->len, text, len);
+        tb->len += len;
+}
+
+/*
+   Writes the text to the logfile of the client, through the ring of
+   asynchronous logging, when used.
+ */
+static void tlog_out (client_context* cctx, const char* text, size_t len)
+{
+        if (cctx->bctx->alog)
+        {
+                alog_text (cctx, text, len);
+        }
+        else
+        {
+                (void)fwrite (text, 1, len, cctx->file_output);
+        }
+}
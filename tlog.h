@@ -0,0 +1,113 @@
+/*
+*     tlog.h
+*
+* 2006-2007 Copyright (c)
+* Robert Iakobashvili, <coroberti@gmail.com>
+* Michael Moser,  <moser.michael@gmail.com>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef TLOG_H
+#define TLOG_H
+
+#include <stddef.h>
+
+/*
+   Tail-based sampled logging of requests (-T command line option).
+
+   Trace lines and headers of the request in progress are kept in a small
+   buffer of the client instead of the logfile. When the request is
+   accomplished, the buffer is written to the logfile only, if the request
+   failed, took longer than the latency threshold or was picked by 1-in-N
+   random sampling. Otherwise the buffer is just reset.
+ */
+
+/* Size of the trace buffer of a client, longer traces are truncated */
+#define TLOG_BUFFER_SIZE 4096
+
+struct batch_context;
+struct client_context;
+
+/****************************************************************************************
+* Function name - tlog_open
+*
+* Description - Allocates trace buffers of the batch clients, when tail-based
+*               logging is configured by -T command line option.
+*
+* Input -       *bctx - pointer to the batch context
+* Return Code/Output - On Success - 0, on Error -1
+****************************************************************************************/
+int tlog_open (struct batch_context* bctx);
+
+/****************************************************************************************
+* Function name - tlog_close
+*
+* Description - Reports the numbers of kept and discarded traces and frees
+*               the trace buffers.
+*
+* Input -       *bctx - pointer to the batch context
+* Return Code/Output - None
+****************************************************************************************/
+void tlog_close (struct batch_context* bctx);
+
+/****************************************************************************************
+* Function name - tlog_line
+*
+* Description - Appends a client log line, formatted as the logfile line, to the
+*               trace buffer of the client.
+*
+* Input -       *cctx        - pointer to the client context
+*               offs         - msec since the start of the load
+*               *ind         - indication string, e.g. "!! OK"
+*               *data        - the logged data
+*               *url         - effective url or NULL
+*               *url_target  - configured url, when differs from the effective one, or NULL
+* Return Code/Output - None
+****************************************************************************************/
+void tlog_line (struct client_context* cctx,
+                long offs,
+                const char* ind,
+                const char* data,
+                const char* url,
+                const char* url_target);
+
+/****************************************************************************************
+* Function name - tlog_text
+*
+* Description - Appends text, like headers, to the trace buffer of the client as is
+*
+* Input -       *cctx - pointer to the client context
+*               *text - the text
+*               len   - length of the text
+* Return Code/Output - None
+****************************************************************************************/
+void tlog_text (struct client_context* cctx, const char* text, size_t len);
+
+/****************************************************************************************
+* Function name - tlog_request_done
+*
+* Description - Writes the trace of the accomplished request to the logfile, when
+*               the request failed, was slow or sampled, and resets the buffer.
+*               Called by stat_request_commit () before the scratch counters of
+*               the request are committed.
+*
+* Input -       *cctx - pointer to the client context
+* Return Code/Output - None
+****************************************************************************************/
+void tlog_request_done (struct client_context* cctx);
+
+#endif /* TLOG_H */
@@ -0,0 +1,161 @@
+/*
+*     tls_rate.c
+*
+* 2006-2007 Copyright (c)
+* Robert Iakobashvili, <coroberti@gmail.com>
+* Michael Moser,  <moser.michael@gmail.com>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+// must be first include
+#include "fdsetsize.h"
+
+#include <stdio.h>
+
+#include <openssl/ssl.h>
+
+#include "tls_rate.h"
+#include "batch.h"
+#include "client.h"
+#include "statistics.h"
+
+static CURLcode tls_ssl_ctx_function (CURL* handle, void* ssl_ctx, void* userptr);
+static void tls_info_callback (const SSL* ssl, int where, int ret);
+
+
+/****************************************************************************************
+* Function name - tls_rate_handle_setup
+*
+* Description - Installs the SSL_CTX callback of the client to the handle.
+*
+* Input -       *cctx   - pointer to the client context
+*               *handle - the CURL handle of the client
+* Return Code/Output - None
+****************************************************************************************/
+void tls_rate_handle_setup (client_context* cctx, CURL* handle)
+{
+        curl_easy_setopt (handle, CURLOPT_SSL_CTX_FUNCTION, tls_ssl_ctx_function);
+        curl_easy_setopt (handle, CURLOPT_SSL_CTX_DATA, cctx);
+}
+
+/****************************************************************************************
+* Function name - tls_rate_error
+*
+* Description - Marks the handshake of the client failed, when the transfer failed
+*               by a TLS error before the handshake completed.
+*
+* Input -       *cctx     - pointer to the client context
+*               curl_code - CURLcode of the transfer
+*               connected - TCP connection was established
+* Return Code/Output - None
+****************************************************************************************/
+void tls_rate_error (client_context* cctx, int curl_code, int connected)
+{
+        if (cctx->tls_hs == TLS_HS_NONE &&
+            op_err_class_of (curl_code, connected) == OP_ERR_SSL)
+        {
+                cctx->tls_hs = TLS_HS_FAILED;
+        }
+}
+
+/****************************************************************************************
+* Function name - tls_rate_commit
+*
+* Description - Commits the handshake of the accomplished request to the url and
+*               HTTPS statistics and clears the mark. Called by stat_request_commit ().
+*
+* Input -       *cctx - pointer to the client context
+* Return Code/Output - None
+****************************************************************************************/
+void tls_rate_commit (client_context* cctx)
+{
+        batch_context* bctx = cctx->bctx;
+        stat_point* us = &bctx->url_stats[cctx->url_curr_index];
+        stat_point* ds = &bctx->https_delta;
+        double connect_time = 0.0, appconnect_time = 0.0;
+        const int hs = cctx->tls_hs;
+
+        if (hs == TLS_HS_NONE)
+        {
+                return;
+        }
+
+        cctx->tls_hs = TLS_HS_NONE;
+
+        if (hs == TLS_HS_FAILED)
+        {
+                us->tls_failed++;
+                ds->tls_failed++;
+                return;
+        }
+
+        if (hs == TLS_HS_RESUMED)
+        {
+                us->tls_resumed++;
+                ds->tls_resumed++;
+        }
+        else
+        {
+                us->tls_full++;
+                ds->tls_full++;
+        }
+
+        if (cctx->handle &&
+            curl_easy_getinfo (cctx->handle, CURLINFO_CONNECT_TIME, &connect_time) == CURLE_OK &&
+            curl_easy_getinfo (cctx->handle, CURLINFO_APPCONNECT_TIME, &appconnect_time) == CURLE_OK &&
+            appconnect_time > connect_time)
+        {
+                const unsigned long usec =
+                        (unsigned long) ((appconnect_time - connect_time) * 1000000.0);
+
+                stat_point_tls_add (us, usec);
+                stat_point_tls_add (ds, usec);
+        }
+}
+
+/*
+   libcurl creates SSL_CTX for each new connection. The client, making the
+   connection, is kept in the application data of the SSL_CTX for the
+   info callback. With fresh connections of -H mode a connection is not
+   re-used by another client.
+ */
+static CURLcode tls_ssl_ctx_function (CURL* handle, void* ssl_ctx, void* userptr)
+{
+        (void) handle;
+
+        SSL_CTX_set_app_data ((SSL_CTX*) ssl_ctx, userptr);
+        SSL_CTX_set_info_callback ((SSL_CTX*) ssl_ctx, tls_info_callback);
+
+        return CURLE_OK;
+}
+
+static void tls_info_callback (const SSL* ssl, int where, int ret)
+{
+        client_context* cctx;
+
+        (void) ret;
+
+        if (!(where & SSL_CB_HANDSHAKE_DONE))
+        {
+                return;
+        }
+
+        if ((cctx = SSL_CTX_get_app_data (SSL_get_SSL_CTX (ssl))))
+        {
+                cctx->tls_hs = SSL_session_reused ((SSL*) ssl) ? TLS_HS_RESUMED : TLS_HS_FULL;
+        }
+}
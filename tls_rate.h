@@ -0,0 +1,87 @@
+/*
+*     tls_rate.h
+*
+* 2006-2007 Copyright (c)
+* Robert Iakobashvili, <coroberti@gmail.com>
+* Michael Moser,  <moser.michael@gmail.com>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef TLS_RATE_H
+#define TLS_RATE_H
+
+#include <curl/curl.h>
+
+/*
+   TLS handshake-rate mode (-H command line option).
+
+   An OpenSSL info callback, installed to the SSL_CTX of each new connection,
+   marks the client with the outcome of the handshake: full or resumed.
+   A transfer failed by a TLS error before the handshake completed marks
+   it failed. The mark is committed to the url and HTTPS statistics with
+   the handshake time, when the request is committed.
+ */
+
+/* Handshake outcome of the request in progress, client_context tls_hs */
+#define TLS_HS_NONE 0
+#define TLS_HS_FULL 1
+#define TLS_HS_RESUMED 2
+#define TLS_HS_FAILED 3
+
+/* Values of TLS_HANDSHAKE url tag */
+#define TLS_HANDSHAKE_DEFAULT 0
+#define TLS_HANDSHAKE_FULL 1
+#define TLS_HANDSHAKE_RESUMED 2
+
+struct client_context;
+
+/****************************************************************************************
+* Function name - tls_rate_handle_setup
+*
+* Description - Installs the SSL_CTX callback of the client to the handle.
+*
+* Input -       *cctx   - pointer to the client context
+*               *handle - the CURL handle of the client
+* Return Code/Output - None
+****************************************************************************************/
+void tls_rate_handle_setup (struct client_context* cctx, CURL* handle);
+
+/****************************************************************************************
+* Function name - tls_rate_error
+*
+* Description - Marks the handshake of the client failed, when the transfer failed
+*               by a TLS error before the handshake completed.
+*
+* Input -       *cctx     - pointer to the client context
+*               curl_code - CURLcode of the transfer
+*               connected - TCP connection was established
+* Return Code/Output - None
+****************************************************************************************/
+void tls_rate_error (struct client_context* cctx, int curl_code, int connected);
+
+/****************************************************************************************
+* Function name - tls_rate_commit
+*
+* Description - Commits the handshake of the accomplished request to the url and
+*               HTTPS statistics and clears the mark. Called by stat_request_commit ().
+*
+* Input -       *cctx - pointer to the client context
+* Return Code/Output - None
+****************************************************************************************/
+void tls_rate_commit (struct client_context* cctx);
+
+#endif /* TLS_RATE_H */
@@ -0,0 +1,303 @@
+/*
+ *     resp_extract.c
+ *
+ * 2006-2007 Copyright (c)
+ * Robert Iakobashvili, <coroberti@gmail.com>
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+   Lists and extracts responses of the segmented store of a batch
+   (LOG_RESP_SEGMENTS), built by "make resp-extract".
+
+   resp-extract [options] <batch-dir>
+
+   Options:
+   -c client  - only responses of the client number;
+   -y cycle   - only responses of the cycle number;
+   -u url     - only responses of the url number;
+   -H         - write headers of the responses to stdout;
+   -B         - write bodies of the responses to stdout;
+   -o dir     - write each response to dir as the files
+                cl-<client>-cycle-<cycle>-url<url>.hdr and .body, the same
+                as logged to separate files without the segmented store.
+
+   Without -H, -B and -o the matching index records are listed.
+   Segments, compressed by curl-loader -z option, are read as well.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <zlib.h>
+
+#include "rstore.h"
+
+#define EXTRACT_COPY_BUFFER_SIZE (256*1024)
+
+static const char* batch_dir = NULL;
+
+/*
+   Open segments, indexed by the segment number: a descriptor of an
+   uncompressed segment or gzFile of a compressed one.
+ */
+typedef struct segment_file
+{
+        int fd;
+        gzFile gz;
+} segment_file;
+
+static segment_file* segs = NULL;
+static unsigned int segs_num = 0;
+
+static char copy_buffer[EXTRACT_COPY_BUFFER_SIZE];
+
+static void usage (const char* prog)
+{
+        fprintf (stderr,
+                 "usage: %s [-c client] [-y cycle] [-u url] [-H] [-B] [-o dir] <batch-dir>\n",
+                 prog);
+        exit (1);
+}
+
+static segment_file* segment_get (unsigned int segment)
+{
+        segment_file* sf;
+
+        if (segment >= segs_num)
+        {
+                unsigned int n = segment + 16, i;
+                segment_file* s = realloc (segs, n * sizeof (segment_file));
+
+                if (!s)
+                {
+                        fprintf (stderr, "%s - error: realloc () failed.\n", __func__);
+                        return NULL;
+                }
+
+                for (i = segs_num; i < n; i++)
+                {
+                        s[i].fd = -1;
+                        s[i].gz = NULL;
+                }
+
+                segs = s;
+                segs_num = n;
+        }
+
+        sf = &segs[segment];
+
+        if (sf->fd == -1 && !sf->gz)
+        {
+                char fname[1024];
+
+                snprintf (fname, sizeof (fname), "%s/" RSTORE_SEGMENT_NAME_FMT,
+                          batch_dir, segment);
+
+                if ((sf->fd = open (fname, O_RDONLY)) == -1)
+                {
+                        strcat (fname, ".gz");
+
+                        if (!(sf->gz = gzopen (fname, "rb")))
+                        {
+                                fprintf (stderr, "%s - error: failed to open segment %u in \"%s\".\n",
+                                         __func__, segment, batch_dir);
+                                return NULL;
+                        }
+
+                        gzbuffer (sf->gz, EXTRACT_COPY_BUFFER_SIZE);
+                }
+        }
+
+        return sf;
+}
+
+/*
+   Copies len bytes at offset of the segment to the output file. Seeking
+   in a compressed segment is done by decompressing, that is fast only
+   forward, in the order of the index.
+ */
+static int copy_range (unsigned int segment, uint64_t offset, uint64_t len, FILE* out)
+{
+        segment_file* sf = segment_get (segment);
+
+        if (!sf)
+        {
+                return -1;
+        }
+
+        if (sf->gz && gzseek (sf->gz, (z_off_t) offset, SEEK_SET) == -1)
+        {
+                fprintf (stderr, "%s - error: segment %u is truncated at %llu.\n",
+                         __func__, segment, (unsigned long long) offset);
+                return -1;
+        }
+
+        while (len > 0)
+        {
+                size_t chunk = len < sizeof (copy_buffer) ? (size_t) len : sizeof (copy_buffer);
+                ssize_t n = sf->gz ? gzread (sf->gz, copy_buffer, chunk) :
+                        pread (sf->fd, copy_buffer, chunk, (off_t) offset);
+
+                if (n <= 0)
+                {
+                        fprintf (stderr, "%s - error: segment %u is truncated at %llu.\n",
+                                 __func__, segment, (unsigned long long) offset);
+                        return -1;
+                }
+
+                if (fwrite (copy_buffer, 1, n, out) != (size_t) n)
+                {
+                        fprintf (stderr, "%s - error: fwrite () failed with errno %d.\n",
+                                 __func__, errno);
+                        return -1;
+                }
+
+                offset += n;
+                len -= n;
+        }
+
+        return 0;
+}
+
+static int copy_to_file (const char* out_dir, const rstore_index_rec* rec,
+                         const char* suffix, uint64_t offset, uint64_t len)
+{
+        char fname[1024];
+        FILE* out;
+        int rval;
+
+        snprintf (fname, sizeof (fname), "%s/cl-%u-cycle-%u-url%u.%s",
+                  out_dir, rec->client_index, rec->cycle, rec->url_index, suffix);
+
+        if (!(out = fopen (fname, "w")))
+        {
+                fprintf (stderr, "%s - error: fopen () of \"%s\" failed with errno %d.\n",
+                         __func__, fname, errno);
+                return -1;
+        }
+
+        rval = copy_range (rec->segment, offset, len, out);
+        fclose (out);
+        return rval;
+}
+
+int main (int argc, char** argv)
+{
+        long client = -1, cycle = -1, url = -1;
+        int headers = 0, bodies = 0;
+        const char* out_dir = NULL;
+        char fname[1024];
+        FILE* idx;
+        rstore_index_hdr hdr;
+        rstore_index_rec rec;
+        unsigned long matched = 0;
+        int opt;
+
+        while ((opt = getopt (argc, argv, "c:y:u:HBo:")) != -1)
+        {
+                switch (opt)
+                {
+                case 'c': client = atol (optarg); break;
+                case 'y': cycle = atol (optarg); break;
+                case 'u': url = atol (optarg); break;
+                case 'H': headers = 1; break;
+                case 'B': bodies = 1; break;
+                case 'o': out_dir = optarg; break;
+                default: usage (argv[0]);
+                }
+        }
+
+        if (optind != argc - 1)
+        {
+                usage (argv[0]);
+        }
+
+        batch_dir = argv[optind];
+        snprintf (fname, sizeof (fname), "%s/%s", batch_dir, RSTORE_INDEX_NAME);
+
+        if (!(idx = fopen (fname, "r")))
+        {
+                fprintf (stderr, "%s - error: fopen () of \"%s\" failed with errno %d.\n",
+                         __func__, fname, errno);
+                return 1;
+        }
+
+        if (fread (&hdr, sizeof (hdr), 1, idx) != 1 ||
+            memcmp (hdr.magic, RSTORE_INDEX_MAGIC, sizeof (hdr.magic)) ||
+            hdr.rec_size != sizeof (rstore_index_rec))
+        {
+                fprintf (stderr, "%s - error: \"%s\" is not a responses index.\n",
+                         __func__, fname);
+                return 1;
+        }
+
+        if (!headers && !bodies && !out_dir)
+        {
+                fprintf (stdout, "client\tcycle\turl\tsegment\toffset\thdr_len\tbody_len\n");
+        }
+
+        while (fread (&rec, sizeof (rec), 1, idx) == 1)
+        {
+                const uint64_t body_offset = rec.offset + rec.hdr_len;
+
+                if ((client >= 0 && rec.client_index != client) ||
+                    (cycle >= 0 && rec.cycle != cycle) ||
+                    (url >= 0 && rec.url_index != url))
+                {
+                        continue;
+                }
+
+                matched++;
+
+                if (out_dir)
+                {
+                        if ((rec.hdr_len &&
+                             copy_to_file (out_dir, &rec, "hdr", rec.offset, rec.hdr_len) == -1) ||
+                            (rec.body_len &&
+                             copy_to_file (out_dir, &rec, "body", body_offset, rec.body_len) == -1))
+                        {
+                                return 1;
+                        }
+                }
+                else if (headers || bodies)
+                {
+                        if ((headers && copy_range (rec.segment, rec.offset, rec.hdr_len, stdout) == -1) ||
+                            (bodies && copy_range (rec.segment, body_offset, rec.body_len, stdout) == -1))
+                        {
+                                return 1;
+                        }
+                }
+                else
+                {
+                        fprintf (stdout, "%u\t%u\t%u\t%u\t%llu\t%u\t%u\n",
+                                 rec.client_index, rec.cycle, rec.url_index, rec.segment,
+                                 (unsigned long long) rec.offset, rec.hdr_len, rec.body_len);
+                }
+        }
+
+        fclose (idx);
+
+        fprintf (stderr, "%lu responses matched.\n", matched);
+        return 0;
+}
@@ -0,0 +1,417 @@
+/*
+*     topk.c
+*
+* 2006-2007 Copyright (c)
+* Robert Iakobashvili, <coroberti@gmail.com>
+* Michael Moser,  <moser.michael@gmail.com>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+// must be first include
+#include "fdsetsize.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "topk.h"
+#include "batch.h"
+#include "client.h"
+#include "conf.h"
+#include "loader.h"
+
+/*
+   Min-heap of the slowest requests, the root is the fastest of them.
+ */
+typedef struct topk_heap
+{
+        int num;
+        topk_entry* e;
+} topk_heap;
+
+/*
+   The slowest requests of a batch. Heaps of a sub-batch are filled by
+   its loading thread and emptied by the batch group leader under the lock.
+ */
+typedef struct topk
+{
+        pthread_mutex_t lock;
+
+        /* Heaps of the current interval and of the whole run, indexed by url */
+        topk_heap* interval;
+        topk_heap* total;
+} topk;
+
+static void topk_heap_push (topk_heap* h, const topk_entry* entry);
+static void topk_heap_merge (topk_heap* to, topk_heap* from);
+static int topk_entry_cmp (const void* a, const void* b);
+
+
+/****************************************************************************************
+* Function name - topk_init
+*
+* Description - Allocates the per url heaps of the slowest requests of a batch,
+*               when configured by -k command line option.
+*
+* Input -       *bctx - pointer to the batch context
+* Return Code/Output - On Success - 0, on Error -1
+****************************************************************************************/
+int topk_init (batch_context* bctx)
+{
+        topk* tk;
+        topk_entry* entries;
+        int i;
+
+        if (!topk_slowest || bctx->topk || !bctx->urls_num)
+        {
+                return 0;
+        }
+
+        if (!(tk = calloc (1, sizeof (topk))) ||
+            !(tk->interval = calloc (2 * bctx->urls_num, sizeof (topk_heap))) ||
+            !(entries = calloc (2 * bctx->urls_num * topk_slowest, sizeof (topk_entry))))
+        {
+                fprintf (stderr, "%s - error: calloc () failed.\n", __func__);
+                if (tk)
+                        free (tk->interval);
+                free (tk);
+                return -1;
+        }
+
+        pthread_mutex_init (&tk->lock, NULL);
+
+        tk->total = tk->interval + bctx->urls_num;
+
+        for (i = 0; i < 2 * bctx->urls_num; i++)
+        {
+                tk->interval[i].e = entries + i * topk_slowest;
+        }
+
+        bctx->topk = tk;
+        return 0;
+}
+
+/****************************************************************************************
+* Function name - topk_request_done
+*
+* Description - Inserts the accomplished request to the interval heap of its url,
+*               when the request is slower than the heap minimum. Called by
+*               stat_request_commit () before the scratch counters are reset.
+*
+* Input -       *cctx - pointer to the client context
+* Return Code/Output - None
+****************************************************************************************/
+void topk_request_done (client_context* cctx)
+{
+        batch_context* bctx = cctx->bctx;
+        topk* tk = bctx->topk;
+        topk_heap* h;
+        topk_entry entry;
+        unsigned long now;
+        char* url = NULL;
+        double t;
+
+        if (!tk)
+        {
+                return;
+        }
+
+        now = get_tick_count ();
+        entry.latency = now > cctx->req_sent_timestamp ? now - cctx->req_sent_timestamp : 0;
+
+        /*
+           The cheap test, that filters out almost all requests. Reading the
+           heap unlocked may race only with the leader emptying it.
+         */
+        h = &tk->interval[cctx->url_curr_index];
+        if (h->num == topk_slowest && entry.latency <= h->e[0].latency)
+        {
+                return;
+        }
+
+        entry.client_index = cctx->client_index + 1;
+        entry.cycle = cctx->cycle_num;
+        entry.status = 0;
+        entry.data_in = cctx->rs.data_in;
+        entry.data_out = cctx->rs.data_out;
+
+        if (!client_ip_str (bctx, cctx->client_index, entry.ip, sizeof (entry.ip)))
+        {
+                entry.ip[0] = '\0';
+        }
+
+        entry.dns = entry.connect = entry.appconnect = 0;
+        entry.pretransfer = entry.starttransfer = entry.total = 0;
+
+        if (cctx->handle)
+        {
+                curl_easy_getinfo (cctx->handle, CURLINFO_RESPONSE_CODE, &entry.status);
+                curl_easy_getinfo (cctx->handle, CURLINFO_EFFECTIVE_URL, &url);
+
+                if (curl_easy_getinfo (cctx->handle, CURLINFO_NAMELOOKUP_TIME, &t) == CURLE_OK)
+                        entry.dns = (unsigned long) (t * 1000000);
+                if (curl_easy_getinfo (cctx->handle, CURLINFO_CONNECT_TIME, &t) == CURLE_OK)
+                        entry.connect = (unsigned long) (t * 1000000);
+                if (curl_easy_getinfo (cctx->handle, CURLINFO_APPCONNECT_TIME, &t) == CURLE_OK)
+                        entry.appconnect = (unsigned long) (t * 1000000);
+                if (curl_easy_getinfo (cctx->handle, CURLINFO_PRETRANSFER_TIME, &t) == CURLE_OK)
+                        entry.pretransfer = (unsigned long) (t * 1000000);
+                if (curl_easy_getinfo (cctx->handle, CURLINFO_STARTTRANSFER_TIME, &t) == CURLE_OK)
+                        entry.starttransfer = (unsigned long) (t * 1000000);
+                if (curl_easy_getinfo (cctx->handle, CURLINFO_TOTAL_TIME, &t) == CURLE_OK)
+                        entry.total = (unsigned long) (t * 1000000);
+        }
+
+        if (!url)
+        {
+                url = bctx->url_ctx_array[cctx->url_curr_index].url_str;
+        }
+
+        strncpy (entry.url, url ? url : "", sizeof (entry.url) - 1);
+        entry.url[sizeof (entry.url) - 1] = '\0';
+
+        pthread_mutex_lock (&tk->lock);
+        topk_heap_push (h, &entry);
+        pthread_mutex_unlock (&tk->lock);
+}
+
+/****************************************************************************************
+* Function name - topk_advance
+*
+* Description - Merges the interval heaps of the sub-batches to the heaps of the
+*               batch group leader and the interval heaps of the leader to its
+*               heaps of the whole run. Called by the leader at the end of an interval.
+*
+* Input -       *bctx - pointer to the batch group leader context
+* Return Code/Output - None
+****************************************************************************************/
+void topk_advance (batch_context* bctx)
+{
+        topk* tk = bctx->topk;
+        int i, u;
+
+        if (!tk)
+        {
+                return;
+        }
+
+        pthread_mutex_lock (&tk->lock);
+
+        for (i = 1; i <= threads_subbatches_num; i++)
+        {
+                topk* sub = (bctx + i)->topk;
+
+                if (!sub)
+                        continue;
+
+                pthread_mutex_lock (&sub->lock);
+
+                /* Other threads heaps - emptied just after collecting */
+                for (u = 0; u < bctx->urls_num; u++)
+                {
+                        topk_heap_merge (&tk->interval[u], &sub->interval[u]);
+                        sub->interval[u].num = 0;
+                }
+
+                pthread_mutex_unlock (&sub->lock);
+        }
+
+        for (u = 0; u < bctx->urls_num; u++)
+        {
+                topk_heap_merge (&tk->total[u], &tk->interval[u]);
+        }
+
+        pthread_mutex_unlock (&tk->lock);
+}
+
+/****************************************************************************************
+* Function name - topk_interval_reset
+*
+* Description - Empties the interval heaps of the batch group leader after output.
+*
+* Input -       *bctx - pointer to the batch group leader context
+* Return Code/Output - None
+****************************************************************************************/
+void topk_interval_reset (batch_context* bctx)
+{
+        topk* tk = bctx->topk;
+        int u;
+
+        if (!tk)
+        {
+                return;
+        }
+
+        pthread_mutex_lock (&tk->lock);
+
+        for (u = 0; u < bctx->urls_num; u++)
+        {
+                tk->interval[u].num = 0;
+        }
+
+        pthread_mutex_unlock (&tk->lock);
+}
+
+/****************************************************************************************
+* Function name - topk_sorted
+*
+* Description - Copies the entries of a heap of the batch group leader to an
+*               array, sorted from the slowest.
+*
+* Input -       *bctx     - pointer to the batch group leader context
+*               url_index - index of the url
+*               total     - 1 - heap of the whole run, 0 - of the latest interval
+*               *out      - array of at least topk_slowest entries
+* Return Code/Output - Number of the entries copied
+****************************************************************************************/
+int topk_sorted (batch_context* bctx, size_t url_index, int total, topk_entry* out)
+{
+        topk* tk = bctx->topk;
+        topk_heap* h;
+        int n;
+
+        if (!tk || url_index >= (size_t) bctx->urls_num)
+        {
+                return 0;
+        }
+
+        pthread_mutex_lock (&tk->lock);
+
+        h = total ? &tk->total[url_index] : &tk->interval[url_index];
+        n = h->num;
+        memcpy (out, h->e, n * sizeof (topk_entry));
+
+        pthread_mutex_unlock (&tk->lock);
+
+        qsort (out, n, sizeof (topk_entry), topk_entry_cmp);
+        return n;
+}
+
+/****************************************************************************************
+* Function name - topk_dump
+*
+* Description - Prints the slowest requests of the whole run per url.
+*
+* Input -       *bctx - pointer to the batch group leader context
+*               *file - output file
+* Return Code/Output - None
+****************************************************************************************/
+void topk_dump (batch_context* bctx, FILE* file)
+{
+        topk_entry* entries;
+        int u, i, n;
+
+        if (!bctx->topk)
+        {
+                return;
+        }
+
+        if (!(entries = calloc (topk_slowest, sizeof (topk_entry))))
+        {
+                fprintf (stderr, "%s - error: calloc () failed.\n", __func__);
+                return;
+        }
+
+        for (u = 0; u < bctx->urls_num; u++)
+        {
+                if (!(n = topk_sorted (bctx, u, 1, entries)))
+                        continue;
+
+                fprintf (file, "\nSlowest requests of url %d \"%s\" (msec):\n", u,
+                         bctx->url_ctx_array[u].url_short_name);
+                fprintf (file, "%8s %8s %-16s %6s %4s %8s %8s %8s %8s %8s %8s %10s %10s  %s\n",
+                         "Latency", "Client", "IP", "Cycle", "Code", "DNS", "Connect",
+                         "TLS", "PreXfer", "FirstB", "Total", "D-in", "D-out", "Url");
+
+                for (i = 0; i < n; i++)
+                {
+                        const topk_entry* e = &entries[i];
+
+                        fprintf (file, "%8lu %8lu %-16s %6ld %4ld %8.1f %8.1f %8.1f %8.1f "
+                                 "%8.1f %8.1f %10lu %10lu  %s\n",
+                                 e->latency, e->client_index, e->ip, e->cycle, e->status,
+                                 e->dns / 1000.0, e->connect / 1000.0, e->appconnect / 1000.0,
+                                 e->pretransfer / 1000.0, e->starttransfer / 1000.0,
+                                 e->total / 1000.0, e->data_in, e->data_out, e->url);
+                }
+        }
+
+        free (entries);
+}
+
+/*
+   Inserts to the heap, when not full, or replaces the root, when the
+   entry is slower than it. O(log K).
+ */
+static void topk_heap_push (topk_heap* h, const topk_entry* entry)
+{
+        topk_entry* e = h->e;
+        topk_entry tmp;
+        int i, c;
+
+        if (h->num < topk_slowest)
+        {
+                /* Sift up */
+                for (i = h->num++; i > 0 && e[(i - 1) / 2].latency > entry->latency; i = (i - 1) / 2)
+                {
+                        e[i] = e[(i - 1) / 2];
+                }
+                e[i] = *entry;
+                return;
+        }
+
+        if (entry->latency <= e[0].latency)
+        {
+                return;
+        }
+
+        /* Sift down from the root */
+        tmp = *entry;
+        for (i = 0; (c = 2 * i + 1) < h->num; i = c)
+        {
+                if (c + 1 < h->num && e[c + 1].latency < e[c].latency)
+                        c++;
+
+                if (e[c].latency >= tmp.latency)
+                        break;
+
+                e[i] = e[c];
+        }
+        e[i] = tmp;
+}
+
+/*
+   Pushes all entries of the heap from to the heap to.
+ */
+static void topk_heap_merge (topk_heap* to, topk_heap* from)
+{
+        int i;
+
+        for (i = 0; i < from->num; i++)
+        {
+                topk_heap_push (to, &from->e[i]);
+        }
+}
+
+static int topk_entry_cmp (const void* a, const void* b)
+{
+        const unsigned long la = ((const topk_entry*) a)->latency;
+        const unsigned long lb = ((const topk_entry*) b)->latency;
+
+        return la < lb ? 1 : (la > lb ? -1 : 0);
+}
@@ -0,0 +1,155 @@
+/*
+*     topk.h
+*
+* 2006-2007 Copyright (c)
+* Robert Iakobashvili, <coroberti@gmail.com>
+* Michael Moser,  <moser.michael@gmail.com>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef TOPK_H
+#define TOPK_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+/*
+   Capture of the K slowest requests per url (-k command line option).
+
+   Each batch keeps per url a bounded min-heap of the K slowest requests
+   of the current interval. A request is compared to the heap minimum and
+   only a slower one gathers its details and is inserted in O(log K).
+   At the end of each interval the batch group leader merges the heaps of
+   the sub-batches into its own and the interval heap into the heap of the
+   whole run.
+ */
+
+/* Max number of the slowest requests kept per url */
+#define TOPK_MAX 1000
+
+#define TOPK_IP_LEN 64
+#define TOPK_URL_LEN 256
+
+struct batch_context;
+struct client_context;
+
+/*
+   Details of a captured request.
+ */
+typedef struct topk_entry
+{
+        /* Latency of the request in msec, the heap key */
+        unsigned long latency;
+
+        unsigned long client_index;
+
+        long cycle;
+
+        /* Response status code, 0 - no response */
+        long status;
+
+        /*
+           Phase timings of libcurl in usec since the start of the transfer:
+           name lookup, connect, TLS handshake, pretransfer, first byte and total.
+         */
+        unsigned long dns;
+        unsigned long connect;
+        unsigned long appconnect;
+        unsigned long pretransfer;
+        unsigned long starttransfer;
+        unsigned long total;
+
+        unsigned long data_in;
+        unsigned long data_out;
+
+        char ip[TOPK_IP_LEN];
+
+        /* Effective url, may be truncated */
+        char url[TOPK_URL_LEN];
+} topk_entry;
+
+/****************************************************************************************
+* Function name - topk_init
+*
+* Description - Allocates the per url heaps of the slowest requests of a batch,
+*               when configured by -k command line option.
+*
+* Input -       *bctx - pointer to the batch context
+* Return Code/Output - On Success - 0, on Error -1
+****************************************************************************************/
+int topk_init (struct batch_context* bctx);
+
+/****************************************************************************************
+* Function name - topk_request_done
+*
+* Description - Inserts the accomplished request to the interval heap of its url,
+*               when the request is slower than the heap minimum. Called by
+*               stat_request_commit () before the scratch counters are reset.
+*
+* Input -       *cctx - pointer to the client context
+* Return Code/Output - None
+****************************************************************************************/
+void topk_request_done (struct client_context* cctx);
+
+/****************************************************************************************
+* Function name - topk_advance
+*
+* Description - Merges the interval heaps of the sub-batches to the heaps of the
+*               batch group leader and the interval heaps of the leader to its
+*               heaps of the whole run. Called by the leader at the end of an interval.
+*
+* Input -       *bctx - pointer to the batch group leader context
+* Return Code/Output - None
+****************************************************************************************/
+void topk_advance (struct batch_context* bctx);
+
+/****************************************************************************************
+* Function name - topk_interval_reset
+*
+* Description - Empties the interval heaps of the batch group leader after output.
+*
+* Input -       *bctx - pointer to the batch group leader context
+* Return Code/Output - None
+****************************************************************************************/
+void topk_interval_reset (struct batch_context* bctx);
+
+/****************************************************************************************
+* Function name - topk_sorted
+*
+* Description - Copies the entries of a heap of the batch group leader to an
+*               array, sorted from the slowest.
+*
+* Input -       *bctx     - pointer to the batch group leader context
+*               url_index - index of the url
+*               total     - 1 - heap of the whole run, 0 - of the latest interval
+*               *out      - array of at least topk_slowest entries
+* Return Code/Output - Number of the entries copied
+****************************************************************************************/
+int topk_sorted (struct batch_context* bctx, size_t url_index, int total, topk_entry* out);
+
+/****************************************************************************************
+* Function name - topk_dump
+*
+* Description - Prints the slowest requests of the whole run per url.
+*
+* Input -       *bctx - pointer to the batch group leader context
+*               *file - output file
+* Return Code/Output - None
+****************************************************************************************/
+void topk_dump (struct batch_context* bctx, FILE* file);
+
+#endif /* TOPK_H */
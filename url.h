@@ -282,6 +282,21 @@ typedef struct url_context
          */
         long fresh_connect;
 
+        /*
+           Mask of SHARE_DATA_* flags (share.h): DNS cache, TLS sessions and
+           cookies, shared with other handles of the url mask. Zero - nothing shared.
+         */
+        int share_data;
+
+        /*
+           TLS_HANDSHAKE_* (tls_rate.h): FULL disables the TLS session cache of
+           the handles, RESUMED and the default keep it.
+         */
+        int tls_handshake;
+
+        /* OpenSSL cipher list of TLS connections, NULL - libcurl default */
+        char* tls_ciphers;
+
         /*
            Maximum time to establish TCP connection with a server (including resolving).
            If zero, the global connect_timeout default is taken.
@@ -0,0 +1,130 @@
+/*
+ *     url_formatter.c
+ *
+ * 2006-2007 Copyright (c)
+ * Robert Iakobashvili, <coroberti@gmail.com>
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// must be first include
+#include "fdsetsize.h"
+
+#include <stdio.h>
+#include <ctype.h>
+
+#include "url_formatter.h"
+
+#define URL_S_DEFAULT 0
+#define URL_S_OPEN    1
+#define URL_S_CLOSE   2
+#define URL_S_DONE    3
+
+#define char_to_int(p) (p - '0')
+
+static void url_formatter_append (char *buffer, size_t *currlen, size_t maxlen, char c);
+
+/****************************************************************************************
+* Function name - url_formatter
+*
+* Description - Renders a form string to the buffer, substituting {N} placeholders
+*               by the N-th token of the client data record.
+*
+* Input -       *buffer  - pointer to the output buffer
+*               maxlen   - size of the buffer
+*               *format  - form string with {N} placeholders
+*               *fcd     - pointer to the client data record with tokens
+* Return Code/Output - None
+****************************************************************************************/
+void url_formatter (char *buffer, size_t maxlen, const char *format, const form_records_cdata*const fcd) {
+        char ch;
+        char *strvalue;
+        int min;
+        int state;
+        size_t currlen;
+
+        state = URL_S_DEFAULT;
+        currlen = min = 0;
+        ch = *format++;
+
+        while (state != URL_S_DONE)
+        {
+                if ((ch == '\0') || (currlen >= maxlen))
+                        state = URL_S_DONE;
+
+                switch(state)
+                {
+                case URL_S_DEFAULT:
+                        if (ch == '{')
+                                state = URL_S_OPEN;
+                        else
+                                url_formatter_append (buffer, &currlen, maxlen, ch);
+                        ch = *format++;
+                        break;
+                case URL_S_OPEN:
+                        if (isdigit(ch))
+                        {
+                                min = 10*min + char_to_int (ch);
+                                ch = *format++;
+                        }
+                        else if (ch == '}')
+                        {
+                                state = URL_S_CLOSE;
+                        }
+                        else
+                        {
+                                min = 0;
+                                state = URL_S_DEFAULT;
+                        }
+
+                        break;
+
+                case URL_S_CLOSE:
+                        fprintf (stderr, "\"%s\" - Convert the variable: %d \n",
+                                 __func__, min);
+
+                        strvalue = fcd->form_tokens[min] ? fcd->form_tokens[min] : "";
+
+                        fprintf (stderr, "\"%s\" - Variable value: %s \n",
+                                 __func__, strvalue);
+
+                        while (*strvalue)
+                        {
+                                url_formatter_append (buffer, &currlen, maxlen, *strvalue++);
+                        }
+
+                        ch = *format++;
+                        state = URL_S_DEFAULT;
+                        min = 0;
+                        break;
+                case URL_S_DONE:
+                        break;
+                default:
+                        // hmm?
+                        break; // some picky compilers need this
+                }
+        }
+        if (currlen < maxlen - 1)
+                buffer[currlen] = '\0';
+        else
+                buffer[maxlen - 1] = '\0';
+}
+
+static void url_formatter_append (char *buffer, size_t *currlen, size_t maxlen, char c)
+{
+        if (*currlen < maxlen)
+                buffer[(*currlen)++] = c;
+}
@@ -0,0 +1,44 @@
+/*
+ *     url_formatter.h
+ *
+ * 2006-2007 Copyright (c)
+ * Robert Iakobashvili, <coroberti@gmail.com>
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef URL_FORMATTER_H
+#define URL_FORMATTER_H
+
+#include <stddef.h>
+
+#include "url.h"
+
+/****************************************************************************************
+* Function name - url_formatter
+*
+* Description - Renders a form string to the buffer, substituting {N} placeholders
+*               by the N-th token of the client data record.
+*
+* Input -       *buffer  - pointer to the output buffer
+*               maxlen   - size of the buffer
+*               *format  - form string with {N} placeholders
+*               *fcd     - pointer to the client data record with tokens
+* Return Code/Output - None
+****************************************************************************************/
+void url_formatter (char *buffer, size_t maxlen, const char *format, const form_records_cdata*const fcd);
+
+#endif /* URL_FORMATTER_H */
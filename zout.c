@@ -0,0 +1,528 @@
+/*
+*     zout.c
+*
+* 2006-2007 Copyright (c)
+* Robert Iakobashvili, <coroberti@gmail.com>
+* Michael Moser,  <moser.michael@gmail.com>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/* fopencookie () */
+#define _GNU_SOURCE
+
+// must be first include
+#include "fdsetsize.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <zlib.h>
+
+#include "zout.h"
+#include "conf.h"
+
+/* Buffer of a compressed FILE, written out to the compressor as a block */
+#define ZOUT_FILE_BUFFER_SIZE (256*1024)
+
+/* Output buffer of the compressor */
+#define ZOUT_OUT_BUFFER_SIZE (1024*1024)
+
+/* Writers wait, when more bytes are queued to the compressor */
+#define ZOUT_QUEUE_MAX (64*1024*1024)
+
+/* Period of sync-flushing of the compressed files, seconds */
+#define ZOUT_SYNC_PERIOD 1
+
+typedef struct zout_stream
+{
+        /* Compressed file descriptor */
+        int fd;
+
+        /* The FILE, writing to the stream */
+        FILE* fp;
+
+        /* Used only by the compressor thread */
+        z_stream strm;
+
+        /* Deflated since the latest sync-flush */
+        int dirty;
+
+        /* Streams to sync-flush, linked and used only by the compressor thread */
+        struct zout_stream* sync_next;
+
+        /* Set by the compressor, when the gzip stream is finished and closed */
+        int finished;
+
+        struct zout_stream* next;
+} zout_stream;
+
+typedef struct zout_block
+{
+        struct zout_block* next;
+        zout_stream* zs;
+
+        /* Finish the stream after the data */
+        int finish;
+
+        size_t len;
+        char data[];
+} zout_block;
+
+static pthread_mutex_t zout_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* Signaled by writers on a new block */
+static pthread_cond_t zout_work = PTHREAD_COND_INITIALIZER;
+
+/* Broadcasted by the compressor on blocks consumed and streams finished */
+static pthread_cond_t zout_done = PTHREAD_COND_INITIALIZER;
+
+static zout_block* queue_head = NULL;
+static zout_block* queue_tail = NULL;
+static size_t queued_bytes = 0;
+
+/* Open compressed streams */
+static zout_stream* streams = NULL;
+
+static pthread_t compressor_thread;
+static int compressor_started = 0;
+static int compressor_stopping = 0;
+
+/* Accessed only by the compressor thread */
+static unsigned char* out_buffer = NULL;
+
+static void* zout_compressor (void* arg);
+static int zout_deflate (zout_stream* zs, const char* data, size_t len, int flush);
+static void zout_enqueue (zout_stream* zs, const char* data, size_t len, int finish);
+static ssize_t zout_cookie_write (void* cookie, const char* buf, size_t size);
+static int zout_cookie_close (void* cookie);
+
+
+/****************************************************************************************
+* Function name - zout_start
+*
+* Description - Starts the compressor thread, when compression is configured
+*               by -z command line option.
+*
+* Return Code/Output - On Success - 0, on Error -1
+****************************************************************************************/
+int zout_start ()
+{
+        if (!compress_level || compressor_started)
+        {
+                return 0;
+        }
+
+        if (!(out_buffer = malloc (ZOUT_OUT_BUFFER_SIZE)))
+        {
+                fprintf (stderr, "%s - error: malloc () failed.\n", __func__);
+                return -1;
+        }
+
+        if (pthread_create (&compressor_thread, NULL, zout_compressor, NULL))
+        {
+                fprintf (stderr, "%s - error: pthread_create () failed.\n", __func__);
+                return -1;
+        }
+
+        compressor_started = 1;
+
+        atexit (zout_stop);
+
+        return 0;
+}
+
+/****************************************************************************************
+* Function name - zout_stop
+*
+* Description - Finishes the compressed files, left open, lets the compressor to
+*               drain the queue and joins it. Registered by zout_start () to run
+*               at exit.
+*
+* Return Code/Output - None
+****************************************************************************************/
+void zout_stop ()
+{
+        zout_stream* zs;
+
+        if (!compressor_started)
+        {
+                return;
+        }
+
+        /*
+           Files, not closed by their batches, are finished here, since
+           stdio only flushes the cookie files at exit and never closes them.
+         */
+        pthread_mutex_lock (&zout_mutex);
+
+        for (zs = streams; zs; zs = zs->next)
+        {
+                pthread_mutex_unlock (&zout_mutex);
+                fflush (zs->fp);
+                zout_enqueue (zs, NULL, 0, 1);
+                pthread_mutex_lock (&zout_mutex);
+        }
+
+        compressor_stopping = 1;
+        pthread_cond_signal (&zout_work);
+        pthread_mutex_unlock (&zout_mutex);
+
+        pthread_join (compressor_thread, NULL);
+        compressor_started = 0;
+
+        free (out_buffer);
+        out_buffer = NULL;
+}
+
+/****************************************************************************************
+* Function name - zout_fopen
+*
+* Description - Creates a file for writing. With compression, creates <fname>.gz,
+*               written through the compressor thread, otherwise <fname>.
+*
+* Input -       *fname - name of the file
+* Return Code/Output - On Success - FILE pointer, to be closed by fclose (),
+*                      on Error - NULL
+****************************************************************************************/
+FILE* zout_fopen (const char* fname)
+{
+        cookie_io_functions_t io;
+        zout_stream* zs = NULL;
+        char gz_name[PATH_MAX + 4];
+
+        if (!compressor_started)
+        {
+                return fopen (fname, "w");
+        }
+
+        snprintf (gz_name, sizeof (gz_name), "%s.gz", fname);
+
+        if (!(zs = calloc (1, sizeof (zout_stream))))
+        {
+                fprintf (stderr, "%s - error: calloc () failed.\n", __func__);
+                return NULL;
+        }
+
+        if ((zs->fd = open (gz_name, O_WRONLY | O_CREAT | O_TRUNC, 0644)) == -1)
+        {
+                free (zs);
+                return NULL;
+        }
+
+        /* windowBits of 15 + 16 for the gzip wrapper */
+        if (deflateInit2 (&zs->strm, compress_level, Z_DEFLATED, 15 + 16, 8,
+                          Z_DEFAULT_STRATEGY) != Z_OK)
+        {
+                fprintf (stderr, "%s - error: deflateInit2 () failed.\n", __func__);
+                close (zs->fd);
+                free (zs);
+                return NULL;
+        }
+
+        memset (&io, 0, sizeof (io));
+        io.write = zout_cookie_write;
+        io.close = zout_cookie_close;
+
+        if (!(zs->fp = fopencookie (zs, "w", io)))
+        {
+                fprintf (stderr, "%s - error: fopencookie () failed.\n", __func__);
+                deflateEnd (&zs->strm);
+                close (zs->fd);
+                free (zs);
+                return NULL;
+        }
+
+        setvbuf (zs->fp, NULL, _IOFBF, ZOUT_FILE_BUFFER_SIZE);
+
+        pthread_mutex_lock (&zout_mutex);
+        zs->next = streams;
+        streams = zs;
+        pthread_mutex_unlock (&zout_mutex);
+
+        return zs->fp;
+}
+
+/****************************************************************************************
+* Function name - zout_file
+*
+* Description - Tells, whether a file was created by zout_fopen () as compressed.
+*               Compressed files cannot be rewound.
+*
+* Input -       *fp - FILE pointer
+* Return Code/Output - 1, when compressed, otherwise 0
+****************************************************************************************/
+int zout_file (FILE* fp)
+{
+        zout_stream* zs;
+        int found = 0;
+
+        if (!compressor_started)
+        {
+                return 0;
+        }
+
+        pthread_mutex_lock (&zout_mutex);
+
+        for (zs = streams; zs && !found; zs = zs->next)
+        {
+                found = (zs->fp == fp);
+        }
+
+        pthread_mutex_unlock (&zout_mutex);
+
+        return found;
+}
+
+/*
+   Copies the bytes to a block and queues it to the compressor. Waits, when
+   the compressor is behind by more than ZOUT_QUEUE_MAX bytes.
+ */
+static void zout_enqueue (zout_stream* zs, const char* data, size_t len, int finish)
+{
+        zout_block* block = malloc (sizeof (zout_block) + len);
+
+        if (!block)
+        {
+                fprintf (stderr, "%s - error: malloc () failed, %Zu bytes lost.\n",
+                         __func__, len);
+                return;
+        }
+
+        block->next = NULL;
+        block->zs = zs;
+        block->finish = finish;
+        block->len = len;
+
+        if (len)
+        {
+                memcpy (block->data, data, len);
+        }
+
+        pthread_mutex_lock (&zout_mutex);
+
+        while (queued_bytes > ZOUT_QUEUE_MAX && !compressor_stopping)
+        {
+                pthread_cond_wait (&zout_done, &zout_mutex);
+        }
+
+        if (queue_tail)
+                queue_tail->next = block;
+        else
+                queue_head = block;
+
+        queue_tail = block;
+        queued_bytes += len;
+
+        pthread_cond_signal (&zout_work);
+        pthread_mutex_unlock (&zout_mutex);
+}
+
+static ssize_t zout_cookie_write (void* cookie, const char* buf, size_t size)
+{
+        zout_enqueue ((zout_stream *) cookie, buf, size, 0);
+        return size;
+}
+
+/*
+   Called by fclose () after the last write. Queues finishing of the stream
+   and waits for the compressor to close the file.
+ */
+static int zout_cookie_close (void* cookie)
+{
+        zout_stream* zs = (zout_stream *) cookie;
+        zout_stream** pp;
+
+        if (!zs->finished)
+        {
+                zout_enqueue (zs, NULL, 0, 1);
+        }
+
+        pthread_mutex_lock (&zout_mutex);
+
+        while (!zs->finished && compressor_started)
+        {
+                pthread_cond_wait (&zout_done, &zout_mutex);
+        }
+
+        for (pp = &streams; *pp; pp = &(*pp)->next)
+        {
+                if (*pp == zs)
+                {
+                        *pp = zs->next;
+                        break;
+                }
+        }
+
+        pthread_mutex_unlock (&zout_mutex);
+
+        free (zs);
+        return 0;
+}
+
+/*
+   Deflates the data with the flush mode and writes all the output.
+ */
+static int zout_deflate (zout_stream* zs, const char* data, size_t len, int flush)
+{
+        int rval = 0;
+
+        zs->strm.next_in = (unsigned char *) data;
+        zs->strm.avail_in = len;
+
+        do
+        {
+                size_t have, off = 0;
+
+                zs->strm.next_out = out_buffer;
+                zs->strm.avail_out = ZOUT_OUT_BUFFER_SIZE;
+
+                deflate (&zs->strm, flush);
+
+                have = ZOUT_OUT_BUFFER_SIZE - zs->strm.avail_out;
+
+                while (off < have)
+                {
+                        ssize_t n = write (zs->fd, out_buffer + off, have - off);
+
+                        if (n == -1)
+                        {
+                                if (errno == EINTR)
+                                        continue;
+
+                                fprintf (stderr, "%s - error: write () failed with errno %d.\n",
+                                         __func__, errno);
+                                rval = -1;
+                                break;
+                        }
+                        off += n;
+                }
+        }
+        while (zs->strm.avail_out == 0);
+
+        zs->dirty = (flush == Z_NO_FLUSH);
+        return rval;
+}
+
+static void* zout_compressor (void* arg)
+{
+        struct timespec sync_time;
+
+        (void) arg;
+
+        clock_gettime (CLOCK_REALTIME, &sync_time);
+        sync_time.tv_sec += ZOUT_SYNC_PERIOD;
+
+        pthread_mutex_lock (&zout_mutex);
+
+        for (;;)
+        {
+                zout_block* block;
+                zout_stream* zs;
+                zout_stream* sync_list = NULL;
+                struct timespec now;
+
+                while (!queue_head && !compressor_stopping)
+                {
+                        if (pthread_cond_timedwait (&zout_work, &zout_mutex, &sync_time) == ETIMEDOUT)
+                                break;
+                }
+
+                /*
+                   Each period, busy or idle, sync-flush the streams deflated since
+                   the latest sync, so that the files are readable up to the latest
+                   written bytes. A stream is freed only after the compressor has
+                   finished it, thus the collected streams are kept till the flush.
+                 */
+                clock_gettime (CLOCK_REALTIME, &now);
+
+                if (now.tv_sec > sync_time.tv_sec ||
+                    (now.tv_sec == sync_time.tv_sec && now.tv_nsec >= sync_time.tv_nsec))
+                {
+                        for (zs = streams; zs; zs = zs->next)
+                        {
+                                if (zs->dirty && !zs->finished)
+                                {
+                                        zs->sync_next = sync_list;
+                                        sync_list = zs;
+                                }
+                        }
+
+                        sync_time = now;
+                        sync_time.tv_sec += ZOUT_SYNC_PERIOD;
+                }
+
+                if (!queue_head && !sync_list)
+                {
+                        if (compressor_stopping)
+                                break; /* stopping and drained */
+
+                        continue;
+                }
+
+                if ((block = queue_head) && !(queue_head = block->next))
+                        queue_tail = NULL;
+
+                pthread_mutex_unlock (&zout_mutex);
+
+                for (zs = sync_list; zs; zs = zs->sync_next)
+                {
+                        zout_deflate (zs, NULL, 0, Z_SYNC_FLUSH);
+                }
+
+                if (!block)
+                {
+                        pthread_mutex_lock (&zout_mutex);
+                        continue;
+                }
+
+                zs = block->zs;
+
+                if (!zs->finished)
+                {
+                        zout_deflate (zs, block->data, block->len,
+                                      block->finish ? Z_FINISH : Z_NO_FLUSH);
+
+                        if (block->finish)
+                        {
+                                deflateEnd (&zs->strm);
+                                close (zs->fd);
+                        }
+                }
+
+                pthread_mutex_lock (&zout_mutex);
+
+                queued_bytes -= block->len;
+
+                if (block->finish)
+                        zs->finished = 1;
+
+                pthread_cond_broadcast (&zout_done);
+
+                free (block);
+        }
+
+        pthread_mutex_unlock (&zout_mutex);
+
+        return NULL;
+}
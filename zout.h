@@ -0,0 +1,84 @@
+/*
+*     zout.h
+*
+* 2006-2007 Copyright (c)
+* Robert Iakobashvili, <coroberti@gmail.com>
+* Michael Moser,  <moser.michael@gmail.com>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef ZOUT_H
+#define ZOUT_H
+
+#include <stdio.h>
+
+/*
+   Streaming gzip compression of output files (-z command line option).
+
+   A compressed file is a usual FILE*, created by fopencookie () with a large
+   buffer. Each time the buffer is written out, its bytes are queued to a
+   compressor thread, that deflates the queued blocks of all the files and
+   writes them to <file-name>.gz. Once a second the compressor sync-flushes
+   the files, so that they can be read by zcat while loading. When the
+   compressor falls behind by more than the queue limit, writers wait.
+ */
+
+/****************************************************************************************
+* Function name - zout_start
+*
+* Description - Starts the compressor thread, when compression is configured
+*               by -z command line option.
+*
+* Return Code/Output - On Success - 0, on Error -1
+****************************************************************************************/
+int zout_start ();
+
+/****************************************************************************************
+* Function name - zout_stop
+*
+* Description - Finishes the compressed files, left open, lets the compressor to
+*               drain the queue and joins it. Registered by zout_start () to run
+*               at exit.
+*
+* Return Code/Output - None
+****************************************************************************************/
+void zout_stop ();
+
+/****************************************************************************************
+* Function name - zout_fopen
+*
+* Description - Creates a file for writing. With compression, creates <fname>.gz,
+*               written through the compressor thread, otherwise <fname>.
+*
+* Input -       *fname - name of the file
+* Return Code/Output - On Success - FILE pointer, to be closed by fclose (),
+*                      on Error - NULL
+****************************************************************************************/
+FILE* zout_fopen (const char* fname);
+
+/****************************************************************************************
+* Function name - zout_file
+*
+* Description - Tells, whether a file was created by zout_fopen () as compressed.
+*               Compressed files cannot be rewound.
+*
+* Input -       *fp - FILE pointer
+* Return Code/Output - 1, when compressed, otherwise 0
+****************************************************************************************/
+int zout_file (FILE* fp);
+
+#endif /* ZOUT_H */